@@ -0,0 +1,161 @@
+/*
+  Copyright (c) 2010 Gluster, Inc. <http://www.gluster.com>
+  This file is part of GlusterFS.
+
+  GlusterFS is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 3 of the License,
+  or (at your option) any later version.
+
+  GlusterFS is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see
+  <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * checksum-bm: throughput of the rsync checksums used by rchecksum and
+ * the diff self-heal of replicate. Compares the scalar weak checksum with
+ * the kernel picked at runtime, and MD5 with the other strong checksums.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "checksum.h"
+
+#define CHECKSUM_BM_DEFAULT_BLOCK  (128 * 1024)
+#define CHECKSUM_BM_DEFAULT_TOTAL  (1024)       /* MB */
+
+static double
+checksum_bm_elapsed (struct timeval *start)
+{
+        struct timeval end;
+
+        gettimeofday (&end, NULL);
+
+        return (end.tv_sec - start->tv_sec)
+                + (end.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+
+static void
+checksum_bm_report (const char *name, uint64_t bytes, double secs,
+                    double base)
+{
+        double mbps = (bytes / (1024.0 * 1024.0)) / secs;
+
+        if (base > 0)
+                printf ("%-16s %10.1f MB/s  %5.2fx\n", name, mbps,
+                        mbps / base);
+        else
+                printf ("%-16s %10.1f MB/s\n", name, mbps);
+}
+
+
+int
+main (int argc, char *argv[])
+{
+        char           *buf = NULL;
+        uint8_t         sum[16];
+        int32_t         block = CHECKSUM_BM_DEFAULT_BLOCK;
+        uint64_t        total = CHECKSUM_BM_DEFAULT_TOTAL;
+        uint64_t        iters = 0;
+        uint64_t        i = 0;
+        uint32_t        weak = 0;
+        uint32_t        ref = 0;
+        struct timeval  start;
+        double          secs = 0;
+        double          base = 0;
+        int             type = 0;
+        char            name[64];
+
+        if (argc > 1)
+                block = atoi (argv[1]);
+        if (argc > 2)
+                total = strtoull (argv[2], NULL, 0);
+
+        if (block <= 0 || !total) {
+                fprintf (stderr, "usage: %s [block-size] [total-MB]\n",
+                         argv[0]);
+                return 1;
+        }
+
+        buf = malloc (block);
+        if (!buf) {
+                perror ("malloc");
+                return 1;
+        }
+
+        srandom (time (NULL));
+        for (i = 0; i < (uint64_t) block; i++)
+                buf[i] = random ();
+
+        iters = (total * 1024 * 1024) / block;
+        if (!iters)
+                iters = 1;
+
+        /* the runtime kernel must agree with the scalar one at every
+           length, including the odd tails */
+        for (i = 0; i <= 257 && i <= (uint64_t) block; i++) {
+                if (gf_rsync_weak_checksum_scalar (buf, i)
+                    != gf_rsync_weak_checksum (buf, i)) {
+                        fprintf (stderr, "weak checksum mismatch at "
+                                 "length %"PRIu64"\n", i);
+                        return 1;
+                }
+        }
+
+        printf ("block size %d, %"PRIu64" MB per run\n\n", block,
+                (iters * block) >> 20);
+
+        gettimeofday (&start, NULL);
+        for (i = 0; i < iters; i++)
+                ref += gf_rsync_weak_checksum_scalar (buf, block);
+        base = checksum_bm_elapsed (&start);
+        checksum_bm_report ("weak scalar", iters * block, base, 0);
+        base = ((iters * block) / (1024.0 * 1024.0)) / base;
+
+        gettimeofday (&start, NULL);
+        for (i = 0; i < iters; i++)
+                weak += gf_rsync_weak_checksum (buf, block);
+        secs = checksum_bm_elapsed (&start);
+        snprintf (name, sizeof (name), "weak %s",
+                  gf_rsync_weak_checksum_impl ());
+        checksum_bm_report (name, iters * block, secs, base);
+
+        if (weak != ref) {
+                fprintf (stderr, "weak checksum mismatch\n");
+                return 1;
+        }
+
+        printf ("\n");
+        base = 0;
+
+        for (type = 0; type < GF_RSYNC_STRONG_MAX; type++) {
+                gettimeofday (&start, NULL);
+                for (i = 0; i < iters; i++)
+                        gf_rsync_strong_checksum_type (type, buf, block, sum);
+                secs = checksum_bm_elapsed (&start);
+
+                snprintf (name, sizeof (name), "strong %s",
+                          gf_rsync_strong_type_name (type));
+                checksum_bm_report (name, iters * block, secs, base);
+
+                if (!base)
+                        base = ((iters * block) / (1024.0 * 1024.0)) / secs;
+        }
+
+        free (buf);
+
+        return 0;
+}
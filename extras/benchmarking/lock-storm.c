@@ -0,0 +1,278 @@
+/*
+  Copyright (c) 2010 Gluster, Inc. <http://www.gluster.com>
+  This file is part of GlusterFS.
+
+  GlusterFS is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 3 of the License,
+  or (at your option) any later version.
+
+  GlusterFS is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see
+  <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * lock-storm: byte-range lock throughput on a single file, the way
+ * databases and MPI-IO use it. Several processes each pile up a set of
+ * small non-adjacent write locks on the file, then take and drop locks
+ * on the free bytes in between, contending with each other, and probe
+ * the held ones with F_GETLK; finally everything is unlocked one range
+ * at a time.
+ * Run it against a file on a glusterfs mount.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define LOCK_STORM_DEFAULT_PROCS   4
+#define LOCK_STORM_DEFAULT_HELD    2000
+#define LOCK_STORM_DEFAULT_OPS     20000
+
+enum {
+        LOCK_STORM_HOLD,
+        LOCK_STORM_CONTEND,
+        LOCK_STORM_RELEASE,
+        LOCK_STORM_PHASES
+};
+
+static const char *lock_storm_phase_names[LOCK_STORM_PHASES] = {
+        "hold", "contend", "release"
+};
+
+
+static double
+lock_storm_elapsed (struct timeval *start)
+{
+        struct timeval end;
+
+        gettimeofday (&end, NULL);
+
+        return (end.tv_sec - start->tv_sec)
+                + (end.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+
+static int
+lock_storm_lock (int fd, int cmd, short type, off_t start, off_t len)
+{
+        struct flock lock = {0, };
+
+        lock.l_type   = type;
+        lock.l_whence = SEEK_SET;
+        lock.l_start  = start;
+        lock.l_len    = len;
+
+        while (fcntl (fd, cmd, &lock) == -1) {
+                if (errno != EINTR)
+                        return -1;
+        }
+
+        return 0;
+}
+
+
+/* Process @id of @procs holds bytes (i * procs + id) * 2 for i < @held,
+   so no two ranges of the same process touch and get merged. */
+static int
+lock_storm_child (const char *path, int id, int procs, int held, int ops,
+                  int rfd, int wfd)
+{
+        double  secs[LOCK_STORM_PHASES] = {0, };
+        struct  timeval start;
+        off_t   span = (off_t) held * procs * 2;
+        off_t   offset = 0;
+        short   type = 0;
+        char    go = 0;
+        int     fd = -1;
+        int     i = 0;
+
+        fd = open (path, O_RDWR);
+        if (fd == -1) {
+                perror (path);
+                return 1;
+        }
+
+        srandom (getpid ());
+
+        /* wait for everyone to have the file open */
+        if (read (rfd, &go, 1) != 1)
+                return 1;
+
+        gettimeofday (&start, NULL);
+        for (i = 0; i < held; i++) {
+                offset = ((off_t) i * procs + id) * 2;
+                if (lock_storm_lock (fd, F_SETLKW, F_WRLCK, offset, 1)) {
+                        perror ("hold");
+                        return 1;
+                }
+        }
+        secs[LOCK_STORM_HOLD] = lock_storm_elapsed (&start);
+
+        /* the odd bytes are free and fought over, the even ones are
+           held and only probed */
+        gettimeofday (&start, NULL);
+        for (i = 0; i < ops; i++) {
+                offset = random () % span;
+                type = (random () & 1) ? F_WRLCK : F_RDLCK;
+
+                if (!(offset & 1)) {
+                        if (lock_storm_lock (fd, F_GETLK, type, offset, 1)) {
+                                perror ("probe");
+                                return 1;
+                        }
+                        continue;
+                }
+
+                if (lock_storm_lock (fd, F_SETLK, type, offset, 1) == 0)
+                        lock_storm_lock (fd, F_SETLK, F_UNLCK, offset, 1);
+                else if ((errno != EAGAIN) && (errno != EACCES)) {
+                        perror ("contend");
+                        return 1;
+                }
+        }
+        secs[LOCK_STORM_CONTEND] = lock_storm_elapsed (&start);
+
+        gettimeofday (&start, NULL);
+        for (i = 0; i < held; i++) {
+                offset = ((off_t) i * procs + id) * 2;
+                if (lock_storm_lock (fd, F_SETLK, F_UNLCK, offset, 1)) {
+                        perror ("release");
+                        return 1;
+                }
+        }
+        secs[LOCK_STORM_RELEASE] = lock_storm_elapsed (&start);
+
+        close (fd);
+
+        if (write (wfd, secs, sizeof (secs)) != sizeof (secs))
+                return 1;
+
+        return 0;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+        double  secs[LOCK_STORM_PHASES];
+        double  worst[LOCK_STORM_PHASES] = {0, };
+        char   *path = NULL;
+        int     procs = LOCK_STORM_DEFAULT_PROCS;
+        int     held = LOCK_STORM_DEFAULT_HELD;
+        int     ops = LOCK_STORM_DEFAULT_OPS;
+        int     start_pipe[2];
+        int     result_pipe[2];
+        int     failed = 0;
+        int     status = 0;
+        int     fd = -1;
+        int     i = 0;
+        int     j = 0;
+        pid_t   pid = 0;
+
+        if (argc < 2) {
+                fprintf (stderr, "usage: %s <file> [processes] "
+                         "[held-locks-per-process] [ops-per-process]\n",
+                         argv[0]);
+                return 1;
+        }
+
+        path = argv[1];
+        if (argc > 2)
+                procs = atoi (argv[2]);
+        if (argc > 3)
+                held = atoi (argv[3]);
+        if (argc > 4)
+                ops = atoi (argv[4]);
+
+        if (procs <= 0 || held <= 0 || ops < 0) {
+                fprintf (stderr, "bad arguments\n");
+                return 1;
+        }
+
+        fd = open (path, O_RDWR | O_CREAT, 0644);
+        if (fd == -1) {
+                perror (path);
+                return 1;
+        }
+        close (fd);
+
+        if (pipe (start_pipe) || pipe (result_pipe)) {
+                perror ("pipe");
+                return 1;
+        }
+
+        for (i = 0; i < procs; i++) {
+                pid = fork ();
+                if (pid == -1) {
+                        perror ("fork");
+                        return 1;
+                }
+                if (pid == 0) {
+                        close (start_pipe[1]);
+                        close (result_pipe[0]);
+                        _exit (lock_storm_child (path, i, procs, held, ops,
+                                                 start_pipe[0],
+                                                 result_pipe[1]));
+                }
+        }
+
+        close (start_pipe[0]);
+        close (result_pipe[1]);
+
+        for (i = 0; i < procs; i++) {
+                if (write (start_pipe[1], "g", 1) != 1) {
+                        perror ("write");
+                        return 1;
+                }
+        }
+
+        for (i = 0; i < procs; i++) {
+                if (read (result_pipe[0], secs, sizeof (secs))
+                    != sizeof (secs))
+                        break;
+
+                for (j = 0; j < LOCK_STORM_PHASES; j++) {
+                        if (secs[j] > worst[j])
+                                worst[j] = secs[j];
+                }
+        }
+
+        while (wait (&status) > 0) {
+                if (!WIFEXITED (status) || WEXITSTATUS (status))
+                        failed = 1;
+        }
+
+        if (failed || i != procs) {
+                fprintf (stderr, "some of the processes failed\n");
+                return 1;
+        }
+
+        printf ("%d processes, %d locks held each, %d ops each\n\n",
+                procs, held, ops);
+
+        /* the slowest process sets the pace of each phase */
+        for (j = 0; j < LOCK_STORM_PHASES; j++) {
+                int count = (j == LOCK_STORM_CONTEND) ? ops : held;
+
+                printf ("%-8s %10.3f s  %12.1f locks/s\n",
+                        lock_storm_phase_names[j], worst[j],
+                        worst[j] ? ((double) count * procs) / worst[j] : 0);
+        }
+
+        return 0;
+}
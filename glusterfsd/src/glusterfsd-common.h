@@ -26,5 +26,8 @@
 #define ZR_DIRECT_IO_OPT        "direct-io-mode"
 #define ZR_STRICT_VOLFILE_CHECK "strict-volfile-check"
 #define ZR_DUMP_FUSE            "dump-fuse"
+#define ZR_READER_THREAD_COUNT_OPT "reader-thread-count"
+#define ZR_USE_READDIRP_OPT     "use-readdirp"
+#define ZR_SPLICE_OPT           "splice"
 
 #endif
@@ -156,6 +156,8 @@ static struct argp_option gf_options[] = {
          "[default: \"off\"]"
 #endif
         },
+        {"event-threads", ARGP_EVENT_THREADS_KEY, "COUNT", 0,
+         "Number of threads dispatching network events [default: 1]"},
         {"brick-name", ARGP_BRICK_NAME_KEY, "BRICK-NAME", OPTION_HIDDEN,
          "Brick name to be registered with Gluster portmapper" },
         {"brick-port", ARGP_BRICK_PORT_KEY, "BRICK-PORT", OPTION_HIDDEN,
@@ -175,6 +177,14 @@ static struct argp_option gf_options[] = {
          "client will authenticate itself with process id PID to server"},
         {"dump-fuse", ARGP_DUMP_FUSE_KEY, "PATH", 0,
          "Dump fuse traffic to PATH"},
+        {"reader-thread-count", ARGP_READER_THREAD_COUNT_KEY, "COUNT", 0,
+         "Number of threads reading requests from /dev/fuse [default: 1]"},
+        {"use-readdirp", ARGP_USE_READDIRP_KEY, "BOOL", OPTION_ARG_OPTIONAL,
+         "Let the fuse kernel module read directories with READDIRPLUS "
+         "[default: \"on\"]"},
+        {"splice", ARGP_SPLICE_KEY, "BOOL", OPTION_ARG_OPTIONAL,
+         "Hand replies to the fuse kernel module with splice "
+         "[default: \"off\"]"},
         {"volfile-check", ARGP_VOLFILE_CHECK_KEY, 0, 0,
          "Enable strict volume file checking"},
         {0, 0, 0, 0, "Miscellaneous Options:"},
@@ -258,6 +268,40 @@ create_fuse_mount (glusterfs_ctx_t *ctx)
                 }
         }
 
+        if (cmd_args->fuse_reader_thread_count) {
+                ret = dict_set_int32 (master->options,
+                                      ZR_READER_THREAD_COUNT_OPT,
+                                      cmd_args->fuse_reader_thread_count);
+                if (ret < 0) {
+                        gf_log ("glusterfsd", GF_LOG_ERROR,
+                                "failed to set dict value.");
+                        goto err;
+                }
+        }
+
+        if (cmd_args->fuse_use_readdirp != GF_OPTION_DEFERRED) {
+                ret = dict_set_static_ptr (master->options,
+                                           ZR_USE_READDIRP_OPT,
+                                           cmd_args->fuse_use_readdirp ?
+                                           "on" : "off");
+                if (ret < 0) {
+                        gf_log ("glusterfsd", GF_LOG_ERROR,
+                                "failed to set dict value.");
+                        goto err;
+                }
+        }
+
+        if (cmd_args->fuse_splice != GF_OPTION_DEFERRED) {
+                ret = dict_set_static_ptr (master->options, ZR_SPLICE_OPT,
+                                           cmd_args->fuse_splice ?
+                                           "on" : "off");
+                if (ret < 0) {
+                        gf_log ("glusterfsd", GF_LOG_ERROR,
+                                "failed to set dict value.");
+                        goto err;
+                }
+        }
+
         if (cmd_args->volfile_check) {
                 ret = dict_set_int32 (master->options, ZR_STRICT_VOLFILE_CHECK,
                                       cmd_args->volfile_check);
@@ -665,6 +709,58 @@ parse_opts (int key, char *arg, struct argp_state *state)
                 argp_failure (state, -1, 0,
                               "unknown brick (listen) port %s", arg);
                 break;
+
+        case ARGP_EVENT_THREADS_KEY:
+                n = 0;
+
+                if (gf_string2uint_base10 (arg, &n) == 0 && n > 0) {
+                        cmd_args->event_threads = n;
+                        break;
+                }
+
+                argp_failure (state, -1, 0,
+                              "invalid event thread count %s", arg);
+                break;
+
+        case ARGP_READER_THREAD_COUNT_KEY:
+                n = 0;
+
+                if (gf_string2uint_base10 (arg, &n) == 0 && n > 0) {
+                        cmd_args->fuse_reader_thread_count = n;
+                        break;
+                }
+
+                argp_failure (state, -1, 0,
+                              "invalid reader thread count %s", arg);
+                break;
+
+        case ARGP_USE_READDIRP_KEY:
+                if (!arg)
+                        arg = "on";
+
+                if (gf_string2boolean (arg, &b) == 0) {
+                        cmd_args->fuse_use_readdirp = b;
+
+                        break;
+                }
+
+                argp_failure (state, -1, 0,
+                              "unknown use-readdirp setting \"%s\"", arg);
+                break;
+
+        case ARGP_SPLICE_KEY:
+                if (!arg)
+                        arg = "on";
+
+                if (gf_string2boolean (arg, &b) == 0) {
+                        cmd_args->fuse_splice = b;
+
+                        break;
+                }
+
+                argp_failure (state, -1, 0,
+                              "unknown splice setting \"%s\"", arg);
+                break;
         }
 
         return 0;
@@ -950,6 +1046,9 @@ glusterfs_ctx_defaults_init (glusterfs_ctx_t *ctx)
 #endif
         cmd_args->fuse_attribute_timeout = -1;
         cmd_args->fuse_entry_timeout = -1;
+        cmd_args->fuse_use_readdirp = GF_OPTION_DEFERRED;
+        cmd_args->fuse_splice = GF_OPTION_DEFERRED;
+        cmd_args->event_threads = DEFAULT_EVENT_THREADS;
 
         INIT_LIST_HEAD (&cmd_args->xlator_options);
 
@@ -1435,6 +1534,12 @@ main (int argc, char *argv[])
         if (ret)
                 goto out;
 
+        /* must happen before any transport registers with the pool */
+        ret = event_pool_set_threads (ctx->event_pool,
+                                      ctx->cmd_args.event_threads);
+        if (ret)
+                goto out;
+
         ret = glusterfs_volumes_init (ctx);
         if (ret)
                 goto out;
@@ -34,6 +34,7 @@
 #define DEFAULT_LOG_LEVEL                     GF_LOG_NORMAL
 
 #define DEFAULT_EVENT_POOL_SIZE            16384
+#define DEFAULT_EVENT_THREADS              1
 
 #define ARGP_LOG_LEVEL_NONE_OPTION        "NONE"
 #define ARGP_LOG_LEVEL_TRACE_OPTION       "TRACE"
@@ -76,6 +77,10 @@ enum argp_option_keys {
         ARGP_BRICK_NAME_KEY = 151,
         ARGP_BRICK_PORT_KEY = 152,
         ARGP_CLIENT_PID_KEY = 153,
+        ARGP_EVENT_THREADS_KEY = 154,
+        ARGP_READER_THREAD_COUNT_KEY = 155,
+        ARGP_USE_READDIRP_KEY = 156,
+        ARGP_SPLICE_KEY = 157,
 };
 
 int glusterfs_mgmt_pmap_signout (glusterfs_ctx_t *ctx);
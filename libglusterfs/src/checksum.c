@@ -34,7 +34,7 @@
  */
 
 uint32_t
-gf_rsync_weak_checksum (char *buf1, int32_t len)
+gf_rsync_weak_checksum_scalar (char *buf1, int32_t len)
 {
         int32_t i;
         uint32_t s1, s2;
@@ -60,6 +60,183 @@ gf_rsync_weak_checksum (char *buf1, int32_t len)
 }
 
 
+/*
+ * Vector versions of the weak checksum. Over a block of n bytes the
+ * checksum advances as
+ *
+ *      s2 += n * s1 + sum ((n - j) * buf[j])
+ *      s1 += sum (buf[j])
+ *
+ * pmaddubsw gives us both sums (with weights 1 and n..1) in one go. All the
+ * arithmetic is modulo 2^32, so the per-lane partial sums add up to exactly
+ * what the scalar loop computes.
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) \
+        && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define GF_RSYNC_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+static uint32_t
+gf_rsync_weak_checksum_tail (signed char *buf, int32_t i, int32_t len,
+                             uint32_t s1, uint32_t s2)
+{
+        for (; i < len; i++) {
+                s1 += buf[i];
+                s2 += s1;
+        }
+
+        return (s1 & 0xffff) + (s2 << 16);
+}
+
+
+#ifdef GF_RSYNC_X86_KERNELS
+
+__attribute__ ((target ("ssse3")))
+static uint32_t
+gf_rsync_weak_checksum_ssse3 (char *buf1, int32_t len)
+{
+        signed char *buf = (signed char *) buf1;
+        int32_t      i = 0;
+        int          j = 0;
+        uint32_t     s1 = 0;
+        uint32_t     s2 = 0;
+        uint32_t     lanes[3][4];
+        __m128i      weights;
+        __m128i      ones8;
+        __m128i      ones16;
+        __m128i      data;
+        __m128i      vs1;
+        __m128i      vs1_prev;
+        __m128i      vs2;
+
+        weights = _mm_setr_epi8 (16, 15, 14, 13, 12, 11, 10, 9,
+                                 8, 7, 6, 5, 4, 3, 2, 1);
+        ones8  = _mm_set1_epi8 (1);
+        ones16 = _mm_set1_epi16 (1);
+        vs1 = vs1_prev = vs2 = _mm_setzero_si128 ();
+
+        for (i = 0; i + 16 <= len; i += 16) {
+                data = _mm_loadu_si128 ((__m128i *) (buf + i));
+
+                vs1_prev = _mm_add_epi32 (vs1_prev, vs1);
+                vs1 = _mm_add_epi32 (vs1, _mm_madd_epi16 (
+                                       _mm_maddubs_epi16 (ones8, data),
+                                       ones16));
+                vs2 = _mm_add_epi32 (vs2, _mm_madd_epi16 (
+                                       _mm_maddubs_epi16 (weights, data),
+                                       ones16));
+        }
+
+        _mm_storeu_si128 ((__m128i *) lanes[0], vs1);
+        _mm_storeu_si128 ((__m128i *) lanes[1], vs1_prev);
+        _mm_storeu_si128 ((__m128i *) lanes[2], vs2);
+
+        for (j = 0; j < 4; j++) {
+                s1 += lanes[0][j];
+                s2 += 16 * lanes[1][j] + lanes[2][j];
+        }
+
+        return gf_rsync_weak_checksum_tail (buf, i, len, s1, s2);
+}
+
+
+__attribute__ ((target ("avx2")))
+static uint32_t
+gf_rsync_weak_checksum_avx2 (char *buf1, int32_t len)
+{
+        signed char *buf = (signed char *) buf1;
+        int32_t      i = 0;
+        int          j = 0;
+        uint32_t     s1 = 0;
+        uint32_t     s2 = 0;
+        uint32_t     lanes[3][8];
+        __m256i      weights;
+        __m256i      ones8;
+        __m256i      ones16;
+        __m256i      data;
+        __m256i      vs1;
+        __m256i      vs1_prev;
+        __m256i      vs2;
+
+        weights = _mm256_setr_epi8 (32, 31, 30, 29, 28, 27, 26, 25,
+                                    24, 23, 22, 21, 20, 19, 18, 17,
+                                    16, 15, 14, 13, 12, 11, 10, 9,
+                                    8, 7, 6, 5, 4, 3, 2, 1);
+        ones8  = _mm256_set1_epi8 (1);
+        ones16 = _mm256_set1_epi16 (1);
+        vs1 = vs1_prev = vs2 = _mm256_setzero_si256 ();
+
+        for (i = 0; i + 32 <= len; i += 32) {
+                data = _mm256_loadu_si256 ((__m256i *) (buf + i));
+
+                vs1_prev = _mm256_add_epi32 (vs1_prev, vs1);
+                vs1 = _mm256_add_epi32 (vs1, _mm256_madd_epi16 (
+                                          _mm256_maddubs_epi16 (ones8, data),
+                                          ones16));
+                vs2 = _mm256_add_epi32 (vs2, _mm256_madd_epi16 (
+                                          _mm256_maddubs_epi16 (weights, data),
+                                          ones16));
+        }
+
+        _mm256_storeu_si256 ((__m256i *) lanes[0], vs1);
+        _mm256_storeu_si256 ((__m256i *) lanes[1], vs1_prev);
+        _mm256_storeu_si256 ((__m256i *) lanes[2], vs2);
+
+        for (j = 0; j < 8; j++) {
+                s1 += lanes[0][j];
+                s2 += 32 * lanes[1][j] + lanes[2][j];
+        }
+
+        return gf_rsync_weak_checksum_tail (buf, i, len, s1, s2);
+}
+
+#endif /* GF_RSYNC_X86_KERNELS */
+
+
+static pthread_once_t   gf_rsync_weak_once = PTHREAD_ONCE_INIT;
+static uint32_t       (*gf_rsync_weak_fn) (char *buf, int32_t len);
+static const char      *gf_rsync_weak_name;
+
+static void
+gf_rsync_weak_checksum_select (void)
+{
+        gf_rsync_weak_fn   = gf_rsync_weak_checksum_scalar;
+        gf_rsync_weak_name = "scalar";
+
+#ifdef GF_RSYNC_X86_KERNELS
+        __builtin_cpu_init ();
+
+        if (__builtin_cpu_supports ("avx2")) {
+                gf_rsync_weak_fn   = gf_rsync_weak_checksum_avx2;
+                gf_rsync_weak_name = "avx2";
+        } else if (__builtin_cpu_supports ("ssse3")) {
+                gf_rsync_weak_fn   = gf_rsync_weak_checksum_ssse3;
+                gf_rsync_weak_name = "ssse3";
+        }
+#endif
+}
+
+
+uint32_t
+gf_rsync_weak_checksum (char *buf, int32_t len)
+{
+        pthread_once (&gf_rsync_weak_once, gf_rsync_weak_checksum_select);
+
+        return gf_rsync_weak_fn (buf, len);
+}
+
+
+const char *
+gf_rsync_weak_checksum_impl (void)
+{
+        pthread_once (&gf_rsync_weak_once, gf_rsync_weak_checksum_select);
+
+        return gf_rsync_weak_name;
+}
+
+
 /*
  * The "strong" checksum required for the rsync algorithm,
  * adapted from the rsync source code.
@@ -76,3 +253,163 @@ gf_rsync_strong_checksum (char *buf, int32_t len, uint8_t *sum)
 
         return;
 }
+
+
+/*
+ * MurmurHash3 x64 128 by Austin Appleby (public domain). Several times
+ * faster than MD5 and good enough to compare blocks between replicas
+ * which trust each other. Input and output are read and written little
+ * endian so that bricks of different byte order agree.
+ */
+
+#define GF_ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+static inline uint64_t
+gf_load_le64 (const uint8_t *p)
+{
+        return ((uint64_t) p[0])       | ((uint64_t) p[1] << 8)
+                | ((uint64_t) p[2] << 16) | ((uint64_t) p[3] << 24)
+                | ((uint64_t) p[4] << 32) | ((uint64_t) p[5] << 40)
+                | ((uint64_t) p[6] << 48) | ((uint64_t) p[7] << 56);
+}
+
+
+static inline void
+gf_store_le64 (uint8_t *p, uint64_t v)
+{
+        int i = 0;
+
+        for (i = 0; i < 8; i++)
+                p[i] = (uint8_t) (v >> (8 * i));
+}
+
+
+static inline uint64_t
+gf_murmur3_fmix64 (uint64_t k)
+{
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdULL;
+        k ^= k >> 33;
+        k *= 0xc4ceb9fe1a85ec53ULL;
+        k ^= k >> 33;
+
+        return k;
+}
+
+
+static void
+gf_murmur3_128 (const uint8_t *data, int32_t len, uint8_t *out)
+{
+        const uint64_t  c1 = 0x87c37b91114253d5ULL;
+        const uint64_t  c2 = 0x4cf5ad432745937fULL;
+        const uint8_t  *tail = NULL;
+        uint64_t        h1 = 0;
+        uint64_t        h2 = 0;
+        uint64_t        k1 = 0;
+        uint64_t        k2 = 0;
+        int32_t         nblocks = 0;
+        int32_t         i = 0;
+
+        nblocks = len / 16;
+
+        for (i = 0; i < nblocks; i++) {
+                k1 = gf_load_le64 (data + (i * 16));
+                k2 = gf_load_le64 (data + (i * 16) + 8);
+
+                k1 *= c1; k1 = GF_ROTL64 (k1, 31); k1 *= c2; h1 ^= k1;
+
+                h1 = GF_ROTL64 (h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+
+                k2 *= c2; k2 = GF_ROTL64 (k2, 33); k2 *= c1; h2 ^= k2;
+
+                h2 = GF_ROTL64 (h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+        }
+
+        tail = data + (nblocks * 16);
+        k1 = k2 = 0;
+
+        switch (len & 15) {
+        case 15: k2 ^= ((uint64_t) tail[14]) << 48;     /* fall through */
+        case 14: k2 ^= ((uint64_t) tail[13]) << 40;     /* fall through */
+        case 13: k2 ^= ((uint64_t) tail[12]) << 32;     /* fall through */
+        case 12: k2 ^= ((uint64_t) tail[11]) << 24;     /* fall through */
+        case 11: k2 ^= ((uint64_t) tail[10]) << 16;     /* fall through */
+        case 10: k2 ^= ((uint64_t) tail[9]) << 8;       /* fall through */
+        case  9: k2 ^= ((uint64_t) tail[8]);
+                k2 *= c2; k2 = GF_ROTL64 (k2, 33); k2 *= c1; h2 ^= k2;
+                                                        /* fall through */
+        case  8: k1 ^= ((uint64_t) tail[7]) << 56;      /* fall through */
+        case  7: k1 ^= ((uint64_t) tail[6]) << 48;      /* fall through */
+        case  6: k1 ^= ((uint64_t) tail[5]) << 40;      /* fall through */
+        case  5: k1 ^= ((uint64_t) tail[4]) << 32;      /* fall through */
+        case  4: k1 ^= ((uint64_t) tail[3]) << 24;      /* fall through */
+        case  3: k1 ^= ((uint64_t) tail[2]) << 16;      /* fall through */
+        case  2: k1 ^= ((uint64_t) tail[1]) << 8;       /* fall through */
+        case  1: k1 ^= ((uint64_t) tail[0]);
+                k1 *= c1; k1 = GF_ROTL64 (k1, 31); k1 *= c2; h1 ^= k1;
+        }
+
+        h1 ^= (uint64_t) len;
+        h2 ^= (uint64_t) len;
+
+        h1 += h2;
+        h2 += h1;
+
+        h1 = gf_murmur3_fmix64 (h1);
+        h2 = gf_murmur3_fmix64 (h2);
+
+        h1 += h2;
+        h2 += h1;
+
+        gf_store_le64 (out, h1);
+        gf_store_le64 (out + 8, h2);
+}
+
+
+static const char *gf_rsync_strong_names[GF_RSYNC_STRONG_MAX] = {
+        [GF_RSYNC_STRONG_MD5]     = "md5",
+        [GF_RSYNC_STRONG_MURMUR3] = "murmur3",
+};
+
+
+void
+gf_rsync_strong_checksum_type (gf_rsync_strong_type_t type, char *buf,
+                               int32_t len, uint8_t *sum)
+{
+        switch (type) {
+        case GF_RSYNC_STRONG_MURMUR3:
+                gf_murmur3_128 ((uint8_t *) buf, len, sum);
+                break;
+        case GF_RSYNC_STRONG_MD5:
+        default:
+                gf_rsync_strong_checksum (buf, len, sum);
+                break;
+        }
+}
+
+
+int
+gf_rsync_strong_type_get (const char *name)
+{
+        int i = 0;
+
+        if (!name)
+                return -1;
+
+        for (i = 0; i < GF_RSYNC_STRONG_MAX; i++) {
+                if (strcasecmp (name, gf_rsync_strong_names[i]) == 0)
+                        return i;
+        }
+
+        return -1;
+}
+
+
+const char *
+gf_rsync_strong_type_name (gf_rsync_strong_type_t type)
+{
+        if (type < 0 || type >= GF_RSYNC_STRONG_MAX)
+                return NULL;
+
+        return gf_rsync_strong_names[type];
+}
@@ -20,10 +20,33 @@
 #ifndef __CHECKSUM_H__
 #define __CHECKSUM_H__
 
+/* strong checksums are all MD5_DIGEST_LEN (16) bytes long */
+typedef enum {
+        GF_RSYNC_STRONG_MD5 = 0,
+        GF_RSYNC_STRONG_MURMUR3,       /* MurmurHash3 x64 128, not crypto */
+        GF_RSYNC_STRONG_MAX,
+} gf_rsync_strong_type_t;
+
 uint32_t
 gf_rsync_weak_checksum (char *buf, int32_t len);
 
+uint32_t
+gf_rsync_weak_checksum_scalar (char *buf, int32_t len);
+
+const char *
+gf_rsync_weak_checksum_impl (void);
+
 void
 gf_rsync_strong_checksum (char *buf, int32_t len, uint8_t *sum);
 
+void
+gf_rsync_strong_checksum_type (gf_rsync_strong_type_t type, char *buf,
+                               int32_t len, uint8_t *sum);
+
+int
+gf_rsync_strong_type_get (const char *name);
+
+const char *
+gf_rsync_strong_type_name (gf_rsync_strong_type_t type);
+
 #endif /* __CHECKSUM_H__ */
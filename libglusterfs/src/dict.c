@@ -36,25 +36,67 @@
 #include "compat.h"
 #include "byte-order.h"
 
+/* dicts, pairs and values are short lived and made by the thousand for
+   every fop, they come out of process wide pools */
+#define DICT_POOL_COUNT       1024
+#define DATA_PAIR_POOL_COUNT  4096
+#define DATA_POOL_COUNT       4096
+
+/* up to this many keys a walk of members_list beats maintaining an
+   index, and most dicts never get past it */
+#define DICT_SMALL_COUNT      8
+#define DICT_INDEX_MIN_SIZE   32
+
+static struct mem_pool *dict_pool;
+static struct mem_pool *data_pair_pool;
+static struct mem_pool *data_pool;
+static pthread_once_t   dict_pools_once = PTHREAD_ONCE_INIT;
+
+static void
+dict_pools_init (void)
+{
+        dict_pool      = mem_pool_new (dict_t, DICT_POOL_COUNT);
+        data_pair_pool = mem_pool_new (data_pair_t, DATA_PAIR_POOL_COUNT);
+        data_pool      = mem_pool_new (data_t, DATA_POOL_COUNT);
+
+        if (!dict_pool || !data_pair_pool || !data_pool)
+                gf_log ("dict", GF_LOG_CRITICAL,
+                        "failed to create the dict mem pools");
+}
+
 data_pair_t *
 get_new_data_pair ()
 {
 	data_pair_t *data_pair_ptr = NULL;
 
-	data_pair_ptr = (data_pair_t *) GF_CALLOC (1, sizeof (data_pair_t),
-                                                   gf_common_mt_data_pair_t);
+        pthread_once (&dict_pools_once, dict_pools_init);
+
+	data_pair_ptr = mem_get0 (data_pair_pool);
         if (!data_pair_ptr)
                 gf_log ("dict", GF_LOG_ERROR, "memory alloc failed");
 
 	return data_pair_ptr;
 }
 
+static void
+data_pair_destroy (data_pair_t *pair)
+{
+        data_unref (pair->value);
+
+        if (pair->key != pair->key_buf)
+                GF_FREE (pair->key);
+
+        mem_put (data_pair_pool, pair);
+}
+
 data_t *
 get_new_data ()
 {
 	data_t *data = NULL;
 
-	data = (data_t *) GF_CALLOC (1, sizeof (data_t), gf_common_mt_data_t);
+        pthread_once (&dict_pools_once, dict_pools_init);
+
+	data = mem_get0 (data_pool);
 	if (!data) {
 		gf_log ("dict", GF_LOG_CRITICAL,
 			"calloc () returned NULL");
@@ -65,26 +107,114 @@ get_new_data ()
 	return data;
 }
 
+static void
+_dict_index_insert (dict_t *this, data_pair_t *pair)
+{
+        uint32_t mask = this->hash_size - 1;
+        uint32_t i    = 0;
+
+        for (i = pair->key_hash & mask; this->members[i]; i = (i + 1) & mask)
+                ;
+
+        this->members[i] = pair;
+}
+
+/* (Re)build the index with @size slots. If that cannot be had the
+   dict goes back to walking members_list, which is slow but correct. */
+static void
+_dict_index_resize (dict_t *this, int32_t size)
+{
+        data_pair_t *pair = NULL;
+
+        if (this->members)
+                GF_FREE (this->members);
+
+        this->members = GF_CALLOC (size, sizeof (data_pair_t *),
+                                   gf_common_mt_data_pair_t);
+        if (!this->members) {
+                gf_log ("dict", GF_LOG_WARNING,
+                        "failed to grow the index of a dict with %d keys",
+                        this->count);
+                this->hash_size = 0;
+                return;
+        }
+
+        this->hash_size = size;
+
+        for (pair = this->members_list; pair; pair = pair->next)
+                _dict_index_insert (this, pair);
+}
+
+/* called with @pair already on members_list and counted */
+static void
+_dict_index_add (dict_t *this, data_pair_t *pair)
+{
+        if (!this->members) {
+                if (this->count > DICT_SMALL_COUNT)
+                        _dict_index_resize (this, DICT_INDEX_MIN_SIZE);
+                return;
+        }
+
+        /* keep the load at a half at most */
+        if (this->count * 2 > this->hash_size) {
+                _dict_index_resize (this, this->hash_size * 2);
+                return;
+        }
+
+        _dict_index_insert (this, pair);
+}
+
+/* Linear probing allows deleting without tombstones: every entry
+   after the hole that would have liked to be in it or before it is
+   moved back into it. */
+static void
+_dict_index_remove (dict_t *this, data_pair_t *pair)
+{
+        uint32_t mask = this->hash_size - 1;
+        uint32_t hole = 0;
+        uint32_t i    = 0;
+        uint32_t home = 0;
+
+        for (hole = pair->key_hash & mask; this->members[hole] != pair;
+             hole = (hole + 1) & mask)
+                ;
+
+        for (i = (hole + 1) & mask; this->members[i]; i = (i + 1) & mask) {
+                home = this->members[i]->key_hash & mask;
+
+                /* stays put if home lies cyclically in (hole, i] */
+                if ((hole < i) ? ((home > hole) && (home <= i))
+                               : ((home > hole) || (home <= i)))
+                        continue;
+
+                this->members[hole] = this->members[i];
+                hole = i;
+        }
+
+        this->members[hole] = NULL;
+}
+
 dict_t *
 get_new_dict_full (int size_hint)
 {
-	dict_t *dict = GF_CALLOC (1, sizeof (dict_t), gf_common_mt_dict_t);
+        dict_t *dict = NULL;
+        int32_t size = DICT_INDEX_MIN_SIZE;
+
+        pthread_once (&dict_pools_once, dict_pools_init);
 
+	dict = mem_get0 (dict_pool);
 	if (!dict) {
 		gf_log ("dict", GF_LOG_CRITICAL,
 			"calloc () returned NULL");
 		return NULL;
 	}
 
-	dict->hash_size = size_hint;
-	dict->members = GF_CALLOC (size_hint, sizeof (data_pair_t *),
-                                   gf_common_mt_data_pair_t);
-
-	if (!dict->members) {
-		gf_log ("dict", GF_LOG_CRITICAL,
-			"calloc () returned NULL");
-		return NULL;
-	}
+        /* room for @size_hint keys without growing */
+        if (size_hint > DICT_SMALL_COUNT) {
+                while (size < size_hint * 2)
+                        size *= 2;
+                _dict_index_resize (dict, size);
+        }
 
 	LOCK_INIT (&dict->lock);
 
@@ -150,9 +280,12 @@ data_destroy (data_t *data)
 				GF_FREE (data->vec);
 		}
 
+                if (data->backing)
+                        data_unref (data->backing);
+
 		data->len = 0xbabababa;
 		if (!data->is_const)
-			GF_FREE (data);
+			mem_put (data_pool, data);
 	}
 }
 
@@ -165,8 +298,7 @@ data_copy (data_t *old)
 		return NULL;
 	}
 
-	data_t *newdata = (data_t *) GF_CALLOC (1, sizeof (*newdata),
-                                                gf_common_mt_data_t);
+	data_t *newdata = get_new_data ();
 
 	if (!newdata) {
 		gf_log ("dict", GF_LOG_CRITICAL,
@@ -189,7 +321,6 @@ data_copy (data_t *old)
 		}
 	}
 
-        LOCK_INIT (&newdata->lock);
 	return newdata;
 
  err_out:
@@ -198,7 +329,8 @@ data_copy (data_t *old)
 		FREE (newdata->data);
 	if (newdata->vec)
 		FREE (newdata->vec);
-	GF_FREE (newdata);
+        LOCK_DESTROY (&newdata->lock);
+	mem_put (data_pool, newdata);
 
 	gf_log ("dict", GF_LOG_CRITICAL,
 		"@newdata->data || @newdata->vec got NULL from CALLOC()");
@@ -206,22 +338,33 @@ data_copy (data_t *old)
 }
 
 static data_pair_t *
-_dict_lookup (dict_t *this, char *key)
+_dict_lookup (dict_t *this, char *key, uint32_t hash)
 {
+        data_pair_t *pair = NULL;
+        uint32_t     mask = 0;
+        uint32_t     i    = 0;
+
 	if (!this || !key) {
 		gf_log ("dict", GF_LOG_CRITICAL,
 			"@this=%p @key=%p", this, key);
 		return NULL;
 	}
 
-	int hashval = SuperFastHash (key, strlen (key)) % this->hash_size;
-	data_pair_t *pair;
-   
-	for (pair = this->members[hashval]; pair != NULL; pair = pair->hash_next) {
-		if (pair->key && !strcmp (pair->key, key))
-			return pair;
-	}
-  
+        if (!this->members) {
+                for (pair = this->members_list; pair; pair = pair->next) {
+                        if ((pair->key_hash == hash) && !strcmp (pair->key, key))
+                                return pair;
+                }
+
+                return NULL;
+        }
+
+        mask = this->hash_size - 1;
+        for (i = hash & mask; (pair = this->members[i]); i = (i + 1) & mask) {
+                if ((pair->key_hash == hash) && !strcmp (pair->key, key))
+                        return pair;
+        }
+
 	return NULL;
 }
 
@@ -231,10 +374,10 @@ _dict_set (dict_t *this,
 	   char *key, 
 	   data_t *value)
 {
-	int hashval;
 	data_pair_t *pair;
 	char key_free = 0;
-	int tmp = 0;
+        uint32_t hash = 0;
+        size_t keylen = 0;
         int ret = 0;
 
 	if (!key) {
@@ -246,9 +389,9 @@ _dict_set (dict_t *this,
 		key_free = 1;
 	}
 
-	tmp = SuperFastHash (key, strlen (key));
-	hashval = (tmp % this->hash_size);
-	pair = _dict_lookup (this, key);
+        keylen = strlen (key) + 1;
+	hash = SuperFastHash (key, keylen - 1);
+	pair = _dict_lookup (this, key, hash);
 
 	if (pair) {
 		data_t *unref_data = pair->value;
@@ -259,38 +402,42 @@ _dict_set (dict_t *this,
 		/* Indicates duplicate key */
 		return 0;
 	}
-	pair = (data_pair_t *) GF_CALLOC (1, sizeof (*pair),
-                                        gf_common_mt_data_pair_t);
+	pair = mem_get0 (data_pair_pool);
 	if (!pair) {
 		gf_log ("dict", GF_LOG_CRITICAL,
 			"@pair - NULL returned by CALLOC");
-		return -1;
-	}
-
-	pair->key = (char *) GF_CALLOC (1, strlen (key) + 1,
-                                        gf_common_mt_char);
-	if (!pair->key) {
-		gf_log ("dict", GF_LOG_CRITICAL,
-			"@pair->key - NULL returned by CALLOC");
-		GF_FREE (pair);
-
                 if (key_free)
                         GF_FREE (key);
 		return -1;
 	}
 
-	strcpy (pair->key, key);
+        if (keylen <= sizeof (pair->key_buf)) {
+                pair->key = pair->key_buf;
+        } else {
+                pair->key = GF_MALLOC (keylen, gf_common_mt_char);
+                if (!pair->key) {
+                        gf_log ("dict", GF_LOG_CRITICAL,
+                                "@pair->key - NULL returned by CALLOC");
+                        mem_put (data_pair_pool, pair);
+
+                        if (key_free)
+                                GF_FREE (key);
+                        return -1;
+                }
+        }
+
+	memcpy (pair->key, key, keylen);
+        pair->key_hash = hash;
 	pair->value = data_ref (value);
  
-	pair->hash_next = this->members[hashval];
-	this->members[hashval] = pair;
- 
 	pair->next = this->members_list;
 	pair->prev = NULL;
 	if (this->members_list)
 		this->members_list->prev = pair;
 	this->members_list = pair;
 	this->count++;
+
+        _dict_index_add (this, pair);
   
 	if (key_free)
 		GF_FREE (key);
@@ -325,6 +472,7 @@ dict_get (dict_t *this,
   	  char *key)
 {
 	data_pair_t *pair;
+        uint32_t hash;
 
 	if (!this || !key) {
 		gf_log_callingfn ("dict", GF_LOG_DEBUG,
@@ -332,9 +480,11 @@ dict_get (dict_t *this,
 		return NULL;
 	}
 
+        hash = SuperFastHash (key, strlen (key));
+
 	LOCK (&this->lock);
 
-	pair = _dict_lookup (this, key);
+	pair = _dict_lookup (this, key, hash);
 
 	UNLOCK (&this->lock);
 
@@ -348,44 +498,35 @@ void
 dict_del (dict_t *this,
   	  char *key)
 {
+        data_pair_t *pair = NULL;
+        uint32_t     hash = 0;
+
 	if (!this || !key) {
 		gf_log ("dict", GF_LOG_DEBUG,
 			"@this=%p @key=%p", this, key);
 		return;
 	}
 
+        hash = SuperFastHash (key, strlen (key));
+
 	LOCK (&this->lock);
 
-	int hashval = SuperFastHash (key, strlen (key)) % this->hash_size;
-	data_pair_t *pair = this->members[hashval];
-	data_pair_t *prev = NULL;
-  
-	while (pair) {
-		if (strcmp (pair->key, key) == 0) {
-			if (prev)
-				prev->hash_next = pair->hash_next;
-			else
-				this->members[hashval] = pair->hash_next;
-  
-			data_unref (pair->value);
-  
-			if (pair->prev)
-				pair->prev->next = pair->next;
-			else
-				this->members_list = pair->next;
+        pair = _dict_lookup (this, key, hash);
+        if (pair) {
+                if (this->members)
+                        _dict_index_remove (this, pair);
 
-			if (pair->next)
-				pair->next->prev = pair->prev;
-  
-			GF_FREE (pair->key);
-			GF_FREE (pair);
-			this->count--;
-			break;
-		}
- 
-		prev = pair;
-		pair = pair->hash_next;
-	}
+                if (pair->prev)
+                        pair->prev->next = pair->next;
+                else
+                        this->members_list = pair->next;
+
+                if (pair->next)
+                        pair->next->prev = pair->prev;
+
+                data_pair_destroy (pair);
+                this->count--;
+        }
 
 	UNLOCK (&this->lock);
 
@@ -408,13 +549,12 @@ dict_destroy (dict_t *this)
 
 	while (prev) {
 		pair = pair->next;
-		data_unref (prev->value);
-		GF_FREE (prev->key);
-		GF_FREE (prev);
+		data_pair_destroy (prev);
 		prev = pair;
 	}
 
-	GF_FREE (this->members);
+        if (this->members)
+                GF_FREE (this->members);
 
 	if (this->extra_free)
 		GF_FREE (this->extra_free);
@@ -422,7 +562,7 @@ dict_destroy (dict_t *this)
                 free (this->extra_stdfree);
 
 	if (!this->is_static)
-		GF_FREE (this);
+		mem_put (dict_pool, this);
 
 	return;
 }
@@ -646,7 +786,7 @@ dict_unserialize_old (char *buf, int32_t size, dict_t **fill)
 	goto ret;
 
 err:
-	GF_FREE (*fill);
+	dict_destroy (*fill);
 	*fill = NULL; 
 
 ret:
@@ -1274,7 +1414,7 @@ dict_copy (dict_t *dict,
 	}
 
 	if (!new)
-		new = get_new_dict_full (dict->hash_size);
+		new = get_new_dict_full (dict->count);
 
 	dict_foreach (dict, _copy, new);
 
@@ -1317,15 +1457,18 @@ dict_get_with_ref (dict_t *this, char *key, data_t **data)
 {
 	data_pair_t * pair = NULL;
 	int           ret  = -ENOENT;
+        uint32_t      hash = 0;
 
 	if (!this || !key || !data) {
 		ret = -EINVAL;
 		goto err;
 	}
 
+        hash = SuperFastHash (key, strlen (key));
+
 	LOCK (&this->lock);
 	{
-		pair = _dict_lookup (this, key);
+		pair = _dict_lookup (this, key, hash);
 	}
 	UNLOCK (&this->lock);
 
@@ -2483,18 +2626,60 @@ out:
 
 
 /**
- * dict_unserialize - unserialize a buffer into a dict
+ * dict_serialize_into - serialize a dictionary into a buffer of given size
  *
- * @buf:  buf containing serialized dict
- * @size: size of the @buf
- * @fill: dict to fill in
- * 
- * @return: success: 0
- *          failure: -errno
+ * @this: dict to serialize
+ * @buf:  buffer to serialize into
+ * @size: room in @buf
+ *
+ * Unlike dict_serialized_length() followed by dict_serialize(), the dict
+ * is walked under one hold of its lock, so it cannot change in between.
+ *
+ * @return: success: length of the serialized dict
+ *          failure: -errno (-ENOSPC if it does not fit in @size)
  */
 
 int32_t
-dict_unserialize (char *orig_buf, int32_t size, dict_t **fill)
+dict_serialize_into (dict_t *this, char *buf, size_t size)
+{
+	int           ret    = -EINVAL;
+
+	if (!this || !buf) {
+		gf_log ("dict", GF_LOG_ERROR,
+			"@this=%p @buf=%p", this, buf);
+		goto out;
+	}
+
+        LOCK (&this->lock);
+        {
+                ret = _dict_serialized_length (this);
+                if (ret < 0)
+                        goto unlock;
+
+                if ((size_t) ret > size) {
+                        ret = -ENOSPC;
+                        goto unlock;
+                }
+
+                if (_dict_serialize (this, buf) < 0)
+                        ret = -EINVAL;
+        }
+unlock:
+        UNLOCK (&this->lock);
+out:
+	return ret;
+}
+
+
+/*
+ * _dict_unserialize - unserialize a buffer into a dict. With a @backing
+ * data_t holding the buffer, the values point into it and keep a ref on
+ * @backing instead of being copied out one by one.
+ */
+
+static int32_t
+_dict_unserialize (char *orig_buf, int32_t size, dict_t **fill,
+                   data_t *backing)
 {
 	char   *buf = NULL;
 	int     ret   = -1;
@@ -2596,8 +2781,14 @@ dict_unserialize (char *orig_buf, int32_t size, dict_t **fill)
 		}
 		value = get_new_data ();
 		value->len  = vallen;
-		value->data = memdup (buf, vallen);
-		value->is_static = 0;
+                if (backing) {
+                        value->data = buf;
+                        value->is_static = 1;
+                        value->backing = data_ref (backing);
+                } else {
+                        value->data = memdup (buf, vallen);
+                        value->is_static = 0;
+                }
 		buf += vallen;
 
 		dict_set (*fill, key, value);
@@ -2609,6 +2800,70 @@ out:
 }
 
 
+/**
+ * dict_unserialize - unserialize a buffer into a dict
+ *
+ * @buf:  buf containing serialized dict
+ * @size: size of the @buf
+ * @fill: dict to fill in
+ * 
+ * @return: success: 0
+ *          failure: -errno
+ */
+
+int32_t
+dict_unserialize (char *orig_buf, int32_t size, dict_t **fill)
+{
+        return _dict_unserialize (orig_buf, size, fill, NULL);
+}
+
+
+/**
+ * dict_unserialize_nocopy - unserialize a buffer into a dict, without
+ *                           copying the values out of it
+ *
+ * @buf:  buf containing serialized dict, allocated by libc (as the XDR
+ *        decoder does). It is taken over in all cases, and freed once
+ *        the last value pointing into it is gone, which may well be after
+ *        @fill itself.
+ * @size: size of the @buf
+ * @fill: dict to fill in
+ *
+ * @return: success: 0
+ *          failure: -errno
+ */
+
+int32_t
+dict_unserialize_nocopy (char *buf, int32_t size, dict_t **fill)
+{
+        data_t *backing = NULL;
+        int32_t ret     = -1;
+
+        if (!buf) {
+                gf_log ("dict", GF_LOG_ERROR,
+                        "buf is null!");
+                goto out;
+        }
+
+        backing = get_new_data ();
+        if (!backing) {
+                free (buf);
+                goto out;
+        }
+
+        backing->data = buf;
+        backing->len = size;
+        backing->is_stdalloc = 1;
+        data_ref (backing);
+
+        ret = _dict_unserialize (buf, size, fill, backing);
+
+        data_unref (backing);
+out:
+        return ret;
+}
+
+
 /**
  * dict_allocate_and_serialize - serialize a dictionary into an allocated buffer
  *
@@ -44,16 +44,23 @@ struct _data {
   char *data;
   int32_t refcount;
   gf_lock_t lock;
+  data_t *backing;      /* owns the buffer data points into, if not us */
 };
 
+#define DICT_PAIR_KEY_INLINE 48
+
 struct _data_pair {
-  struct _data_pair *hash_next;
   struct _data_pair *prev;
   struct _data_pair *next;
   data_t *value;
-  char *key;
+  char *key;            /* points to key_buf unless the key is longer */
+  uint32_t key_hash;
+  char key_buf[DICT_PAIR_KEY_INLINE];
 };
 
+/* Pairs are kept on members_list in insertion order (newest first).
+   Once a dict grows past a handful of keys, members becomes an open
+   addressed index into them, of hash_size (a power of two) slots. */
 struct _dict {
   unsigned char is_static:1;
   int32_t hash_size;
@@ -77,6 +84,8 @@ void dict_del (dict_t *this, char *key);
 int32_t dict_serialized_length (dict_t *dict);
 int32_t dict_serialize (dict_t *dict, char *buf);
 int32_t dict_unserialize (char *buf, int32_t size, dict_t **fill);
+int32_t dict_unserialize_nocopy (char *buf, int32_t size, dict_t **fill);
+int32_t dict_serialize_into (dict_t *dict, char *buf, size_t size);
 
 int32_t
 dict_allocate_and_serialize (dict_t *this, char **buf, size_t *length);
@@ -563,6 +563,16 @@ event_register_epoll (struct event_pool *event_pool, int fd,
 		event_pool->reg[idx].events = EPOLLPRI;
 		event_pool->reg[idx].handler = handler;
 		event_pool->reg[idx].data = data;
+		event_pool->reg[idx].armed = 1;
+		event_pool->reg[idx].gen = ++event_pool->gen;
+
+		/* with more than one dispatcher thread, an fd is disarmed
+		   after each event and re-armed once its handler returns,
+		   so that the handler of an fd never runs concurrently
+		   with itself
+		*/
+		if (event_pool->eventthreadcount > 1)
+			event_pool->reg[idx].events |= EPOLLONESHOT;
 
 		switch (poll_in) {
 		case 1:
@@ -671,6 +681,12 @@ event_unregister_epoll (struct event_pool *event_pool, int fd, int idx_hint)
 			goto unlock;
 		}
 
+		/* an fd being dispatched in another thread must stay
+		   disarmed, it picks up its new index when re-armed
+		*/
+		if (!event_pool->reg[lastidx].armed)
+			goto move;
+
 		epoll_event.events = event_pool->reg[lastidx].events;
 		ev_data->fd = event_pool->reg[lastidx].fd;
 		ev_data->idx = idx;
@@ -684,6 +700,7 @@ event_unregister_epoll (struct event_pool *event_pool, int fd, int idx_hint)
 				strerror (errno));
 			goto unlock;
 		}
+move:
 
 		/* just replace the unregistered idx by last one */
 		event_pool->reg[idx] = event_pool->reg[lastidx];
@@ -756,6 +773,14 @@ event_select_on_epoll (struct event_pool *event_pool, int fd, int idx_hint,
 			break;
 		}
 
+		/* a dispatcher owns the fd, the new events take effect
+		   when it re-arms the fd after the handler returns
+		*/
+		if (!event_pool->reg[idx].armed) {
+			ret = 0;
+			goto unlock;
+		}
+
 		epoll_event.events = event_pool->reg[idx].events;
 		ev_data->fd = fd;
 		ev_data->idx = idx;
@@ -775,6 +800,44 @@ unlock:
 }
 
 
+static int
+event_rearm_epoll (struct event_pool *event_pool, int fd, int idx_hint,
+		   unsigned int gen)
+{
+	int                 idx = -1;
+	int                 ret = 0;
+	struct epoll_event  epoll_event = {0, };
+	struct event_data  *ev_data = (void *)&epoll_event.data;
+
+	pthread_mutex_lock (&event_pool->mutex);
+	{
+		idx = __event_getindex (event_pool, fd, idx_hint);
+
+		/* unregistered (and possibly reused) while in the handler */
+		if (idx == -1 || event_pool->reg[idx].gen != gen)
+			goto unlock;
+
+		event_pool->reg[idx].armed = 1;
+
+		epoll_event.events = event_pool->reg[idx].events;
+		ev_data->fd = fd;
+		ev_data->idx = idx;
+
+		ret = epoll_ctl (event_pool->fd, EPOLL_CTL_MOD, fd,
+				 &epoll_event);
+		if (ret == -1) {
+			gf_log ("epoll", GF_LOG_ERROR,
+				"failed to re-arm fd(=%d) (%s)",
+				fd, strerror (errno));
+		}
+	}
+unlock:
+	pthread_mutex_unlock (&event_pool->mutex);
+
+	return ret;
+}
+
+
 static int
 event_dispatch_epoll_handler (struct event_pool *event_pool,
 			      struct epoll_event *events, int i)
@@ -784,6 +847,8 @@ event_dispatch_epoll_handler (struct event_pool *event_pool,
 	void               *data = NULL;
 	int                 idx = -1;
 	int                 ret = -1;
+	int                 oneshot = 0;
+	unsigned int        gen = 0;
 
 
 	event_data = (void *)&events[i].data;
@@ -802,6 +867,23 @@ event_dispatch_epoll_handler (struct event_pool *event_pool,
 			goto unlock;
 		}
 
+		if (event_pool->reg[idx].events & EPOLLONESHOT) {
+			/* epoll disarms the fd when it hands out the event,
+			   but until we get here the slot still looks armed
+			   and event_select_on/event_unregister may re-arm it
+			   with EPOLL_CTL_MOD. Whoever claims the slot first
+			   runs the handler; an event on a slot already
+			   claimed is dropped, it is level-triggered and
+			   shows up again once the owner re-arms the fd.
+			*/
+			if (!event_pool->reg[idx].armed)
+				goto unlock;
+
+			oneshot = 1;
+			gen = event_pool->reg[idx].gen;
+			event_pool->reg[idx].armed = 0;
+		}
+
 		handler = event_pool->reg[idx].handler;
 		data = event_pool->reg[idx].data;
 	}
@@ -813,10 +895,92 @@ unlock:
 			       (events[i].events & (EPOLLIN|EPOLLPRI)),
 			       (events[i].events & (EPOLLOUT)),
 			       (events[i].events & (EPOLLERR|EPOLLHUP)));
+
+	if (oneshot)
+		event_rearm_epoll (event_pool, event_data->fd, idx, gen);
+
 	return ret;
 }
 
 
+static void *
+event_dispatch_epoll_worker (void *data)
+{
+	struct event_pool  *event_pool = NULL;
+	struct epoll_event  event = {0, };
+	int                 ret = -1;
+
+	event_pool = data;
+
+	while (1) {
+		pthread_mutex_lock (&event_pool->mutex);
+		{
+			while (event_pool->used == 0)
+				pthread_cond_wait (&event_pool->cond,
+						   &event_pool->mutex);
+		}
+		pthread_mutex_unlock (&event_pool->mutex);
+
+		/* one event at a time, so that ready fds spread across
+		   all the dispatcher threads
+		*/
+		ret = epoll_wait (event_pool->fd, &event, 1, -1);
+
+		if (ret == 0)
+			/* timeout */
+			continue;
+
+		if (ret == -1 && errno == EINTR)
+			/* sys call */
+			continue;
+
+		if (ret == -1) {
+			gf_log ("epoll", GF_LOG_ERROR,
+				"epoll_wait failed (%s)", strerror (errno));
+			continue;
+		}
+
+		if (!event.events)
+			continue;
+
+		event_dispatch_epoll_handler (event_pool, &event, 0);
+	}
+
+	return NULL;
+}
+
+
+static int
+event_dispatch_epoll_threads (struct event_pool *event_pool)
+{
+	pthread_t  thread;
+	int        i = 0;
+	int        ret = -1;
+
+	for (i = 1; i < event_pool->eventthreadcount; i++) {
+		ret = pthread_create (&thread, NULL,
+				      event_dispatch_epoll_worker, event_pool);
+		if (ret != 0) {
+			gf_log ("epoll", GF_LOG_WARNING,
+				"failed to start event thread %d (%s)",
+				i, strerror (ret));
+			continue;
+		}
+
+		pthread_detach (thread);
+	}
+
+	gf_log ("epoll", GF_LOG_NORMAL,
+		"dispatching events with %d threads",
+		event_pool->eventthreadcount);
+
+	/* the calling thread is the last of the dispatchers */
+	event_dispatch_epoll_worker (event_pool);
+
+	return -1;
+}
+
+
 static int
 event_dispatch_epoll (struct event_pool *event_pool)
 {
@@ -830,7 +994,10 @@ event_dispatch_epoll (struct event_pool *event_pool)
 		gf_log ("event", GF_LOG_ERROR, "invalid argument");
 		return -1;
 	}
-  
+
+	if (event_pool->eventthreadcount > 1)
+		return event_dispatch_epoll_threads (event_pool);
+
 	while (1) {
 		pthread_mutex_lock (&event_pool->mutex);
 		{
@@ -985,3 +1152,45 @@ event_dispatch (struct event_pool *event_pool)
 
 	return ret;
 }
+
+
+int
+event_pool_set_threads (struct event_pool *event_pool, int count)
+{
+	int ret = -1;
+	int multi = 0;
+
+	if (event_pool == NULL || count < 1) {
+		gf_log ("event", GF_LOG_ERROR, "invalid argument");
+		return -1;
+	}
+
+#ifdef HAVE_SYS_EPOLL_H
+	multi = (event_pool->ops == &event_ops_epoll);
+#endif
+
+	pthread_mutex_lock (&event_pool->mutex);
+	{
+		if (count > 1 && !multi) {
+			gf_log ("event", GF_LOG_WARNING,
+				"multi-threaded dispatch needs epoll, "
+				"using a single event thread");
+			count = 1;
+		}
+
+		/* registered fds would lack the oneshot arming */
+		if (multi && event_pool->used) {
+			gf_log ("event", GF_LOG_ERROR,
+				"cannot change event threads after fds are "
+				"registered");
+			goto unlock;
+		}
+
+		event_pool->eventthreadcount = count;
+		ret = 0;
+	}
+unlock:
+	pthread_mutex_unlock (&event_pool->mutex);
+
+	return ret;
+}
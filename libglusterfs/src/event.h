@@ -50,6 +50,8 @@ struct event_pool {
     int events;
     void *data;
     event_handler_t handler;
+    int armed;             /* oneshot fd armed and owned by no dispatcher */
+    unsigned int gen;      /* registration generation of this slot */
   } *reg;
 
   int used;
@@ -61,6 +63,9 @@ struct event_pool {
 
   void *evcache;
   int evcache_size;
+
+  int eventthreadcount;    /* number of threads running event_dispatch */
+  unsigned int gen;
 };
 
 struct event_ops {
@@ -86,5 +91,6 @@ int event_register (struct event_pool *event_pool, int fd,
 		    void *data, int poll_in, int poll_out);
 int event_unregister (struct event_pool *event_pool, int fd, int idx);
 int event_dispatch (struct event_pool *event_pool);
+int event_pool_set_threads (struct event_pool *event_pool, int count);
 
 #endif /* _EVENT_H_ */
@@ -272,6 +272,10 @@ struct _cmd_args {
 	char            *dump_fuse;
         pid_t            client_pid;
         int              client_pid_set;
+        int              event_threads;
+        int              fuse_reader_thread_count;
+        int              fuse_use_readdirp;
+        int              fuse_splice;
 
 	/* key args */
 	char            *mount_point;
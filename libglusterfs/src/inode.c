@@ -37,9 +37,8 @@
    move latest accessed dentry to list_head of inode
 */
 
-#define INODE_DUMP_LIST(head, key_buf, key_prefix, list_type) \
+#define INODE_DUMP_LIST(head, key_buf, key_prefix, list_type, i)      \
         {                                                               \
-                int i = 1;                                              \
                 inode_t *inode = NULL;                                  \
                 list_for_each_entry (inode, head, list) {               \
                         gf_proc_dump_build_key(key_buf, key_prefix, "%s.%d",list_type, \
@@ -49,6 +48,11 @@
                 }                                                       \
         }
 
+/* Reference count of an inode which is being retired. Once an inode
+   has been claimed this way nothing can take a reference on it any
+   more, lookups through the hashes treat it as not found. */
+#define INODE_REF_DEAD  ((uint32_t) -1)
+
 static inode_t *
 __inode_unref (inode_t *inode);
 
@@ -87,6 +91,30 @@ hash_gfid (uuid_t uuid, int mod)
 }
 
 
+/* Locking: table->lock serialises every change to the hashes, the
+   dentries and the purge list. A hash bucket is additionally guarded by
+   the lock of its stripe, which is held around every change to it, so
+   that lookups only need the stripe lock of the bucket they search.
+   The stripe locks are never nested.
+*/
+static gf_lock_t *
+__bucket_lock (inode_table_t *table, int hash)
+{
+        return &table->stripes[hash % GF_INODE_TABLE_STRIPES].lock;
+}
+
+
+static struct _inode_stripe *
+__inode_stripe (inode_t *inode)
+{
+        unsigned long slot = 0;
+
+        slot = (unsigned long) inode / sizeof (*inode);
+
+        return &inode->table->stripes[slot % GF_INODE_TABLE_STRIPES];
+}
+
+
 static void
 __dentry_hash (dentry_t *dentry)
 {
@@ -100,8 +128,12 @@ __dentry_hash (dentry_t *dentry)
         hash = hash_dentry (dentry->parent, dentry->name,
                             table->hashsize);
 
-        list_del_init (&dentry->hash);
-        list_add (&dentry->hash, &table->name_hash[hash]);
+        LOCK (__bucket_lock (table, hash));
+        {
+                list_del_init (&dentry->hash);
+                list_add (&dentry->hash, &table->name_hash[hash]);
+        }
+        UNLOCK (__bucket_lock (table, hash));
 }
 
 
@@ -118,10 +150,21 @@ __is_dentry_hashed (dentry_t *dentry)
 static void
 __dentry_unhash (dentry_t *dentry)
 {
-        if (!dentry)
+        inode_table_t   *table = NULL;
+        int              hash = 0;
+
+        if (!dentry || !__is_dentry_hashed (dentry))
                 return;
 
-        list_del_init (&dentry->hash);
+        table = dentry->inode->table;
+        hash = hash_dentry (dentry->parent, dentry->name,
+                            table->hashsize);
+
+        LOCK (__bucket_lock (table, hash));
+        {
+                list_del_init (&dentry->hash);
+        }
+        UNLOCK (__bucket_lock (table, hash));
 }
 
 
@@ -222,23 +265,33 @@ __is_dentry_cyclic (dentry_t *dentry)
 }
 
 
-static void
-__inode_unhash (inode_t *inode)
+static int
+__is_inode_hashed (inode_t *inode)
 {
         if (!inode)
-                return;
+                return 0;
 
-        list_del_init (&inode->hash);
+        return !list_empty (&inode->hash);
 }
 
 
-static int
-__is_inode_hashed (inode_t *inode)
+static void
+__inode_unhash (inode_t *inode)
 {
-        if (!inode)
-                return 0;
+        inode_table_t *table = NULL;
+        int            hash = 0;
 
-        return !list_empty (&inode->hash);
+        if (!inode || !__is_inode_hashed (inode))
+                return;
+
+        table = inode->table;
+        hash = hash_gfid (inode->gfid, 65536);
+
+        LOCK (__bucket_lock (table, hash));
+        {
+                list_del_init (&inode->hash);
+        }
+        UNLOCK (__bucket_lock (table, hash));
 }
 
 
@@ -254,8 +307,12 @@ __inode_hash (inode_t *inode)
         table = inode->table;
         hash = hash_gfid (inode->gfid, 65536);
 
-        list_del_init (&inode->hash);
-        list_add (&inode->hash, &table->inode_hash[hash]);
+        LOCK (__bucket_lock (table, hash));
+        {
+                list_del_init (&inode->hash);
+                list_add (&inode->hash, &table->inode_hash[hash]);
+        }
+        UNLOCK (__bucket_lock (table, hash));
 }
 
 
@@ -316,46 +373,61 @@ noctx:
 }
 
 
-static void
-__inode_activate (inode_t *inode)
-{
-        if (!inode)
-                return;
-
-        list_move (&inode->list, &inode->table->active);
-        inode->table->active_size++;
-}
-
-
-static void
+/* Drop the last reference of an inode which stays cached. The inode is
+   queued at the tail of the lru list of its stripe; the move and the
+   drop happen under the stripe lock so that the pruner, which claims
+   idle inodes under the same lock, never sees one half way. Returns 0
+   if somebody took another reference meanwhile.
+*/
+static int
 __inode_passivate (inode_t *inode)
 {
-        dentry_t      *dentry = NULL;
-        dentry_t      *t = NULL;
+        struct _inode_stripe *stripe = NULL;
+        inode_table_t        *table = NULL;
+        int                   ret = 0;
 
-        if (!inode)
-                return;
+        /* once the reference is gone the inode may be freed under us */
+        table = inode->table;
+        stripe = __inode_stripe (inode);
 
-        list_move_tail (&inode->list, &inode->table->lru);
-        inode->table->lru_size++;
+        LOCK (&stripe->lock);
+        {
+                ret = __sync_bool_compare_and_swap (&inode->ref, 1, 0);
+                if (ret)
+                        list_move_tail (&inode->list, &stripe->lru);
+        }
+        UNLOCK (&stripe->lock);
 
-        list_for_each_entry_safe (dentry, t, &inode->dentry_list, inode_list) {
-                if (!__is_dentry_hashed (dentry))
-                        __dentry_unset (dentry);
+        if (ret) {
+                __sync_fetch_and_sub (&table->active_size, 1);
+                __sync_fetch_and_add (&table->lru_size, 1);
         }
+
+        return ret;
 }
 
 
+/* The caller holds table->lock and has claimed the inode with
+   INODE_REF_DEAD. */
 static void
 __inode_retire (inode_t *inode)
 {
-        dentry_t      *dentry = NULL;
-        dentry_t      *t = NULL;
+        struct _inode_stripe *stripe = NULL;
+        dentry_t             *dentry = NULL;
+        dentry_t             *t = NULL;
 
         if (!inode)
                 return;
 
-        list_move_tail (&inode->list, &inode->table->purge);
+        stripe = __inode_stripe (inode);
+
+        LOCK (&stripe->lock);
+        {
+                list_del_init (&inode->list);
+        }
+        UNLOCK (&stripe->lock);
+
+        list_add_tail (&inode->list, &inode->table->purge);
         inode->table->purge_size++;
 
         __inode_unhash (inode);
@@ -366,43 +438,70 @@ __inode_retire (inode_t *inode)
 }
 
 
+/* table->lock held */
 static inode_t *
 __inode_unref (inode_t *inode)
 {
+        uint32_t ref = 0;
+
         if (!inode)
                 return NULL;
 
         if (inode->ino == 1)
                 return inode;
 
-        GF_ASSERT (inode->ref);
+        for (;;) {
+                ref = inode->ref;
 
-        --inode->ref;
+                GF_ASSERT (ref && (ref != INODE_REF_DEAD));
 
-        if (!inode->ref) {
-                inode->table->active_size--;
+                if (ref > 1) {
+                        if (__sync_bool_compare_and_swap (&inode->ref, ref,
+                                                          ref - 1))
+                                break;
+                        continue;
+                }
 
-                if (inode->nlookup)
-                        __inode_passivate (inode);
-                else
+                if (inode->nlookup) {
+                        if (__inode_passivate (inode))
+                                break;
+                        continue;
+                }
+
+                if (__sync_bool_compare_and_swap (&inode->ref, 1,
+                                                  INODE_REF_DEAD)) {
+                        __sync_fetch_and_sub (&inode->table->active_size, 1);
                         __inode_retire (inode);
+                        break;
+                }
         }
 
         return inode;
 }
 
 
+/* Takes a reference without any lock. Fails only on an inode which is
+   being retired, which callers holding a reference never see. */
 static inode_t *
 __inode_ref (inode_t *inode)
 {
+        uint32_t ref = 0;
+
         if (!inode)
                 return NULL;
 
-        if (!inode->ref) {
-                inode->table->lru_size--;
-                __inode_activate (inode);
+        do {
+                ref = inode->ref;
+                if (ref == INODE_REF_DEAD)
+                        return NULL;
+        } while (!__sync_bool_compare_and_swap (&inode->ref, ref, ref + 1));
+
+        /* the inode stays on the lru list until the pruner walks past
+           it and moves it over to the active one */
+        if (!ref) {
+                __sync_fetch_and_sub (&inode->table->lru_size, 1);
+                __sync_fetch_and_add (&inode->table->active_size, 1);
         }
-        inode->ref++;
 
         return inode;
 }
@@ -412,18 +511,44 @@ inode_t *
 inode_unref (inode_t *inode)
 {
         inode_table_t *table = NULL;
+        uint32_t       ref = 0;
 
         if (!inode)
                 return NULL;
 
         table = inode->table;
 
+        if (inode->ino == 1)
+                return inode;
+
+        /* only dropping the last reference of an inode nobody looked up
+           any more has to retire it, which needs the table lock */
+        for (;;) {
+                ref = inode->ref;
+
+                GF_ASSERT (ref && (ref != INODE_REF_DEAD));
+
+                if (ref > 1) {
+                        if (__sync_bool_compare_and_swap (&inode->ref, ref,
+                                                          ref - 1))
+                                return inode;
+                        continue;
+                }
+
+                if (!inode->nlookup)
+                        break;
+
+                if (__inode_passivate (inode))
+                        goto prune;
+        }
+
         pthread_mutex_lock (&table->lock);
         {
                 inode = __inode_unref (inode);
         }
         pthread_mutex_unlock (&table->lock);
 
+prune:
         inode_table_prune (table);
 
         return inode;
@@ -433,20 +558,19 @@ inode_unref (inode_t *inode)
 inode_t *
 inode_ref (inode_t *inode)
 {
-        inode_table_t *table = NULL;
+        inode_t *ret = NULL;
 
         if (!inode)
                 return NULL;
 
-        table = inode->table;
+        ret = __inode_ref (inode);
+        if (!ret)
+                gf_log (inode->table->name, GF_LOG_CRITICAL,
+                        "reference taken on inode %"PRId64" (%s) "
+                        "being destroyed", inode->ino,
+                        uuid_utoa (inode->gfid));
 
-        pthread_mutex_lock (&table->lock);
-        {
-                inode = __inode_ref (inode);
-        }
-        pthread_mutex_unlock (&table->lock);
-
-        return inode;
+        return ret;
 }
 
 
@@ -487,10 +611,12 @@ out:
 }
 
 
+/* the new inode comes with a reference held */
 static inode_t *
 __inode_create (inode_table_t *table)
 {
-        inode_t  *newi = NULL;
+        struct _inode_stripe *stripe = NULL;
+        inode_t              *newi = NULL;
 
         if (!table)
                 return NULL;
@@ -502,6 +628,7 @@ __inode_create (inode_table_t *table)
         }
 
         newi->table = table;
+        newi->ref = 1;
 
         LOCK_INIT (&newi->lock);
 
@@ -522,8 +649,15 @@ __inode_create (inode_table_t *table)
                 goto out;
         }
 
-        list_add (&newi->list, &table->lru);
-        table->lru_size++;
+        stripe = __inode_stripe (newi);
+
+        LOCK (&stripe->lock);
+        {
+                list_add (&newi->list, &stripe->active);
+        }
+        UNLOCK (&stripe->lock);
+
+        __sync_fetch_and_add (&table->active_size, 1);
 
 out:
 
@@ -534,21 +668,10 @@ out:
 inode_t *
 inode_new (inode_table_t *table)
 {
-        inode_t *inode = NULL;
-
         if (!table)
                 return NULL;
 
-        pthread_mutex_lock (&table->lock);
-        {
-                inode = __inode_create (table);
-                if (inode != NULL) {
-                        __inode_ref (inode);
-                }
-        }
-        pthread_mutex_unlock (&table->lock);
-
-        return inode;
+        return __inode_create (table);
 }
 
 
@@ -558,7 +681,7 @@ __inode_lookup (inode_t *inode)
         if (!inode)
                 return NULL;
 
-        inode->nlookup++;
+        __sync_fetch_and_add (&inode->nlookup, 1);
 
         return inode;
 }
@@ -572,15 +695,16 @@ __inode_forget (inode_t *inode, uint64_t nlookup)
 
         GF_ASSERT (inode->nlookup >= nlookup);
 
-        inode->nlookup -= nlookup;
-
-        if (!nlookup)
-                inode->nlookup = 0;
+        if (nlookup)
+                __sync_fetch_and_sub (&inode->nlookup, nlookup);
+        else
+                __sync_fetch_and_and (&inode->nlookup, 0);
 
         return inode;
 }
 
 
+/* Either table->lock or the stripe lock of the bucket must be held. */
 dentry_t *
 __dentry_grep (inode_table_t *table, inode_t *parent, const char *name)
 {
@@ -609,21 +733,21 @@ inode_grep (inode_table_t *table, inode_t *parent, const char *name)
 {
         inode_t   *inode = NULL;
         dentry_t  *dentry = NULL;
+        int        hash = 0;
 
         if (!table || !parent || !name)
                 return NULL;
 
-        pthread_mutex_lock (&table->lock);
+        hash = hash_dentry (parent, name, table->hashsize);
+
+        LOCK (__bucket_lock (table, hash));
         {
                 dentry = __dentry_grep (table, parent, name);
 
                 if (dentry)
-                        inode = dentry->inode;
-
-                if (inode)
-                        __inode_ref (inode);
+                        inode = __inode_ref (dentry->inode);
         }
-        pthread_mutex_unlock (&table->lock);
+        UNLOCK (__bucket_lock (table, hash));
 
         return inode;
 }
@@ -651,6 +775,7 @@ __is_root_gfid (uuid_t gfid)
 }
 
 
+/* Either table->lock or the stripe lock of the bucket must be held. */
 inode_t *
 __inode_find (inode_table_t *table, uuid_t gfid)
 {
@@ -682,17 +807,20 @@ inode_t *
 inode_find (inode_table_t *table, uuid_t gfid)
 {
         inode_t   *inode = NULL;
+        int        hash = 0;
 
         if (!table)
                 return NULL;
 
-        pthread_mutex_lock (&table->lock);
+        hash = hash_gfid (gfid, 65536);
+
+        LOCK (__bucket_lock (table, hash));
         {
                 inode = __inode_find (table, gfid);
                 if (inode)
-                        __inode_ref (inode);
+                        inode = __inode_ref (inode);
         }
-        pthread_mutex_unlock (&table->lock);
+        UNLOCK (__bucket_lock (table, hash));
 
         return inode;
 }
@@ -758,6 +886,71 @@ __inode_link (inode_t *inode, inode_t *parent, const char *name,
 }
 
 
+/* Most links repeat what the table already knows: a lookup of a cached
+   name. Recognise those with the stripe locks alone, and return the
+   linked inode with a reference held, or NULL if the table has to
+   change. */
+static inode_t *
+inode_link_cached (inode_t *inode, inode_t *parent, const char *name,
+                   struct iatt *iatt)
+{
+        inode_table_t *table = NULL;
+        inode_t       *link_inode = NULL;
+        dentry_t      *dentry = NULL;
+        int            hash = 0;
+        int            hashed = 0;
+        int            found = 0;
+
+        if (!iatt || uuid_is_null (iatt->ia_gfid))
+                return NULL;
+
+        if (parent && !name)
+                return NULL;
+
+        table = inode->table;
+        hash = hash_gfid (iatt->ia_gfid, 65536);
+
+        LOCK (__bucket_lock (table, hash));
+        {
+                link_inode = __inode_find (table, iatt->ia_gfid);
+                hashed = __is_inode_hashed (inode);
+
+                if (link_inode && (link_inode == inode || !hashed))
+                        link_inode = __inode_ref (link_inode);
+                else
+                        link_inode = NULL;
+        }
+        UNLOCK (__bucket_lock (table, hash));
+
+        if (!link_inode)
+                return NULL;
+
+        if (parent) {
+                hash = hash_dentry (parent, name, table->hashsize);
+
+                LOCK (__bucket_lock (table, hash));
+                {
+                        dentry = __dentry_grep (table, parent, name);
+                        found = (dentry && dentry->inode == link_inode);
+                }
+                UNLOCK (__bucket_lock (table, hash));
+
+                if (!found) {
+                        inode_unref (link_inode);
+                        return NULL;
+                }
+        }
+
+        if (!hashed) {
+                uuid_copy (inode->gfid, iatt->ia_gfid);
+                inode->ino        = iatt->ia_ino;
+                inode->ia_type    = iatt->ia_type;
+        }
+
+        return link_inode;
+}
+
+
 inode_t *
 inode_link (inode_t *inode, inode_t *parent, const char *name,
             struct iatt *iatt)
@@ -770,6 +963,10 @@ inode_link (inode_t *inode, inode_t *parent, const char *name,
 
         table = inode->table;
 
+        linked_inode = inode_link_cached (inode, parent, name, iatt);
+        if (linked_inode)
+                return linked_inode;
+
         pthread_mutex_lock (&table->lock);
         {
                 linked_inode = __inode_link (inode, parent, name, iatt);
@@ -788,18 +985,10 @@ inode_link (inode_t *inode, inode_t *parent, const char *name,
 int
 inode_lookup (inode_t *inode)
 {
-        inode_table_t *table = NULL;
-
         if (!inode)
                 return -1;
 
-        table = inode->table;
-
-        pthread_mutex_lock (&table->lock);
-        {
-                __inode_lookup (inode);
-        }
-        pthread_mutex_unlock (&table->lock);
+        __inode_lookup (inode);
 
         return 0;
 }
@@ -815,11 +1004,7 @@ inode_forget (inode_t *inode, uint64_t nlookup)
 
         table = inode->table;
 
-        pthread_mutex_lock (&table->lock);
-        {
-                __inode_forget (inode, nlookup);
-        }
-        pthread_mutex_unlock (&table->lock);
+        __inode_forget (inode, nlookup);
 
         inode_table_prune (table);
 
@@ -1039,11 +1224,63 @@ unlock:
         return ret;
 }
 
+
+/* Idle inodes are evicted only once the lru overflows its limit by a
+   sixteenth, and then down to the limit, so the table lock is taken
+   once per batch of evictions instead of once per inode going idle. */
+static int
+inode_table_overflown (inode_table_t *table)
+{
+        uint32_t lru_size = table->lru_size;
+
+        if (!table->lru_limit)
+                return 0;
+
+        return (lru_size > table->lru_limit + table->lru_limit / 16);
+}
+
+
+/* Claim the least recently used idle inode of @stripe. Inodes found in
+   use are moved over to the active list on the way. */
+static inode_t *
+__inode_stripe_evict (inode_table_t *table, struct _inode_stripe *stripe)
+{
+        inode_t *victim = NULL;
+        inode_t *trav = NULL;
+        inode_t *tmp = NULL;
+
+        LOCK (&stripe->lock);
+        {
+                list_for_each_entry_safe (trav, tmp, &stripe->lru, list) {
+                        if (trav->ref ||
+                            !__sync_bool_compare_and_swap (&trav->ref, 0,
+                                                           INODE_REF_DEAD)) {
+                                list_move_tail (&trav->list, &stripe->active);
+                                continue;
+                        }
+
+                        list_del_init (&trav->list);
+                        victim = trav;
+                        break;
+                }
+        }
+        UNLOCK (&stripe->lock);
+
+        if (victim)
+                __sync_fetch_and_sub (&table->lru_size, 1);
+
+        return victim;
+}
+
+
 static int
 inode_table_prune (inode_table_t *table)
 {
         int               ret = 0;
+        int               misses = 0;
+        int               overflown = 0;
         struct list_head  purge = {0, };
+        struct _inode_stripe *stripe = NULL;
         inode_t          *del = NULL;
         inode_t          *tmp = NULL;
         inode_t          *entry = NULL;
@@ -1051,16 +1288,28 @@ inode_table_prune (inode_table_t *table)
         if (!table)
                 return -1;
 
+        if (!table->purge_size && !inode_table_overflown (table))
+                return 0;
+
         INIT_LIST_HEAD (&purge);
 
         pthread_mutex_lock (&table->lock);
         {
-                while (table->lru_limit
-                       && table->lru_size > (table->lru_limit)) {
-
-                        entry = list_entry (table->lru.next, inode_t, list);
+                overflown = inode_table_overflown (table);
+
+                /* oldest first within a stripe, round robin across them */
+                while (overflown && table->lru_size > table->lru_limit
+                       && misses < GF_INODE_TABLE_STRIPES) {
+                        stripe = &table->stripes[table->prune_hand++
+                                                 % GF_INODE_TABLE_STRIPES];
+
+                        entry = __inode_stripe_evict (table, stripe);
+                        if (!entry) {
+                                misses++;
+                                continue;
+                        }
 
-                        table->lru_size--;
+                        misses = 0;
                         __inode_retire (entry);
 
                         ret++;
@@ -1171,8 +1420,12 @@ inode_table_new (size_t lru_limit, xlator_t *xl)
                 INIT_LIST_HEAD (&new->name_hash[i]);
         }
 
-        INIT_LIST_HEAD (&new->active);
-        INIT_LIST_HEAD (&new->lru);
+        for (i = 0; i < GF_INODE_TABLE_STRIPES; i++) {
+                LOCK_INIT (&new->stripes[i].lock);
+                INIT_LIST_HEAD (&new->stripes[i].active);
+                INIT_LIST_HEAD (&new->stripes[i].lru);
+        }
+
         INIT_LIST_HEAD (&new->purge);
 
         ret = gf_asprintf (&new->name, "%s/inode", xl->name);
@@ -1538,6 +1791,10 @@ inode_table_dump (inode_table_t *itable, char *prefix)
 
         char    key[GF_DUMP_MAX_BUF_LEN];
         int     ret = 0;
+        int     active = 1;
+        int     lru = 1;
+        int     purge = 1;
+        int     i = 0;
 
         if (!itable)
                 return;
@@ -1565,9 +1822,19 @@ inode_table_dump (inode_table_t *itable, char *prefix)
         gf_proc_dump_build_key(key, prefix, "purge_size");
         gf_proc_dump_write(key, "%d", itable->purge_size);
 
-        INODE_DUMP_LIST(&itable->active, key, prefix, "active");
-        INODE_DUMP_LIST(&itable->lru, key, prefix, "lru");
-        INODE_DUMP_LIST(&itable->purge, key, prefix, "purge");
+        /* the stripe lists are sorted out lazily, an inode taken into
+           use again may still be listed as lru */
+        for (i = 0; i < GF_INODE_TABLE_STRIPES; i++) {
+                LOCK (&itable->stripes[i].lock);
+                {
+                        INODE_DUMP_LIST(&itable->stripes[i].active, key,
+                                        prefix, "active", active);
+                        INODE_DUMP_LIST(&itable->stripes[i].lru, key,
+                                        prefix, "lru", lru);
+                }
+                UNLOCK (&itable->stripes[i].lock);
+        }
+        INODE_DUMP_LIST(&itable->purge, key, prefix, "purge", purge);
 
         pthread_mutex_unlock(&itable->lock);
 }
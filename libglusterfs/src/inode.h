@@ -44,8 +44,22 @@ typedef struct _dentry dentry_t;
 #include "uuid.h"
 
 
+/* The hash buckets and the inode lists are split over a fixed number
+   of stripes, each with its own lock, so that lookups and reference
+   counting on different inodes do not contend with each other. */
+#define GF_INODE_TABLE_STRIPES          64
+
+struct _inode_stripe {
+        gf_lock_t          lock;        /* guards the hash buckets mapping to
+                                           this stripe, and the lists below */
+        struct list_head   active;      /* inodes in use, maintained lazily:
+                                           some of them may be idle by now */
+        struct list_head   lru;         /* idle inodes, lru.next least recent */
+};
+
 struct _inode_table {
-        pthread_mutex_t    lock;
+        pthread_mutex_t    lock;        /* serialises changes to the dentry
+                                           tree, the hashes and the purge list */
         size_t             hashsize;    /* bucket size of inode hash and dentry hash */
         char              *name;        /* name of the inode table, just for gf_log() */
         inode_t           *root;        /* root directory inode, with number 1 */
@@ -53,11 +67,10 @@ struct _inode_table {
         uint32_t           lru_limit;   /* maximum LRU cache size */
         struct list_head  *inode_hash;  /* buckets for inode hash table */
         struct list_head  *name_hash;   /* buckets for dentry hash table */
-        struct list_head   active;      /* list of inodes currently active (in an fop) */
-        uint32_t           active_size; /* count of inodes in active list */
-        struct list_head   lru;         /* list of inodes recently used.
-                                           lru.next most recent */
-        uint32_t           lru_size;    /* count of inodes in lru list  */
+        struct _inode_stripe stripes[GF_INODE_TABLE_STRIPES];
+        uint32_t           active_size; /* count of inodes in use */
+        uint32_t           lru_size;    /* count of idle inodes */
+        uint32_t           prune_hand;  /* stripe the next eviction looks at */
         struct list_head   purge;       /* list of inodes to be purged soon */
         uint32_t           purge_size;  /* count of inodes in purge list */
 
@@ -95,13 +108,14 @@ struct _inode {
         uuid_t               gfid;
         gf_lock_t            lock;
         uint64_t             nlookup;
-        uint32_t             ref;           /* reference count on this inode */
+        uint32_t             ref;           /* reference count on this inode,
+                                               updated atomically */
         ino_t                ino;           /* inode number in the storage (persistent) */
         ia_type_t            ia_type;       /* what kind of file */
         struct list_head     fd_list;       /* list of open files on this inode */
         struct list_head     dentry_list;   /* list of directory entries for this inode */
         struct list_head     hash;          /* hash table pointers */
-        struct list_head     list;          /* active/lru/purge */
+        struct list_head     list;          /* active/lru of its stripe, or purge */
 
 	struct _inode_ctx   *_ctx;    /* replacement for dict_t *(inode->ctx) */
 };
@@ -24,9 +24,31 @@
 
 
 /*
-  TODO: implement destroy margins and prefetching of arenas
+  Every pool serves iobufs of several page sizes (classes), each class
+  with its own arenas. Idle arenas are kept mapped up to IOBUF_ARENA_KEEP
+  per class, so that bursts do not mmap/munmap repeatedly.
+
+  In front of the arenas, each thread keeps a magazine of up to
+  IOBUF_MAG_SIZE free iobufs per class. Gets and puts are served from
+  the magazine without any locking; it is refilled from and flushed to
+  the arenas half a magazine at a time under one pool lock.
+
+  Iobufs sitting in magazines keep their arenas from being pruned, so
+  all the magazines of a class together hold at most IOBUF_CACHE_BYTES
+  (and never less than one magazine). Past that, puts go straight back
+  to the arenas. The count is kept with atomic operations, the
+  magazines themselves stay thread private.
 */
 
+struct iobuf_cache {
+        struct list_head    list;          /* in iobuf_pool->caches */
+        struct iobuf_pool  *iobuf_pool;
+        int                 cnt[IOBUF_CLASS_MAX];
+        struct iobuf       *mag[IOBUF_CLASS_MAX][IOBUF_MAG_SIZE];
+        uint64_t            hits[IOBUF_CLASS_MAX];
+};
+
+
 void
 __iobuf_arena_init_iobufs (struct iobuf_arena *iobuf_arena)
 {
@@ -34,11 +56,11 @@ __iobuf_arena_init_iobufs (struct iobuf_arena *iobuf_arena)
         size_t              page_size = 0;
         int                 iobuf_cnt = 0;
         struct iobuf       *iobuf = NULL;
-        int                 offset = 0;
+        size_t              offset = 0;
         int                 i = 0;
 
-        arena_size = iobuf_arena->iobuf_pool->arena_size;
-        page_size  = iobuf_arena->iobuf_pool->page_size;
+        arena_size = iobuf_arena->arena_size;
+        page_size  = iobuf_arena->page_size;
         iobuf_cnt  = arena_size / page_size;
 
         iobuf_arena->iobufs = GF_CALLOC (sizeof (*iobuf), iobuf_cnt,
@@ -73,8 +95,8 @@ __iobuf_arena_destroy_iobufs (struct iobuf_arena *iobuf_arena)
         struct iobuf       *iobuf = NULL;
         int                 i = 0;
 
-        arena_size = iobuf_arena->iobuf_pool->arena_size;
-        page_size  = iobuf_arena->iobuf_pool->page_size;
+        arena_size = iobuf_arena->arena_size;
+        page_size  = iobuf_arena->page_size;
         iobuf_cnt  = arena_size / page_size;
 
         if (!iobuf_arena->iobufs)
@@ -95,25 +117,22 @@ __iobuf_arena_destroy_iobufs (struct iobuf_arena *iobuf_arena)
 void
 __iobuf_arena_destroy (struct iobuf_arena *iobuf_arena)
 {
-        struct iobuf_pool *iobuf_pool = NULL;
-
         if (!iobuf_arena)
                 return;
 
-        iobuf_pool = iobuf_arena->iobuf_pool;
-
         __iobuf_arena_destroy_iobufs (iobuf_arena);
 
         if (iobuf_arena->mem_base
             && iobuf_arena->mem_base != MAP_FAILED)
-                munmap (iobuf_arena->mem_base, iobuf_pool->arena_size);
+                munmap (iobuf_arena->mem_base, iobuf_arena->arena_size);
 
         GF_FREE (iobuf_arena);
 }
 
 
 struct iobuf_arena *
-__iobuf_arena_alloc (struct iobuf_pool *iobuf_pool)
+__iobuf_arena_alloc (struct iobuf_pool *iobuf_pool,
+                     struct iobuf_class *iobuf_class)
 {
         struct iobuf_arena *iobuf_arena = NULL;
         size_t              arena_size = 0;
@@ -127,8 +146,11 @@ __iobuf_arena_alloc (struct iobuf_pool *iobuf_pool)
         INIT_LIST_HEAD (&iobuf_arena->active.list);
         INIT_LIST_HEAD (&iobuf_arena->passive.list);
         iobuf_arena->iobuf_pool = iobuf_pool;
+        iobuf_arena->iobuf_class = iobuf_class;
+        iobuf_arena->page_size = iobuf_class->page_size;
+        iobuf_arena->arena_size = iobuf_class->arena_size;
 
-        arena_size = iobuf_pool->arena_size;
+        arena_size = iobuf_arena->arena_size;
         iobuf_arena->mem_base = mmap (NULL, arena_size, PROT_READ|PROT_WRITE,
                                       MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
         if (iobuf_arena->mem_base == MAP_FAILED)
@@ -138,6 +160,7 @@ __iobuf_arena_alloc (struct iobuf_pool *iobuf_pool)
         if (!iobuf_arena->iobufs)
                 goto err;
 
+        iobuf_class->arena_cnt++;
         iobuf_pool->arena_cnt++;
 
         return iobuf_arena;
@@ -149,13 +172,14 @@ err:
 
 
 struct iobuf_arena *
-__iobuf_arena_unprune (struct iobuf_pool *iobuf_pool)
+__iobuf_arena_unprune (struct iobuf_class *iobuf_class)
 {
         struct iobuf_arena *iobuf_arena = NULL;
         struct iobuf_arena *tmp = NULL;
 
-        list_for_each_entry (tmp, &iobuf_pool->purge.list, list) {
+        list_for_each_entry (tmp, &iobuf_class->purge.list, list) {
                 list_del_init (&tmp->list);
+                iobuf_class->purge_cnt--;
                 iobuf_arena = tmp;
                 break;
         }
@@ -165,32 +189,35 @@ __iobuf_arena_unprune (struct iobuf_pool *iobuf_pool)
 
 
 struct iobuf_arena *
-__iobuf_pool_add_arena (struct iobuf_pool *iobuf_pool)
+__iobuf_pool_add_arena (struct iobuf_pool *iobuf_pool,
+                        struct iobuf_class *iobuf_class)
 {
         struct iobuf_arena *iobuf_arena = NULL;
 
-        iobuf_arena = __iobuf_arena_unprune (iobuf_pool);
+        iobuf_arena = __iobuf_arena_unprune (iobuf_class);
 
         if (!iobuf_arena)
-                iobuf_arena = __iobuf_arena_alloc (iobuf_pool);
+                iobuf_arena = __iobuf_arena_alloc (iobuf_pool, iobuf_class);
 
         if (!iobuf_arena)
                 return NULL;
 
-        list_add_tail (&iobuf_arena->list, &iobuf_pool->arenas.list);
+        list_add_tail (&iobuf_arena->list, &iobuf_class->arenas.list);
 
         return iobuf_arena;
 }
 
 
 struct iobuf_arena *
-iobuf_pool_add_arena (struct iobuf_pool *iobuf_pool)
+iobuf_pool_add_arena (struct iobuf_pool *iobuf_pool,
+                      struct iobuf_class *iobuf_class)
 {
         struct iobuf_arena *iobuf_arena = NULL;
 
         pthread_mutex_lock (&iobuf_pool->mutex);
         {
-                iobuf_arena = __iobuf_pool_add_arena (iobuf_pool);
+                iobuf_arena = __iobuf_pool_add_arena (iobuf_pool,
+                                                      iobuf_class);
         }
         pthread_mutex_unlock (&iobuf_pool->mutex);
 
@@ -199,18 +226,16 @@ iobuf_pool_add_arena (struct iobuf_pool *iobuf_pool)
 
 
 void
-iobuf_pool_destroy (struct iobuf_pool *iobuf_pool)
+__iobuf_class_destroy (struct iobuf_pool *iobuf_pool,
+                       struct iobuf_arena *head)
 {
         struct iobuf_arena *iobuf_arena = NULL;
         struct iobuf_arena *tmp = NULL;
 
-        if (!iobuf_pool)
-                return;
-
-        list_for_each_entry_safe (iobuf_arena, tmp, &iobuf_pool->arenas.list,
-                                  list) {
+        list_for_each_entry_safe (iobuf_arena, tmp, &head->list, list) {
 
                 list_del_init (&iobuf_arena->list);
+                iobuf_arena->iobuf_class->arena_cnt--;
                 iobuf_pool->arena_cnt--;
 
                 __iobuf_arena_destroy (iobuf_arena);
@@ -218,10 +243,76 @@ iobuf_pool_destroy (struct iobuf_pool *iobuf_pool)
 }
 
 
+void
+iobuf_pool_destroy (struct iobuf_pool *iobuf_pool)
+{
+        struct iobuf_class *iobuf_class = NULL;
+        struct iobuf_cache *cache = NULL;
+        struct iobuf_cache *tmp = NULL;
+        int                 i = 0;
+
+        if (!iobuf_pool)
+                return;
+
+        /* the iobufs still cached by threads are dropped along with
+           their arenas */
+        pthread_key_delete (iobuf_pool->cache_key);
+
+        list_for_each_entry_safe (cache, tmp, &iobuf_pool->caches, list) {
+                list_del_init (&cache->list);
+                GF_FREE (cache);
+        }
+
+        for (i = 0; i < iobuf_pool->class_cnt; i++) {
+                iobuf_class = &iobuf_pool->classes[i];
+
+                __iobuf_class_destroy (iobuf_pool, &iobuf_class->arenas);
+                __iobuf_class_destroy (iobuf_pool, &iobuf_class->purge);
+        }
+}
+
+
+void iobuf_cache_destroy (void *data);
+
+
+static void
+iobuf_class_init (struct iobuf_pool *iobuf_pool, size_t page_size)
+{
+        struct iobuf_class *iobuf_class = NULL;
+        size_t              arena_size = 0;
+
+        iobuf_class = &iobuf_pool->classes[iobuf_pool->class_cnt];
+
+        iobuf_class->index = iobuf_pool->class_cnt++;
+        iobuf_class->page_size = page_size;
+
+        /* small pages get smaller arenas, never less than one page */
+        arena_size = page_size * IOBUF_ARENA_PAGES;
+        if (arena_size > iobuf_pool->arena_size)
+                arena_size = (iobuf_pool->arena_size / page_size) * page_size;
+        if (arena_size < page_size)
+                arena_size = page_size;
+        iobuf_class->arena_size = arena_size;
+
+        iobuf_class->cache_max = IOBUF_CACHE_BYTES / page_size;
+        if (iobuf_class->cache_max < IOBUF_MAG_SIZE)
+                iobuf_class->cache_max = IOBUF_MAG_SIZE;
+
+        INIT_LIST_HEAD (&iobuf_class->arenas.list);
+        INIT_LIST_HEAD (&iobuf_class->filled.list);
+        INIT_LIST_HEAD (&iobuf_class->purge.list);
+
+        if (page_size == iobuf_pool->page_size)
+                iobuf_pool->default_class = iobuf_class;
+}
+
+
 struct iobuf_pool *
 iobuf_pool_new (size_t arena_size, size_t page_size)
 {
         struct iobuf_pool  *iobuf_pool = NULL;
+        size_t              size = 0;
+        int                 added = 0;
 
         if (arena_size < page_size)
                 return NULL;
@@ -232,36 +323,58 @@ iobuf_pool_new (size_t arena_size, size_t page_size)
                 return NULL;
 
         pthread_mutex_init (&iobuf_pool->mutex, NULL);
-        INIT_LIST_HEAD (&iobuf_pool->arenas.list);
-        INIT_LIST_HEAD (&iobuf_pool->filled.list);
-        INIT_LIST_HEAD (&iobuf_pool->purge.list);
+        INIT_LIST_HEAD (&iobuf_pool->caches);
 
         iobuf_pool->arena_size = arena_size;
         iobuf_pool->page_size  = page_size;
 
-        iobuf_pool_add_arena (iobuf_pool);
+        /* power of two classes, with @page_size in its sorted place */
+        for (size = IOBUF_MIN_PAGE_SIZE; size <= IOBUF_MAX_PAGE_SIZE;
+             size *= 2) {
+                if (!added && page_size <= size) {
+                        iobuf_class_init (iobuf_pool, page_size);
+                        added = 1;
+                }
+
+                if (size != page_size)
+                        iobuf_class_init (iobuf_pool, size);
+        }
+
+        if (!added)
+                iobuf_class_init (iobuf_pool, page_size);
+
+        if (pthread_key_create (&iobuf_pool->cache_key,
+                                iobuf_cache_destroy) != 0) {
+                GF_FREE (iobuf_pool);
+                return NULL;
+        }
+
+        iobuf_pool_add_arena (iobuf_pool, iobuf_pool->default_class);
 
         return iobuf_pool;
 }
 
 
 void
-__iobuf_pool_prune (struct iobuf_pool *iobuf_pool)
+__iobuf_class_prune (struct iobuf_pool *iobuf_pool,
+                     struct iobuf_class *iobuf_class)
 {
         struct iobuf_arena *iobuf_arena = NULL;
         struct iobuf_arena *tmp = NULL;
 
-        if (list_empty (&iobuf_pool->arenas.list))
-                /* buffering - preserve this one arena (if at all)
-                   for __iobuf_arena_unprune */
-                return;
-
-        list_for_each_entry_safe (iobuf_arena, tmp, &iobuf_pool->purge.list,
+        /* buffering - preserve IOBUF_ARENA_KEEP idle arenas for
+           __iobuf_arena_unprune */
+        list_for_each_entry_safe (iobuf_arena, tmp, &iobuf_class->purge.list,
                                   list) {
+                if (iobuf_class->purge_cnt <= IOBUF_ARENA_KEEP)
+                        break;
+
                 if (iobuf_arena->active_cnt)
                         continue;
 
                 list_del_init (&iobuf_arena->list);
+                iobuf_class->purge_cnt--;
+                iobuf_class->arena_cnt--;
                 iobuf_pool->arena_cnt--;
 
                 __iobuf_arena_destroy (iobuf_arena);
@@ -269,25 +382,15 @@ __iobuf_pool_prune (struct iobuf_pool *iobuf_pool)
 }
 
 
-void
-iobuf_pool_prune (struct iobuf_pool *iobuf_pool)
-{
-        pthread_mutex_lock (&iobuf_pool->mutex);
-        {
-                __iobuf_pool_prune (iobuf_pool);
-        }
-        pthread_mutex_unlock (&iobuf_pool->mutex);
-}
-
-
 struct iobuf_arena *
-__iobuf_select_arena (struct iobuf_pool *iobuf_pool)
+__iobuf_select_arena (struct iobuf_pool *iobuf_pool,
+                      struct iobuf_class *iobuf_class)
 {
         struct iobuf_arena *iobuf_arena = NULL;
         struct iobuf_arena *trav = NULL;
 
         /* look for unused iobuf from the head-most arena */
-        list_for_each_entry (trav, &iobuf_pool->arenas.list, list) {
+        list_for_each_entry (trav, &iobuf_class->arenas.list, list) {
                 if (trav->passive_cnt) {
                         iobuf_arena = trav;
                         break;
@@ -296,7 +399,8 @@ __iobuf_select_arena (struct iobuf_pool *iobuf_pool)
 
         if (!iobuf_arena) {
                 /* all arenas were full */
-                iobuf_arena = __iobuf_pool_add_arena (iobuf_pool);
+                iobuf_arena = __iobuf_pool_add_arena (iobuf_pool,
+                                                      iobuf_class);
         }
 
         return iobuf_arena;
@@ -324,10 +428,10 @@ __iobuf_unref (struct iobuf *iobuf)
 struct iobuf *
 __iobuf_get (struct iobuf_arena *iobuf_arena)
 {
-        struct iobuf      *iobuf = NULL;
-        struct iobuf_pool *iobuf_pool = NULL;
+        struct iobuf       *iobuf = NULL;
+        struct iobuf_class *iobuf_class = NULL;
 
-        iobuf_pool = iobuf_arena->iobuf_pool;
+        iobuf_class = iobuf_arena->iobuf_class;
 
         list_for_each_entry (iobuf, &iobuf_arena->passive.list, list)
                 break;
@@ -340,7 +444,7 @@ __iobuf_get (struct iobuf_arena *iobuf_arena)
 
         if (iobuf_arena->passive_cnt == 0) {
                 list_del (&iobuf_arena->list);
-                list_add (&iobuf_arena->list, &iobuf_pool->filled.list);
+                list_add (&iobuf_arena->list, &iobuf_class->filled.list);
         }
 
         return iobuf;
@@ -348,41 +452,30 @@ __iobuf_get (struct iobuf_arena *iobuf_arena)
 
 
 struct iobuf *
-iobuf_get (struct iobuf_pool *iobuf_pool)
+__iobuf_class_get (struct iobuf_pool *iobuf_pool,
+                   struct iobuf_class *iobuf_class)
 {
-        struct iobuf       *iobuf = NULL;
         struct iobuf_arena *iobuf_arena = NULL;
 
-        pthread_mutex_lock (&iobuf_pool->mutex);
-        {
-                /* most eligible arena for picking an iobuf */
-                iobuf_arena = __iobuf_select_arena (iobuf_pool);
-                if (!iobuf_arena)
-                        goto unlock;
-
-                iobuf = __iobuf_get (iobuf_arena);
-                if (!iobuf)
-                        goto unlock;
-
-                __iobuf_ref (iobuf);
-        }
-unlock:
-        pthread_mutex_unlock (&iobuf_pool->mutex);
+        /* most eligible arena for picking an iobuf */
+        iobuf_arena = __iobuf_select_arena (iobuf_pool, iobuf_class);
+        if (!iobuf_arena)
+                return NULL;
 
-        return iobuf;
+        return __iobuf_get (iobuf_arena);
 }
 
 
 void
 __iobuf_put (struct iobuf *iobuf, struct iobuf_arena *iobuf_arena)
 {
-        struct iobuf_pool *iobuf_pool = NULL;
+        struct iobuf_class *iobuf_class = NULL;
 
-        iobuf_pool = iobuf_arena->iobuf_pool;
+        iobuf_class = iobuf_arena->iobuf_class;
 
         if (iobuf_arena->passive_cnt == 0) {
                 list_del (&iobuf_arena->list);
-                list_add_tail (&iobuf_arena->list, &iobuf_pool->arenas.list);
+                list_add_tail (&iobuf_arena->list, &iobuf_class->arenas.list);
         }
 
         list_del_init (&iobuf->list);
@@ -393,16 +486,175 @@ __iobuf_put (struct iobuf *iobuf, struct iobuf_arena *iobuf_arena)
 
         if (iobuf_arena->active_cnt == 0) {
                 list_del (&iobuf_arena->list);
-                list_add_tail (&iobuf_arena->list, &iobuf_pool->purge.list);
+                list_add_tail (&iobuf_arena->list, &iobuf_class->purge.list);
+                iobuf_class->purge_cnt++;
+        }
+}
+
+
+struct iobuf_class *
+iobuf_class_select (struct iobuf_pool *iobuf_pool, size_t page_size)
+{
+        int  i = 0;
+
+        for (i = 0; i < iobuf_pool->class_cnt; i++) {
+                if (iobuf_pool->classes[i].page_size >= page_size)
+                        return &iobuf_pool->classes[i];
+        }
+
+        return NULL;
+}
+
+
+struct iobuf_cache *
+iobuf_cache_get (struct iobuf_pool *iobuf_pool)
+{
+        struct iobuf_cache *cache = NULL;
+
+        cache = pthread_getspecific (iobuf_pool->cache_key);
+        if (cache)
+                return cache;
+
+        cache = GF_CALLOC (1, sizeof (*cache), gf_common_mt_iobuf_cache);
+        if (!cache)
+                return NULL;
+
+        INIT_LIST_HEAD (&cache->list);
+        cache->iobuf_pool = iobuf_pool;
+
+        if (pthread_setspecific (iobuf_pool->cache_key, cache) != 0) {
+                GF_FREE (cache);
+                return NULL;
+        }
+
+        pthread_mutex_lock (&iobuf_pool->mutex);
+        {
+                list_add (&cache->list, &iobuf_pool->caches);
+        }
+        pthread_mutex_unlock (&iobuf_pool->mutex);
+
+        return cache;
+}
+
+
+/* return @count iobufs of a class from the magazine to the arenas */
+void
+__iobuf_cache_flush (struct iobuf_cache *cache, int idx, int count)
+{
+        struct iobuf  *iobuf = NULL;
+
+        while (count-- && cache->cnt[idx]) {
+                iobuf = cache->mag[idx][--cache->cnt[idx]];
+                __sync_fetch_and_sub (&iobuf->iobuf_arena->iobuf_class->cached,
+                                      1);
+                __iobuf_put (iobuf, iobuf->iobuf_arena);
+                __iobuf_class_prune (cache->iobuf_pool,
+                                     iobuf->iobuf_arena->iobuf_class);
         }
 }
 
 
+void
+iobuf_cache_destroy (void *data)
+{
+        struct iobuf_cache *cache = NULL;
+        struct iobuf_pool  *iobuf_pool = NULL;
+        int                 i = 0;
+
+        cache = data;
+        iobuf_pool = cache->iobuf_pool;
+
+        pthread_mutex_lock (&iobuf_pool->mutex);
+        {
+                for (i = 0; i < iobuf_pool->class_cnt; i++)
+                        __iobuf_cache_flush (cache, i, IOBUF_MAG_SIZE);
+
+                list_del_init (&cache->list);
+        }
+        pthread_mutex_unlock (&iobuf_pool->mutex);
+
+        GF_FREE (cache);
+}
+
+
+struct iobuf *
+iobuf_get2 (struct iobuf_pool *iobuf_pool, size_t page_size)
+{
+        struct iobuf       *iobuf = NULL;
+        struct iobuf_class *iobuf_class = NULL;
+        struct iobuf_cache *cache = NULL;
+        int                 idx = 0;
+
+        iobuf_class = iobuf_class_select (iobuf_pool, page_size);
+        if (!iobuf_class) {
+                gf_log ("iobuf", GF_LOG_ERROR,
+                        "no iobuf class for page size %"GF_PRI_SIZET,
+                        page_size);
+                return NULL;
+        }
+
+        idx = iobuf_class->index;
+
+        cache = iobuf_cache_get (iobuf_pool);
+        if (cache && cache->cnt[idx]) {
+                iobuf = cache->mag[idx][--cache->cnt[idx]];
+                __sync_fetch_and_sub (&iobuf_class->cached, 1);
+                cache->hits[idx]++;
+                goto out;
+        }
+
+        pthread_mutex_lock (&iobuf_pool->mutex);
+        {
+                iobuf_class->misses++;
+
+                iobuf = __iobuf_class_get (iobuf_pool, iobuf_class);
+                if (!iobuf || !cache)
+                        goto unlock;
+
+                /* refill half of the magazine while holding the lock,
+                   as far as the bound on the cached iobufs allows */
+                while (cache->cnt[idx] < IOBUF_MAG_SIZE / 2) {
+                        if (__sync_add_and_fetch (&iobuf_class->cached, 1)
+                            > iobuf_class->cache_max) {
+                                __sync_fetch_and_sub (&iobuf_class->cached, 1);
+                                break;
+                        }
+
+                        cache->mag[idx][cache->cnt[idx]] =
+                                __iobuf_class_get (iobuf_pool, iobuf_class);
+                        if (!cache->mag[idx][cache->cnt[idx]]) {
+                                __sync_fetch_and_sub (&iobuf_class->cached, 1);
+                                break;
+                        }
+                        cache->cnt[idx]++;
+                }
+        }
+unlock:
+        pthread_mutex_unlock (&iobuf_pool->mutex);
+
+out:
+        if (iobuf)
+                __iobuf_ref (iobuf);
+
+        return iobuf;
+}
+
+
+struct iobuf *
+iobuf_get (struct iobuf_pool *iobuf_pool)
+{
+        return iobuf_get2 (iobuf_pool, iobuf_pool->page_size);
+}
+
+
 void
 iobuf_put (struct iobuf *iobuf)
 {
         struct iobuf_arena *iobuf_arena = NULL;
         struct iobuf_pool  *iobuf_pool = NULL;
+        struct iobuf_class *iobuf_class = NULL;
+        struct iobuf_cache *cache = NULL;
+        int                 idx = 0;
 
         if (!iobuf)
                 return;
@@ -415,13 +667,33 @@ iobuf_put (struct iobuf *iobuf)
         if (!iobuf_pool)
                 return;
 
+        idx = iobuf_arena->iobuf_class->index;
+
+        iobuf_class = iobuf_arena->iobuf_class;
+
+        cache = iobuf_cache_get (iobuf_pool);
+        if (cache && cache->cnt[idx] < IOBUF_MAG_SIZE) {
+                if (__sync_add_and_fetch (&iobuf_class->cached, 1)
+                    <= iobuf_class->cache_max) {
+                        cache->mag[idx][cache->cnt[idx]++] = iobuf;
+                        return;
+                }
+
+                /* the other threads hold enough of this class already */
+                __sync_fetch_and_sub (&iobuf_class->cached, 1);
+                cache = NULL;
+        }
+
         pthread_mutex_lock (&iobuf_pool->mutex);
         {
                 __iobuf_put (iobuf, iobuf_arena);
+                __iobuf_class_prune (iobuf_pool, iobuf_arena->iobuf_class);
+
+                /* make room for the next puts of this thread */
+                if (cache)
+                        __iobuf_cache_flush (cache, idx, IOBUF_MAG_SIZE / 2);
         }
         pthread_mutex_unlock (&iobuf_pool->mutex);
-
-        iobuf_pool_prune (iobuf_pool);
 }
 
 
@@ -612,10 +884,7 @@ iobuf_size (struct iobuf *iobuf)
         if (!iobuf->iobuf_arena)
                 goto out;
 
-        if (!iobuf->iobuf_arena->iobuf_pool)
-                goto out;
-
-        size = iobuf->iobuf_arena->iobuf_pool->page_size;
+        size = iobuf->iobuf_arena->page_size;
 out:
         return size;
 }
@@ -694,13 +963,50 @@ iobuf_arena_info_dump (struct iobuf_arena *iobuf_arena, const char *key_prefix)
 
 }
 
+void
+iobuf_class_info_dump (struct iobuf_pool *iobuf_pool,
+                       struct iobuf_class *iobuf_class, const char *key_prefix)
+{
+        char                key[GF_DUMP_MAX_BUF_LEN];
+        char                msg[1024];
+        struct iobuf_arena *trav = NULL;
+        struct iobuf_cache *cache = NULL;
+        uint64_t            hits = 0;
+        int                 i = 1;
+
+        list_for_each_entry (cache, &iobuf_pool->caches, list)
+                hits += cache->hits[iobuf_class->index];
+
+        gf_proc_dump_build_key(key, key_prefix, "page_size");
+        gf_proc_dump_write(key, "%"GF_PRI_SIZET, iobuf_class->page_size);
+        gf_proc_dump_build_key(key, key_prefix, "arena_size");
+        gf_proc_dump_write(key, "%"GF_PRI_SIZET, iobuf_class->arena_size);
+        gf_proc_dump_build_key(key, key_prefix, "arena_cnt");
+        gf_proc_dump_write(key, "%d", iobuf_class->arena_cnt);
+        gf_proc_dump_build_key(key, key_prefix, "purge_cnt");
+        gf_proc_dump_write(key, "%d", iobuf_class->purge_cnt);
+        gf_proc_dump_build_key(key, key_prefix, "cache_hits");
+        gf_proc_dump_write(key, "%"PRIu64, hits);
+        gf_proc_dump_build_key(key, key_prefix, "cache_misses");
+        gf_proc_dump_write(key, "%"PRIu64, iobuf_class->misses);
+        gf_proc_dump_build_key(key, key_prefix, "cached");
+        gf_proc_dump_write(key, "%d/%d", iobuf_class->cached,
+                           iobuf_class->cache_max);
+
+        list_for_each_entry (trav, &iobuf_class->arenas.list, list) {
+                snprintf(msg, sizeof(msg), "%s.arena.%d", key_prefix, i);
+		gf_proc_dump_add_section(msg);
+                iobuf_arena_info_dump(trav,msg);
+                i++;
+        }
+}
+
 void
 iobuf_stats_dump (struct iobuf_pool *iobuf_pool)
 {
     
         char               msg[1024];
-        struct iobuf_arena *trav = NULL;
-        int                i = 1;
+        int                i = 0;
         int                ret = -1;
 
         if (!iobuf_pool)
@@ -724,12 +1030,12 @@ iobuf_stats_dump (struct iobuf_pool *iobuf_pool)
         gf_proc_dump_write("iobuf.global.iobuf_pool.arena_cnt", "%d",
 						 iobuf_pool->arena_cnt);
 
-        list_for_each_entry (trav, &iobuf_pool->arenas.list, list) {
-                snprintf(msg, sizeof(msg), "iobuf.global.iobuf_pool.arena.%d",
-                                                                            i);
+        for (i = 0; i < iobuf_pool->class_cnt; i++) {
+                snprintf(msg, sizeof(msg), "iobuf.global.iobuf_pool.class.%d",
+                         i);
 		gf_proc_dump_add_section(msg);
-                iobuf_arena_info_dump(trav,msg);
-                i++;
+                iobuf_class_info_dump(iobuf_pool, &iobuf_pool->classes[i],
+                                      msg);
         }
         
         pthread_mutex_unlock(&iobuf_pool->mutex);
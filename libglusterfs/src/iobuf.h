@@ -46,10 +46,24 @@ struct iobuf;
 /* each arena hosts @arena_size / @page_size IOBUFs */
 struct iobuf_arena;
 
+/* arenas of one page size */
+struct iobuf_class;
+
 /* expandable and contractable pool of memory, internally broken into arenas */
 struct iobuf_pool;
 
 
+#define IOBUF_MIN_PAGE_SIZE   (4 * GF_UNIT_KB)
+#define IOBUF_MAX_PAGE_SIZE   (1 * GF_UNIT_MB)
+#define IOBUF_CLASS_MAX       10   /* 4KB - 1MB, plus the pool page size */
+#define IOBUF_ARENA_PAGES     256  /* pages per arena, below @arena_size */
+
+#define IOBUF_MAG_SIZE        16   /* iobufs cached per thread and class */
+#define IOBUF_CACHE_BYTES     (16 * GF_UNIT_MB) /* cached by all threads,
+                                                  per class */
+#define IOBUF_ARENA_KEEP      1    /* idle arenas kept mapped per class */
+
+
 struct iobuf {
         union {
                 struct list_head      list;
@@ -76,6 +90,10 @@ struct iobuf_arena {
                 };
         };
         struct iobuf_pool  *iobuf_pool;
+        struct iobuf_class *iobuf_class;
+
+        size_t              page_size;  /* size of the iobufs in this arena */
+        size_t              arena_size;
 
         void               *mem_base;
         struct iobuf       *iobufs;     /* allocated iobufs list */
@@ -89,16 +107,36 @@ struct iobuf_arena {
 };
 
 
-struct iobuf_pool {
-        pthread_mutex_t     mutex;
-        size_t              page_size;  /* size of all iobufs in this pool */
-        size_t              arena_size; /* size of memory region in arena */
+struct iobuf_class {
+        int                 index;
+        size_t              page_size;
+        size_t              arena_size;
 
         int                 arena_cnt;
         struct iobuf_arena  arenas;     /* head node arena
                                            (unused by itself) */
         struct iobuf_arena  filled;     /* arenas without  free iobufs */
+        int                 purge_cnt;
         struct iobuf_arena  purge;      /* arenas which can be purged */
+
+        uint64_t            misses;     /* gets not served by a thread cache */
+        int                 cached;     /* iobufs in all the magazines */
+        int                 cache_max;  /* bound on @cached */
+};
+
+
+struct iobuf_pool {
+        pthread_mutex_t     mutex;
+        size_t              page_size;  /* size of iobufs from iobuf_get () */
+        size_t              arena_size; /* size of memory region in arena */
+
+        int                 arena_cnt;
+        int                 class_cnt;
+        struct iobuf_class *default_class;
+        struct iobuf_class  classes[IOBUF_CLASS_MAX]; /* by page size */
+
+        pthread_key_t       cache_key;  /* per-thread iobuf magazines */
+        struct list_head    caches;
 };
 
 
@@ -107,6 +145,7 @@ struct iobuf_pool {
 struct iobuf_pool *iobuf_pool_new (size_t arena_size, size_t page_size);
 void iobuf_pool_destroy (struct iobuf_pool *iobuf_pool);
 struct iobuf *iobuf_get (struct iobuf_pool *iobuf_pool);
+struct iobuf *iobuf_get2 (struct iobuf_pool *iobuf_pool, size_t page_size);
 void iobuf_unref (struct iobuf *iobuf);
 struct iobuf *iobuf_ref (struct iobuf *iobuf);
 void iobuf_pool_destroy (struct iobuf_pool *iobuf_pool);
@@ -114,7 +153,7 @@ void iobuf_to_iovec(struct iobuf *iob, struct iovec *iov);
 
 #define iobuf_ptr(iob) ((iob)->ptr)
 #define iobpool_pagesize(iobpool) ((iobpool)->page_size)
-#define iobuf_pagesize(iob) (iobpool_pagesize((iob)->iobuf_arena->iobuf_pool))
+#define iobuf_pagesize(iob) ((iob)->iobuf_arena->page_size)
 
 
 struct iobref {
@@ -23,6 +23,8 @@
  * latencies of FOPs broken down by subvolumes.
  */
 
+#include <ctype.h>
+
 #include "glusterfs.h"
 #include "stack.h"
 #include "xlator.h"
@@ -30,119 +32,112 @@
 #include "statedump.h"
 
 
-void
-gf_set_fop_from_fn_pointer (call_frame_t *frame, struct xlator_fops *fops, void *fn)
+static struct {
+        const char      *name;
+        glusterfs_fop_t  fop;
+} gf_wind_fops[] = {
+        { "lookup",      GF_FOP_LOOKUP },
+        { "stat",        GF_FOP_STAT },
+        { "fstat",       GF_FOP_FSTAT },
+        { "truncate",    GF_FOP_TRUNCATE },
+        { "ftruncate",   GF_FOP_FTRUNCATE },
+        { "access",      GF_FOP_ACCESS },
+        { "readlink",    GF_FOP_READLINK },
+        { "mknod",       GF_FOP_MKNOD },
+        { "mkdir",       GF_FOP_MKDIR },
+        { "unlink",      GF_FOP_UNLINK },
+        { "rmdir",       GF_FOP_RMDIR },
+        { "symlink",     GF_FOP_SYMLINK },
+        { "rename",      GF_FOP_RENAME },
+        { "link",        GF_FOP_LINK },
+        { "create",      GF_FOP_CREATE },
+        { "open",        GF_FOP_OPEN },
+        { "readv",       GF_FOP_READ },
+        { "writev",      GF_FOP_WRITE },
+        { "flush",       GF_FOP_FLUSH },
+        { "fsync",       GF_FOP_FSYNC },
+        { "opendir",     GF_FOP_OPENDIR },
+        { "readdir",     GF_FOP_READDIR },
+        { "readdirp",    GF_FOP_READDIRP },
+        { "fsyncdir",    GF_FOP_FSYNCDIR },
+        { "statfs",      GF_FOP_STATFS },
+        { "setxattr",    GF_FOP_SETXATTR },
+        { "getxattr",    GF_FOP_GETXATTR },
+        { "fsetxattr",   GF_FOP_FSETXATTR },
+        { "fgetxattr",   GF_FOP_FGETXATTR },
+        { "removexattr", GF_FOP_REMOVEXATTR },
+        { "lk",          GF_FOP_LK },
+        { "inodelk",     GF_FOP_INODELK },
+        { "finodelk",    GF_FOP_FINODELK },
+        { "entrylk",     GF_FOP_ENTRYLK },
+        { "fentrylk",    GF_FOP_FENTRYLK },
+        { "rchecksum",   GF_FOP_RCHECKSUM },
+        { "xattrop",     GF_FOP_XATTROP },
+        { "fxattrop",    GF_FOP_FXATTROP },
+        { "setattr",     GF_FOP_SETATTR },
+        { "fsetattr",    GF_FOP_FSETATTR },
+        { "getspec",     GF_FOP_GETSPEC },
+        { NULL,          GF_FOP_NULL },
+};
+
+
+/*
+ * @fn is the stringified fn argument of STACK_WIND, which always ends in
+ * the name of a member of struct xlator_fops. STACK_WIND calls this once
+ * per call site and keeps the result, see FRAME_SET_FOP.
+ */
+int
+gf_fop_from_wind_fn (const char *fn)
 {
-        glusterfs_fop_t fop = -1;
-
-        if (fops->stat == fn)
-                fop = GF_FOP_STAT;
-        else if (fops->readlink == fn)
-                fop = GF_FOP_READLINK;
-        else if (fops->mknod == fn)
-                fop = GF_FOP_MKNOD;
-        else if (fops->mkdir == fn)
-                fop = GF_FOP_MKDIR;
-        else if (fops->unlink == fn)
-                fop = GF_FOP_UNLINK;
-        else if (fops->rmdir == fn)
-                fop = GF_FOP_RMDIR;
-        else if (fops->symlink == fn)
-                fop = GF_FOP_SYMLINK;
-        else if (fops->rename == fn)
-                fop = GF_FOP_RENAME;
-        else if (fops->link == fn)
-                fop = GF_FOP_LINK;
-        else if (fops->truncate == fn)
-                fop = GF_FOP_TRUNCATE;
-        else if (fops->open == fn)
-                fop = GF_FOP_OPEN;
-        else if (fops->readv == fn)
-                fop = GF_FOP_READ;
-        else if (fops->writev == fn)
-                fop = GF_FOP_WRITE;
-        else if (fops->statfs == fn)
-                fop = GF_FOP_STATFS;
-        else if (fops->flush == fn)
-                fop = GF_FOP_FLUSH;
-        else if (fops->fsync == fn)
-                fop = GF_FOP_FSYNC;
-        else if (fops->setxattr == fn)
-                fop = GF_FOP_SETXATTR;
-        else if (fops->getxattr == fn)
-                fop = GF_FOP_GETXATTR;
-        else if (fops->removexattr == fn)
-                fop = GF_FOP_REMOVEXATTR;
-        else if (fops->opendir == fn)
-                fop = GF_FOP_OPENDIR;
-        else if (fops->fsyncdir == fn)
-                fop = GF_FOP_FSYNCDIR;
-        else if (fops->access == fn)
-                fop = GF_FOP_ACCESS;
-        else if (fops->create == fn)
-                fop = GF_FOP_CREATE;
-        else if (fops->ftruncate == fn)
-                fop = GF_FOP_FTRUNCATE;
-        else if (fops->fstat == fn)
-                fop = GF_FOP_FSTAT;
-        else if (fops->lk == fn)
-                fop = GF_FOP_LK;
-        else if (fops->lookup == fn)
-                fop = GF_FOP_LOOKUP;
-        else if (fops->readdir == fn)
-                fop = GF_FOP_READDIR;
-        else if (fops->inodelk == fn)
-                fop = GF_FOP_INODELK;
-        else if (fops->finodelk == fn)
-                fop = GF_FOP_FINODELK;
-	else if (fops->entrylk == fn)
-                fop = GF_FOP_ENTRYLK;
-	else if (fops->fentrylk == fn)
-                fop = GF_FOP_FENTRYLK;
-        else if (fops->xattrop == fn)
-                fop = GF_FOP_XATTROP;
-        else if (fops->fxattrop == fn)
-                fop = GF_FOP_FXATTROP;
-        else if (fops->fgetxattr == fn)
-                fop = GF_FOP_FGETXATTR;
-        else if (fops->fsetxattr == fn)
-                fop = GF_FOP_FSETXATTR;
-        else if (fops->rchecksum == fn)
-                fop = GF_FOP_RCHECKSUM;
-        else if (fops->setattr == fn)
-                fop = GF_FOP_SETATTR;
-        else if (fops->fsetattr == fn)
-                fop = GF_FOP_FSETATTR;
-        else if (fops->readdirp == fn)
-                fop = GF_FOP_READDIRP;
-        else if (fops->getspec == fn)
-                fop = GF_FOP_GETSPEC;
-        else
-                fop = -1;
-
-        frame->op   = fop;
+        const char *name = NULL;
+        int         i = 0;
+
+        name = fn + strlen (fn);
+        while ((name > fn) && (isalnum (name[-1]) || (name[-1] == '_')))
+                name--;
+
+        for (i = 0; gf_wind_fops[i].name; i++) {
+                if (strcmp (name, gf_wind_fops[i].name) == 0)
+                        return gf_wind_fops[i].fop;
+        }
+
+        return -1;
 }
 
 
 void
 gf_update_latency (call_frame_t *frame)
 {
-        double elapsed;
         struct timeval *begin, *end;
+        fop_latency_t  *lat;
+        int64_t         elapsed;
+        uint64_t        old;
 
-        fop_latency_t *lat;
+        if ((frame->op <= GF_FOP_NULL) || (frame->op >= GF_FOP_MAXVALUE))
+                return;
 
         begin = &frame->begin;
         end   = &frame->end;
 
-        elapsed = (end->tv_sec - begin->tv_sec) * 1e6
+        elapsed = (end->tv_sec - begin->tv_sec) * 1000000LL
                 + (end->tv_usec - begin->tv_usec);
+        if (elapsed < 0)
+                elapsed = 0;
 
         lat = &frame->this->latencies[frame->op];
 
-	lat->total += elapsed;
-        lat->count++;
-        lat->mean = lat->mean + (elapsed - lat->mean) / lat->count;
+        __sync_fetch_and_add (&lat->total, elapsed);
+        __sync_fetch_and_add (&lat->count, 1);
+
+        old = lat->min;
+        while ((old == 0 || old > elapsed)
+               && !__sync_bool_compare_and_swap (&lat->min, old, elapsed))
+                old = lat->min;
+
+        old = lat->max;
+        while ((old < elapsed)
+               && !__sync_bool_compare_and_swap (&lat->max, old, elapsed))
+                old = lat->max;
 }
 
 
@@ -151,18 +146,25 @@ gf_proc_dump_latency_info (xlator_t *xl)
 {
         char key_prefix[GF_DUMP_MAX_BUF_LEN];
         char key[GF_DUMP_MAX_BUF_LEN];
+        fop_latency_t *lat;
         int i;
 
         snprintf (key_prefix, GF_DUMP_MAX_BUF_LEN, "%s.latency", xl->name);
         gf_proc_dump_add_section (key_prefix);
 
         for (i = 0; i < GF_FOP_MAXVALUE; i++) {
+                lat = &xl->latencies[i];
+                if (!lat->count)
+                        continue;
+
                 gf_proc_dump_build_key (key, key_prefix, gf_fop_list[i]);
 
-                gf_proc_dump_write (key, "%.03f,%"PRId64",%.03f",
-                                    xl->latencies[i].mean,
-                                    xl->latencies[i].count,
-				    xl->latencies[i].total);
+                /* mean,count,total,min,max */
+                gf_proc_dump_write (key, "%.03f,%"PRId64",%.03f,%"PRIu64
+                                    ",%"PRIu64,
+                                    (double) lat->total / lat->count,
+                                    lat->count, (double) lat->total,
+                                    lat->min, lat->max);
         }
 }
 
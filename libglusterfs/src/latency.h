@@ -21,12 +21,12 @@
 #define __LATENCY_H__
 
 
+/* updated without locks from whichever thread unwinds, see
+   gf_update_latency () */
 typedef struct fop_latency {
         uint64_t min;           /* min time for the call (microseconds) */
         uint64_t max;           /* max time for the call (microseconds) */
-	double total;           /* total time (microseconds) */
-        double std;             /* standard deviation */
-        double mean;            /* mean (microseconds) */
+        uint64_t total;         /* total time (microseconds) */
         uint64_t count;
 } fop_latency_t;
 
@@ -20,8 +20,10 @@
 #include "mem-pool.h"
 #include "logging.h"
 #include "xlator.h"
+#include "statedump.h"
 #include <stdlib.h>
 #include <stdarg.h>
+#include <inttypes.h>
 
 #define GF_MEM_POOL_LIST_BOUNDARY        (sizeof(struct list_head))
 #define GF_MEM_POOL_PAD_BOUNDARY         (GF_MEM_POOL_LIST_BOUNDARY + sizeof(int))
@@ -39,6 +41,39 @@
 
 static int gf_mem_acct_enable = 0;
 
+/* Per-thread front end of the mem pools. Each thread owns one magazine per
+ * slot; a pool maps to a fixed slot and may only take the magazine over
+ * when it is empty. Objects parked in a magazine are still accounted in the
+ * pool's hot_count but are marked not in use. The owning thread works on
+ * its magazines without any locking, the pool lock is taken only when a
+ * magazine has to be refilled from or flushed to the slab. No other thread
+ * ever touches a magazine: a bound magazine holds a ref on its pool, and a
+ * destroyed pool stays around until its owners have detached from it the
+ * next time they use the slot or when they exit.
+ */
+struct mem_pool_magazine {
+        struct mem_pool  *pool;
+        int               count;
+        uint64_t          hits;
+        void             *objs[MEM_POOL_MAG_SIZE];  /* chunk heads */
+};
+
+struct mem_pool_tcache {
+        struct list_head          list;
+        struct mem_pool_magazine  mags[MEM_POOL_TC_SLOTS];
+};
+
+static pthread_once_t   mem_pool_tc_once = PTHREAD_ONCE_INIT;
+static pthread_key_t    mem_pool_tc_key;
+static int              mem_pool_tc_enabled = 0;
+
+/* protects the lists of pools and thread caches below */
+static pthread_mutex_t  mem_pool_global_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct list_head mem_pool_list = {&mem_pool_list, &mem_pool_list};
+static struct list_head mem_pool_tcaches = {&mem_pool_tcaches,
+                                            &mem_pool_tcaches};
+static int              mem_pool_next_slot = 0;
+
 int
 gf_mem_acct_is_enabled ()
 {
@@ -311,9 +346,224 @@ free:
 
 
 
+static void
+__mem_pool_magazine_flush (struct mem_pool *pool,
+                           struct mem_pool_magazine *mag, int count)
+{
+        struct list_head *list = NULL;
+
+        while (count-- && mag->count) {
+                list = mag->objs[--mag->count];
+                list_add (list, &pool->list);
+                pool->hot_count--;
+                pool->cold_count++;
+        }
+
+        pool->tc_hits += mag->hits;
+        mag->hits = 0;
+}
+
+
+static void
+mem_pool_free (struct mem_pool *pool)
+{
+        LOCK_DESTROY (&pool->lock);
+        GF_FREE (pool->pool);
+        GF_FREE (pool);
+}
+
+
+/* Unbinds the magazine from its pool, giving the parked objects back to the
+ * slab, or dropping them along with the slab if the pool was destroyed.
+ * Called by the owning thread only.
+ */
+static void
+mem_pool_magazine_detach (struct mem_pool_magazine *mag)
+{
+        struct mem_pool *pool = NULL;
+        int              refcount = 0;
+
+        pool = mag->pool;
+        mag->pool = NULL;
+
+        LOCK (&pool->lock);
+        {
+                if (!pool->dead)
+                        __mem_pool_magazine_flush (pool, mag, mag->count);
+                mag->count = 0;
+                mag->hits = 0;
+
+                refcount = --pool->refcount;
+        }
+        UNLOCK (&pool->lock);
+
+        if (!refcount)
+                mem_pool_free (pool);
+}
+
+
+static void
+mem_pool_tcache_destroy (void *data)
+{
+        struct mem_pool_tcache   *tc = NULL;
+        int                       i = 0;
+
+        tc = data;
+        if (!tc)
+                return;
+
+        pthread_mutex_lock (&mem_pool_global_lock);
+        {
+                list_del_init (&tc->list);
+        }
+        pthread_mutex_unlock (&mem_pool_global_lock);
+
+        for (i = 0; i < MEM_POOL_TC_SLOTS; i++) {
+                if (tc->mags[i].pool)
+                        mem_pool_magazine_detach (&tc->mags[i]);
+        }
+
+        GF_FREE (tc);
+}
+
+
+static void
+mem_pool_tcache_key_init (void)
+{
+        int ret = 0;
+
+        ret = pthread_key_create (&mem_pool_tc_key, mem_pool_tcache_destroy);
+        if (ret) {
+                gf_log ("mem-pool", GF_LOG_WARNING,
+                        "failed to create thread cache key (%s), "
+                        "mem pools will not be cached per thread",
+                        strerror (ret));
+                return;
+        }
+
+        mem_pool_tc_enabled = 1;
+}
+
+
+static struct mem_pool_tcache *
+mem_pool_tcache_get (void)
+{
+        struct mem_pool_tcache *tc = NULL;
+
+        if (!mem_pool_tc_enabled)
+                return NULL;
+
+        tc = pthread_getspecific (mem_pool_tc_key);
+        if (tc)
+                return tc;
+
+        tc = GF_CALLOC (1, sizeof (*tc), gf_common_mt_mem_pool_tcache);
+        if (!tc)
+                return NULL;
+
+        INIT_LIST_HEAD (&tc->list);
+
+        if (pthread_setspecific (mem_pool_tc_key, tc)) {
+                GF_FREE (tc);
+                return NULL;
+        }
+
+        pthread_mutex_lock (&mem_pool_global_lock);
+        {
+                list_add_tail (&tc->list, &mem_pool_tcaches);
+        }
+        pthread_mutex_unlock (&mem_pool_global_lock);
+
+        return tc;
+}
+
+
+/* Returns this thread's magazine for @pool, or NULL if the slot is
+ * currently held by objects of another live pool.
+ */
+static struct mem_pool_magazine *
+mem_pool_magazine_get (struct mem_pool *pool)
+{
+        struct mem_pool_tcache   *tc = NULL;
+        struct mem_pool_magazine *mag = NULL;
+
+        tc = mem_pool_tcache_get ();
+        if (!tc)
+                return NULL;
+
+        mag = &tc->mags[pool->tc_slot];
+        if (mag->pool == pool)
+                return mag;
+
+        if (mag->pool) {
+                /* racy peek, a pool is only ever marked dead */
+                if (mag->count && !mag->pool->dead)
+                        return NULL;
+
+                mem_pool_magazine_detach (mag);
+        }
+
+        LOCK (&pool->lock);
+        {
+                pool->refcount++;
+        }
+        UNLOCK (&pool->lock);
+
+        mag->pool = pool;
+        mag->hits = 0;
+
+        return mag;
+}
+
+
+static void
+mem_pool_magazine_refill (struct mem_pool *pool, struct mem_pool_magazine *mag)
+{
+        struct list_head *list = NULL;
+        int              *in_use = NULL;
+        int               count = 0;
+
+        LOCK (&pool->lock);
+        {
+                while (pool->cold_count
+                       && (count < MEM_POOL_MAG_SIZE / 2)) {
+                        list = pool->list.next;
+                        list_del (list);
+
+                        in_use = ((void *)list + GF_MEM_POOL_LIST_BOUNDARY);
+                        *in_use = 0;
+
+                        mag->objs[mag->count++] = list;
+                        pool->hot_count++;
+                        pool->cold_count--;
+                        count++;
+                }
+
+                pool->alloc_count += count;
+                if (pool->hot_count > pool->max_hot_count)
+                        pool->max_hot_count = pool->hot_count;
+
+                pool->tc_hits += mag->hits;
+                mag->hits = 0;
+        }
+        UNLOCK (&pool->lock);
+}
+
+
+static void
+mem_pool_magazine_flush (struct mem_pool *pool, struct mem_pool_magazine *mag)
+{
+        LOCK (&pool->lock);
+        {
+                __mem_pool_magazine_flush (pool, mag, MEM_POOL_MAG_SIZE / 2);
+        }
+        UNLOCK (&pool->lock);
+}
+
+
 struct mem_pool *
 mem_pool_new_fn (unsigned long sizeof_type,
-		 unsigned long count)
+		 unsigned long count, const char *name)
 {
 	struct mem_pool  *mem_pool = NULL;
 	unsigned long     padded_sizeof_type = 0;
@@ -337,6 +587,7 @@ mem_pool_new_fn (unsigned long sizeof_type,
 	mem_pool->padded_sizeof_type = padded_sizeof_type;
 	mem_pool->cold_count = count;
         mem_pool->real_sizeof_type = sizeof_type;
+        mem_pool->refcount = 1;
 
         pool = GF_CALLOC (count, padded_sizeof_type, gf_common_mt_long);
 	if (!pool) {
@@ -352,6 +603,16 @@ mem_pool_new_fn (unsigned long sizeof_type,
 
 	mem_pool->pool = pool;
 	mem_pool->pool_end = pool + (count * (padded_sizeof_type));
+        mem_pool->name = name;
+
+        pthread_once (&mem_pool_tc_once, mem_pool_tcache_key_init);
+
+        pthread_mutex_lock (&mem_pool_global_lock);
+        {
+                mem_pool->tc_slot = mem_pool_next_slot++ % MEM_POOL_TC_SLOTS;
+                list_add_tail (&mem_pool->global_list, &mem_pool_list);
+        }
+        pthread_mutex_unlock (&mem_pool_global_lock);
 
 	return mem_pool;
 }
@@ -380,12 +641,29 @@ mem_get (struct mem_pool *mem_pool)
 	struct list_head *list = NULL;
 	void             *ptr = NULL;
         int             *in_use = NULL;
+        struct mem_pool_magazine *mag = NULL;
 
 	if (!mem_pool) {
 		gf_log ("mem-pool", GF_LOG_ERROR, "invalid argument");
 		return NULL;
 	}
 
+        mag = mem_pool_magazine_get (mem_pool);
+        if (mag) {
+                if (!mag->count)
+                        mem_pool_magazine_refill (mem_pool, mag);
+
+                if (mag->count) {
+                        ptr = mag->objs[--mag->count];
+                        mag->hits++;
+
+                        in_use = (ptr + GF_MEM_POOL_LIST_BOUNDARY);
+                        *in_use = 1;
+
+                        return mem_pool_chunkhead2ptr (ptr);
+                }
+        }
+
 	LOCK (&mem_pool->lock);
 	{
 		if (mem_pool->cold_count) {
@@ -394,6 +672,9 @@ mem_get (struct mem_pool *mem_pool)
 
 			mem_pool->hot_count++;
 			mem_pool->cold_count--;
+                        mem_pool->alloc_count++;
+                        if (mem_pool->hot_count > mem_pool->max_hot_count)
+                                mem_pool->max_hot_count = mem_pool->hot_count;
 
 			ptr = list;
                         in_use = (ptr + GF_MEM_POOL_LIST_BOUNDARY);
@@ -423,6 +704,7 @@ mem_get (struct mem_pool *mem_pool)
                  * allocator is coming RSN.
                  */
 		ptr = MALLOC (mem_pool->real_sizeof_type);
+                mem_pool->pool_misses++;
 
                 /* Memory coming from the heap need not be transformed from a
                  * chunkhead to a usable pointer since it is not coming from
@@ -464,12 +746,36 @@ mem_put (struct mem_pool *pool, void *ptr)
 	struct list_head *list = NULL;
 	int    *in_use = NULL;
 	void   *head = NULL;
+        struct mem_pool_magazine *mag = NULL;
 
 	if (!pool || !ptr) {
 		gf_log ("mem-pool", GF_LOG_ERROR, "invalid argument");
 		return;
 	}
 
+        if (__is_member (pool, ptr) == 1) {
+                mag = mem_pool_magazine_get (pool);
+                if (!mag)
+                        goto locked;
+
+                head = mem_pool_ptr2chunkhead (ptr);
+                in_use = (head + GF_MEM_POOL_LIST_BOUNDARY);
+                if (!is_mem_chunk_in_use (in_use)) {
+                        gf_log_callingfn ("mem-pool", GF_LOG_CRITICAL,
+                                          "mem_put called on freed ptr %p of "
+                                          "mem pool %p", ptr, pool);
+                        return;
+                }
+
+                if (mag->count == MEM_POOL_MAG_SIZE)
+                        mem_pool_magazine_flush (pool, mag);
+
+                *in_use = 0;
+                mag->objs[mag->count++] = head;
+                return;
+        }
+
+locked:
 	LOCK (&pool->lock);
 	{
 
@@ -521,12 +827,91 @@ mem_put (struct mem_pool *pool, void *ptr)
 void
 mem_pool_destroy (struct mem_pool *pool)
 {
+        int refcount = 0;
+
         if (!pool)
                 return;
 
-        LOCK_DESTROY (&pool->lock);
-        GF_FREE (pool->pool);
-        GF_FREE (pool);
+        pthread_mutex_lock (&mem_pool_global_lock);
+        {
+                list_del_init (&pool->global_list);
+        }
+        pthread_mutex_unlock (&mem_pool_global_lock);
+
+        /* Magazines still bound to the pool keep it, and the slab their
+         * objects point into, until their threads detach from it.
+         */
+        LOCK (&pool->lock);
+        {
+                pool->dead = 1;
+                refcount = --pool->refcount;
+        }
+        UNLOCK (&pool->lock);
+
+        if (!refcount)
+                mem_pool_free (pool);
 
         return;
 }
+
+
+void
+mem_pool_stats_dump (void)
+{
+        struct mem_pool          *pool = NULL;
+        struct mem_pool_tcache   *tc = NULL;
+        struct mem_pool_magazine *mag = NULL;
+        char                      key[GF_DUMP_MAX_BUF_LEN];
+        char                      prefix[GF_DUMP_MAX_BUF_LEN];
+        int                       cached = 0;
+        uint64_t                  hits = 0;
+
+        if (pthread_mutex_trylock (&mem_pool_global_lock)) {
+                gf_log ("mem-pool", GF_LOG_WARNING,
+                        "Unable to dump mem pools");
+                return;
+        }
+
+        list_for_each_entry (pool, &mem_pool_list, global_list) {
+                cached = 0;
+                hits = 0;
+
+                /* racy, but good enough for a dump */
+                list_for_each_entry (tc, &mem_pool_tcaches, list) {
+                        mag = &tc->mags[pool->tc_slot];
+                        if (mag->pool != pool)
+                                continue;
+                        cached += mag->count;
+                        hits += mag->hits;
+                }
+
+                snprintf (prefix, sizeof (prefix), "mempool.%s.%p",
+                          pool->name ? pool->name : "unknown", pool);
+                gf_proc_dump_add_section (prefix);
+
+                LOCK (&pool->lock);
+                {
+                        gf_proc_dump_build_key (key, prefix, "sizeof_type");
+                        gf_proc_dump_write (key, "%d", pool->real_sizeof_type);
+                        gf_proc_dump_build_key (key, prefix, "hot_count");
+                        gf_proc_dump_write (key, "%d",
+                                            pool->hot_count - cached);
+                        gf_proc_dump_build_key (key, prefix, "cached_count");
+                        gf_proc_dump_write (key, "%d", cached);
+                        gf_proc_dump_build_key (key, prefix, "cold_count");
+                        gf_proc_dump_write (key, "%d", pool->cold_count);
+                        gf_proc_dump_build_key (key, prefix, "max_hot_count");
+                        gf_proc_dump_write (key, "%d", pool->max_hot_count);
+                        gf_proc_dump_build_key (key, prefix, "alloc_count");
+                        gf_proc_dump_write (key, "%"PRIu64, pool->alloc_count);
+                        gf_proc_dump_build_key (key, prefix, "pool_misses");
+                        gf_proc_dump_write (key, "%"PRIu64, pool->pool_misses);
+                        gf_proc_dump_build_key (key, prefix, "cache_hits");
+                        gf_proc_dump_write (key, "%"PRIu64,
+                                            pool->tc_hits + hits);
+                }
+                UNLOCK (&pool->lock);
+        }
+
+        pthread_mutex_unlock (&mem_pool_global_lock);
+}
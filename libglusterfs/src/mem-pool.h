@@ -100,6 +100,9 @@ char * gf_strdup (const char *src)
 
 
 
+#define MEM_POOL_TC_SLOTS       32  /* pools cached per thread */
+#define MEM_POOL_MAG_SIZE       32  /* objects cached per thread and pool */
+
 struct mem_pool {
 	struct list_head  list;
 	int               hot_count;
@@ -109,18 +112,30 @@ struct mem_pool {
 	void             *pool;
 	void             *pool_end;
         int               real_sizeof_type;
+
+        const char       *name;
+        struct list_head  global_list;  /* all the mem pools, for statedump */
+        int               tc_slot;      /* slot in the thread caches */
+        int               max_hot_count;
+        uint64_t          alloc_count;  /* gets served by the slab */
+        uint64_t          pool_misses;  /* gets served from the heap */
+        uint64_t          tc_hits;      /* gets served by retired caches */
+        int               refcount;     /* creator and bound magazines */
+        int               dead;         /* destroyed, freed on last unref */
 };
 
 struct mem_pool *
-mem_pool_new_fn (unsigned long sizeof_type, unsigned long count);
+mem_pool_new_fn (unsigned long sizeof_type, unsigned long count,
+                 const char *name);
 
-#define mem_pool_new(type,count) mem_pool_new_fn (sizeof(type), count)
+#define mem_pool_new(type,count) mem_pool_new_fn (sizeof(type), count, #type)
 
 void mem_put (struct mem_pool *pool, void *ptr);
 void *mem_get (struct mem_pool *pool);
 void *mem_get0 (struct mem_pool *pool);
 
 void mem_pool_destroy (struct mem_pool *pool);
+void mem_pool_stats_dump (void);
 
 int gf_mem_acct_is_enabled ();
 void gf_mem_acct_enable_set ();
@@ -122,13 +122,40 @@ struct _call_stack_t {
 
 struct xlator_fops;
 
-void
-gf_set_fop_from_fn_pointer (call_frame_t *frame, struct xlator_fops *fops,
-                            void *fn);
+int
+gf_fop_from_wind_fn (const char *fn);
 
 void
 gf_update_latency (call_frame_t *frame);
 
+
+/* the fop of a wind site never changes, it is looked up on the first
+   wind through it only */
+#define FRAME_SET_FOP(_new, fn)                                         \
+        do {                                                            \
+                static int _wind_fop = GF_FOP_NULL;                     \
+                                                                        \
+                if (_wind_fop == GF_FOP_NULL)                           \
+                        _wind_fop = gf_fop_from_wind_fn (#fn);          \
+                (_new)->op = _wind_fop;                                 \
+        } while (0)
+
+
+#define FRAME_BEGIN_LATENCY(_new)                                       \
+        do {                                                            \
+                if ((_new)->this->ctx && (_new)->this->ctx->measure_latency) \
+                        gettimeofday (&(_new)->begin, NULL);            \
+        } while (0)
+
+
+#define FRAME_END_LATENCY(frame)                                        \
+        do {                                                            \
+                if ((frame)->begin.tv_sec) {                            \
+                        gettimeofday (&(frame)->end, NULL);             \
+                        gf_update_latency (frame);                      \
+                }                                                       \
+        } while (0)
+
 static inline void
 FRAME_DESTROY (call_frame_t *frame)
 {
@@ -223,6 +250,8 @@ STACK_DESTROY (call_stack_t *stack)
 		_new->cookie = _new;					\
 		LOCK_INIT (&_new->lock);				\
 		frame->ref_count++;					\
+                FRAME_SET_FOP (_new, fn);                               \
+                FRAME_BEGIN_LATENCY (_new);                             \
                 old_THIS = THIS;                                        \
                 THIS = obj;                                             \
 		fn (_new, obj, params);					\
@@ -255,6 +284,8 @@ STACK_DESTROY (call_stack_t *stack)
 		LOCK_INIT (&_new->lock);				\
 		frame->ref_count++;					\
 		fn##_cbk = rfn;						\
+                FRAME_SET_FOP (_new, fn);                               \
+                FRAME_BEGIN_LATENCY (_new);                             \
                 old_THIS = THIS;                                        \
                 THIS = obj;                                             \
 		fn (_new, obj, params);					\
@@ -278,6 +309,7 @@ STACK_DESTROY (call_stack_t *stack)
                 old_THIS = THIS;                                        \
                 THIS = _parent->this;                                   \
                 frame->complete = _gf_true;                             \
+                FRAME_END_LATENCY (frame);                              \
 		fn (_parent, frame->cookie, _parent->this, params);	\
                 THIS = old_THIS;                                        \
 	} while (0)
@@ -300,6 +332,7 @@ STACK_DESTROY (call_stack_t *stack)
                 old_THIS = THIS;                                        \
                 THIS = _parent->this;                                   \
                 frame->complete = _gf_true;                             \
+                FRAME_END_LATENCY (frame);                              \
 		fn (_parent, frame->cookie, _parent->this, params);	\
                 THIS = old_THIS;                                        \
 	} while (0)
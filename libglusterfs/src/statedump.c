@@ -193,6 +193,7 @@ gf_proc_dump_mem_info ()
         gf_proc_dump_write ("mallinfo_fordblks", "%d", info.fordblks);
         gf_proc_dump_write ("mallinfo_keepcost", "%d", info.keepcost);
 #endif
+        mem_pool_stats_dump ();
         gf_proc_dump_xlator_mem_info(&global_xlator);
 
 }
@@ -51,6 +51,41 @@ rpc_clnt_new_callid (struct rpc_clnt *clnt)
 }
 
 
+static struct list_head *
+__saved_frames_bucket (struct saved_frames *frames, int64_t callid)
+{
+        return &frames->buckets[(uint32_t) callid
+                                % RPC_CLNT_SAVED_FRAMES_BUCKETS];
+}
+
+
+static void
+__saved_frame_unlink (struct saved_frames *frames,
+                      struct saved_frame *saved_frame)
+{
+        list_del_init (&saved_frame->list);
+        list_del_init (&saved_frame->hash);
+        frames->count--;
+}
+
+
+static struct saved_frame *
+__saved_frame_lookup (struct saved_frames *frames, int64_t callid)
+{
+	struct saved_frame *tmp = NULL;
+
+	list_for_each_entry (tmp, __saved_frames_bucket (frames, callid),
+                             hash) {
+		if (tmp->rpcreq->xid == callid)
+                        return tmp;
+	}
+
+	return NULL;
+}
+
+
+/* All frames share the same timeout and sf.list is in the order they
+   were sent, so the timed out ones are always at its head. */
 struct saved_frame *
 __saved_frames_get_timedout (struct saved_frames *frames, uint32_t timeout,
                              struct timeval *current)
@@ -61,8 +96,8 @@ __saved_frames_get_timedout (struct saved_frames *frames, uint32_t timeout,
 		tmp = list_entry (frames->sf.list.next, typeof (*tmp), list);
 		if ((tmp->saved_at.tv_sec + timeout) < current->tv_sec) {
 			bailout_frame = tmp;
-			list_del_init (&bailout_frame->list);
-			frames->count--;
+			__saved_frame_unlink (frames, bailout_frame);
+                        frames->bailed++;
 		}
 	}
 
@@ -85,6 +120,7 @@ __saved_frames_put (struct saved_frames *frames, void *frame,
 
         memset (saved_frame, 0, sizeof (*saved_frame));
 	INIT_LIST_HEAD (&saved_frame->list);
+	INIT_LIST_HEAD (&saved_frame->hash);
 
 	saved_frame->capital_this = THIS;
 	saved_frame->frame        = frame;
@@ -92,8 +128,13 @@ __saved_frames_put (struct saved_frames *frames, void *frame,
 	gettimeofday (&saved_frame->saved_at, NULL);
 
 	list_add_tail (&saved_frame->list, &frames->sf.list);
+	list_add_tail (&saved_frame->hash,
+                       __saved_frames_bucket (frames, rpcreq->xid));
 	frames->count++;
 
+        if (frames->count > frames->peak)
+                frames->peak = frames->count;
+
 out:
 	return saved_frame;
 }
@@ -109,8 +150,7 @@ saved_frames_delete (struct saved_frame *saved_frame,
 
         pthread_mutex_lock (&conn->lock);
         {
-                list_del_init (&saved_frame->list);
-                conn->saved_frames->count--;
+                __saved_frame_unlink (conn->saved_frames, saved_frame);
         }
         pthread_mutex_unlock (&conn->lock);
 
@@ -246,6 +286,7 @@ struct saved_frames *
 saved_frames_new (void)
 {
 	struct saved_frames *saved_frames = NULL;
+        int                  i            = 0;
 
 	saved_frames = GF_CALLOC (1, sizeof (*saved_frames),
                                   gf_common_mt_rpcclnt_savedframe_t);
@@ -256,6 +297,9 @@ saved_frames_new (void)
 
 	INIT_LIST_HEAD (&saved_frames->sf.list);
 
+        for (i = 0; i < RPC_CLNT_SAVED_FRAMES_BUCKETS; i++)
+                INIT_LIST_HEAD (&saved_frames->buckets[i]);
+
 	return saved_frames;
 }
 
@@ -272,13 +316,11 @@ __saved_frame_copy (struct saved_frames *frames, int64_t callid,
                 goto out;
         }
 
-	list_for_each_entry (tmp, &frames->sf.list, list) {
-		if (tmp->rpcreq->xid == callid) {
-			*saved_frame = *tmp;
-                        ret = 0;
-			break;
-		}
-	}
+        tmp = __saved_frame_lookup (frames, callid);
+        if (tmp) {
+                *saved_frame = *tmp;
+                ret = 0;
+        }
 
 out:
 	return ret;
@@ -289,18 +331,10 @@ struct saved_frame *
 __saved_frame_get (struct saved_frames *frames, int64_t callid)
 {
 	struct saved_frame *saved_frame = NULL;
-	struct saved_frame *tmp = NULL;
-
-	list_for_each_entry (tmp, &frames->sf.list, list) {
-		if (tmp->rpcreq->xid == callid) {
-			list_del_init (&tmp->list);
-			frames->count--;
-			saved_frame = tmp;
-			break;
-		}
-	}
 
+        saved_frame = __saved_frame_lookup (frames, callid);
 	if (saved_frame) {
+                __saved_frame_unlink (frames, saved_frame);
                 THIS  = saved_frame->capital_this;
         }
 
@@ -338,7 +372,7 @@ saved_frames_unwind (struct saved_frames *saved_frames)
                                   trav->rpcreq->prog->procnames[trav->rpcreq->procnum]
                                   : "--",
                                   trav->rpcreq->procnum, timestr);
-		saved_frames->count--;
+                __saved_frame_unlink (saved_frames, trav);
 
                 trav->rpcreq->rpc_status = -1;
                 trav->rpcreq->cbkfn (trav->rpcreq, &iov, 1, trav->frame);
@@ -348,7 +382,6 @@ saved_frames_unwind (struct saved_frames *saved_frames)
                 rpc_clnt_reply_deinit (trav->rpcreq,
                                        trav->rpcreq->conn->rpc_clnt->reqpool);
 
-		list_del_init (&trav->list);
                 mem_put (saved_frames_pool, trav);
 	}
 }
@@ -418,7 +451,7 @@ rpc_clnt_reconnect (void *trans_ptr)
 int
 rpc_clnt_fill_request_info (struct rpc_clnt *clnt, rpc_request_info_t *info)
 {
-        struct saved_frame  saved_frame = {{}, 0};
+        struct saved_frame  saved_frame = {{}, };
         int                 ret         = -1;
 
         pthread_mutex_lock (&clnt->conn.lock);
@@ -1234,13 +1267,14 @@ rpc_clnt_record_build_record (struct rpc_clnt *clnt, int prognum, int progver,
         /* First, try to get a pointer into the buffer which the RPC
          * layer can use.
          */
-        request_iob = iobuf_get (clnt->ctx->iobuf_pool);
+        request_iob = iobuf_get2 (clnt->ctx->iobuf_pool,
+                                  RPC_CLNT_RECORD_HDR_SIZE);
         if (!request_iob) {
                 gf_log ("rpc-clnt", GF_LOG_ERROR, "Failed to get iobuf");
                 goto out;
         }
 
-        pagesize = ((struct iobuf_pool *)clnt->ctx->iobuf_pool)->page_size;
+        pagesize = iobuf_pagesize (request_iob);
 
         record = iobuf_ptr (request_iob);  /* Now we have it. */
 
@@ -1607,3 +1641,4 @@ rpc_clnt_reconfig (struct rpc_clnt *rpc, struct rpc_clnt_config *config)
                 rpc->conn.config.remote_host = gf_strdup (config->remote_host);
         }
 }
+
@@ -34,6 +34,9 @@ typedef enum {
 #define AUTH_GLUSTERFS  5
 #define RPC_CLNT_MAX_AUTH_BYTES 1024
 
+/* room for the record marker and rpc call header with credentials */
+#define RPC_CLNT_RECORD_HDR_SIZE (4 * GF_UNIT_KB)
+
 struct xptr_clnt;
 struct rpc_req;
 struct rpc_clnt;
@@ -56,6 +59,7 @@ struct saved_frame {
 			struct saved_frame *frame_prev;
 		};
 	};
+        struct list_head         hash;   /* chain of its xid bucket */
         void                    *capital_this;
 	void                    *frame;
 	struct timeval           saved_at;
@@ -63,9 +67,16 @@ struct saved_frame {
         rpc_transport_rsp_t      rsp;
 };
 
+/* xids are handed out in sequence, so hashing them on their low bits
+   spreads the calls in flight evenly over the buckets */
+#define RPC_CLNT_SAVED_FRAMES_BUCKETS 1024
+
 struct saved_frames {
 	int64_t            count;
-	struct saved_frame sf;
+	struct saved_frame sf;       /* in the order sent, oldest first */
+        struct list_head   buckets[RPC_CLNT_SAVED_FRAMES_BUCKETS];
+        int64_t            peak;     /* largest count seen */
+        uint64_t           bailed;   /* frames which timed out */
 };
 
 
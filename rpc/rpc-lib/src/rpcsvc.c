@@ -1254,13 +1254,14 @@ rpcsvc_callback_build_record (rpcsvc_t *rpc, int prognum, int progver,
         /* First, try to get a pointer into the buffer which the RPC
          * layer can use.
          */
-        request_iob = iobuf_get (rpc->ctx->iobuf_pool);
+        request_iob = iobuf_get2 (rpc->ctx->iobuf_pool,
+                                  RPCSVC_RECORD_HDR_SIZE);
         if (!request_iob) {
                 gf_log ("rpcsvc", GF_LOG_ERROR, "Failed to get iobuf");
                 goto out;
         }
 
-        pagesize = ((struct iobuf_pool *)rpc->ctx->iobuf_pool)->page_size;
+        pagesize = iobuf_pagesize (request_iob);
 
         record = iobuf_ptr (request_iob);  /* Now we have it. */
 
@@ -1430,13 +1431,14 @@ rpcsvc_record_build_record (rpcsvc_request_t *req, size_t payload,
                 return NULL;
 
         svc = req->svc;
-        replyiob = iobuf_get (svc->ctx->iobuf_pool);
-        pagesize = iobpool_pagesize ((struct iobuf_pool *)svc->ctx->iobuf_pool);
+        replyiob = iobuf_get2 (svc->ctx->iobuf_pool, RPCSVC_RECORD_HDR_SIZE);
         if (!replyiob) {
                 gf_log (GF_RPCSVC, GF_LOG_ERROR, "Failed to get iobuf");
                 goto err_exit;
         }
 
+        pagesize = iobuf_pagesize (replyiob);
+
         record = iobuf_ptr (replyiob);  /* Now we have it. */
 
         /* Fill the rpc structure and XDR it into the buffer got above. */
@@ -139,6 +139,9 @@ struct rpcsvc_config {
 };
 
 #define RPCSVC_MAX_AUTH_BYTES   400
+
+/* room for the record marker and rpc reply/callback header */
+#define RPCSVC_RECORD_HDR_SIZE  (4 * GF_UNIT_KB)
 typedef struct rpcsvc_auth_data {
         int             flavour;
         int             datalen;
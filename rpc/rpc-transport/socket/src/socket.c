@@ -170,6 +170,15 @@ __socket_rwv (rpc_transport_t *this, struct iovec *vector, int count,
 
         while (opcount) {
                 if (write) {
+#ifdef MSG_MORE
+                        if (priv->write_more) {
+                                struct msghdr msg = {0, };
+
+                                msg.msg_iov    = opvector;
+                                msg.msg_iovlen = opcount;
+                                ret = sendmsg (sock, &msg, MSG_MORE);
+                        } else
+#endif
                         ret = writev (sock, opvector, opcount);
 
                         if (ret == 0 || (ret == -1 && errno == EAGAIN)) {
@@ -608,12 +617,78 @@ __socket_ioq_churn_entry (rpc_transport_t *this, struct ioq *entry)
 }
 
 
+/* Writes out as many queued entries as fit in one gathered writev. Fully
+ * written entries are freed and the first partially written one is left
+ * at the head of the queue with its pending vector advanced.
+ */
+int
+__socket_ioq_churn_batch (rpc_transport_t *this)
+{
+        socket_private_t *priv = NULL;
+        struct ioq       *entry = NULL;
+        struct ioq       *tmp = NULL;
+        struct iovec      vector[GF_SOCKET_BATCH_MAX_IOVEC];
+        int               count = 0;
+        size_t            size = 0;
+        size_t            bytes = 0;
+        size_t            len = 0;
+        int               ret = -1;
+
+        priv = this->private;
+        priv->write_more = 0;
+
+        list_for_each_entry (entry, &priv->ioq, list) {
+                if ((count + entry->pending_count > GF_SOCKET_BATCH_MAX_IOVEC)
+                    || (size >= GF_SOCKET_BATCH_MAX_BYTES)) {
+                        /* cork, the rest follows right away */
+                        priv->write_more = 1;
+                        break;
+                }
+
+                memcpy (&vector[count], entry->pending_vector,
+                        entry->pending_count * sizeof (struct iovec));
+                count += entry->pending_count;
+                size  += iov_length (entry->pending_vector,
+                                     entry->pending_count);
+        }
+
+        ret = __socket_rwv (this, vector, count, NULL, NULL, &bytes, 1);
+
+        priv->write_more = 0;
+
+        list_for_each_entry_safe (entry, tmp, &priv->ioq, list) {
+                if (!bytes)
+                        break;
+
+                len = iov_length (entry->pending_vector, entry->pending_count);
+                if (bytes >= len) {
+                        bytes -= len;
+                        __socket_ioq_entry_free (entry);
+                        continue;
+                }
+
+                while (bytes) {
+                        if (bytes >= entry->pending_vector[0].iov_len) {
+                                bytes -= entry->pending_vector[0].iov_len;
+                                entry->pending_vector++;
+                                entry->pending_count--;
+                        } else {
+                                entry->pending_vector[0].iov_base += bytes;
+                                entry->pending_vector[0].iov_len  -= bytes;
+                                bytes = 0;
+                        }
+                }
+        }
+
+        return ret;
+}
+
+
 int
 __socket_ioq_churn (rpc_transport_t *this)
 {
         socket_private_t *priv = NULL;
         int               ret = 0;
-        struct ioq       *entry = NULL;
 
         if (!this || !this->private)
                 goto out;
@@ -621,10 +696,7 @@ __socket_ioq_churn (rpc_transport_t *this)
         priv = this->private;
 
         while (!list_empty (&priv->ioq)) {
-                /* pick next entry */
-                entry = priv->ioq_next;
-
-                ret = __socket_ioq_churn_entry (this, entry);
+                ret = __socket_ioq_churn_batch (this);
 
                 if (ret != 0)
                         break;
@@ -641,6 +713,50 @@ out:
 }
 
 
+/* Queues @entry for writing. Without batch-writes the entry is written
+ * right away if nothing is queued before it. With batch-writes it waits
+ * for POLLOUT, so that all the entries queued until the event thread gets
+ * to this socket go out in one gathered writev.
+ */
+int
+__socket_ioq_submit (rpc_transport_t *this, struct ioq *entry)
+{
+        socket_private_t *priv = NULL;
+        int               ret = 0;
+        char              need_poll_out = 0;
+        char              need_append = 1;
+
+        priv = this->private;
+
+        if (list_empty (&priv->ioq)) {
+                if (priv->batch_writes) {
+                        need_poll_out = 1;
+                } else {
+                        ret = __socket_ioq_churn_entry (this, entry);
+
+                        if (ret == 0)
+                                need_append = 0;
+
+                        if (ret > 0)
+                                need_poll_out = 1;
+                }
+        }
+
+        if (need_append) {
+                list_add_tail (&entry->list, &priv->ioq);
+                ret = 0;
+        }
+
+        if (need_poll_out) {
+                /* first entry to wait. continue writing on POLLOUT */
+                priv->idx = event_select_on (this->ctx->event_pool,
+                                             priv->sock, priv->idx, -1, 1);
+        }
+
+        return ret;
+}
+
+
 int
 socket_event_poll_err (rpc_transport_t *this)
 {
@@ -2214,16 +2330,12 @@ socket_submit_request (rpc_transport_t *this, rpc_transport_req_t *req)
 {
         socket_private_t *priv = NULL;
         int               ret = -1;
-        char              need_poll_out = 0;
-        char              need_append = 1;
         struct ioq       *entry = NULL;
-	glusterfs_ctx_t  *ctx = NULL;
 
         if (!this || !this->private)
                 goto out;
 
         priv = this->private;
-	ctx  = this->ctx;
 
         pthread_mutex_lock (&priv->lock);
         {
@@ -2242,27 +2354,7 @@ socket_submit_request (rpc_transport_t *this, rpc_transport_req_t *req)
                 if (!entry)
                         goto unlock;
 
-                if (list_empty (&priv->ioq)) {
-                        ret = __socket_ioq_churn_entry (this, entry);
-
-                        if (ret == 0)
-                                need_append = 0;
-
-                        if (ret > 0)
-                                need_poll_out = 1;
-                }
-
-                if (need_append) {
-                        list_add_tail (&entry->list, &priv->ioq);
-                        ret = 0;
-                }
-
-                if (need_poll_out) {
-                        /* first entry to wait. continue writing on POLLOUT */
-                        priv->idx = event_select_on (ctx->event_pool,
-						     priv->sock,
-                                                     priv->idx, -1, 1);
-                }
+                ret = __socket_ioq_submit (this, entry);
         }
 unlock:
         pthread_mutex_unlock (&priv->lock);
@@ -2277,16 +2369,12 @@ socket_submit_reply (rpc_transport_t *this, rpc_transport_reply_t *reply)
 {
         socket_private_t *priv = NULL;
         int               ret = -1;
-        char              need_poll_out = 0;
-        char              need_append = 1;
         struct ioq       *entry = NULL;
-	glusterfs_ctx_t  *ctx = NULL;
 
         if (!this || !this->private)
                 goto out;
 
         priv = this->private;
-	ctx  = this->ctx;
 
         pthread_mutex_lock (&priv->lock);
         {
@@ -2303,29 +2391,9 @@ socket_submit_reply (rpc_transport_t *this, rpc_transport_reply_t *reply)
                 entry = __socket_ioq_new (this, &reply->msg);
                 if (!entry)
                         goto unlock;
-                if (list_empty (&priv->ioq)) {
-                        ret = __socket_ioq_churn_entry (this, entry);
-
-                        if (ret == 0)
-                                need_append = 0;
-
-                        if (ret > 0)
-                                need_poll_out = 1;
-                }
-
-                if (need_append) {
-                        list_add_tail (&entry->list, &priv->ioq);
-                        ret = 0;
-                }
 
-                if (need_poll_out) {
-                        /* first entry to wait. continue writing on POLLOUT */
-                        priv->idx = event_select_on (ctx->event_pool,
-						     priv->sock,
-                                                     priv->idx, -1, 1);
-                }
+                ret = __socket_ioq_submit (this, entry);
         }
-
 unlock:
         pthread_mutex_unlock (&priv->lock);
 
@@ -2447,6 +2515,18 @@ validate_options (rpc_transport_t *this, dict_t *options, char **op_errstr)
                     }
         }
 
+        if (dict_get_str (options, "transport.socket.batch-writes",
+                          &optstr) == 0) {
+                if (gf_string2boolean (optstr, &tmp_bool) == -1) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "'transport.socket.batch-writes' takes only "
+                                "boolean options, not taking any action");
+                        *op_errstr = "Value should be only boolean!!";
+                        ret = -1;
+                        goto out;
+                }
+        }
+
         ret =0;
 out:
                 return ret;
@@ -2484,6 +2564,24 @@ reconfigure (rpc_transport_t *this, dict_t *options)
         }
         else
                 priv->keepalive = 1;
+
+        if (dict_get_str (this->options, "transport.socket.batch-writes",
+                          &optstr) == 0) {
+                if (gf_string2boolean (optstr, &tmp_bool) == -1) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "'transport.socket.batch-writes' takes only "
+                                "boolean options, not taking any action");
+                        goto out;
+                }
+                gf_log (this->name, GF_LOG_DEBUG,
+                        "Reconfigured transport.socket.batch-writes");
+
+                pthread_mutex_lock (&priv->lock);
+                {
+                        priv->batch_writes = tmp_bool;
+                }
+                pthread_mutex_unlock (&priv->lock);
+        }
         ret = 0;
 out:
         return ret;
@@ -2608,6 +2706,19 @@ socket_init (rpc_transport_t *this)
                 priv->keepaliveidle = keepalive;
         }
 
+        optstr = NULL;
+        if (dict_get_str (this->options, "transport.socket.batch-writes",
+                          &optstr) == 0) {
+                if (gf_string2boolean (optstr, &tmp_bool) == -1) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "'transport.socket.batch-writes' takes only "
+                                "boolean options, not taking any action");
+                        tmp_bool = 0;
+                }
+
+                priv->batch_writes = tmp_bool;
+        }
+
         priv->windowsize = (int)windowsize;
 out:
         this->private = priv;
@@ -2710,5 +2821,8 @@ struct volume_options options[] = {
         { .key   = {"transport.socket.keepalive-time"},
           .type  = GF_OPTION_TYPE_INT
         },
+        { .key   = {"transport.socket.batch-writes"},
+          .type  = GF_OPTION_TYPE_BOOL
+        },
         { .key = {NULL} }
 };
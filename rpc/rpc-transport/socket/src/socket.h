@@ -56,6 +56,12 @@
 #define GF_MIN_SOCKET_WINDOW_SIZE       (128 * GF_UNIT_KB)
 #define GF_USE_DEFAULT_KEEPALIVE        (-1)
 
+/* Limits of one gathered writev when draining the ioq. The iovec count
+ * stays well below IOV_MAX.
+ */
+#define GF_SOCKET_BATCH_MAX_IOVEC       256
+#define GF_SOCKET_BATCH_MAX_BYTES       (256 * GF_UNIT_KB)
+
 typedef enum {
         SP_STATE_NADA = 0,
         SP_STATE_COMPLETE,
@@ -192,6 +198,10 @@ typedef struct {
         int                    keepalive;
         int                    keepaliveidle;
         int                    keepaliveintvl;
+        char                   batch_writes; /* leave all writes to the
+                                                event thread */
+        char                   write_more;   /* more data follows the
+                                                current writev */
 } socket_private_t;
 
 
@@ -1135,3 +1135,46 @@ xdr_to_mgmt_probe_query_req (struct iovec outmsg, void *req)
         return xdr_serialize_generic (outmsg, (void *)req,
                                       (xdrproc_t)xdr_gfs3_setattr_req);
 }
+
+
+/* For messages whose last member is an opaque dict<>: @outmsg holds
+   @len bytes encoded with that dict left empty, and the room to grow.
+   Serialize @dict straight into the room after them, and patch the
+   empty length the encoding ends with to match. This gives the same
+   bytes on the wire as encoding a dict serialized beforehand, without
+   the intermediate buffer and the copy out of it. */
+ssize_t
+xdr_append_dict (struct iovec outmsg, ssize_t len, dict_t *dict)
+{
+        char     *buf     = NULL;
+        uint32_t  netlen  = 0;
+        int32_t   ret     = 0;
+        size_t    room    = 0;
+        size_t    pad     = 0;
+
+        if (!outmsg.iov_base || !dict || (len < (ssize_t) sizeof (netlen))
+            || (len > (ssize_t) outmsg.iov_len))
+                return -1;
+
+        buf = outmsg.iov_base;
+
+        memcpy (&netlen, buf + len - sizeof (netlen), sizeof (netlen));
+        if (netlen != 0)
+                return -1;
+
+        /* keep room for the padding to a 4 byte boundary */
+        room = (outmsg.iov_len - len) & ~(BYTES_PER_XDR_UNIT - 1);
+
+        ret = dict_serialize_into (dict, buf + len, room);
+        if (ret < 0)
+                return -1;
+
+        netlen = htonl (ret);
+        memcpy (buf + len - sizeof (netlen), &netlen, sizeof (netlen));
+
+        pad = (BYTES_PER_XDR_UNIT - (ret % BYTES_PER_XDR_UNIT))
+                % BYTES_PER_XDR_UNIT;
+        memset (buf + len + ret, 0, pad);
+
+        return len + ret + pad;
+}
@@ -25,6 +25,7 @@
 
 #include "glusterfs3-xdr.h"
 #include "iatt.h"
+#include "dict.h"
 
 #define xdr_decoded_remaining_addr(xdr)        ((&xdr)->x_private)
 #define xdr_decoded_remaining_len(xdr)         ((&xdr)->x_handy)
@@ -748,4 +749,7 @@ xdr_to_readv_rsp (struct iovec inmsg, void *args);
 ssize_t
 xdr_to_getspec_rsp (struct iovec inmsg, void *args);
 
+ssize_t
+xdr_append_dict (struct iovec outmsg, ssize_t len, dict_t *dict);
+
 #endif /* !_GLUSTERFS3_H */
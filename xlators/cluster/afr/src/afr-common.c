@@ -1187,9 +1187,20 @@ afr_fd_ctx_set (xlator_t *this, fd_t *fd)
                         goto unlock;
                 }
 
+                fd_ctx->eager_locked_nodes =
+                        GF_CALLOC (sizeof (*fd_ctx->eager_locked_nodes),
+                                   priv->child_count, gf_afr_mt_char);
+                if (!fd_ctx->eager_locked_nodes) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "Out of memory");
+                        ret = -ENOMEM;
+                        goto unlock;
+                }
+
                 ret = __fd_ctx_set (fd, this, (uint64_t)(long) fd_ctx);
 
                 INIT_LIST_HEAD (&fd_ctx->entries);
+                INIT_LIST_HEAD (&fd_ctx->eager_waiters);
         }
 unlock:
         UNLOCK (&fd->lock);
@@ -1422,6 +1433,9 @@ afr_cleanup_fd_ctx (xlator_t *this, fd_t *fd)
                 if (fd_ctx->pre_op_piggyback)
                         GF_FREE (fd_ctx->pre_op_piggyback);
 
+                if (fd_ctx->eager_locked_nodes)
+                        GF_FREE (fd_ctx->eager_locked_nodes);
+
                 GF_FREE (fd_ctx);
         }
 
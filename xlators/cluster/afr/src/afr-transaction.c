@@ -32,6 +32,12 @@
                                       of RENAME */
 #define LOCKED_LOWER    0x2        /* for lower_path of RENAME */
 
+static int
+afr_transaction_unlock (call_frame_t *frame, xlator_t *this);
+
+static void
+afr_eager_lock_acquired (call_frame_t *frame, xlator_t *this, int32_t op_ret);
+
 
 afr_fd_ctx_t *
 afr_fd_ctx_get (fd_t *fd, xlator_t *this)
@@ -145,7 +151,10 @@ __mark_pre_op_undone_on_fd (call_frame_t *frame, xlator_t *this, int child_index
 
         LOCK (&local->fd->lock);
         {
-                if (local->transaction.type == AFR_DATA_TRANSACTION)
+                /* afr_openfd_flush () may have reset the count while
+                   this transaction's pre-op was outstanding */
+                if (local->transaction.type == AFR_DATA_TRANSACTION &&
+                    fd_ctx->pre_op_done[child_index])
                         fd_ctx->pre_op_done[child_index]--;
         }
         UNLOCK (&local->fd->lock);
@@ -365,16 +374,12 @@ int32_t
 afr_changelog_post_op_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 			   int32_t op_ret, int32_t op_errno, dict_t *xattr)
 {
-        afr_internal_lock_t *int_lock = NULL;
-	afr_private_t       *priv     = NULL;
 	afr_local_t         *local    = NULL;
         int                  child_index = 0;
 
 	int call_count = -1;
 
-	priv     = this->private;
 	local    = frame->local;
-        int_lock = &local->internal_lock;
 
         child_index = (long) cookie;
 
@@ -391,14 +396,8 @@ afr_changelog_post_op_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 	}
 	UNLOCK (&frame->lock);
 
-	if (call_count == 0) {
-                if (afr_lock_server_count (priv, local->transaction.type) == 0) {
-                        local->transaction.done (frame, this);
-                } else {
-                        int_lock->lock_cbk = local->transaction.done;
-                        afr_unlock (frame, this);
-                }
-	}
+	if (call_count == 0)
+                afr_transaction_unlock (frame, this);
 
 	return 0;
 }
@@ -452,7 +451,6 @@ int
 afr_changelog_post_op (call_frame_t *frame, xlator_t *this)
 {
 	afr_private_t * priv = this->private;
-        afr_internal_lock_t *int_lock = NULL;
 	int ret        = 0;
 	int i          = 0;
 	int call_count = 0;
@@ -465,7 +463,6 @@ afr_changelog_post_op (call_frame_t *frame, xlator_t *this)
         int            nothing_failed = 1;
 
 	local    = frame->local;
-        int_lock = &local->internal_lock;
 
 	__mark_down_children (local->pending, priv->child_count,
                               local->child_up, local->transaction.type);
@@ -498,8 +495,7 @@ afr_changelog_post_op (call_frame_t *frame, xlator_t *this)
                         dict_unref (xattr[i]);
                 }
 
-                int_lock->lock_cbk = local->transaction.done;
-		afr_unlock (frame, this);
+                afr_transaction_unlock (frame, this);
 		return 0;
 	}
 
@@ -766,9 +762,7 @@ afr_changelog_pre_op (call_frame_t *frame, xlator_t *this)
                         dict_unref (xattr[i]);
                 }
 
-                local->internal_lock.lock_cbk =
-                        local->transaction.done;
-		afr_unlock (frame, this);
+                afr_transaction_unlock (frame, this);
 		return 0;
 	}
 
@@ -946,6 +940,7 @@ afr_post_blocking_inodelk_cbk (call_frame_t *frame, xlator_t *this)
         if (int_lock->lock_op_ret < 0) {
                 gf_log (this->name, GF_LOG_DEBUG,
                         "Blocking inodelks failed.");
+                afr_eager_lock_acquired (frame, this, -1);
 		local->transaction.done (frame, this);
         } else {
 
@@ -1149,6 +1144,496 @@ afr_lock (call_frame_t *frame, xlator_t *this)
 
 /* }}} */
 
+/* {{{ eager lock */
+
+/*
+ * With eager-lock on, the first write on an fd locks the whole file and
+ * holds on to the lock. Its transaction frame becomes the holder: once
+ * its fop is through it parks with the post-op still pending, and the
+ * writes that follow on the same fd skip locking altogether, their pre-op
+ * and post-op piggybacking on the holder's. A stream of writes then costs
+ * one lock, pre-op, post-op and unlock in all.
+ *
+ * The lock is given up once no write has used it for post-op-delay-secs,
+ * or as soon as it is idle if any other data transaction comes along on
+ * the fd (flush, ftruncate, ...) -- those wait for it to go and then lock
+ * the usual way. Lock requests from other fds and clients are not visible
+ * here; they block on the server till the lock goes, which is at most
+ * AFR_EAGER_LOCK_MAX_HOLD_SECS after it was taken (plus the writes then
+ * in flight) for an fd that keeps writing, and post-op-delay-secs after
+ * the last write otherwise. A subvolume going down also retires the
+ * lock: the brick drops it with the connection, and the writes that
+ * follow lock afresh.
+ */
+
+static int
+afr_transaction_lock (call_frame_t *frame, xlator_t *this);
+
+
+static int
+afr_eager_lock_eligible (call_frame_t *frame, xlator_t *this)
+{
+        afr_local_t   *local = NULL;
+        afr_private_t *priv  = NULL;
+
+        local = frame->local;
+        priv  = this->private;
+
+        return (priv->eager_lock &&
+                (local->op == GF_FOP_WRITE) &&
+                (local->transaction.type == AFR_DATA_TRANSACTION));
+}
+
+
+static int
+__afr_eager_lock_covers_up_children (afr_private_t *priv,
+                                     afr_fd_ctx_t *fd_ctx)
+{
+        int i = 0;
+
+        for (i = 0; i < priv->child_count; i++) {
+                if (priv->child_up[i] && !fd_ctx->eager_locked_nodes[i])
+                        return 0;
+        }
+
+        return 1;
+}
+
+
+/* held for too long already, or taken before a subvolume went down */
+static int
+__afr_eager_lock_stale (afr_fd_ctx_t *fd_ctx, uint64_t down_count)
+{
+        if (fd_ctx->eager_down_count != down_count)
+                return 1;
+
+        return ((time (NULL) - fd_ctx->eager_acquired)
+                >= AFR_EAGER_LOCK_MAX_HOLD_SECS);
+}
+
+
+/* hands the parked holder over to whoever is going to release the lock */
+static call_frame_t *
+__afr_eager_lock_unpark (afr_fd_ctx_t *fd_ctx)
+{
+        GF_ASSERT (fd_ctx->eager_users == 0);
+
+        fd_ctx->eager_state = AFR_EAGER_LOCK_RELEASING;
+
+        return fd_ctx->eager_holder;
+}
+
+
+/* the timer holds a ref on the fd, dropped by whoever takes the timer off
+   the fd ctx */
+static void
+afr_delay_timer_cancel (xlator_t *this, fd_t *fd, gf_timer_t *timer)
+{
+        if (!timer)
+                return;
+
+        gf_timer_call_cancel (this->ctx, timer);
+        fd_unref (fd);
+}
+
+
+static void
+afr_eager_lock_wake (xlator_t *this, struct list_head *waiters)
+{
+        afr_local_t *local = NULL;
+        afr_local_t *tmp   = NULL;
+
+        list_for_each_entry_safe (local, tmp, waiters,
+                                  transaction.eager_list) {
+                list_del_init (&local->transaction.eager_list);
+
+                afr_transaction_lock (local->transaction.eager_frame, this);
+        }
+}
+
+
+static int
+afr_eager_lock_released (call_frame_t *frame, xlator_t *this)
+{
+        afr_local_t      *local  = NULL;
+        afr_fd_ctx_t     *fd_ctx = NULL;
+        struct list_head  waiters;
+
+        local = frame->local;
+
+        INIT_LIST_HEAD (&waiters);
+
+        fd_ctx = afr_fd_ctx_get (local->fd, this);
+
+        LOCK (&local->fd->lock);
+        {
+                fd_ctx->eager_state   = AFR_EAGER_LOCK_NONE;
+                fd_ctx->eager_holder  = NULL;
+                fd_ctx->eager_release = _gf_false;
+
+                list_splice_init (&fd_ctx->eager_waiters, &waiters);
+        }
+        UNLOCK (&local->fd->lock);
+
+        gf_log (this->name, GF_LOG_TRACE,
+                "eager lock on fd=%p released", local->fd);
+
+        local->transaction.done (frame, this);
+
+        afr_eager_lock_wake (this, &waiters);
+
+        return 0;
+}
+
+
+static int
+afr_eager_lock_release (call_frame_t *frame, xlator_t *this)
+{
+        afr_local_t *local = NULL;
+
+        local = frame->local;
+
+        local->transaction.eager = AFR_EAGER_RELEASE;
+
+        if (local->transaction.post_op_delayed) {
+                local->transaction.post_op_delayed = _gf_false;
+                afr_changelog_post_op (frame, this);
+        } else {
+                afr_transaction_unlock (frame, this);
+        }
+
+        return 0;
+}
+
+
+static void
+afr_delayed_post_op (void *data)
+{
+        xlator_t      *this   = NULL;
+        fd_t          *fd     = NULL;
+        afr_fd_ctx_t  *fd_ctx = NULL;
+        call_frame_t  *holder = NULL;
+        gf_timer_t    *timer  = NULL;
+
+        this = THIS;
+        fd   = data;
+
+        fd_ctx = afr_fd_ctx_get (fd, this);
+        if (!fd_ctx)
+                goto out;
+
+        LOCK (&fd->lock);
+        {
+                timer = fd_ctx->delay_timer;
+                fd_ctx->delay_timer = NULL;
+
+                if (timer && !fd_ctx->eager_users &&
+                    (fd_ctx->eager_state == AFR_EAGER_LOCK_HELD))
+                        holder = __afr_eager_lock_unpark (fd_ctx);
+        }
+        UNLOCK (&fd->lock);
+
+        /* a write picked the lock up again and cancelled us */
+        if (!timer)
+                goto out;
+
+        if (holder)
+                afr_eager_lock_release (holder, this);
+
+        afr_delay_timer_cancel (this, fd, timer);
+out:
+        return;
+}
+
+
+/* a transaction running under the eager lock is through with it. The
+   holder stays parked till the lock is released, the others are done */
+static int
+afr_eager_lock_put (call_frame_t *frame, xlator_t *this)
+{
+        afr_local_t      *local  = NULL;
+        afr_private_t    *priv   = NULL;
+        afr_fd_ctx_t     *fd_ctx = NULL;
+        call_frame_t     *holder = NULL;
+        fd_t             *fd     = NULL;
+        afr_eager_role_t  role   = AFR_EAGER_NONE;
+        struct timeval    delay  = {0, };
+        uint64_t          down_count = 0;
+
+        local = frame->local;
+        priv  = this->private;
+        role  = local->transaction.eager;
+
+        fd_ctx = afr_fd_ctx_get (local->fd, this);
+
+        delay.tv_sec = priv->post_op_delay_secs;
+
+        LOCK (&priv->lock);
+        {
+                down_count = priv->down_count;
+        }
+        UNLOCK (&priv->lock);
+
+        /* for the timer, given back below if it is not armed */
+        fd = fd_ref (local->fd);
+
+        LOCK (&local->fd->lock);
+        {
+                if (--fd_ctx->eager_users)
+                        goto unlock;
+
+                if (!fd_ctx->eager_release && delay.tv_sec &&
+                    !__afr_eager_lock_stale (fd_ctx, down_count)) {
+                        fd_ctx->delay_timer =
+                                gf_timer_call_after (this->ctx, delay,
+                                                     afr_delayed_post_op,
+                                                     local->fd);
+                        if (fd_ctx->delay_timer) {
+                                fd = NULL;
+                                goto unlock;
+                        }
+                }
+
+                holder = __afr_eager_lock_unpark (fd_ctx);
+        }
+unlock:
+        UNLOCK (&local->fd->lock);
+
+        if (fd)
+                fd_unref (fd);
+
+        if (holder)
+                afr_eager_lock_release (holder, this);
+
+        if (role == AFR_EAGER_SHARED)
+                local->transaction.done (frame, this);
+
+        return 0;
+}
+
+
+/* called by the holder once its locks are in, or have failed */
+static void
+afr_eager_lock_acquired (call_frame_t *frame, xlator_t *this, int32_t op_ret)
+{
+        afr_internal_lock_t *int_lock = NULL;
+        afr_local_t         *local    = NULL;
+        afr_private_t       *priv     = NULL;
+        afr_fd_ctx_t        *fd_ctx   = NULL;
+        struct list_head     waiters;
+
+        local    = frame->local;
+        int_lock = &local->internal_lock;
+        priv     = this->private;
+
+        if (local->transaction.eager != AFR_EAGER_HOLDER)
+                return;
+
+        INIT_LIST_HEAD (&waiters);
+
+        fd_ctx = afr_fd_ctx_get (local->fd, this);
+
+        LOCK (&local->fd->lock);
+        {
+                if (fd_ctx->eager_state != AFR_EAGER_LOCK_ACQUIRING)
+                        goto unlock;
+
+                list_splice_init (&fd_ctx->eager_waiters, &waiters);
+
+                if (op_ret == 0) {
+                        fd_ctx->eager_state = AFR_EAGER_LOCK_HELD;
+                        fd_ctx->eager_acquired = time (NULL);
+                        memcpy (fd_ctx->eager_locked_nodes,
+                                int_lock->inode_locked_nodes,
+                                priv->child_count);
+                } else {
+                        fd_ctx->eager_state   = AFR_EAGER_LOCK_NONE;
+                        fd_ctx->eager_holder  = NULL;
+                        fd_ctx->eager_users   = 0;
+                        fd_ctx->eager_release = _gf_false;
+
+                        local->transaction.eager = AFR_EAGER_NONE;
+                }
+        }
+unlock:
+        UNLOCK (&local->fd->lock);
+
+        afr_eager_lock_wake (this, &waiters);
+}
+
+
+/* returns 1 if the transaction has been taken care of: it either joined
+   the eager lock held on its fd and is off to the pre-op, or it is waiting
+   for that lock to be taken or given up. Returns 0 if it has to lock by
+   itself, which for the holder means the whole file */
+static int
+afr_eager_lock_get (call_frame_t *frame, xlator_t *this)
+{
+        afr_local_t      *local    = NULL;
+        afr_private_t    *priv     = NULL;
+        afr_fd_ctx_t     *fd_ctx   = NULL;
+        call_frame_t     *holder   = NULL;
+        gf_timer_t       *timer    = NULL;
+        fd_t             *fd       = NULL;
+        afr_eager_role_t  role     = AFR_EAGER_NONE;
+        uint64_t          down_count = 0;
+        int               eligible = 0;
+        int               ret      = 0;
+        int               i        = 0;
+
+        local = frame->local;
+        priv  = this->private;
+
+        if (!local->fd || (local->transaction.type != AFR_DATA_TRANSACTION))
+                goto out;
+
+        fd     = local->fd;
+        fd_ctx = afr_fd_ctx_get (fd, this);
+        if (!fd_ctx)
+                goto out;
+
+        eligible = afr_eager_lock_eligible (frame, this);
+
+        LOCK (&priv->lock);
+        {
+                down_count = priv->down_count;
+        }
+        UNLOCK (&priv->lock);
+
+        LOCK (&fd->lock);
+        {
+                switch (fd_ctx->eager_state) {
+                case AFR_EAGER_LOCK_NONE:
+                        if (!eligible)
+                                break;
+
+                        fd_ctx->eager_state  = AFR_EAGER_LOCK_ACQUIRING;
+                        fd_ctx->eager_holder = frame;
+                        fd_ctx->eager_users  = 1;
+                        fd_ctx->eager_down_count = down_count;
+
+                        local->transaction.start = 0;
+                        local->transaction.len   = 0;
+
+                        role = AFR_EAGER_HOLDER;
+                        break;
+
+                case AFR_EAGER_LOCK_HELD:
+                        if (eligible && !fd_ctx->eager_release &&
+                            !__afr_eager_lock_stale (fd_ctx, down_count) &&
+                            __afr_eager_lock_covers_up_children (priv,
+                                                                 fd_ctx)) {
+                                fd_ctx->eager_users++;
+
+                                /* stay off subvolumes the lock is not on */
+                                for (i = 0; i < priv->child_count; i++) {
+                                        if (!fd_ctx->eager_locked_nodes[i])
+                                                local->child_up[i] = 0;
+                                }
+
+                                timer = fd_ctx->delay_timer;
+                                fd_ctx->delay_timer = NULL;
+
+                                role = AFR_EAGER_SHARED;
+                                ret  = 1;
+                                break;
+                        }
+
+                        /* somebody else wants the fd, the lock has been
+                           held long enough, or subvolumes came and went
+                           since it was taken: let it go, and lock afresh
+                           after that */
+                        fd_ctx->eager_release = _gf_true;
+
+                        if (!fd_ctx->eager_users) {
+                                timer = fd_ctx->delay_timer;
+                                fd_ctx->delay_timer = NULL;
+
+                                holder = __afr_eager_lock_unpark (fd_ctx);
+                        }
+
+                        /* fall through */
+                case AFR_EAGER_LOCK_ACQUIRING:
+                case AFR_EAGER_LOCK_RELEASING:
+                        if (!eligible)
+                                fd_ctx->eager_release = _gf_true;
+
+                        local->transaction.eager_frame = frame;
+                        list_add_tail (&local->transaction.eager_list,
+                                       &fd_ctx->eager_waiters);
+                        ret = 1;
+                        break;
+                }
+
+                local->transaction.eager = role;
+        }
+        UNLOCK (&fd->lock);
+
+        /* once queued the transaction may be woken up on another thread
+           right away, so it is not to be touched from here on */
+
+        afr_delay_timer_cancel (this, fd, timer);
+
+        if (holder)
+                afr_eager_lock_release (holder, this);
+
+        if (role == AFR_EAGER_SHARED) {
+                afr_pid_save (frame);
+                afr_internal_lock_finish (frame, this);
+        }
+out:
+        return ret;
+}
+
+
+static int
+afr_transaction_lock (call_frame_t *frame, xlator_t *this)
+{
+        if (afr_eager_lock_get (frame, this))
+                return 0;
+
+        return afr_lock (frame, this);
+}
+
+
+static int
+afr_transaction_unlock (call_frame_t *frame, xlator_t *this)
+{
+        afr_internal_lock_t *int_lock = NULL;
+        afr_local_t         *local    = NULL;
+        afr_private_t       *priv     = NULL;
+
+        local    = frame->local;
+        int_lock = &local->internal_lock;
+        priv     = this->private;
+
+        switch (local->transaction.eager) {
+        case AFR_EAGER_HOLDER:
+        case AFR_EAGER_SHARED:
+                afr_eager_lock_put (frame, this);
+                break;
+
+        case AFR_EAGER_RELEASE:
+                int_lock->lock_cbk = afr_eager_lock_released;
+                afr_unlock (frame, this);
+                break;
+
+        case AFR_EAGER_NONE:
+                if (afr_lock_server_count (priv, local->transaction.type) == 0) {
+                        local->transaction.done (frame, this);
+                } else {
+                        int_lock->lock_cbk = local->transaction.done;
+                        afr_unlock (frame, this);
+                }
+                break;
+        }
+
+        return 0;
+}
+
+/* }}} */
+
+
 int
 afr_internal_lock_finish (call_frame_t *frame, xlator_t *this)
 {
@@ -1158,6 +1643,8 @@ afr_internal_lock_finish (call_frame_t *frame, xlator_t *this)
         priv  = this->private;
         local = frame->local;
 
+        afr_eager_lock_acquired (frame, this, 0);
+
         if (__changelog_needed_pre_op (frame, this)) {
                 afr_changelog_pre_op (frame, this);
         } else {
@@ -1173,28 +1660,58 @@ afr_internal_lock_finish (call_frame_t *frame, xlator_t *this)
 }
 
 
+/* the holder of an eager lock can leave its post-op for when the lock
+   is released only if the fop went through on every subvolume; otherwise
+   the failures have to be on disk right away */
+static int
+afr_post_op_can_be_delayed (call_frame_t *frame, xlator_t *this)
+{
+	afr_local_t   *local = NULL;
+	afr_private_t *priv  = NULL;
+
+        int index = 0;
+        int i     = 0;
+
+	local = frame->local;
+	priv  = this->private;
+
+        if (local->transaction.eager != AFR_EAGER_HOLDER)
+                return 0;
+
+        if (local->op_ret < 0)
+                return 0;
+
+        index = afr_index_for_transaction_type (local->transaction.type);
+
+        for (i = 0; i < priv->child_count; i++) {
+                if (!local->child_up[i] || (local->pending[i][index] == 0))
+                        return 0;
+        }
+
+        return 1;
+}
+
+
 int
 afr_transaction_resume (call_frame_t *frame, xlator_t *this)
 {
-        afr_internal_lock_t *int_lock = NULL;
 	afr_local_t         *local    = NULL;
-	afr_private_t       *priv     = NULL;
 
 	local    = frame->local;
-        int_lock = &local->internal_lock;
-	priv     = this->private;
 
-	if (__changelog_needed_post_op (frame, this)) {
-		afr_changelog_post_op (frame, this);
-	} else {
-		if (afr_lock_server_count (priv, local->transaction.type) == 0) {
-			local->transaction.done (frame, this);
-		} else {
-                        int_lock->lock_cbk = local->transaction.done;
-			afr_unlock (frame, this);
-		}
-	}
+	if (!__changelog_needed_post_op (frame, this)) {
+                afr_transaction_unlock (frame, this);
+                goto out;
+        }
 
+        if (afr_post_op_can_be_delayed (frame, this)) {
+                local->transaction.post_op_delayed = _gf_true;
+                afr_eager_lock_put (frame, this);
+                goto out;
+        }
+
+        afr_changelog_post_op (frame, this);
+out:
 	return 0;
 }
 
@@ -1234,7 +1751,7 @@ afr_transaction (call_frame_t *frame, xlator_t *this, afr_transaction_type type)
 	if (afr_lock_server_count (priv, local->transaction.type) == 0) {
                 afr_internal_lock_finish (frame, this);
 	} else {
-		afr_lock (frame, this);
+		afr_transaction_lock (frame, this);
 	}
 
 	return 0;
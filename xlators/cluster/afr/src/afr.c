@@ -72,6 +72,7 @@ validate_options (xlator_t *this, dict_t *options, char **op_errstr)
         gf_boolean_t entry_change_log;      
         gf_boolean_t strict_readdir;
         gf_boolean_t optimistic_change_log;
+        gf_boolean_t eager_lock;
 
         xlator_list_t * trav        = NULL;
         
@@ -80,9 +81,11 @@ validate_options (xlator_t *this, dict_t *options, char **op_errstr)
         char * change_log      = NULL;
         char * str_readdir     = NULL;
         char * self_heal_algo  = NULL;
+        char * str_eager_lock  = NULL;
 
         int32_t background_count  = 0;
         int32_t window_size       = 0;
+        int32_t post_op_delay     = 0;
 
         int    read_ret      = -1;
         int    dict_ret      = -1;
@@ -285,6 +288,38 @@ validate_options (xlator_t *this, dict_t *options, char **op_errstr)
                         "change-log %s'.", change_log);
         }
 
+        dict_ret = dict_get_str (options, "eager-lock",
+                                 &str_eager_lock);
+        if (dict_ret == 0) {
+                temp_ret = gf_string2boolean (str_eager_lock, &eager_lock);
+                if (temp_ret < 0) {
+                        gf_log (this->name, GF_LOG_WARNING,
+                                "Validation failed for eager-lock "
+                                "(given-string = %s)", str_eager_lock);
+                        *op_errstr = gf_strdup ("Error, option should be "
+                                                "boolean");
+                        ret = -1;
+                        goto out;
+                }
+
+                gf_log (this->name, GF_LOG_DEBUG,
+                        "Validated 'option eager-lock %s'.", str_eager_lock);
+        }
+
+        dict_ret = dict_get_int32 (options, "post-op-delay-secs",
+                                   &post_op_delay);
+        if (dict_ret == 0) {
+                if (post_op_delay < 0) {
+                        *op_errstr = gf_strdup ("Error, option should be >= 0");
+                        ret = -1;
+                        goto out;
+                }
+
+                gf_log (this->name, GF_LOG_DEBUG,
+                        "validated post-op delay to %d seconds",
+                        post_op_delay);
+        }
+
         dict_ret = dict_get_str (options, "data-self-heal-algorithm",
                                  &self_heal_algo);
         if (dict_ret == 0) {
@@ -351,6 +386,7 @@ reconfigure (xlator_t *this, dict_t *options)
 	gf_boolean_t metadata_change_log;   /* on/off */
 	gf_boolean_t entry_change_log;      /* on/off */
 	gf_boolean_t strict_readdir;
+	gf_boolean_t eager_lock;            /* on/off */
 
 	afr_private_t * priv        = NULL;
 	xlator_list_t * trav        = NULL;
@@ -360,9 +396,11 @@ reconfigure (xlator_t *this, dict_t *options)
 	char * change_log      = NULL;
 	char * str_readdir     = NULL;
         char * self_heal_algo  = NULL;
+        char * str_eager_lock  = NULL;
 
         int32_t background_count  = 0;
         int32_t window_size       = 0;
+        int32_t post_op_delay     = 0;
 
 	int    read_ret      = -1;
 	int    dict_ret      = -1;
@@ -532,6 +570,35 @@ reconfigure (xlator_t *this, dict_t *options)
 			"change-log %s'.", change_log);
 	}
 
+	dict_ret = dict_get_str (options, "eager-lock",
+				 &str_eager_lock);
+	if (dict_ret == 0) {
+		temp_ret = gf_string2boolean (str_eager_lock, &eager_lock);
+		if (temp_ret < 0) {
+			gf_log (this->name, GF_LOG_WARNING,
+				"Reconfiguration Invalid 'option eager-"
+				"lock %s'. Defaulting to old value.",
+				str_eager_lock);
+			ret = -1;
+			goto out;
+		}
+
+		priv->eager_lock = eager_lock;
+		gf_log (this->name, GF_LOG_DEBUG,
+			"Reconfiguring 'option eager-lock %s'.",
+			str_eager_lock);
+	}
+
+	dict_ret = dict_get_int32 (options, "post-op-delay-secs",
+				   &post_op_delay);
+	if (dict_ret == 0) {
+		gf_log (this->name, GF_LOG_DEBUG,
+			"Reconfiguring post-op delay to %d seconds",
+			post_op_delay);
+
+		priv->post_op_delay_secs = post_op_delay;
+	}
+
         dict_ret = dict_get_str (options, "data-self-heal-algorithm",
                                  &self_heal_algo);
         if (dict_ret == 0) {
@@ -634,10 +701,12 @@ init (xlator_t *this)
 	char * strict_readdir  = NULL;
         char * inodelk_trace   = NULL;
         char * entrylk_trace   = NULL;
+        char * eager_lock      = NULL;
 
         int32_t background_count  = 0;
 	int32_t lock_server_count = 1;
         int32_t window_size       = 0;
+        int32_t post_op_delay     = 0;
 
 	int    fav_ret       = -1;
 	int    read_ret      = -1;
@@ -805,6 +874,32 @@ init (xlator_t *this)
 
 	/* Locking options */
 
+        priv->eager_lock         = _gf_false;
+        priv->post_op_delay_secs = 1;
+
+	dict_ret = dict_get_str (this->options, "eager-lock",
+				 &eager_lock);
+	if (dict_ret == 0) {
+		ret = gf_string2boolean (eager_lock, &priv->eager_lock);
+		if (ret < 0) {
+			gf_log (this->name, GF_LOG_WARNING,
+				"Invalid 'option eager-lock %s'. "
+				"Defaulting to eager-lock as 'off'.",
+				eager_lock);
+			priv->eager_lock = _gf_false;
+		}
+	}
+
+	dict_ret = dict_get_int32 (this->options, "post-op-delay-secs",
+				   &post_op_delay);
+	if (dict_ret == 0) {
+		gf_log (this->name, GF_LOG_DEBUG,
+			"Setting post-op delay to %d seconds",
+			post_op_delay);
+
+		priv->post_op_delay_secs = post_op_delay;
+	}
+
         priv->inodelk_trace = 0;
         priv->entrylk_trace = 0;
 
@@ -1107,5 +1202,12 @@ struct volume_options options[] = {
 	{ .key  = {"strict-readdir"},
 	  .type = GF_OPTION_TYPE_BOOL,
 	},
+	{ .key  = {"eager-lock"},
+	  .type = GF_OPTION_TYPE_BOOL
+	},
+	{ .key  = {"post-op-delay-secs"},
+	  .type = GF_OPTION_TYPE_INT,
+	  .min  = 0
+	},
 	{ .key  = {NULL} },
 };
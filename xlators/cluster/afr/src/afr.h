@@ -28,12 +28,17 @@
 
 #include "call-stub.h"
 #include "compat-errno.h"
+#include "timer.h"
 #include "afr-mem-types.h"
 
 #include "libxlator.h"
 
 #define AFR_XATTR_PREFIX "trusted.afr"
 
+/* an eager lock is not handed to new writes once it has been held this
+   long, so that a busy fd cannot keep other fds and clients off the file */
+#define AFR_EAGER_LOCK_MAX_HOLD_SECS 5
+
 struct _pump_private;
 
 typedef struct _afr_private {
@@ -92,6 +97,11 @@ typedef struct _afr_private {
         struct list_head saved_fds;   /* list of fds on which locks have succeeded */
         gf_boolean_t     optimistic_change_log;
 
+        gf_boolean_t     eager_lock;         /* on/off */
+        int32_t          post_op_delay_secs; /* how long an idle eager lock
+                                                is kept before post-op and
+                                                unlock */
+
         char                   vol_uuid[UUID_SIZE + 1];
 } afr_private_t;
 
@@ -194,6 +204,20 @@ typedef enum {
         AFR_UNLOCK_OP,
 } afr_lock_op_type_t;
 
+typedef enum {
+        AFR_EAGER_LOCK_NONE,        /* no eager lock on the fd */
+        AFR_EAGER_LOCK_ACQUIRING,   /* holder is locking, writes wait */
+        AFR_EAGER_LOCK_HELD,        /* writes share the lock */
+        AFR_EAGER_LOCK_RELEASING,   /* holder's post-op and unlock in flight */
+} afr_eager_lock_state_t;
+
+typedef enum {
+        AFR_EAGER_NONE,             /* transaction takes its own locks */
+        AFR_EAGER_HOLDER,           /* took the eager lock for the fd */
+        AFR_EAGER_SHARED,           /* runs under the holder's lock */
+        AFR_EAGER_RELEASE,          /* holder, now giving the lock up */
+} afr_eager_role_t;
+
 typedef enum {
         AFR_DATA_SELF_HEAL_LK,
         AFR_METADATA_SELF_HEAL_LK,
@@ -619,6 +643,11 @@ typedef struct _afr_local {
 		int (*unwind) (call_frame_t *frame, xlator_t *this);
 
                 /* post-op hook */
+
+                afr_eager_role_t eager;
+                gf_boolean_t     post_op_delayed;
+                struct list_head eager_list;  /* on fd_ctx->eager_waiters */
+                call_frame_t    *eager_frame; /* to resume a waiter with */
 	} transaction;
 
 	afr_self_heal_t self_heal;
@@ -644,6 +673,20 @@ typedef struct {
         struct list_head entries; /* needed for readdir failover */
 
         unsigned char *locked_on; /* which subvolumes locks have been successful */
+
+        /* eager lock: one inodelk over the whole file, taken by the first
+           write on the fd and shared by the writes that follow it. All of
+           these are protected by fd->lock */
+        afr_eager_lock_state_t  eager_state;
+        call_frame_t           *eager_holder;
+        unsigned char          *eager_locked_nodes;
+        int32_t                 eager_users;    /* transactions in flight */
+        gf_boolean_t            eager_release;  /* give it up once idle */
+        time_t                  eager_acquired; /* when it was taken */
+        uint64_t                eager_down_count; /* priv->down_count when
+                                                     it was asked for */
+        gf_timer_t             *delay_timer;
+        struct list_head        eager_waiters;
 } afr_fd_ctx_t;
 
 
@@ -46,6 +46,8 @@ struct dht_layout {
 	int               type;
         int               ref;   /* use with dht_conf_t->layout_lock */
         int               search_unhashed;
+        int               search_cnt; /* entries in the range index which
+                                         follows list[], -1 = not built */
         struct {
 		int       err;   /* 0 = normal
 				   -1 = dir exists and no xattr
@@ -227,6 +229,7 @@ dht_layout_t *dht_layout_for_subvol (xlator_t *this, xlator_t *subvol);
 xlator_t *dht_layout_search (xlator_t *this, dht_layout_t *layout,
 			     const char *name);
 int dht_layout_normalize (xlator_t *this, loc_t *loc, dht_layout_t *layout);
+int dht_layout_index (dht_layout_t *layout);
 int dht_layout_anomalies (xlator_t *this, loc_t *loc, dht_layout_t *layout,
 			  uint32_t *holes_p, uint32_t *overlaps_p,
 			  uint32_t *missing_p, uint32_t *down_p,
@@ -32,7 +32,13 @@
 
 #define layout_entry_size (sizeof ((dht_layout_t *)NULL)->list[0])
 
-#define layout_size(cnt) (layout_base_size + (cnt * layout_entry_size))
+/* every layout carries room for its range index right after list[] */
+#define layout_index_size (sizeof (int))
+
+#define layout_size(cnt) (layout_base_size +                            \
+                          (cnt * (layout_entry_size + layout_index_size)))
+
+#define layout_index(layout) ((int *) &(layout)->list[(layout)->cnt])
 
 
 dht_layout_t *
@@ -54,6 +60,7 @@ dht_layout_new (xlator_t *this, int cnt)
 
         layout->type = DHT_HASH_TYPE_DM;
 	layout->cnt = cnt;
+        layout->search_cnt = -1;
         if (conf)
                 layout->gen = conf->gen;
 
@@ -164,6 +171,77 @@ dht_layout_ref (xlator_t *this, dht_layout_t *layout)
 }
 
 
+/* Builds the range index of @layout: the positions of all entries holding
+ * a hash range, ordered by start. Entries which were never given a range
+ * (0 - 0) are left out. If the ranges overlap the index is not built and
+ * dht_layout_search() keeps scanning list[] in order.
+ */
+int
+dht_layout_index (dht_layout_t *layout)
+{
+        int      *index = NULL;
+        int       cnt = 0;
+        int       i = 0;
+        int       j = 0;
+
+        index = layout_index (layout);
+        layout->search_cnt = -1;
+
+        for (i = 0; i < layout->cnt; i++) {
+                if (layout->list[i].start > layout->list[i].stop)
+                        continue;
+                if (!layout->list[i].start && !layout->list[i].stop)
+                        continue;
+
+                /* insertion sort, list[] is mostly sorted already */
+                for (j = cnt; j > 0; j--) {
+                        if (layout->list[index[j - 1]].start
+                            <= layout->list[i].start)
+                                break;
+                        index[j] = index[j - 1];
+                }
+                index[j] = i;
+                cnt++;
+        }
+
+        for (i = 1; i < cnt; i++) {
+                if (layout->list[index[i]].start
+                    <= layout->list[index[i - 1]].stop)
+                        return -1;
+        }
+
+        layout->search_cnt = cnt;
+
+        return 0;
+}
+
+
+static xlator_t *
+dht_layout_index_search (dht_layout_t *layout, uint32_t hash)
+{
+        int      *index = NULL;
+        int       low = 0;
+        int       high = 0;
+        int       mid = 0;
+
+        index = layout_index (layout);
+        high = layout->search_cnt - 1;
+
+        while (low <= high) {
+                mid = low + (high - low) / 2;
+
+                if (hash < layout->list[index[mid]].start)
+                        high = mid - 1;
+                else if (hash > layout->list[index[mid]].stop)
+                        low = mid + 1;
+                else
+                        return layout->list[index[mid]].xlator;
+        }
+
+        return NULL;
+}
+
+
 xlator_t *
 dht_layout_search (xlator_t *this, dht_layout_t *layout, const char *name)
 {
@@ -181,6 +259,11 @@ dht_layout_search (xlator_t *this, dht_layout_t *layout, const char *name)
 		goto out;
 	}
 
+        if (layout->search_cnt >= 0) {
+                subvol = dht_layout_index_search (layout, hash);
+                goto found;
+        }
+
 	for (i = 0; i < layout->cnt; i++) {
 		if (layout->list[i].start <= hash
 		    && layout->list[i].stop >= hash) {
@@ -189,6 +272,7 @@ dht_layout_search (xlator_t *this, dht_layout_t *layout, const char *name)
 		}
 	}
 
+found:
 	if (!subvol) {
 		gf_log (this->name, GF_LOG_DEBUG,
 			"no subvolume for hash (value) = %u", hash);
@@ -318,6 +402,7 @@ dht_disk_layout_merge (xlator_t *this, dht_layout_t *layout,
 
 	layout->list[pos].start = start_off;
 	layout->list[pos].stop  = stop_off;
+        layout->search_cnt      = -1;
 
 	gf_log (this->name, GF_LOG_TRACE,
 		"merged to layout: %u - %u (type %d) from %s",
@@ -448,6 +533,8 @@ dht_layout_sort (dht_layout_t *layout)
 		}
 	}
 
+        dht_layout_index (layout);
+
 	return 0;
 }
 
@@ -468,6 +555,9 @@ dht_layout_sort_volname (dht_layout_t *layout)
 		}
 	}
 
+        /* positions moved, the index is stale */
+        layout->search_cnt = -1;
+
 	return 0;
 }
 
@@ -459,6 +459,8 @@ dht_selfheal_layout_new_directory (call_frame_t *frame, loc_t *loc,
 			}
 		}
 	}
+
+        dht_layout_index (layout);
 }
 
 
@@ -27,6 +27,8 @@
 enum gf_io_stats_mem_types_ {
         gf_io_stats_mt_ios_conf = gf_common_mt_end + 1,
         gf_io_stats_mt_ios_fd,
+        gf_io_stats_mt_ios_shard,
+        gf_io_stats_mt_ios_stats,
         gf_io_stats_mt_end
 };
 #endif
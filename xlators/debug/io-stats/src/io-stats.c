@@ -33,6 +33,8 @@
  *  c) counts of read IO block size - since process start, last interval and per fd
  *  d) counts of write IO block size - since process start, last interval and per fd
  *  e) counts of all FOP types passing through it
+ *  f) latency of all FOP types (min/avg/max and p50/p99/p999), when
+ *     latency-measurement is on
  *
  *  Usage: setfattr -n io-stats-dump /tmp/filename /mnt/gluster
  *
@@ -44,10 +46,24 @@
 #include "xlator.h"
 #include "io-stats-mem-types.h"
 
+/*
+ * latencies are counted in usecs into log-linear buckets. values below
+ * IOS_LAT_SUB_BUCKETS get a bucket each, every power of two above is split
+ * into IOS_LAT_SUB_BUCKETS buckets of equal width. a percentile read off
+ * the histogram is thus within 1/IOS_LAT_SUB_BUCKETS of the real value.
+ */
+#define IOS_LAT_SUB_BITS      3
+#define IOS_LAT_SUB_BUCKETS   (1 << IOS_LAT_SUB_BITS)
+#define IOS_LAT_MAX_BITS      32
+#define IOS_LAT_BUCKETS       ((IOS_LAT_MAX_BITS - IOS_LAT_SUB_BITS + 1)   \
+                               * IOS_LAT_SUB_BUCKETS)
+
 struct ios_lat {
-        double  min;
-        double  max;
-        double  avg;
+        uint64_t  count;
+        uint64_t  total;
+        uint64_t  min;
+        uint64_t  max;
+        uint64_t  buckets[IOS_LAT_BUCKETS];
 };
 
 struct ios_global_stats {
@@ -61,11 +77,27 @@ struct ios_global_stats {
 };
 
 
+/*
+ * every thread passing fops through gets a shard of its own and bumps its
+ * counters there without any locking. the shard is written by its thread
+ * only, a dump adds all of them up under conf->lock. shards of exited
+ * threads are handed over to new threads, their counts stay.
+ */
+struct ios_shard {
+        struct list_head          list;
+        struct ios_conf          *conf;
+        char                      in_use;
+        struct ios_global_stats   stats;
+};
+
+
 struct ios_conf {
         gf_lock_t                 lock;
-        struct ios_global_stats   cumulative;
+        struct list_head          shards;
+        pthread_key_t             shard_key;
+        struct timeval            started_at;
         uint64_t                  increment;
-        struct ios_global_stats   incremental;
+        struct ios_global_stats  *last;   /* sums as of the last dump */
         gf_boolean_t              dump_fd_stats;
         int                       measure_latency;
 };
@@ -86,6 +118,65 @@ struct ios_local {
         struct timeval  unwind_at;
 };
 
+
+void
+ios_shard_release (void *data)
+{
+        struct ios_shard *shard = NULL;
+
+        shard = data;
+
+        LOCK (&shard->conf->lock);
+        {
+                shard->in_use = 0;
+        }
+        UNLOCK (&shard->conf->lock);
+}
+
+
+struct ios_shard *
+ios_shard_get (struct ios_conf *conf)
+{
+        struct ios_shard *shard = NULL;
+        struct ios_shard *tmp   = NULL;
+
+        shard = pthread_getspecific (conf->shard_key);
+        if (shard)
+                goto out;
+
+        LOCK (&conf->lock);
+        {
+                list_for_each_entry (tmp, &conf->shards, list) {
+                        if (!tmp->in_use) {
+                                shard = tmp;
+                                break;
+                        }
+                }
+
+                if (!shard) {
+                        shard = GF_CALLOC (1, sizeof (*shard),
+                                           gf_io_stats_mt_ios_shard);
+                        if (shard) {
+                                shard->conf = conf;
+                                list_add_tail (&shard->list, &conf->shards);
+                        }
+                }
+
+                if (shard)
+                        shard->in_use = 1;
+        }
+        UNLOCK (&conf->lock);
+
+        if (shard && pthread_setspecific (conf->shard_key, shard) != 0) {
+                ios_shard_release (shard);
+                shard = NULL;
+        }
+
+out:
+        return shard;
+}
+
+
 #define END_FOP_LATENCY(frame, op)                                      \
         do {                                                            \
                 struct ios_conf  *conf = NULL;                          \
@@ -111,22 +202,22 @@ struct ios_local {
 #define BUMP_FOP(op)                                                    \
         do {                                                            \
                 struct ios_conf  *conf = NULL;                          \
+                struct ios_shard *shard = NULL;                         \
                                                                         \
                 conf = this->private;                                   \
                 if (!conf)                                              \
                         break;                                          \
-                LOCK (&conf->lock);                                     \
-                {                                                       \
-                        conf->cumulative.fop_hits[GF_FOP_##op]++;       \
-                        conf->incremental.fop_hits[GF_FOP_##op]++;      \
-                }                                                       \
-                UNLOCK (&conf->lock);                                   \
+                shard = ios_shard_get (conf);                           \
+                if (!shard)                                             \
+                        break;                                          \
+                shard->stats.fop_hits[GF_FOP_##op]++;                   \
         } while (0)
 
 
 #define BUMP_READ(fd, len)                                              \
         do {                                                            \
                 struct ios_conf  *conf = NULL;                          \
+                struct ios_shard *shard = NULL;                         \
                 struct ios_fd    *iosfd = NULL;                         \
                 int               lb2 = 0;                              \
                                                                         \
@@ -136,25 +227,24 @@ struct ios_local {
                 if (!conf)                                              \
                         break;                                          \
                                                                         \
-                LOCK (&conf->lock);                                     \
-                {                                                       \
-                        conf->cumulative.data_read += len;              \
-                        conf->incremental.data_read += len;             \
-                        conf->cumulative.block_count_read[lb2]++;       \
-                        conf->incremental.block_count_read[lb2]++;      \
-                                                                        \
-                        if (iosfd) {                                    \
-                                iosfd->data_read += len;                \
-                                iosfd->block_count_read[lb2]++;         \
-                        }                                               \
+                if (iosfd) {                                            \
+                        __sync_fetch_and_add (&iosfd->data_read, len);  \
+                        __sync_fetch_and_add                            \
+                                (&iosfd->block_count_read[lb2], 1);     \
                 }                                                       \
-                UNLOCK (&conf->lock);                                   \
+                                                                        \
+                shard = ios_shard_get (conf);                           \
+                if (!shard)                                             \
+                        break;                                          \
+                shard->stats.data_read += len;                          \
+                shard->stats.block_count_read[lb2]++;                   \
         } while (0)
 
 
 #define BUMP_WRITE(fd, len)                                             \
         do {                                                            \
                 struct ios_conf  *conf = NULL;                          \
+                struct ios_shard *shard = NULL;                         \
                 struct ios_fd    *iosfd = NULL;                         \
                 int               lb2 = 0;                              \
                                                                         \
@@ -164,19 +254,18 @@ struct ios_local {
                 if (!conf)                                              \
                         break;                                          \
                                                                         \
-                LOCK (&conf->lock);                                     \
-                {                                                       \
-                        conf->cumulative.data_written += len;           \
-                        conf->incremental.data_written += len;          \
-                        conf->cumulative.block_count_write[lb2]++;      \
-                        conf->incremental.block_count_write[lb2]++;     \
-                                                                        \
-                        if (iosfd) {                                    \
-                                iosfd->data_written += len;             \
-                                iosfd->block_count_write[lb2]++;        \
-                        }                                               \
+                if (iosfd) {                                            \
+                        __sync_fetch_and_add (&iosfd->data_written,     \
+                                              len);                     \
+                        __sync_fetch_and_add                            \
+                                (&iosfd->block_count_write[lb2], 1);    \
                 }                                                       \
-                UNLOCK (&conf->lock);                                   \
+                                                                        \
+                shard = ios_shard_get (conf);                           \
+                if (!shard)                                             \
+                        break;                                          \
+                shard->stats.data_written += len;                       \
+                shard->stats.block_count_write[lb2]++;                  \
         } while (0)
 
 
@@ -220,11 +309,193 @@ ios_fd_ctx_set (fd_t *fd, xlator_t *this, struct ios_fd *iosfd)
         } while (0)
 
 
+static int
+ios_lat_bucket (uint64_t usec)
+{
+        int shift = 0;
+
+        if (usec < IOS_LAT_SUB_BUCKETS)
+                return usec;
+
+        if (usec >> IOS_LAT_MAX_BITS)
+                return IOS_LAT_BUCKETS - 1;
+
+        shift = log_base2 (usec) - IOS_LAT_SUB_BITS;
+
+        return ((shift + 1) << IOS_LAT_SUB_BITS)
+                + (usec >> shift) - IOS_LAT_SUB_BUCKETS;
+}
+
+
+/* smallest and largest value counted into bucket @i */
+static uint64_t
+ios_lat_bucket_low (int i)
+{
+        int shift = 0;
+
+        if (i < IOS_LAT_SUB_BUCKETS)
+                return i;
+
+        shift = (i >> IOS_LAT_SUB_BITS) - 1;
+
+        return ((uint64_t) (IOS_LAT_SUB_BUCKETS + (i % IOS_LAT_SUB_BUCKETS)))
+                << shift;
+}
+
+
+static uint64_t
+ios_lat_bucket_high (int i)
+{
+        if (i < IOS_LAT_SUB_BUCKETS)
+                return i;
+
+        return ios_lat_bucket_low (i)
+                + ((uint64_t)1 << ((i >> IOS_LAT_SUB_BITS) - 1)) - 1;
+}
+
+
+/* value below which @permille of the samples fall */
+static double
+ios_lat_percentile (struct ios_lat *lat, int permille)
+{
+        uint64_t  count = 0;
+        uint64_t  rank  = 0;
+        uint64_t  value = 0;
+        int       i     = 0;
+
+        for (i = 0; i < IOS_LAT_BUCKETS; i++)
+                count += lat->buckets[i];
+
+        if (!count)
+                return 0;
+
+        rank = (count * permille + 999) / 1000;
+        if (!rank)
+                rank = 1;
+
+        for (i = 0; i < IOS_LAT_BUCKETS; i++) {
+                if (lat->buckets[i] >= rank)
+                        break;
+                rank -= lat->buckets[i];
+        }
+
+        value = ios_lat_bucket_high (i);
+        if (value > lat->max)
+                value = lat->max;
+        if (value < lat->min)
+                value = lat->min;
+
+        return value;
+}
+
+
+static void
+ios_stats_add (struct ios_global_stats *to, struct ios_global_stats *from)
+{
+        struct ios_lat *lat = NULL;
+        int             i = 0;
+        int             j = 0;
+
+        to->data_read += from->data_read;
+        to->data_written += from->data_written;
+
+        for (i = 0; i < 32; i++) {
+                to->block_count_read[i] += from->block_count_read[i];
+                to->block_count_write[i] += from->block_count_write[i];
+        }
+
+        for (i = 0; i < GF_FOP_MAXVALUE; i++) {
+                to->fop_hits[i] += from->fop_hits[i];
+
+                lat = &from->latency[i];
+                if (!lat->count)
+                        continue;
+
+                if (!to->latency[i].count || (lat->min < to->latency[i].min))
+                        to->latency[i].min = lat->min;
+                if (lat->max > to->latency[i].max)
+                        to->latency[i].max = lat->max;
+
+                to->latency[i].count += lat->count;
+                to->latency[i].total += lat->total;
+
+                for (j = 0; j < IOS_LAT_BUCKETS; j++)
+                        to->latency[i].buckets[j] += lat->buckets[j];
+        }
+}
+
+
+/*
+ * @diff = @now - @then. min and max of the interval are not known
+ * exactly, they are taken from the outermost buckets that grew.
+ */
+static void
+ios_stats_sub (struct ios_global_stats *diff, struct ios_global_stats *now,
+               struct ios_global_stats *then)
+{
+        struct ios_lat *lat = NULL;
+        int             i = 0;
+        int             j = 0;
+        int             lo = -1;
+        int             hi = -1;
+
+        diff->data_read = now->data_read - then->data_read;
+        diff->data_written = now->data_written - then->data_written;
+
+        for (i = 0; i < 32; i++) {
+                diff->block_count_read[i] = now->block_count_read[i]
+                        - then->block_count_read[i];
+                diff->block_count_write[i] = now->block_count_write[i]
+                        - then->block_count_write[i];
+        }
+
+        for (i = 0; i < GF_FOP_MAXVALUE; i++) {
+                diff->fop_hits[i] = now->fop_hits[i] - then->fop_hits[i];
+
+                lat = &diff->latency[i];
+                lat->count = now->latency[i].count - then->latency[i].count;
+                lat->total = now->latency[i].total - then->latency[i].total;
+
+                lo = hi = -1;
+                for (j = 0; j < IOS_LAT_BUCKETS; j++) {
+                        lat->buckets[j] = now->latency[i].buckets[j]
+                                - then->latency[i].buckets[j];
+                        if (!lat->buckets[j])
+                                continue;
+                        if (lo == -1)
+                                lo = j;
+                        hi = j;
+                }
+
+                if (lo == -1)
+                        continue;
+
+                lat->min = max (ios_lat_bucket_low (lo), now->latency[i].min);
+                lat->max = min (ios_lat_bucket_high (hi),
+                                now->latency[i].max);
+        }
+}
+
+
+static void
+__ios_stats_sum (struct ios_conf *conf, struct ios_global_stats *sum)
+{
+        struct ios_shard *shard = NULL;
+
+        memset (sum, 0, sizeof (*sum));
+
+        list_for_each_entry (shard, &conf->shards, list) {
+                ios_stats_add (sum, &shard->stats);
+        }
+}
+
+
 int
 io_stats_dump_global (xlator_t *this, struct ios_global_stats *stats,
                       struct timeval *now, int interval, FILE *logfp)
 {
-        int    i = 0;
+        struct ios_lat *lat = NULL;
+        int             i = 0;
 
         if (interval == -1)
                 ios_log (this, logfp, "=== Cumulative stats ===");
@@ -251,15 +522,21 @@ io_stats_dump_global (xlator_t *this, struct ios_global_stats *stats,
         }
 
         for (i = 0; i < GF_FOP_MAXVALUE; i++) {
-                if (stats->fop_hits[i] && !stats->latency[i].avg)
+                lat = &stats->latency[i];
+
+                if (stats->fop_hits[i] && !lat->count)
                         ios_log (this, logfp, "%14s : %"PRId64,
                                  gf_fop_list[i], stats->fop_hits[i]);
-                else if (stats->fop_hits[i] && stats->latency[i].avg)
+                else if (stats->fop_hits[i] && lat->count)
                         ios_log (this, logfp, "%14s : %"PRId64 ", latency"
-                                 "(avg: %f, min: %f, max: %f)",
+                                 "(avg: %f, min: %f, max: %f, p50: %f, "
+                                 "p99: %f, p999: %f)",
                                  gf_fop_list[i], stats->fop_hits[i],
-                                 stats->latency[i].avg, stats->latency[i].min,
-                                 stats->latency[i].max);
+                                 (double) lat->total / lat->count,
+                                 (double) lat->min, (double) lat->max,
+                                 ios_lat_percentile (lat, 500),
+                                 ios_lat_percentile (lat, 990),
+                                 ios_lat_percentile (lat, 999));
         }
 
         return 0;
@@ -271,33 +548,50 @@ io_stats_dump (xlator_t *this, char *filename, inode_t *inode,
                const char *path)
 {
         struct ios_conf         *conf = NULL;
-        struct ios_global_stats  cumulative = {0, };
-        struct ios_global_stats  incremental = {0, };
+        struct ios_global_stats *cumulative = NULL;
+        struct ios_global_stats *incremental = NULL;
         int                      increment = 0;
         struct timeval           now;
         FILE                    *logfp = NULL;
 
         conf = this->private;
 
+        cumulative = GF_CALLOC (1, sizeof (*cumulative),
+                                gf_io_stats_mt_ios_stats);
+        incremental = GF_CALLOC (1, sizeof (*incremental),
+                                 gf_io_stats_mt_ios_stats);
+        if (!cumulative || !incremental) {
+                gf_log (this->name, GF_LOG_ERROR, "Out of memory.");
+                goto out;
+        }
+
         gettimeofday (&now, NULL);
         LOCK (&conf->lock);
         {
-                cumulative  = conf->cumulative;
-                incremental = conf->incremental;
+                __ios_stats_sum (conf, cumulative);
+                cumulative->started_at = conf->started_at;
+
+                ios_stats_sub (incremental, cumulative, conf->last);
+                incremental->started_at = conf->last->started_at;
 
                 increment = conf->increment++;
 
-                memset (&conf->incremental, 0, sizeof (conf->incremental));
-                conf->incremental.started_at = now;
+                *conf->last = *cumulative;
+                conf->last->started_at = now;
         }
         UNLOCK (&conf->lock);
 
         logfp = fopen (filename, "w+");
-        io_stats_dump_global (this, &cumulative, &now, -1, logfp);
-        io_stats_dump_global (this, &incremental, &now, increment, logfp);
+        io_stats_dump_global (this, cumulative, &now, -1, logfp);
+        io_stats_dump_global (this, incremental, &now, increment, logfp);
 
         if (logfp)
                 fclose (logfp);
+out:
+        if (cumulative)
+                GF_FREE (cumulative);
+        if (incremental)
+                GF_FREE (incremental);
         return 0;
 }
 
@@ -371,41 +665,33 @@ int
 update_ios_latency (struct ios_conf *conf, call_frame_t *frame,
                     glusterfs_fop_t op)
 {
-        double elapsed;
-        struct timeval *begin, *end;
-        double avg;
+        struct ios_shard *shard = NULL;
+        struct ios_lat   *lat = NULL;
+        struct timeval   *begin, *end;
+        int64_t           elapsed = 0;
 
         begin = &frame->begin;
         end   = &frame->end;
 
-        elapsed = (end->tv_sec - begin->tv_sec) * 1e6
+        elapsed = (end->tv_sec - begin->tv_sec) * 1000000LL
                 + (end->tv_usec - begin->tv_usec);
+        if (elapsed < 0)
+                elapsed = 0;
 
-        /* Cumulative */
-        if (!conf->cumulative.latency[op].min)
-                conf->cumulative.latency[op].min = elapsed;
-        if (conf->cumulative.latency[op].min > elapsed)
-                conf->cumulative.latency[op].min = elapsed;
-        if (conf->cumulative.latency[op].max < elapsed)
-                conf->cumulative.latency[op].max = elapsed;
-
-        avg = conf->cumulative.latency[op].avg;
-
-        conf->cumulative.latency[op].avg =
-                avg + (elapsed - avg) / conf->cumulative.fop_hits[op];
+        shard = ios_shard_get (conf);
+        if (!shard)
+                return -1;
 
-        /* Incremental */
-        if (!conf->incremental.latency[op].min)
-                conf->incremental.latency[op].min = elapsed;
-        if (conf->incremental.latency[op].min > elapsed)
-                conf->incremental.latency[op].min = elapsed;
-        if (conf->incremental.latency[op].max < elapsed)
-                conf->incremental.latency[op].max = elapsed;
+        lat = &shard->stats.latency[op];
 
-        avg = conf->incremental.latency[op].avg;
+        if (!lat->count || (lat->min > elapsed))
+                lat->min = elapsed;
+        if (lat->max < elapsed)
+                lat->max = elapsed;
 
-        conf->incremental.latency[op].avg =
-                avg + (elapsed - avg) / conf->incremental.fop_hits[op];
+        lat->buckets[ios_lat_bucket (elapsed)]++;
+        lat->total += elapsed;
+        lat->count++;
 
         return 0;
 }
@@ -1655,9 +1941,27 @@ init (xlator_t *this)
         }
 
         LOCK_INIT (&conf->lock);
+        INIT_LIST_HEAD (&conf->shards);
+
+        conf->last = GF_CALLOC (1, sizeof (*conf->last),
+                                gf_io_stats_mt_ios_stats);
+        if (!conf->last) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "Out of memory.");
+                GF_FREE (conf);
+                return -1;
+        }
+
+        if (pthread_key_create (&conf->shard_key, ios_shard_release) != 0) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "could not create the key for per thread stats");
+                GF_FREE (conf->last);
+                GF_FREE (conf);
+                return -1;
+        }
 
-        gettimeofday (&conf->cumulative.started_at, NULL);
-        gettimeofday (&conf->incremental.started_at, NULL);
+        gettimeofday (&conf->started_at, NULL);
+        conf->last->started_at = conf->started_at;
 
         ret = dict_get_str (options, "dump-fd-stats", &str);
         if (ret == 0) {
@@ -1699,7 +2003,9 @@ init (xlator_t *this)
 void
 fini (xlator_t *this)
 {
-        struct ios_conf *conf = NULL;
+        struct ios_conf  *conf = NULL;
+        struct ios_shard *shard = NULL;
+        struct ios_shard *tmp = NULL;
 
         if (!this)
                 return;
@@ -1710,6 +2016,14 @@ fini (xlator_t *this)
                 return;
         this->private = NULL;
 
+        pthread_key_delete (conf->shard_key);
+
+        list_for_each_entry_safe (shard, tmp, &conf->shards, list) {
+                list_del (&shard->list);
+                GF_FREE (shard);
+        }
+
+        GF_FREE (conf->last);
         GF_FREE(conf);
 
         gf_log (this->name, GF_LOG_NORMAL,
@@ -72,6 +72,9 @@ allocate_domain (const char *volume)
         INIT_LIST_HEAD (&dom->inodelk_list);
         INIT_LIST_HEAD (&dom->blocked_inodelks);
 
+        pl_range_tree_init (&dom->inodelk_tree);
+        pl_range_tree_init (&dom->blocked_tree);
+
         return dom;
 }
 
@@ -453,6 +456,9 @@ pl_inode_get (xlator_t *this, inode_t *inode)
 	INIT_LIST_HEAD (&pl_inode->blocked_reservelks);
         INIT_LIST_HEAD (&pl_inode->blocked_calls);
 
+        pl_range_tree_init (&pl_inode->ext_granted);
+        pl_range_tree_init (&pl_inode->ext_blocked);
+
 	inode_ctx_put (inode, this, (uint64_t)(long)(pl_inode));
 
 out:
@@ -493,10 +499,26 @@ new_posix_lock (struct gf_flock *flock, void *transport, pid_t client_pid,
 }
 
 
+/* Take a lock out of the inode's range index, without waking anyone */
+static void
+__unindex_lock (pl_inode_t *pl_inode, posix_lock_t *lock)
+{
+        if (lock->blocked)
+                pl_range_remove (&pl_inode->ext_blocked, &lock->range);
+        else
+                pl_range_remove (&pl_inode->ext_granted, &lock->range);
+}
+
+
 /* Delete a lock from the inode's lock list */
 void
 __delete_lock (pl_inode_t *pl_inode, posix_lock_t *lock)
 {
+        if (!lock->blocked && pl_range_linked (&lock->range))
+                pl_range_release (&pl_inode->ext_granted, lock->fl_start,
+                                  lock->fl_end);
+
+        __unindex_lock (pl_inode, lock);
 	list_del_init (&lock->list);
 }
 
@@ -530,6 +552,13 @@ __insert_lock (pl_inode_t *pl_inode, posix_lock_t *lock)
 {
         list_add_tail (&lock->list, &pl_inode->ext_list);
 
+        if (lock->blocked)
+                pl_range_insert (&pl_inode->ext_blocked, &lock->range,
+                                 lock->fl_start, lock->fl_end);
+        else
+                pl_range_insert (&pl_inode->ext_granted, &lock->range,
+                                 lock->fl_start, lock->fl_end);
+
 	return;
 }
 
@@ -590,6 +619,8 @@ add_locks (posix_lock_t *l1, posix_lock_t *l2)
 	sum->fl_start = min (l1->fl_start, l2->fl_start);
 	sum->fl_end   = max (l1->fl_end, l2->fl_end);
 
+        INIT_LIST_HEAD (&sum->list);
+
 	return sum;
 }
 
@@ -706,24 +737,20 @@ done:
 }
 
 /*
-  Start searching from {begin}, and return the first lock that
-  conflicts, NULL if no conflict
-  If {begin} is NULL, then start from the beginning of the list
+  Return the granted lock with the lowest start that overlaps {lock},
+  NULL if there is none
 */
 static posix_lock_t *
 first_overlap (pl_inode_t *pl_inode, posix_lock_t *lock)
 {
-        posix_lock_t *l = NULL;
-
-        list_for_each_entry (l, &pl_inode->ext_list, list) {
-                if (l->blocked)
-                        continue;
+        struct pl_range_node *node = NULL;
 
-                if (locks_overlap (l, lock))
-                        return l;
-        }
+        node = pl_range_first (&pl_inode->ext_granted, lock->fl_start,
+                               lock->fl_end);
+        if (!node)
+                return NULL;
 
-        return NULL;
+        return pl_range_entry (node, posix_lock_t, range);
 }
 
 
@@ -735,15 +762,16 @@ __is_lock_grantable (pl_inode_t *pl_inode, posix_lock_t *lock)
         posix_lock_t *l = NULL;
         int           ret = 1;
 
-        list_for_each_entry (l, &pl_inode->ext_list, list) {
-                if (!l->blocked && locks_overlap (lock, l)) {
-                        if (((l->fl_type == F_WRLCK)
-                             || (lock->fl_type == F_WRLCK))
-                            && (lock->fl_type != F_UNLCK)
-                            && !same_owner (l, lock)) {
-                                ret = 0;
-                                break;
-                        }
+        if (lock->fl_type == F_UNLCK)
+                return ret;
+
+        pl_range_for_each_overlap (l, &pl_inode->ext_granted, lock->fl_start,
+                                   lock->fl_end, range) {
+                if (((l->fl_type == F_WRLCK)
+                     || (lock->fl_type == F_WRLCK))
+                    && !same_owner (l, lock)) {
+                        ret = 0;
+                        break;
                 }
         }
         return ret;
@@ -762,66 +790,65 @@ __insert_and_merge (pl_inode_t *pl_inode, posix_lock_t *lock)
         int            i = 0;
         struct _values v = { .locks = {0, 0, 0} };
 
-        list_for_each_entry_safe (conf, t, &pl_inode->ext_list, list) {
-                if (!locks_overlap (conf, lock))
-                        continue;
-
-                if (same_owner (conf, lock)) {
-                        if (conf->fl_type == lock->fl_type) {
-                                sum = add_locks (lock, conf);
+        /* the lock has been found grantable, so only the owner's own
+           locks in its range have to be merged or split */
+        pl_range_for_each_overlap (t, &pl_inode->ext_granted, lock->fl_start,
+                                   lock->fl_end, range) {
+                if (same_owner (t, lock)) {
+                        conf = t;
+                        break;
+                }
+        }
 
-                                sum->fl_type    = lock->fl_type;
-                                sum->transport  = lock->transport;
-                                sum->fd_num     = lock->fd_num;
-                                sum->client_pid = lock->client_pid;
-                                sum->owner      = lock->owner;
+        if (conf) {
+                if (conf->fl_type == lock->fl_type) {
+                        sum = add_locks (lock, conf);
 
-                                __delete_lock (pl_inode, conf);
-                                __destroy_lock (conf);
+                        sum->fl_type    = lock->fl_type;
+                        sum->transport  = lock->transport;
+                        sum->fd_num     = lock->fd_num;
+                        sum->client_pid = lock->client_pid;
+                        sum->owner      = lock->owner;
 
-                                __destroy_lock (lock);
-                                __insert_and_merge (pl_inode, sum);
+                        /* the range stays locked, nobody to wake */
+                        __unindex_lock (pl_inode, conf);
+                        list_del_init (&conf->list);
+                        __destroy_lock (conf);
 
-                                return;
-                        } else {
-                                sum = add_locks (lock, conf);
+                        __destroy_lock (lock);
+                        __insert_and_merge (pl_inode, sum);
 
-                                sum->fl_type    = conf->fl_type;
-                                sum->transport  = conf->transport;
-                                sum->fd_num     = conf->fd_num;
-                                sum->client_pid = conf->client_pid;
-                                sum->owner      = conf->owner;
+                        return;
+                } else {
+                        sum = add_locks (lock, conf);
 
-                                v = subtract_locks (sum, lock);
+                        sum->fl_type    = conf->fl_type;
+                        sum->transport  = conf->transport;
+                        sum->fd_num     = conf->fd_num;
+                        sum->client_pid = conf->client_pid;
+                        sum->owner      = conf->owner;
 
-                                __delete_lock (pl_inode, conf);
-                                __destroy_lock (conf);
+                        v = subtract_locks (sum, lock);
 
-                                __delete_lock (pl_inode, lock);
-                                __destroy_lock (lock);
+                        __delete_lock (pl_inode, conf);
+                        __destroy_lock (conf);
 
-                                __destroy_lock (sum);
+                        __delete_lock (pl_inode, lock);
+                        __destroy_lock (lock);
 
-                                for (i = 0; i < 3; i++) {
-                                        if (!v.locks[i])
-                                                continue;
+                        __destroy_lock (sum);
 
-                                        INIT_LIST_HEAD (&v.locks[i]->list);
-                                        __insert_and_merge (pl_inode,
-                                                            v.locks[i]);
-                                }
+                        for (i = 0; i < 3; i++) {
+                                if (!v.locks[i])
+                                        continue;
 
-                                __delete_unlck_locks (pl_inode);
-                                return;
+                                INIT_LIST_HEAD (&v.locks[i]->list);
+                                memset (&v.locks[i]->range, 0,
+                                        sizeof (v.locks[i]->range));
+                                __insert_and_merge (pl_inode,
+                                                    v.locks[i]);
                         }
-                }
 
-                if (lock->fl_type == F_UNLCK) {
-                        continue;
-                }
-
-                if ((conf->fl_type == F_RDLCK) && (lock->fl_type == F_RDLCK)) {
-                        __insert_lock (pl_inode, lock);
                         return;
                 }
         }
@@ -842,18 +869,28 @@ __grant_blocked_locks (xlator_t *this, pl_inode_t *pl_inode, struct list_head *g
         posix_lock_t     *l = NULL;
         posix_lock_t     *tmp = NULL;
         posix_lock_t     *conf = NULL;
+        off_t             start = 0;
+        off_t             end = 0;
 
         INIT_LIST_HEAD (&tmp_list);
 
-        list_for_each_entry_safe (l, tmp, &pl_inode->ext_list, list) {
-                if (l->blocked) {
-                        conf = first_overlap (pl_inode, l);
-                        if (conf)
-                                continue;
+        /* only the locks waiting on a range given up since the last
+           pass can have become grantable */
+        if (!pl_range_take_released (&pl_inode->ext_granted, &start, &end))
+                return;
 
-                        l->blocked = 0;
-                        list_move_tail (&l->list, &tmp_list);
-                }
+        pl_range_for_each_overlap (l, &pl_inode->ext_blocked, start, end,
+                                   range) {
+                conf = first_overlap (pl_inode, l);
+                if (conf)
+                        continue;
+
+                list_move_tail (&l->list, &tmp_list);
+        }
+
+        list_for_each_entry (l, &tmp_list, list) {
+                pl_range_remove (&pl_inode->ext_blocked, &l->range);
+                l->blocked = 0;
         }
 
         list_for_each_entry_safe (l, tmp, &tmp_list, list) {
@@ -866,6 +903,9 @@ __grant_blocked_locks (xlator_t *this, pl_inode_t *pl_inode, struct list_head *g
                         if (!conf) {
                                 l->blocked = 1;
                                 __insert_lock (pl_inode, l);
+                                /* retry on the next pass */
+                                pl_range_release (&pl_inode->ext_granted,
+                                                  l->fl_start, l->fl_end);
                                 continue;
                         }
 
@@ -34,11 +34,30 @@
 #include "common.h"
 
 void
-__delete_inode_lock (pl_inode_lock_t *lock)
+__delete_inode_lock (pl_dom_list_t *dom, pl_inode_lock_t *lock)
 {
+        pl_range_remove (&dom->inodelk_tree, &lock->range);
+        pl_range_release (&dom->inodelk_tree, lock->fl_start, lock->fl_end);
+
 	list_del (&lock->list);
 }
 
+/* Queue a lock on the blocked inodelks of the domain */
+static void
+__block_inode_lock (pl_dom_list_t *dom, pl_inode_lock_t *lock)
+{
+        list_add_tail (&lock->blocked_locks, &dom->blocked_inodelks);
+        pl_range_insert (&dom->blocked_tree, &lock->range, lock->fl_start,
+                         lock->fl_end);
+}
+
+static void
+__unblock_inode_lock (pl_dom_list_t *dom, pl_inode_lock_t *lock)
+{
+        pl_range_remove (&dom->blocked_tree, &lock->range);
+        list_del_init (&lock->blocked_locks);
+}
+
 void
 __destroy_inode_lock (pl_inode_lock_t *lock)
 {
@@ -111,14 +130,6 @@ pl_print_inodelk (char *str, int size, int cmd, struct gf_flock *flock, const ch
                   (unsigned long long) flock->l_pid);
 }
 
-/* Determine if the two inodelks overlap reach other's lock regions */
-static int
-inodelk_overlap (pl_inode_lock_t *l1, pl_inode_lock_t *l2)
-{
-	return ((l1->fl_end >= l2->fl_start) &&
-		(l2->fl_end >= l1->fl_start));
-}
-
 /* Returns true if the 2 inodelks have the same owner */
 static int same_inodelk_owner (pl_inode_lock_t *l1, pl_inode_lock_t *l2)
 {
@@ -126,14 +137,6 @@ static int same_inodelk_owner (pl_inode_lock_t *l1, pl_inode_lock_t *l2)
                 (l1->transport  == l2->transport));
 }
 
-/* Returns true if the 2 inodelks conflict with each other */
-static int
-inodelk_conflict (pl_inode_lock_t *l1, pl_inode_lock_t *l2)
-{
-        return (inodelk_overlap (l1, l2) &&
-                inodelk_type_conflict (l1, l2));
-}
-
 /* Determine if lock is grantable or not */
 static pl_inode_lock_t *
 __inodelk_grantable (pl_dom_list_t *dom, pl_inode_lock_t *lock)
@@ -142,8 +145,9 @@ __inodelk_grantable (pl_dom_list_t *dom, pl_inode_lock_t *lock)
 	pl_inode_lock_t *ret = NULL;
 	if (list_empty (&dom->inodelk_list))
 		goto out;
-	list_for_each_entry (l, &dom->inodelk_list, list){
-		if (inodelk_conflict (lock, l)) {
+	pl_range_for_each_overlap (l, &dom->inodelk_tree, lock->fl_start,
+                                   lock->fl_end, range) {
+		if (inodelk_type_conflict (lock, l)) {
 			ret = l;
 			goto out;
 		}
@@ -161,8 +165,9 @@ __blocked_lock_conflict (pl_dom_list_t *dom, pl_inode_lock_t *lock)
 	if (list_empty (&dom->blocked_entrylks))
 		return NULL;
 
-	list_for_each_entry (l, &dom->blocked_inodelks, blocked_locks) {
-		if (inodelk_conflict (lock, l)) {
+	pl_range_for_each_overlap (l, &dom->blocked_tree, lock->fl_start,
+                                   lock->fl_end, range) {
+		if (inodelk_type_conflict (lock, l)) {
 			ret = l;
 			goto out;
                 }
@@ -207,7 +212,7 @@ __lock_inodelk (xlator_t *this, pl_inode_t *pl_inode, pl_inode_lock_t *lock,
 		if (can_block == 0)
 			goto out;
 
-		list_add_tail (&lock->blocked_locks, &dom->blocked_inodelks);
+		__block_inode_lock (dom, lock);
 
                 gf_log (this->name, GF_LOG_TRACE,
                         "%s (pid=%d) lk-owner:%"PRIu64" %"PRId64" - %"PRId64" => Blocked",
@@ -226,7 +231,7 @@ __lock_inodelk (xlator_t *this, pl_inode_t *pl_inode, pl_inode_lock_t *lock,
                 if (can_block == 0)
                         goto out;
 
-                list_add_tail (&lock->blocked_locks, &dom->blocked_inodelks);
+                __block_inode_lock (dom, lock);
 
                 gf_log (this->name, GF_LOG_TRACE,
                         "Lock is grantable, but blocking to prevent starvation");
@@ -242,6 +247,8 @@ __lock_inodelk (xlator_t *this, pl_inode_t *pl_inode, pl_inode_lock_t *lock,
 		goto out;
         }
 	list_add (&lock->list, &dom->inodelk_list);
+        pl_range_insert (&dom->inodelk_tree, &lock->range, lock->fl_start,
+                         lock->fl_end);
 
 	ret = 0;
 
@@ -265,7 +272,8 @@ static pl_inode_lock_t *
 find_matching_inodelk (pl_inode_lock_t *lock, pl_dom_list_t *dom)
 {
 	pl_inode_lock_t *l = NULL;
-	list_for_each_entry (l, &dom->inodelk_list, list) {
+	pl_range_for_each_overlap (l, &dom->inodelk_tree, lock->fl_start,
+                                   lock->fl_end, range) {
 		if (inodelks_equal (l, lock) &&
                     same_inodelk_owner (l, lock))
 			return l;
@@ -288,7 +296,7 @@ __inode_unlock_lock (xlator_t *this, pl_inode_lock_t *lock, pl_dom_list_t *dom)
                         " Matching lock not found for unlock");
 		goto out;
         }
-	__delete_inode_lock (conf);
+	__delete_inode_lock (dom, conf);
         gf_log (this->name, GF_LOG_DEBUG,
                 " Matching lock found for unlock");
         __destroy_inode_lock (lock);
@@ -306,11 +314,27 @@ __grant_blocked_inode_locks (xlator_t *this, pl_inode_t *pl_inode,
 	int	      bl_ret = 0;
 	pl_inode_lock_t *bl = NULL;
 	pl_inode_lock_t *tmp = NULL;
+        off_t            start = 0;
+        off_t            end = 0;
 
         struct list_head blocked_list;
 
         INIT_LIST_HEAD (&blocked_list);
-        list_splice_init (&dom->blocked_inodelks, &blocked_list);
+
+        /* waiters not overlapping anything unlocked since the last
+           pass stay queued */
+        if (!pl_range_take_released (&dom->inodelk_tree, &start, &end))
+                return;
+
+        pl_range_for_each_overlap (bl, &dom->blocked_tree, start, end, range) {
+                list_move_tail (&bl->blocked_locks, &blocked_list);
+        }
+
+        /* all of them leave the blocked tree before any is retried, or the
+           starvation check would see waiters of this very pass */
+        list_for_each_entry (bl, &blocked_list, blocked_locks) {
+                pl_range_remove (&dom->blocked_tree, &bl->range);
+        }
 
 	list_for_each_entry_safe (bl, tmp, &blocked_list, blocked_locks) {
 
@@ -390,7 +414,10 @@ release_inode_locks_of_transport (xlator_t *this, pl_dom_list_t *dom,
                         if (l->transport != trans)
                                 continue;
 
-                        list_del_init (&l->blocked_locks);
+                        __unblock_inode_lock (dom, l);
+                        /* locks queued behind it may go ahead now */
+                        pl_range_release (&dom->inodelk_tree, l->fl_start,
+                                          l->fl_end);
 
                         if (inode_path (inode, NULL, &path) < 0) {
                                 gf_log (this->name, GF_LOG_TRACE,
@@ -413,7 +440,7 @@ release_inode_locks_of_transport (xlator_t *this, pl_dom_list_t *dom,
                         if (l->transport != trans)
                                 continue;
 
-                        __delete_inode_lock (l);
+                        __delete_inode_lock (dom, l);
 			__destroy_inode_lock (l);
 
 
@@ -29,11 +29,13 @@
 #include "stack.h"
 #include "call-stub.h"
 #include "locks-mem-types.h"
+#include "range-tree.h"
 
 struct __pl_fd;
 
 struct __posix_lock {
         struct list_head   list;
+        struct pl_range_node range;  /* in ext_granted or ext_blocked */
 
         short              fl_type;
         off_t              fl_start;
@@ -59,6 +61,7 @@ typedef struct __posix_lock posix_lock_t;
 struct __pl_inode_lock {
         struct list_head   list;
         struct list_head   blocked_locks; /* list_head pointing to blocked_inodelks */
+        struct pl_range_node range;       /* in inodelk_tree or blocked_tree */
 
         short              fl_type;
         off_t              fl_start;
@@ -95,6 +98,8 @@ struct __pl_dom_list_t {
         struct list_head   blocked_entrylks; /* List of all blocked entrylks */
         struct list_head   inodelk_list;     /* List of inode locks */
         struct list_head   blocked_inodelks; /* List of all blocked inodelks */
+        struct pl_range_tree inodelk_tree;   /* inodelk_list by range */
+        struct pl_range_tree blocked_tree;   /* blocked_inodelks by range */
 };
 typedef struct __pl_dom_list_t pl_dom_list_t;
 
@@ -125,6 +130,8 @@ struct __pl_inode {
 
         struct list_head dom_list;       /* list of domains */
         struct list_head ext_list;       /* list of fcntl locks */
+        struct pl_range_tree ext_granted; /* granted fcntl locks by range */
+        struct pl_range_tree ext_blocked; /* blocked fcntl locks by range */
         struct list_head rw_list;        /* list of waiting r/w requests */
         struct list_head reservelk_list;        /* list of reservelks */
         struct list_head blocked_reservelks;        /* list of blocked reservelks */
@@ -185,10 +185,10 @@ truncate_allowed (pl_inode_t *pl_inode,
 
         pthread_mutex_lock (&pl_inode->mutex);
         {
-                list_for_each_entry (l, &pl_inode->ext_list, list) {
-                        if (!l->blocked
-                            && locks_overlap (&region, l)
-                            && !same_owner (&region, l)) {
+                pl_range_for_each_overlap (l, &pl_inode->ext_granted,
+                                           region.fl_start, region.fl_end,
+                                           range) {
+                        if (!same_owner (&region, l)) {
                                 ret = 0;
                                 break;
                         }
@@ -346,7 +346,8 @@ delete_locks_of_fd (xlator_t *this, pl_inode_t *pl_inode, fd_t *fd)
                list_for_each_entry_safe (l, tmp, &pl_inode->ext_list, list) {
                        if ((l->fd_num == fd_to_fdnum(fd))) {
                                if (l->blocked) {
-                                       list_move_tail (&l->list, &blocked_list);
+                                       __delete_lock (pl_inode, l);
+                                       list_add_tail (&l->list, &blocked_list);
                                        continue;
                                }
                                __delete_lock (pl_inode, l);
@@ -633,14 +634,15 @@ do_blocked_rw (pl_inode_t *pl_inode)
 
 
 static int
-__rw_allowable (pl_inode_t *pl_inode, posix_lock_t *region,
-                glusterfs_fop_t op)
+__rw_allowable_in (struct pl_range_tree *tree, posix_lock_t *region,
+                   glusterfs_fop_t op)
 {
         posix_lock_t *l = NULL;
         int           ret = 1;
 
-        list_for_each_entry (l, &pl_inode->ext_list, list) {
-                if (locks_overlap (l, region) && !same_owner (l, region)) {
+        pl_range_for_each_overlap (l, tree, region->fl_start, region->fl_end,
+                                   range) {
+                if (!same_owner (l, region)) {
                         if ((op == GF_FOP_READ) && (l->fl_type != F_WRLCK))
                                 continue;
                         ret = 0;
@@ -652,6 +654,16 @@ __rw_allowable (pl_inode_t *pl_inode, posix_lock_t *region,
 }
 
 
+/* blocked locks are honoured too */
+static int
+__rw_allowable (pl_inode_t *pl_inode, posix_lock_t *region,
+                glusterfs_fop_t op)
+{
+        return (__rw_allowable_in (&pl_inode->ext_granted, region, op)
+                && __rw_allowable_in (&pl_inode->ext_blocked, region, op));
+}
+
+
 int
 pl_readv_cont (call_frame_t *frame, xlator_t *this,
                fd_t *fd, size_t size, off_t offset)
@@ -1261,7 +1273,7 @@ pl_forget (xlator_t *this,
 					"Pending inode locks found, releasing.");
 
 				list_for_each_entry_safe (ino_l, ino_tmp, &dom->inodelk_list, list) {
-					__delete_inode_lock (ino_l);
+					__delete_inode_lock (dom, ino_l);
 					__destroy_inode_lock (ino_l);
 				}
 
@@ -0,0 +1,336 @@
+/*
+  Copyright (c) 2006, 2007, 2008 Gluster, Inc. <http://www.gluster.com>
+  This file is part of GlusterFS.
+
+  GlusterFS is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Affero General Public License as published
+  by the Free Software Foundation; either version 3 of the License,
+  or (at your option) any later version.
+
+  GlusterFS is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Affero General Public License for more details.
+
+  You should have received a copy of the GNU Affero General Public License
+  along with this program.  If not, see
+  <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include <limits.h>
+#include <stddef.h>
+
+#include "range-tree.h"
+
+#ifndef LLONG_MAX
+#define LLONG_MAX LONG_LONG_MAX /* compat with old gcc */
+#endif /* LLONG_MAX */
+
+/* The tree is an AVL tree with parent pointers. Rebalancing always
+   walks up to the root, which also refreshes the max_end of every
+   ancestor of the node that changed.
+*/
+
+static int
+range_height (struct pl_range_node *node)
+{
+        return node ? node->height : 0;
+}
+
+
+static void
+range_update (struct pl_range_node *node)
+{
+        int   lh = range_height (node->left);
+        int   rh = range_height (node->right);
+        off_t max_end = node->end;
+
+        if (node->left && node->left->max_end > max_end)
+                max_end = node->left->max_end;
+        if (node->right && node->right->max_end > max_end)
+                max_end = node->right->max_end;
+
+        node->height  = 1 + ((lh > rh) ? lh : rh);
+        node->max_end = max_end;
+}
+
+
+/* put @new where @old hangs off its parent */
+static void
+range_replace_child (struct pl_range_tree *tree, struct pl_range_node *old,
+                     struct pl_range_node *new)
+{
+        if (!old->parent)
+                tree->root = new;
+        else if (old->parent->left == old)
+                old->parent->left = new;
+        else
+                old->parent->right = new;
+
+        if (new)
+                new->parent = old->parent;
+}
+
+
+static struct pl_range_node *
+range_rotate_left (struct pl_range_tree *tree, struct pl_range_node *node)
+{
+        struct pl_range_node *pivot = node->right;
+
+        node->right = pivot->left;
+        if (pivot->left)
+                pivot->left->parent = node;
+
+        range_replace_child (tree, node, pivot);
+
+        pivot->left  = node;
+        node->parent = pivot;
+
+        range_update (node);
+        range_update (pivot);
+
+        return pivot;
+}
+
+
+static struct pl_range_node *
+range_rotate_right (struct pl_range_tree *tree, struct pl_range_node *node)
+{
+        struct pl_range_node *pivot = node->left;
+
+        node->left = pivot->right;
+        if (pivot->right)
+                pivot->right->parent = node;
+
+        range_replace_child (tree, node, pivot);
+
+        pivot->right = node;
+        node->parent = pivot;
+
+        range_update (node);
+        range_update (pivot);
+
+        return pivot;
+}
+
+
+static void
+range_rebalance (struct pl_range_tree *tree, struct pl_range_node *node)
+{
+        int balance = 0;
+
+        while (node) {
+                range_update (node);
+
+                balance = range_height (node->left) - range_height (node->right);
+
+                if (balance > 1) {
+                        if (range_height (node->left->left)
+                            < range_height (node->left->right))
+                                range_rotate_left (tree, node->left);
+                        node = range_rotate_right (tree, node);
+                } else if (balance < -1) {
+                        if (range_height (node->right->right)
+                            < range_height (node->right->left))
+                                range_rotate_right (tree, node->right);
+                        node = range_rotate_left (tree, node);
+                }
+
+                node = node->parent;
+        }
+}
+
+
+void
+pl_range_tree_init (struct pl_range_tree *tree)
+{
+        tree->root  = NULL;
+        tree->count = 0;
+
+        tree->released_start = LLONG_MAX;
+        tree->released_end   = -1;
+}
+
+
+int
+pl_range_linked (struct pl_range_node *node)
+{
+        return (node->height != 0);
+}
+
+
+void
+pl_range_insert (struct pl_range_tree *tree, struct pl_range_node *node,
+                 off_t start, off_t end)
+{
+        struct pl_range_node *parent = NULL;
+        struct pl_range_node *cur    = NULL;
+
+        node->start   = start;
+        node->end     = end;
+        node->max_end = end;
+        node->height  = 1;
+        node->left    = NULL;
+        node->right   = NULL;
+
+        cur = tree->root;
+        while (cur) {
+                parent = cur;
+                if (start < cur->start)
+                        cur = cur->left;
+                else
+                        cur = cur->right;
+        }
+
+        node->parent = parent;
+        if (!parent)
+                tree->root = node;
+        else if (start < parent->start)
+                parent->left = node;
+        else
+                parent->right = node;
+
+        tree->count++;
+
+        range_rebalance (tree, parent);
+}
+
+
+void
+pl_range_remove (struct pl_range_tree *tree, struct pl_range_node *node)
+{
+        struct pl_range_node *succ = NULL;
+        struct pl_range_node *fix  = NULL;
+
+        if (!pl_range_linked (node))
+                return;
+
+        if (!node->left) {
+                fix = node->parent;
+                range_replace_child (tree, node, node->right);
+        } else if (!node->right) {
+                fix = node->parent;
+                range_replace_child (tree, node, node->left);
+        } else {
+                succ = node->right;
+                while (succ->left)
+                        succ = succ->left;
+
+                if (succ->parent != node) {
+                        fix = succ->parent;
+                        range_replace_child (tree, succ, succ->right);
+
+                        succ->right = node->right;
+                        succ->right->parent = succ;
+                } else {
+                        fix = succ;
+                }
+
+                range_replace_child (tree, node, succ);
+                succ->left = node->left;
+                succ->left->parent = succ;
+        }
+
+        node->parent = node->left = node->right = NULL;
+        node->height = 0;
+
+        tree->count--;
+
+        range_rebalance (tree, fix);
+}
+
+
+/* leftmost node of the subtree at @node overlapping [start, end] */
+static struct pl_range_node *
+range_first_in (struct pl_range_node *node, off_t start, off_t end)
+{
+        while (node) {
+                /* if anything on the left reaches @start, either it
+                   overlaps, or everything from here on starts past @end */
+                if (node->left && node->left->max_end >= start) {
+                        node = node->left;
+                        continue;
+                }
+
+                if (node->start > end)
+                        return NULL;
+
+                if (node->end >= start)
+                        return node;
+
+                node = node->right;
+        }
+
+        return NULL;
+}
+
+
+struct pl_range_node *
+pl_range_first (struct pl_range_tree *tree, off_t start, off_t end)
+{
+        return range_first_in (tree->root, start, end);
+}
+
+
+struct pl_range_node *
+pl_range_next (struct pl_range_node *node, off_t start, off_t end)
+{
+        struct pl_range_node *found  = NULL;
+        struct pl_range_node *parent = NULL;
+
+        found = range_first_in (node->right, start, end);
+        if (found)
+                return found;
+
+        while ((parent = node->parent)) {
+                if (parent->left == node) {
+                        if (parent->start > end)
+                                return NULL;
+
+                        if (parent->end >= start)
+                                return parent;
+
+                        found = range_first_in (parent->right, start, end);
+                        if (found)
+                                return found;
+                }
+                node = parent;
+        }
+
+        return NULL;
+}
+
+
+/* Remember that [start, end] was given up, waiters on it may now
+   proceed. */
+void
+pl_range_release (struct pl_range_tree *tree, off_t start, off_t end)
+{
+        if (start < tree->released_start)
+                tree->released_start = start;
+        if (end > tree->released_end)
+                tree->released_end = end;
+}
+
+
+/* Fetch and reset the released hull, returns 0 if nothing was
+   released since the last call. */
+int
+pl_range_take_released (struct pl_range_tree *tree, off_t *start, off_t *end)
+{
+        if (tree->released_start > tree->released_end)
+                return 0;
+
+        *start = tree->released_start;
+        *end   = tree->released_end;
+
+        tree->released_start = LLONG_MAX;
+        tree->released_end   = -1;
+
+        return 1;
+}
@@ -0,0 +1,103 @@
+/*
+  Copyright (c) 2006, 2007, 2008 Gluster, Inc. <http://www.gluster.com>
+  This file is part of GlusterFS.
+
+  GlusterFS is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Affero General Public License as published
+  by the Free Software Foundation; either version 3 of the License,
+  or (at your option) any later version.
+
+  GlusterFS is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Affero General Public License for more details.
+
+  You should have received a copy of the GNU Affero General Public License
+  along with this program.  If not, see
+  <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __PL_RANGE_TREE_H__
+#define __PL_RANGE_TREE_H__
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/types.h>
+#include <stdint.h>
+
+/* An interval tree of byte ranges. The nodes are embedded in the lock
+   structures, ordered on the start offset and augmented with the
+   largest end offset found in their subtree, so that every range
+   overlapping a query can be found without looking at the others.
+   Ranges with the same start are kept in insertion order. Callers
+   provide the locking.
+*/
+
+struct pl_range_node {
+        struct pl_range_node *parent;
+        struct pl_range_node *left;
+        struct pl_range_node *right;
+
+        off_t                 start;
+        off_t                 end;      /* inclusive */
+        off_t                 max_end;  /* largest end in this subtree */
+        int                   height;   /* 0 while not in a tree */
+};
+
+struct pl_range_tree {
+        struct pl_range_node *root;
+        uint64_t              count;
+
+        /* hull of the ranges released since the waiters were last
+           looked at, empty when start > end */
+        off_t                 released_start;
+        off_t                 released_end;
+};
+
+void
+pl_range_tree_init (struct pl_range_tree *tree);
+
+void
+pl_range_insert (struct pl_range_tree *tree, struct pl_range_node *node,
+                 off_t start, off_t end);
+
+void
+pl_range_remove (struct pl_range_tree *tree, struct pl_range_node *node);
+
+int
+pl_range_linked (struct pl_range_node *node);
+
+struct pl_range_node *
+pl_range_first (struct pl_range_tree *tree, off_t start, off_t end);
+
+struct pl_range_node *
+pl_range_next (struct pl_range_node *node, off_t start, off_t end);
+
+void
+pl_range_release (struct pl_range_tree *tree, off_t start, off_t end);
+
+int
+pl_range_take_released (struct pl_range_tree *tree, off_t *start, off_t *end);
+
+#define pl_range_entry(ptr, type, member)                               \
+        ((type *)((char *)(ptr)-(unsigned long)(&((type *)0)->member)))
+
+/* iterate over the entries of @tree overlapping [@start, @end], in
+   order of their start offset. The tree must not change while
+   iterating. */
+#define pl_range_for_each_overlap(pos, tree, start, end, member)        \
+        for (pos = pl_range_entry_or_null (pl_range_first (tree, start, end), \
+                                           typeof (*pos), member);      \
+             pos;                                                       \
+             pos = pl_range_entry_or_null (pl_range_next (&pos->member, \
+                                                          start, end),  \
+                                           typeof (*pos), member))
+
+#define pl_range_entry_or_null(ptr, type, member)                       \
+        ({ struct pl_range_node *__n = (ptr);                           \
+           __n ? pl_range_entry (__n, type, member) : NULL; })
+
+#endif /* __PL_RANGE_TREE_H__ */
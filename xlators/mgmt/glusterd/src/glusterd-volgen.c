@@ -98,6 +98,9 @@ static struct volopt_map_entry glusterd_volopt_map[] = {
         {"cluster.data-change-log",              "cluster/replicate",         }, /* NODOC */
         {"cluster.metadata-change-log",          "cluster/replicate",         }, /* NODOC */
         {"cluster.data-self-heal-algorithm",     "cluster/replicate",         "data-self-heal-algorithm"},
+        {"cluster.eager-lock",                   "cluster/replicate",         },
+        {"cluster.post-op-delay-secs",           "cluster/replicate",         },
+        {"cluster.data-self-heal-checksum",      "storage/posix",             "rchecksum-strong-hash"},
 
         {"cluster.stripe-block-size",            "cluster/stripe",            "block-size",},
 
@@ -123,12 +126,14 @@ static struct volopt_map_entry glusterd_volopt_map[] = {
 
         {"network.frame-timeout",                "protocol/client",           },
         {"network.ping-timeout",                 "protocol/client",           },
+        {"network.transport-count",              "protocol/client",           },
         {"network.inode-lru-limit",              "protocol/server",           }, /* NODOC */
 
         {"auth.allow",                           "protocol/server",           "!server-auth", "*"},
         {"auth.reject",                          "protocol/server",           "!server-auth",},
 
         {"transport.keepalive",                   "protocol/server",           "transport.socket.keepalive",},
+        {"transport.batch-writes",                "protocol/server",           "transport.socket.batch-writes",},
 
         {"performance.write-behind",             "performance/write-behind",  "!perf", "on"}, /* NODOC */
         {"performance.read-ahead",               "performance/read-ahead",    "!perf", "on"}, /* NODOC */
@@ -31,6 +31,154 @@ static int gf_fuse_conn_err_log;
 static int gf_fuse_xattr_enotsup_log;
 
 
+/* the device fd the request was read from, see struct fuse_reader */
+static inline int
+fuse_reply_fd (fuse_private_t *priv, fuse_in_header_t *finh)
+{
+        if (priv->readers && (finh->padding < priv->reader_thread_count))
+                return priv->readers[finh->padding].fd;
+
+        return priv->fd;
+}
+
+static void
+fuse_close_devices (fuse_private_t *priv)
+{
+        int i = 0;
+
+        for (i = 0; priv->readers && (i < priv->reader_thread_count); i++) {
+                if (priv->readers[i].fd != priv->fd)
+                        close (priv->readers[i].fd);
+        }
+
+        close (priv->fd);
+}
+
+#ifdef GF_LINUX_HOST_OS
+/*
+ * Replies can be handed to the device by vmsplice()-ing the header and the
+ * iobuf pages into a pipe and splice()-ing the pipe into /dev/fuse, so the
+ * payload is never touched by us on the way out. Replies are sent from
+ * whichever thread unwinds the fop, each such thread keeps a pipe of its
+ * own.
+ */
+struct fuse_splice_pipe {
+        int     fd[2];
+        size_t  slots;   /* number of page sized pipe buffers */
+};
+
+static void
+fuse_splice_pipe_destroy (void *data)
+{
+        struct fuse_splice_pipe *sp = data;
+
+        if (!sp)
+                return;
+
+        close (sp->fd[0]);
+        close (sp->fd[1]);
+        GF_FREE (sp);
+}
+
+static struct fuse_splice_pipe *
+fuse_splice_pipe_get (fuse_private_t *priv)
+{
+        struct fuse_splice_pipe *sp = NULL;
+        int                      size = 0;
+
+        sp = pthread_getspecific (priv->splice_key);
+        if (sp)
+                return sp;
+
+        sp = GF_CALLOC (1, sizeof (*sp), gf_fuse_mt_splice_pipe_t);
+        if (!sp)
+                return NULL;
+
+        if (pipe (sp->fd) == -1) {
+                gf_log ("glusterfs-fuse", GF_LOG_DEBUG,
+                        "failed to create splice pipe: %s", strerror (errno));
+                GF_FREE (sp);
+                return NULL;
+        }
+
+        /* room for the largest read reply, header included */
+        size = 16 * getpagesize ();
+#ifdef F_SETPIPE_SZ
+        fcntl (sp->fd[1], F_SETPIPE_SZ, (1 << 17) + getpagesize ());
+        size = fcntl (sp->fd[1], F_GETPIPE_SZ);
+        if (size <= 0)
+                size = 16 * getpagesize ();
+#endif
+        sp->slots = size / getpagesize ();
+
+        pthread_setspecific (priv->splice_key, sp);
+
+        return sp;
+}
+
+static void
+fuse_splice_pipe_drop (fuse_private_t *priv, struct fuse_splice_pipe *sp)
+{
+        /* whatever is left in the pipe is garbage now */
+        pthread_setspecific (priv->splice_key, NULL);
+        fuse_splice_pipe_destroy (sp);
+}
+
+/* returns the number of bytes handed to the device, or -1 if the caller
+   has to fall back to writev() */
+static int
+fuse_splice_iov (fuse_private_t *priv, int fd, struct iovec *iov_out,
+                 int count, size_t len)
+{
+        struct fuse_splice_pipe *sp = NULL;
+        size_t                   slots = 0;
+        unsigned long            pagesize = 0;
+        unsigned long            start = 0;
+        unsigned long            end = 0;
+        ssize_t                  res = -1;
+        int                      i = 0;
+
+        if (count > IOV_MAX)
+                return -1;
+
+        sp = fuse_splice_pipe_get (priv);
+        if (!sp)
+                return -1;
+
+        /* every page an iovec touches takes a pipe buffer, make sure
+           vmsplice() will not stop half way */
+        pagesize = getpagesize ();
+        for (i = 0; i < count; i++) {
+                if (!iov_out[i].iov_len)
+                        continue;
+                start = (unsigned long) iov_out[i].iov_base / pagesize;
+                end = ((unsigned long) iov_out[i].iov_base +
+                       iov_out[i].iov_len - 1) / pagesize;
+                slots += end - start + 1;
+        }
+        if (slots > sp->slots)
+                return -1;
+
+        res = vmsplice (sp->fd[1], iov_out, count, SPLICE_F_NONBLOCK);
+        if (res != len)
+                goto err;
+
+        res = splice (sp->fd[0], NULL, fd, NULL, len, SPLICE_F_NONBLOCK);
+        if (res != len)
+                goto err;
+
+        return res;
+
+err:
+        gf_log ("glusterfs-fuse", GF_LOG_DEBUG,
+                "splicing reply failed (%zd/%zu): %s", res, len,
+                (res == -1) ? strerror (errno) : "short transfer");
+        fuse_splice_pipe_drop (priv, sp);
+
+        return -1;
+}
+#endif /* GF_LINUX_HOST_OS */
+
 /*
  * iov_out should contain a fuse_out_header at zeroth position.
  * The error value of this header is sent to kernel.
@@ -41,6 +189,7 @@ send_fuse_iov (xlator_t *this, fuse_in_header_t *finh, struct iovec *iov_out,
 {
         fuse_private_t *priv = NULL;
         struct fuse_out_header *fouh = NULL;
+        int fd = -1;
         int res, i;
 
         if (!this || !finh || !iov_out) {
@@ -56,10 +205,18 @@ send_fuse_iov (xlator_t *this, fuse_in_header_t *finh, struct iovec *iov_out,
                 fouh->len += iov_out[i].iov_len;
         fouh->unique = finh->unique;
 
-        res = writev (priv->fd, iov_out, count);
-
-        if (res == -1)
-                return errno;
+        fd = fuse_reply_fd (priv, finh);
+        res = -1;
+#ifdef GF_LINUX_HOST_OS
+        if (priv->splice_write &&
+            (fouh->len - sizeof (*fouh) >= FUSE_SPLICE_MIN_PAYLOAD))
+                res = fuse_splice_iov (priv, fd, iov_out, count, fouh->len);
+#endif
+        if (res == -1) {
+                res = writev (fd, iov_out, count);
+                if (res == -1)
+                        return errno;
+        }
         if (res != fouh->len)
                 return EINVAL;
 
@@ -311,6 +468,37 @@ fuse_forget (xlator_t *this, fuse_in_header_t *finh, void *msg)
 }
 
 
+#if FUSE_KERNEL_MINOR_VERSION >= 16
+static void
+fuse_batch_forget (xlator_t *this, fuse_in_header_t *finh, void *msg)
+{
+        struct fuse_batch_forget_in *fbfi = msg;
+        struct fuse_forget_one      *ffo = NULL;
+
+        inode_t      *fuse_inode = NULL;
+        uint32_t      i = 0;
+
+        ffo = (struct fuse_forget_one *) (fbfi + 1);
+
+        gf_log ("glusterfs-fuse", GF_LOG_TRACE,
+                "%"PRIu64": BATCH_FORGET %"PRIu32" inodes", finh->unique,
+                fbfi->count);
+
+        for (i = 0; i < fbfi->count; i++) {
+                if (ffo[i].nodeid == 1)
+                        continue;
+
+                fuse_inode = fuse_ino_to_inode (ffo[i].nodeid, this);
+
+                inode_forget (fuse_inode, ffo[i].nlookup);
+                inode_unref (fuse_inode);
+        }
+
+        GF_FREE (finh);
+}
+#endif
+
+
 static int
 fuse_truncate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                    int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
@@ -1849,7 +2037,7 @@ fuse_write_resume (fuse_state_t *state)
                 return;
         }
 
-        iobuf = ((fuse_private_t *) (state->this->private))->iobuf;
+        iobuf = state->iobuf;
         iobref_add (iobref, iobuf);
 
         FUSE_FOP (state, fuse_writev_cbk, GF_FOP_WRITE, writev, state->fd,
@@ -1893,6 +2081,10 @@ fuse_write (xlator_t *this, fuse_in_header_t *finh, void *msg)
         state->vector.iov_base = msg;
         state->vector.iov_len  = fwi->size;
 
+        /* msg lives in the iobuf the reader thread read into, keep it
+           around until the write is resumed */
+        state->iobuf = iobuf_ref (pthread_getspecific (priv->iobuf_key));
+
         fuse_resolve_and_resume (state, fuse_write_resume);
 
         return;
@@ -2156,6 +2348,159 @@ fuse_readdir (xlator_t *this, fuse_in_header_t *finh, void *msg)
 }
 
 
+#if FUSE_KERNEL_MINOR_VERSION >= 21
+/*
+ * READDIRPLUS: entries whose inode is already known to the table go back
+ * with their attributes and a node id, which saves the kernel a LOOKUP
+ * per entry. Every node id handed out counts as a lookup, just like in
+ * fuse_entry_cbk. Everything else (entries never looked up, entries
+ * without a gfid, "." and "..") goes out with node id 0 which the kernel
+ * takes as a plain dirent and looks up on first use.
+ */
+static int
+fuse_readdirp_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                   int32_t op_ret, int32_t op_errno, gf_dirent_t *entries)
+{
+        fuse_state_t           *state = NULL;
+        fuse_in_header_t       *finh = NULL;
+        fuse_private_t         *priv = NULL;
+        size_t                  size = 0;
+        size_t                  entry_size = 0;
+        int                     count = 0;
+        char                   *buf = NULL;
+        gf_dirent_t            *entry = NULL;
+        struct fuse_direntplus *fde = NULL;
+        struct fuse_entry_out  *feo = NULL;
+        inode_t                *inode = NULL;
+
+        state = frame->root->state;
+        finh  = state->finh;
+        priv  = this->private;
+
+        if (op_ret < 0) {
+                gf_log ("glusterfs-fuse", GF_LOG_WARNING,
+                        "%"PRIu64": READDIRP => -1 (%s)", frame->root->unique,
+                        strerror (op_errno));
+
+                send_fuse_err (this, finh, op_errno);
+                goto out;
+        }
+
+        gf_log ("glusterfs-fuse", GF_LOG_TRACE,
+                "%"PRIu64": READDIRP => %d/%"GF_PRI_SIZET",%"PRId64,
+                frame->root->unique, op_ret, state->size, state->off);
+
+        /* an entry which does not fit is not sent either, the kernel
+           will ask for it again starting at the last offset it got */
+        list_for_each_entry (entry, &entries->list, list) {
+                entry_size = FUSE_DIRENT_ALIGN (FUSE_NAME_OFFSET_DIRENTPLUS +
+                                                strlen (entry->d_name));
+                if (size + entry_size > state->size)
+                        break;
+                size += entry_size;
+                count++;
+        }
+
+        buf = GF_CALLOC (1, size, gf_fuse_mt_char);
+        if (!buf) {
+                gf_log ("glusterfs-fuse", GF_LOG_DEBUG,
+                        "%"PRIu64": READDIRP => -1 (%s)", frame->root->unique,
+                        strerror (ENOMEM));
+                send_fuse_err (this, finh, ENOMEM);
+                goto out;
+        }
+
+        size = 0;
+        list_for_each_entry (entry, &entries->list, list) {
+                if (count-- == 0)
+                        break;
+
+                fde = (struct fuse_direntplus *)(buf + size);
+                feo = &fde->entry_out;
+                fde->dirent.ino = entry->d_ino;
+                fde->dirent.off = entry->d_off;
+                fde->dirent.type = entry->d_type;
+                fde->dirent.namelen = strlen (entry->d_name);
+                strncpy (fde->dirent.name, entry->d_name, fde->dirent.namelen);
+                size += FUSE_DIRENTPLUS_SIZE (fde);
+
+                if ((strcmp (entry->d_name, ".") == 0) ||
+                    (strcmp (entry->d_name, "..") == 0))
+                        continue;
+
+                if (uuid_is_null (entry->d_stat.ia_gfid))
+                        continue;
+
+                fde->dirent.type = d_type_from_stat (&entry->d_stat);
+
+                /* only an inode which already went through a LOOKUP has
+                   its context set up in the graph below us, never link
+                   a new one here */
+                inode = inode_grep (state->fd->inode->table, state->fd->inode,
+                                    entry->d_name);
+                if (!inode)
+                        continue;
+
+                if (uuid_compare (inode->gfid, entry->d_stat.ia_gfid) != 0) {
+                        inode_unref (inode);
+                        continue;
+                }
+
+                inode_lookup (inode);
+                feo->nodeid = inode_to_fuse_nodeid (inode);
+                inode_unref (inode);
+
+                entry->d_stat.ia_blksize = this->ctx->page_size;
+                gf_fuse_stat2attr (&entry->d_stat, &feo->attr);
+
+                feo->entry_valid = calc_timeout_sec (priv->entry_timeout);
+                feo->entry_valid_nsec = calc_timeout_nsec (priv->entry_timeout);
+                feo->attr_valid = calc_timeout_sec (priv->attribute_timeout);
+                feo->attr_valid_nsec =
+                        calc_timeout_nsec (priv->attribute_timeout);
+        }
+
+        send_fuse_data (this, finh, buf, size);
+
+out:
+        free_fuse_state (state);
+        STACK_DESTROY (frame->root);
+        if (buf)
+                GF_FREE (buf);
+        return 0;
+
+}
+
+void
+fuse_readdirp_resume (fuse_state_t *state)
+{
+        gf_log ("glusterfs-fuse", GF_LOG_TRACE,
+                "%"PRIu64": READDIRP (%p, size=%zu, offset=%"PRId64")",
+                state->finh->unique, state->fd, state->size, state->off);
+
+        FUSE_FOP (state, fuse_readdirp_cbk, GF_FOP_READDIRP,
+                  readdirp, state->fd, state->size, state->off);
+}
+
+static void
+fuse_readdirp (xlator_t *this, fuse_in_header_t *finh, void *msg)
+{
+        struct fuse_read_in *fri = msg;
+
+        fuse_state_t *state = NULL;
+        fd_t         *fd = NULL;
+
+        GET_STATE (this, finh, state);
+        state->size = fri->size;
+        state->off = fri->offset;
+        fd = FH_TO_FD (fri->fh);
+        state->fd = fd;
+
+        fuse_resolve_and_resume (state, fuse_readdirp_resume);
+}
+#endif
+
+
 static void
 fuse_releasedir (xlator_t *this, fuse_in_header_t *finh, void *msg)
 {
@@ -2846,7 +3191,7 @@ fuse_init (xlator_t *this, fuse_in_header_t *finh, void *msg)
                 gf_log ("glusterfs-fuse", GF_LOG_ERROR,
                         "got INIT after first message");
 
-                close (priv->fd);
+                fuse_close_devices (priv);
                 goto out;
         }
 
@@ -2857,7 +3202,7 @@ fuse_init (xlator_t *this, fuse_in_header_t *finh, void *msg)
                         "unsupported FUSE protocol version %d.%d",
                         fini->major, fini->minor);
 
-                close (priv->fd);
+                fuse_close_devices (priv);
                 goto out;
         }
         priv->proto_minor = fini->minor;
@@ -2882,7 +3227,22 @@ fuse_init (xlator_t *this, fuse_in_header_t *finh, void *msg)
                 fino.congestion_threshold = 48;
         }
         if (fini->minor < 9)
-                *priv->msg0_len_p = sizeof(*finh) + FUSE_COMPAT_WRITE_IN_SIZE;
+                priv->msg0_len = sizeof(*finh) + FUSE_COMPAT_WRITE_IN_SIZE;
+#endif
+#if FUSE_KERNEL_MINOR_VERSION >= 14 && defined(GF_LINUX_HOST_OS)
+        /* splicing into the device is there since 7.14; it is not a
+           flag the kernel offers, so all we go by is the version */
+        if (fini->minor >= 14 && priv->splice)
+                priv->splice_write = _gf_true;
+#endif
+#if FUSE_KERNEL_MINOR_VERSION >= 21
+        if (fini->minor >= 21 && priv->use_readdirp &&
+            (fini->flags & FUSE_DO_READDIRPLUS)) {
+                fino.flags |= FUSE_DO_READDIRPLUS;
+                /* let the kernel pick READDIR for a plain ls */
+                if (fini->flags & FUSE_READDIRPLUS_AUTO)
+                        fino.flags |= FUSE_READDIRPLUS_AUTO;
+        }
 #endif
         ret = send_fuse_obj (this, finh, &fino);
         if (ret == 0)
@@ -2895,7 +3255,7 @@ fuse_init (xlator_t *this, fuse_in_header_t *finh, void *msg)
                 gf_log ("glusterfs-fuse", GF_LOG_ERROR,
                         "FUSE init failed (%s)", strerror (ret));
 
-                close (priv->fd);
+                fuse_close_devices (priv);
         }
 
  out:
@@ -3068,6 +3428,7 @@ fuse_thread_proc (void *data)
         char           *mount_point = NULL;
         xlator_t       *this = NULL;
         fuse_private_t *priv = NULL;
+        struct fuse_reader *reader = NULL;
         ssize_t         res = 0;
         struct iobuf   *iobuf = NULL;
         fuse_in_header_t *finh;
@@ -3076,24 +3437,27 @@ fuse_thread_proc (void *data)
         const size_t msg0_size = sizeof (*finh) + 128;
         fuse_handler_t **fuse_ops = NULL;
 
-        this = data;
+        reader = data;
+        this = reader->this;
         priv = this->private;
         fuse_ops = priv->fuse_ops;
 
         THIS = this;
 
-        iov_in[0].iov_len = sizeof (*finh) + sizeof (struct fuse_write_in);
         iov_in[1].iov_len = ((struct iobuf_pool *)this->ctx->iobuf_pool)
                               ->page_size;
-        priv->msg0_len_p = &iov_in[0].iov_len;
 
         for (;;) {
                 /* THIS has to be reset here */
                 THIS = this;
 
-                if (priv->init_recvd)
+                /* unlocked peek, fuse_graph_sync rechecks under the lock */
+                if (priv->init_recvd && priv->next_graph)
                         fuse_graph_sync (this);
 
+                /* FUSE_INIT may shrink it for old kernels */
+                iov_in[0].iov_len = priv->msg0_len;
+
                 iobuf = iobuf_get (this->ctx->iobuf_pool);
                 /* Add extra 128 byte to the first iov so that it can
                  * accomodate "ordinary" non-write requests. It's not
@@ -3117,7 +3481,7 @@ fuse_thread_proc (void *data)
 
                 iov_in[1].iov_base = iobuf->ptr;
 
-                res = readv (priv->fd, iov_in, 2);
+                res = readv (reader->fd, iov_in, 2);
 
                 if (res == -1) {
                         if (errno == ENODEV || errno == EBADF) {
@@ -3160,7 +3524,10 @@ fuse_thread_proc (void *data)
                         break;
                 }
 
-                priv->iobuf = iobuf;
+                /* route the reply back to the device we read from */
+                finh->padding = reader->idx;
+
+                pthread_setspecific (priv->iobuf_key, iobuf);
 
                 if (finh->opcode == FUSE_WRITE)
                         msg = iov_in[1].iov_base;
@@ -3187,13 +3554,12 @@ fuse_thread_proc (void *data)
 
                         msg = finh + 1;
                 }
-#ifdef GF_DARWIN_HOST_OS
                 if (finh->opcode >= FUSE_OP_HIGH)
-                        /* turn down MacFUSE specific messages */
+                        /* turn down MacFUSE specific messages, and
+                           opcodes of protocol versions newer than ours */
                         fuse_enosys (this, finh, msg);
                 else
-#endif
-                fuse_ops[finh->opcode] (this, finh, msg);
+                        fuse_ops[finh->opcode] (this, finh, msg);
 
                 iobuf_unref (iobuf);
                 continue;
@@ -3206,6 +3572,11 @@ fuse_thread_proc (void *data)
         iobuf_unref (iobuf);
         GF_FREE (iov_in[0].iov_base);
 
+        /* the first reader to see the device go away takes the process
+           down, the others just leave */
+        if (__sync_add_and_fetch (&priv->readers_exited, 1) > 1)
+                return NULL;
+
         if (dict_get (this->options, ZR_MOUNTPOINT_OPT))
                 mount_point = data_to_str (dict_get (this->options,
                                                      ZR_MOUNTPOINT_OPT));
@@ -3220,6 +3591,77 @@ fuse_thread_proc (void *data)
         return NULL;
 }
 
+/*
+ * fuse_readers_start - spawn the reader threads. each reader beyond the
+ *                      first tries to get its own clone of the device fd
+ *                      and falls back to sharing priv->fd.
+ */
+static int
+fuse_readers_start (xlator_t *this)
+{
+        fuse_private_t *priv = NULL;
+        int             ret = -1;
+        int             i = 0;
+#ifdef FUSE_DEV_IOC_CLONE
+        int             fd = -1;
+        uint32_t        master_fd = 0;
+#endif
+
+        priv = this->private;
+
+        priv->readers = GF_CALLOC (priv->reader_thread_count,
+                                   sizeof (*priv->readers),
+                                   gf_fuse_mt_fuse_reader_t);
+        if (!priv->readers) {
+                gf_log ("glusterfs-fuse", GF_LOG_ERROR,
+                        "Out of memory");
+                goto out;
+        }
+
+        for (i = 0; i < priv->reader_thread_count; i++) {
+                priv->readers[i].this = this;
+                priv->readers[i].idx  = i;
+                priv->readers[i].fd   = priv->fd;
+
+#ifdef FUSE_DEV_IOC_CLONE
+                if (i == 0)
+                        continue;
+
+                master_fd = priv->fd;
+                fd = open ("/dev/fuse", O_RDWR);
+                if (fd == -1 || ioctl (fd, FUSE_DEV_IOC_CLONE, &master_fd)) {
+                        gf_log ("glusterfs-fuse", GF_LOG_DEBUG,
+                                "cannot clone /dev/fuse (%s), reader %d "
+                                "shares the mount fd", strerror (errno), i);
+                        if (fd != -1)
+                                close (fd);
+                        continue;
+                }
+                priv->readers[i].fd = fd;
+#endif
+        }
+
+        for (i = 0; i < priv->reader_thread_count; i++) {
+                ret = pthread_create (&priv->readers[i].thread, NULL,
+                                      fuse_thread_proc, &priv->readers[i]);
+                if (ret != 0) {
+                        gf_log (this->name, GF_LOG_DEBUG,
+                                "pthread_create() failed (%s)",
+                                strerror (ret));
+                        break;
+                }
+        }
+
+        /* running with fewer readers is fine, with none it is not */
+        if (i > 0)
+                ret = 0;
+
+        gf_log ("glusterfs-fuse", GF_LOG_DEBUG,
+                "started %d fuse reader thread(s)", i);
+out:
+        return ret;
+}
+
 int32_t
 fuse_itable_dump (xlator_t  *this)
 {
@@ -3256,10 +3698,14 @@ fuse_priv_dump (xlator_t  *this)
                             private->volfile_size);
         gf_proc_dump_write("xlator.mount.fuse.mount_point", "%s",
                             private->mount_point);
-        gf_proc_dump_write("xlator.mount.fuse.iobuf", "%u",
-                            private->iobuf);
         gf_proc_dump_write("xlator.mount.fuse.fuse_thread_started", "%d",
                             (int)private->fuse_thread_started);
+        gf_proc_dump_write("xlator.mount.fuse.reader_thread_count", "%u",
+                            private->reader_thread_count);
+        gf_proc_dump_write("xlator.mount.fuse.use_readdirp", "%d",
+                            private->use_readdirp);
+        gf_proc_dump_write("xlator.mount.fuse.splice_write", "%d",
+                            private->splice_write);
         gf_proc_dump_write("xlator.mount.fuse.direct_io_mode", "%d",
                             private->direct_io_mode);
         gf_proc_dump_write("xlator.mount.fuse.entry_timeout", "%lf",
@@ -3349,14 +3795,9 @@ notify (xlator_t *this, int32_t event, void *data, ...)
                 if (!private->fuse_thread_started) {
                         private->fuse_thread_started = 1;
 
-                        ret = pthread_create (&private->fuse_thread, NULL,
-                                              fuse_thread_proc, this);
-                        if (ret != 0) {
-                                gf_log (this->name, GF_LOG_DEBUG,
-                                        "pthread_create() failed (%s)",
-                                        strerror (errno));
+                        ret = fuse_readers_start (this);
+                        if (ret != 0)
                                 break;
-                        }
                 }
 
                 break;
@@ -3424,6 +3865,12 @@ static fuse_handler_t *fuse_std_ops[FUSE_OP_HIGH] = {
         [FUSE_GETLK]       = fuse_getlk,
         [FUSE_SETLK]       = fuse_setlk,
         [FUSE_SETLKW]      = fuse_setlk,
+#if FUSE_KERNEL_MINOR_VERSION >= 16
+        [FUSE_BATCH_FORGET] = fuse_batch_forget,
+#endif
+#if FUSE_KERNEL_MINOR_VERSION >= 21
+        [FUSE_READDIRPLUS] = fuse_readdirp,
+#endif
 };
 
 
@@ -3473,6 +3920,7 @@ init (xlator_t *this_xl)
         int                i = 0;
         int                xl_name_allocated = 0;
         int                fsname_allocated = 0;
+        int32_t            reader_thread_count = 0;
 
         if (this_xl == NULL)
                 return -1;
@@ -3560,6 +4008,37 @@ init (xlator_t *this_xl)
         if (ret == 0)
                 priv->client_pid_set = _gf_true;
 
+        priv->reader_thread_count = 1;
+        ret = dict_get_int32 (options, ZR_READER_THREAD_COUNT_OPT,
+                              &reader_thread_count);
+        if (ret == 0) {
+                if ((reader_thread_count < 1)
+                    || (reader_thread_count > FUSE_MAX_READER_THREADS)) {
+                        gf_log ("glusterfs-fuse", GF_LOG_ERROR,
+                                "invalid reader thread count %d",
+                                reader_thread_count);
+                        goto cleanup_exit;
+                }
+                priv->reader_thread_count = reader_thread_count;
+        }
+
+        priv->use_readdirp = _gf_true;
+        ret = dict_get_str (options, ZR_USE_READDIRP_OPT, &value_string);
+        if (ret == 0) {
+                ret = gf_string2boolean (value_string, &priv->use_readdirp);
+                GF_ASSERT (ret == 0);
+        }
+
+        priv->splice = _gf_false;
+        ret = dict_get_str (options, ZR_SPLICE_OPT, &value_string);
+        if (ret == 0) {
+                ret = gf_string2boolean (value_string, &priv->splice);
+                GF_ASSERT (ret == 0);
+        }
+#ifndef GF_LINUX_HOST_OS
+        priv->splice = _gf_false;
+#endif
+
         priv->direct_io_mode = 2;
         ret = dict_get_str (options, ZR_DIRECT_IO_OPT, &value_string);
         if (ret == 0) {
@@ -3627,6 +4106,27 @@ init (xlator_t *this_xl)
         pthread_mutex_init (&priv->sync_mutex, NULL);
         priv->child_up = 0;
 
+        priv->msg0_len = sizeof (fuse_in_header_t)
+                + sizeof (struct fuse_write_in);
+        ret = pthread_key_create (&priv->iobuf_key, NULL);
+        if (ret != 0) {
+                gf_log ("glusterfs-fuse", GF_LOG_ERROR,
+                        "pthread_key_create() failed (%s)", strerror (ret));
+                goto cleanup_exit;
+        }
+#ifdef GF_LINUX_HOST_OS
+        if (priv->splice) {
+                ret = pthread_key_create (&priv->splice_key,
+                                          fuse_splice_pipe_destroy);
+                if (ret != 0) {
+                        gf_log ("glusterfs-fuse", GF_LOG_WARNING,
+                                "pthread_key_create() failed (%s), not "
+                                "splicing replies", strerror (ret));
+                        priv->splice = _gf_false;
+                }
+        }
+#endif
+
         for (i = 0; i < FUSE_OP_HIGH; i++) {
                 if (!fuse_std_ops[i])
                         fuse_std_ops[i] = fuse_enosys;
@@ -3648,7 +4148,7 @@ cleanup_exit:
                 GF_FREE (fsname);
         if (priv) {
                 GF_FREE (priv->mount_point);
-                close (priv->fd);
+                fuse_close_devices (priv);
                 close (priv->fuse_dump_fd);
                 GF_FREE (priv);
         }
@@ -3715,5 +4215,16 @@ struct volume_options options[] = {
         { .key  = {"client-pid"},
           .type = GF_OPTION_TYPE_INT
         },
+        { .key  = {ZR_READER_THREAD_COUNT_OPT},
+          .type = GF_OPTION_TYPE_INT,
+          .min  = 1,
+          .max  = FUSE_MAX_READER_THREADS
+        },
+        { .key  = {ZR_USE_READDIRP_OPT},
+          .type = GF_OPTION_TYPE_BOOL
+        },
+        { .key  = {ZR_SPLICE_OPT},
+          .type = GF_OPTION_TYPE_BOOL
+        },
         { .key = {NULL} },
 };
@@ -26,6 +26,9 @@
 #include <stddef.h>
 #include <dirent.h>
 #include <sys/mount.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <sys/time.h>
 #include <fnmatch.h>
 
@@ -60,7 +63,7 @@
 #define DISABLE_POSIX_ACL
 
 #ifdef GF_LINUX_HOST_OS
-#define FUSE_OP_HIGH (FUSE_POLL + 1)
+#define FUSE_OP_HIGH (FUSE_READDIRPLUS + 1)
 #endif
 #ifdef GF_DARWIN_HOST_OS
 #define FUSE_OP_HIGH (FUSE_DESTROY + 1)
@@ -69,23 +72,56 @@
 
 #define MAX_FUSE_PROC_DELAY 1
 
+#define FUSE_MAX_READER_THREADS 64
+
+#if defined(GF_LINUX_HOST_OS) && !defined(FUSE_DEV_IOC_CLONE)
+/* from linux/fuse.h, available since 4.2 */
+#define FUSE_DEV_IOC_CLONE _IOR (229, 0, uint32_t)
+#endif
+
+/* replies carrying less payload than this are not worth the extra
+   syscalls of going through a pipe */
+#define FUSE_SPLICE_MIN_PAYLOAD  (4 * GF_UNIT_KB)
+
 typedef struct fuse_in_header fuse_in_header_t;
 typedef void (fuse_handler_t) (xlator_t *this, fuse_in_header_t *finh,
                                void *msg);
 
+/*
+ * fuse_reader - one thread reading requests off /dev/fuse. where the
+ *               kernel supports it each reader gets its own clone of the
+ *               device fd; replies have to go out on the fd the request
+ *               came in on, so the reader's index travels in the
+ *               (otherwise unused) padding field of the fuse_in_header.
+ */
+struct fuse_reader {
+        xlator_t            *this;
+        pthread_t            thread;
+        int                  fd;
+        uint32_t             idx;
+};
+
 struct fuse_private {
         int                  fd;
         uint32_t             proto_minor;
         char                *volfile;
         size_t               volfile_size;
         char                *mount_point;
-        struct iobuf        *iobuf;
+        pthread_key_t        iobuf_key;   /* payload iobuf of the request
+                                           * being handled by this reader */
 
-        pthread_t            fuse_thread;
+        uint32_t             reader_thread_count;
+        struct fuse_reader  *readers;
+        int                  readers_exited;
         char                 fuse_thread_started;
 
         uint32_t             direct_io_mode;
-        size_t              *msg0_len_p;
+        size_t               msg0_len;
+
+        gf_boolean_t         use_readdirp;
+        gf_boolean_t         splice;        /* option: vmsplice() replies */
+        gf_boolean_t         splice_write;  /* ... and the kernel takes them */
+        pthread_key_t        splice_key;    /* per-thread reply pipe */
 
         double               entry_timeout;
         double               attribute_timeout;
@@ -272,6 +308,7 @@ typedef struct {
         struct iatt    attr;
         struct gf_flock   lk_lock;
         struct iovec   vector;
+        struct iobuf  *iobuf;
 
         uuid_t         gfid;
 } fuse_state_t;
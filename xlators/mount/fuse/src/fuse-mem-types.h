@@ -29,6 +29,8 @@ enum gf_fuse_mem_types_ {
         gf_fuse_mt_char,
         gf_fuse_mt_iov_base,
         gf_fuse_mt_fuse_state_t,
+        gf_fuse_mt_fuse_reader_t,
+        gf_fuse_mt_splice_pipe_t,
         gf_fuse_mt_end
 };
 #endif
@@ -33,6 +33,7 @@
 #include "xdr-rpc.h"
 #include "iobuf.h"
 #include "globals.h"
+#include "statedump.h"
 
 #include <errno.h>
 #include <pthread.h>
@@ -82,6 +83,9 @@ nfs_rpcsvc_stage_init (rpcsvc_t *svc)
         if (!stg)
                 return NULL;
 
+        INIT_LIST_HEAD (&stg->stglist);
+        stg->svc = svc;
+
         eventpoolsize = svc->memfactor * RPCSVC_EVENTPOOL_SIZE_MULT;
         gf_log (GF_RPCSVC, GF_LOG_TRACE, "event pool size: %d", eventpoolsize);
         stg->eventpool = event_pool_new (eventpoolsize);
@@ -102,7 +106,6 @@ nfs_rpcsvc_stage_init (rpcsvc_t *svc)
                 goto free_stg;
         }
 
-        stg->svc = svc;
         ret = 0;
 free_stg:
         if (ret == -1) {
@@ -147,6 +150,57 @@ nfs_rpcsvc_init_options (rpcsvc_t *svc, dict_t *options)
                 gf_log (GF_RPCSVC, GF_LOG_DEBUG, "Portmap registration "
                         "disabled");
 
+        svc->stagecount = sysconf (_SC_NPROCESSORS_ONLN);
+        if ((int)svc->stagecount < 1)
+                svc->stagecount = 1;
+        if (svc->stagecount > RPCSVC_DEFAULT_MAXSTAGES)
+                svc->stagecount = RPCSVC_DEFAULT_MAXSTAGES;
+
+        if (dict_get (options, "rpc.stages")) {
+                ret = dict_get_str (options, "rpc.stages", &optstr);
+                if (ret < 0) {
+                        gf_log (GF_RPCSVC, GF_LOG_ERROR, "Failed to parse "
+                                "dict");
+                        goto out;
+                }
+
+                ret = gf_string2uint (optstr, &svc->stagecount);
+                if ((ret < 0) || (svc->stagecount < 1)
+                    || (svc->stagecount > RPCSVC_MAX_STAGES)) {
+                        gf_log (GF_RPCSVC, GF_LOG_ERROR, "Invalid number of"
+                                " stages: %s, must be 1 to %d", optstr,
+                                RPCSVC_MAX_STAGES);
+                        ret = -1;
+                        goto out;
+                }
+        }
+
+        svc->stageselect = RPCSVC_STAGESELECT_LEASTLOADED;
+        if (dict_get (options, "rpc.stage-select")) {
+                ret = dict_get_str (options, "rpc.stage-select", &optstr);
+                if (ret < 0) {
+                        gf_log (GF_RPCSVC, GF_LOG_ERROR, "Failed to parse "
+                                "dict");
+                        goto out;
+                }
+
+                if (strcmp (optstr, "round-robin") == 0)
+                        svc->stageselect = RPCSVC_STAGESELECT_ROUNDROBIN;
+                else if (strcmp (optstr, "least-loaded") == 0)
+                        svc->stageselect = RPCSVC_STAGESELECT_LEASTLOADED;
+                else {
+                        gf_log (GF_RPCSVC, GF_LOG_ERROR, "Invalid stage "
+                                "selection policy: %s", optstr);
+                        ret = -1;
+                        goto out;
+                }
+        }
+
+        gf_log (GF_RPCSVC, GF_LOG_DEBUG, "Stages: %u, selection: %s",
+                svc->stagecount,
+                (svc->stageselect == RPCSVC_STAGESELECT_ROUNDROBIN)
+                ? "round-robin" : "least-loaded");
+
         ret = 0;
 out:
         return ret;
@@ -161,7 +215,9 @@ rpcsvc_t *
 nfs_rpcsvc_init (glusterfs_ctx_t *ctx, dict_t *options)
 {
         rpcsvc_t        *svc = NULL;
+        rpcsvc_stage_t  *stg = NULL;
         int             ret = -1;
+        int             i = 0;
 
         if ((!ctx) || (!options))
                 return NULL;
@@ -194,6 +250,22 @@ nfs_rpcsvc_init (glusterfs_ctx_t *ctx, dict_t *options)
                 gf_log (GF_RPCSVC, GF_LOG_ERROR,"RPC service init failed.");
                 goto free_svc;
         }
+
+        /* The stages are never torn down, like the default stage. If one
+         * fails to start, make do with those that did.
+         */
+        for (i = 0; i < svc->stagecount; i++) {
+                stg = nfs_rpcsvc_stage_init (svc);
+                if (!stg) {
+                        gf_log (GF_RPCSVC, GF_LOG_WARNING, "Could only start"
+                                " %d of %u stages", i, svc->stagecount);
+                        break;
+                }
+
+                stg->index = i;
+                list_add_tail (&stg->stglist, &svc->stages);
+        }
+        svc->stagecount = i;
         svc->options = options;
         svc->ctx = ctx;
         gf_log (GF_RPCSVC, GF_LOG_DEBUG, "RPC service inited.");
@@ -209,17 +281,89 @@ free_svc:
 }
 
 
-/* Once multi-threaded support is complete, we'll be able to round-robin
- * the various incoming connections over the many available stages. This
- * function selects one from among all the stages.
+/* Selects the stage that will serve a newly accepted connection, either the
+ * next one in turn or the one serving the fewest connections. Without any
+ * stages, which only happens when none could be started, the connection
+ * is served by the default stage along with the listeners.
  */
 rpcsvc_stage_t *
 nfs_rpcsvc_select_stage (rpcsvc_t *rpcservice)
 {
+        rpcsvc_stage_t          *stg = NULL;
+        rpcsvc_stage_t          *selected = NULL;
+
         if (!rpcservice)
                 return NULL;
 
-        return rpcservice->defaultstage;
+        pthread_mutex_lock (&rpcservice->rpclock);
+        {
+                if (list_empty (&rpcservice->stages)) {
+                        selected = rpcservice->defaultstage;
+                        goto unlock;
+                }
+
+                if (rpcservice->stageselect == RPCSVC_STAGESELECT_ROUNDROBIN) {
+                        stg = rpcservice->laststage;
+                        if ((!stg)
+                            || (stg->stglist.next == &rpcservice->stages))
+                                selected = list_entry (rpcservice->stages.next,
+                                                       rpcsvc_stage_t,
+                                                       stglist);
+                        else
+                                selected = list_entry (stg->stglist.next,
+                                                       rpcsvc_stage_t,
+                                                       stglist);
+                        rpcservice->laststage = selected;
+                        goto unlock;
+                }
+
+                list_for_each_entry (stg, &rpcservice->stages, stglist) {
+                        if ((!selected) || (stg->conns < selected->conns))
+                                selected = stg;
+                }
+        }
+unlock:
+        pthread_mutex_unlock (&rpcservice->rpclock);
+
+        return selected;
+}
+
+
+void
+nfs_rpcsvc_dump (rpcsvc_t *svc)
+{
+        rpcsvc_stage_t          *stg = NULL;
+        char                    key[GF_DUMP_MAX_BUF_LEN];
+        char                    key_prefix[GF_DUMP_MAX_BUF_LEN];
+
+        if (!svc)
+                return;
+
+        gf_proc_dump_build_key (key_prefix, "xlator.nfs", "rpcsvc");
+        gf_proc_dump_add_section (key_prefix);
+
+        gf_proc_dump_build_key (key, key_prefix, "stages");
+        gf_proc_dump_write (key, "%u", svc->stagecount);
+
+        gf_proc_dump_build_key (key, key_prefix, "stage-select");
+        gf_proc_dump_write (key, "%s",
+                            (svc->stageselect == RPCSVC_STAGESELECT_ROUNDROBIN)
+                            ? "round-robin" : "least-loaded");
+
+        list_for_each_entry (stg, &svc->stages, stglist) {
+                snprintf (key_prefix, GF_DUMP_MAX_BUF_LEN,
+                          "xlator.nfs.rpcsvc.stage%d", stg->index);
+                gf_proc_dump_add_section (key_prefix);
+
+                gf_proc_dump_build_key (key, key_prefix, "connections");
+                gf_proc_dump_write (key, "%"PRIu64, stg->conns);
+
+                gf_proc_dump_build_key (key, key_prefix, "total-connections");
+                gf_proc_dump_write (key, "%"PRIu64, stg->totalconns);
+
+                gf_proc_dump_build_key (key, key_prefix, "calls");
+                gf_proc_dump_write (key, "%"PRIu64, stg->calls);
+        }
 }
 
 
@@ -713,6 +857,15 @@ free_conn:
 void
 nfs_rpcsvc_conn_destroy (rpcsvc_conn_t *conn)
 {
+        rpcsvc_t        *svc = NULL;
+
+        /* Only client connections count towards the load of a stage */
+        if (conn->stage) {
+                svc = nfs_rpcsvc_conn_rpcsvc (conn);
+                if (conn->stage != svc->defaultstage)
+                        __sync_fetch_and_sub (&conn->stage->conns, 1);
+        }
+
         mem_pool_destroy (conn->txpool);
         mem_pool_destroy (conn->rxpool);
 
@@ -1044,8 +1197,15 @@ nfs_rpcsvc_stage_conn_associate (rpcsvc_stage_t *stg, rpcsvc_conn_t *conn,
         conn->stage = stg;
         conn->eventidx = event_register (stg->eventpool, conn->sockfd, handler,
                                          data, 1, 0);
-        if (conn->eventidx == -1)
+        if (conn->eventidx == -1) {
+                conn->stage = NULL;
                 goto err;
+        }
+
+        if (stg != nfs_rpcsvc_stage_service (stg)->defaultstage) {
+                __sync_fetch_and_add (&stg->conns, 1);
+                __sync_fetch_and_add (&stg->totalconns, 1);
+        }
 
         ret = 0;
 err:
@@ -1981,6 +2141,7 @@ nfs_rpcsvc_handle_rpc_call (rpcsvc_conn_t *conn)
         if ((actor) && (actor->actor)) {
                 THIS = nfs_rpcsvc_request_actorxl (req);
                 nfs_rpcsvc_conn_ref (conn);
+                conn->stage->calls++;
                 ret = actor->actor (req);
         }
 
@@ -2289,6 +2450,7 @@ nfs_rpcsvc_record_vectored_call_actor (rpcsvc_conn_t *conn)
         if (actor->vector_actor) {
                 nfs_rpcsvc_conn_ref (conn);
                 THIS = nfs_rpcsvc_request_actorxl (req);
+                conn->stage->calls++;
                 ret = actor->vector_actor (req, rs->vectoriob);
         } else {
                 nfs_rpcsvc_request_seterr (req, PROC_UNAVAIL);
@@ -2688,7 +2850,8 @@ nfs_rpcsvc_conn_listening_handler (int fd, int idx, void *data, int poll_in,
                         " with new connection");
                 goto close_err;
         }
-        gf_log (GF_RPCSVC, GF_LOG_DEBUG, "New Connection");
+        gf_log (GF_RPCSVC, GF_LOG_DEBUG, "New Connection on stage %d",
+                selectedstage->index);
         ret = 0;
 close_err:
         if (ret == -1)
@@ -2790,7 +2953,9 @@ nfs_rpcsvc_program_register (rpcsvc_t *svc, rpcsvc_program_t program)
         memcpy (newprog, &program, sizeof (program));
         INIT_LIST_HEAD (&newprog->proglist);
         list_add_tail (&newprog->proglist, &svc->allprograms);
-        selectedstage = nfs_rpcsvc_select_stage (svc);
+
+        /* Listeners are always served by the default stage */
+        selectedstage = svc->defaultstage;
 
         ret = nfs_rpcsvc_stage_program_register (selectedstage, newprog);
         if (ret == -1) {
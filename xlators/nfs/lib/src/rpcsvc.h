@@ -48,6 +48,8 @@
 #define RPCSVC_THREAD_STACK_SIZE ((size_t)(1024 * GF_UNIT_KB))
 
 #define RPCSVC_DEFAULT_MEMFACTOR        15
+#define RPCSVC_DEFAULT_MAXSTAGES        8
+#define RPCSVC_MAX_STAGES               64
 #define RPCSVC_EVENTPOOL_SIZE_MULT      1024
 #define RPCSVC_POOLCOUNT_MULT           35
 #define RPCSVC_CONN_READ        (128 * GF_UNIT_KB)
@@ -120,8 +122,21 @@ typedef struct rpc_svc_stage_context {
         pthread_t               tid;
         struct event_pool       *eventpool;     /* Per-stage event-pool */
         void                    *svc;           /* Ref to the rpcsvc_t */
+        struct list_head        stglist;        /* Entry in svc->stages */
+        int                     index;
+
+        /* Statistics, see nfs_rpcsvc_dump. conns is also what the
+         * least-loaded policy balances on.
+         */
+        uint64_t                conns;          /* connections now */
+        uint64_t                totalconns;     /* connections ever */
+        uint64_t                calls;          /* RPC calls dispatched */
 } rpcsvc_stage_t;
 
+/* How new connections are spread over the stages */
+#define RPCSVC_STAGESELECT_LEASTLOADED  0
+#define RPCSVC_STAGESELECT_ROUNDROBIN   1
+
 
 /* RPC Records and Fragments assembly state.
  * This is per-connection state that is used to determine
@@ -492,9 +507,7 @@ typedef struct rpc_svc_state {
          * other options.
          */
 
-        /* At this point, lock is not used to protect anything. Later, it'll
-         * be used for protecting stages.
-         */
+        /* Protects the stage selection state below. */
         pthread_mutex_t         rpclock;
 
         /* This is the first stage that is inited, so that any RPC based
@@ -505,10 +518,15 @@ typedef struct rpc_svc_state {
          */
         rpcsvc_stage_t          *defaultstage;
 
-        /* When we have multi-threaded RPC support, we'll use this to link
-         * to the multiple Stages.
+        /* The stages that client connections are spread over, each with
+         * its own event pool and thread. Connections stay on the stage
+         * they were accepted onto, so calls on one connection are still
+         * decoded and handed to the actors in order.
          */
         struct list_head        stages;         /* All stages */
+        unsigned int            stagecount;
+        int                     stageselect;
+        rpcsvc_stage_t          *laststage;     /* last round-robin pick */
 
         unsigned int            memfactor;
 
@@ -544,6 +562,10 @@ nfs_rpcsvc_program_unregister (rpcsvc_t *svc, rpcsvc_program_t program);
 extern rpcsvc_t *
 nfs_rpcsvc_init (glusterfs_ctx_t *ctx, dict_t *options);
 
+/* Writes per-stage statistics into the statedump. */
+extern void
+nfs_rpcsvc_dump (rpcsvc_t *svc);
+
 
 extern int
 nfs_rpcsvc_submit_message (rpcsvc_request_t * req, struct iovec msg,
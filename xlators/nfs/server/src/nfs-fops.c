@@ -1226,6 +1226,39 @@ err:
 }
 
 
+/* Same as nfs_fop_write for a vector that spans several iobufs, all held by
+ * srciobref.
+ */
+int
+nfs_fop_writev (xlator_t *nfsx, xlator_t *xl, nfs_user_t *nfu, fd_t *fd,
+                struct iobref *srciobref, struct iovec *vector, int32_t count,
+                off_t offset, fop_writev_cbk_t cbk, void *local)
+{
+        call_frame_t            *frame = NULL;
+        int                     ret = -EFAULT;
+        struct nfs_fop_local    *nfl = NULL;
+
+        if ((!nfsx) || (!xl) || (!fd) || (!vector) || (!nfu) || (!srciobref))
+                return ret;
+
+        nfs_fop_handle_frame_create (frame, nfsx, nfu, ret, err);
+        nfs_fop_handle_local_init (frame, nfsx, nfl, cbk, local, ret, err);
+        nfs_fop_save_root_fd_ino (nfl, fd);
+
+        nfl->iobref = iobref_ref (srciobref);
+        STACK_WIND_COOKIE (frame, nfs_fop_writev_cbk, xl, xl,xl->fops->writev
+                           , fd, vector, count, offset, nfl->iobref);
+        ret = 0;
+err:
+        if (ret < 0) {
+                if (frame)
+                        nfs_stack_destroy (nfl, frame);
+        }
+
+        return ret;
+}
+
+
 int32_t
 nfs_fop_fsync_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                    int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
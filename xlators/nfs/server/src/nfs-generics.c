@@ -165,6 +165,16 @@ nfs_write (xlator_t *nfsx, xlator_t *xl, nfs_user_t *nfu, fd_t *fd,
 }
 
 
+int
+nfs_writev (xlator_t *nfsx, xlator_t *xl, nfs_user_t *nfu, fd_t *fd,
+            struct iobref *srciobref, struct iovec *vector, int32_t count,
+            off_t offset, fop_writev_cbk_t cbk, void *local)
+{
+        return nfs_fop_writev (nfsx, xl, nfu, fd, srciobref, vector, count,
+                               offset, cbk, local);
+}
+
+
 int
 nfs_open (xlator_t *nfsx, xlator_t *xl, nfs_user_t *nfu, loc_t *pathloc,
           int32_t flags, fop_open_cbk_t cbk, void *local)
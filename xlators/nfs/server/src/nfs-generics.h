@@ -95,6 +95,11 @@ nfs_write (xlator_t *nfsx, xlator_t *xl, nfs_user_t *nfu, fd_t *fd,
            struct iobuf *srciob, struct iovec *vector, int32_t count,
            off_t offset, fop_writev_cbk_t cbk, void *local);
 
+extern int
+nfs_writev (xlator_t *nfsx, xlator_t *xl, nfs_user_t *nfu, fd_t *fd,
+            struct iobref *srciobref, struct iovec *vector, int32_t count,
+            off_t offset, fop_writev_cbk_t cbk, void *local);
+
 extern int
 nfs_open (xlator_t *nfsx, xlator_t *xl, nfs_user_t *nfu, loc_t *pathloc,
           int32_t flags, fop_open_cbk_t cbk, void *local);
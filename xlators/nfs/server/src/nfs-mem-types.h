@@ -43,6 +43,10 @@ enum gf_nfs_mem_types_ {
         gf_nfs_mt_mnt3_resolve,
         gf_nfs_mt_mnt3_export,
         gf_nfs_mt_inode_q,
+        gf_nfs_mt_nfs3_fhcache_entry,
+        gf_nfs_mt_nfs3_gathered_write,
+        gf_nfs_mt_nfs3_write_batch,
+        gf_nfs_mt_nfs3_write_run,
         gf_nfs_mt_end
 };
 #endif
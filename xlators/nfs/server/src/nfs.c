@@ -723,15 +723,52 @@ fini (xlator_t *this)
 {
 
         struct nfs_state        *nfs = NULL;
+        struct nfs_initer_list  *version = NULL;
+        rpcsvc_program_t        *prog = NULL;
 
         nfs = (struct nfs_state *)this->private;
         gf_log (GF_NFS, GF_LOG_DEBUG, "NFS service going down");
+
+        list_for_each_entry (version, &nfs->versions, list) {
+                prog = version->program;
+                if ((prog) && (prog->prognum == NFS_PROGRAM) &&
+                    (prog->progver == NFS_V3))
+                        nfs3_fhcache_fini (prog->private);
+        }
+
         nfs_deinit_versions (&nfs->versions, this);
         return 0;
 }
 
+int
+nfs_priv (xlator_t *this)
+{
+        struct nfs_state        *nfs = NULL;
+        struct nfs_initer_list  *version = NULL;
+        rpcsvc_program_t        *prog = NULL;
+
+        nfs = (struct nfs_state *)this->private;
+        if (!nfs)
+                return 0;
+
+        nfs_rpcsvc_dump (nfs->rpcsvc);
+
+        list_for_each_entry (version, &nfs->versions, list) {
+                prog = version->program;
+                if ((prog) && (prog->prognum == NFS_PROGRAM) &&
+                    (prog->progver == NFS_V3))
+                        nfs3_fhcache_dump (prog->private);
+        }
+
+        return 0;
+}
+
+
 struct xlator_cbks cbks = { };
 struct xlator_fops fops = { };
+struct xlator_dumpops dumpops = {
+        .priv = nfs_priv,
+};
 
 /* TODO: If needed, per-volume options below can be extended to be export
 + * specific also because after export-dir is introduced, a volume is not
@@ -756,6 +793,25 @@ struct volume_options options[] = {
           .description = "Size in which the client should issue directory "
                          " reading requests."
         },
+        { .key  = {"nfs3.write-gather-size"},
+          .type = GF_OPTION_TYPE_SIZET,
+          .description = "UNSTABLE writes to a file are held back and sent "
+                         "as one writev per run of adjacent writes once this "
+                         "much has been gathered, on COMMIT, or after a "
+                         "second. 1MB by default, 0 disables it."
+        },
+        { .key  = {"nfs3.fh-cache-size"},
+          .type = GF_OPTION_TYPE_SIZET,
+          .description = "Memory used to remember the paths of file handles "
+                         "so that handles whose inodes are not in the inode "
+                         "table are resolved without searching directories. "
+                         "32MB by default, 0 disables it."
+        },
+        { .key  = {"nfs3.fh-cache-file"},
+          .type = GF_OPTION_TYPE_PATH,
+          .description = "File the handle paths are saved to and loaded from "
+                         "on start-up. Not saved by default."
+        },
         { .key  = {"nfs3.*.volume-access"},
           .type = GF_OPTION_TYPE_STR,
           .description = "Type of access desired for this subvolume: "
@@ -922,6 +978,21 @@ struct volume_options options[] = {
                          "portmap service. Use this option to turn off portmap "
                          "registration for Gluster NFS. On by default"
         },
+        { .key  = {"rpc.stages"},
+          .type = GF_OPTION_TYPE_INT,
+          .min  = 1,
+          .max  = RPCSVC_MAX_STAGES,
+          .description = "Number of threads, each with its own event pool, "
+                         "that NFS client connections are spread over. "
+                         "Defaults to the number of CPUs, but at most 8."
+        },
+        { .key  = {"rpc.stage-select"},
+          .type = GF_OPTION_TYPE_STR,
+          .value = {"least-loaded", "round-robin"},
+          .description = "How a new connection picks its thread: the one "
+                         "serving the fewest connections or the next one "
+                         "in turn. least-loaded by default."
+        },
         { .key  = {"nfs.port"},
           .type = GF_OPTION_TYPE_INT,
           .description = "Use this option on systems that need Gluster NFS to "
@@ -36,6 +36,7 @@
 #include "nfs-mem-types.h"
 #include "iatt.h"
 #include "common-utils.h"
+#include "statedump.h"
 #include <string.h>
 
 extern int
@@ -2097,6 +2098,10 @@ __nfs3_get_inode_queue (nfs3_call_state_t *cs)
         gf_log (GF_NFS3, GF_LOG_TRACE, "Initing inode queue");
         INIT_LIST_HEAD (&inode_q->opq);
         pthread_mutex_init (&inode_q->qlock, NULL);
+        LOCK_INIT (&inode_q->gather.lock);
+        INIT_LIST_HEAD (&inode_q->gather.batches);
+        INIT_LIST_HEAD (&inode_q->gather.waiters);
+        inode_q->gather.nfs3 = cs->nfs3state;
         __inode_ctx_put (cs->resolvedloc.inode, cs->nfsx, (uintptr_t)inode_q);
 
 err:
@@ -2253,6 +2258,470 @@ err:
 }
 
 
+/* A run of adjacent gathered writes sent with one writev. */
+struct nfs3_write_run {
+        struct list_head        list;
+        struct nfs3_write_batch *batch;
+        struct iobref           *iobref;
+        struct iovec            vec[GF_NFS3_WRITE_GATHER_MAX_IOV];
+        int                     count;
+        off_t                   offset;
+        size_t                  size;
+        nfs_user_t              nfu;
+};
+
+
+struct nfs3_write_gather *
+nfs3_write_gather_get (nfs3_call_state_t *cs)
+{
+        struct inode_op_queue   *inode_q = NULL;
+        uint64_t                ctxaddr = 0;
+
+        if (inode_ctx_get (cs->resolvedloc.inode, cs->nfsx, &ctxaddr) == -1)
+                return NULL;
+
+        inode_q = (struct inode_op_queue *)(long)ctxaddr;
+        if (!inode_q)
+                return NULL;
+
+        return &inode_q->gather;
+}
+
+
+void
+nfs3_write_gather_send (struct nfs3_write_gather *gather);
+
+void
+nfs3_write_gather_run_done (struct nfs3_write_run *run, int op_errno)
+{
+        struct nfs3_write_batch         *batch = NULL;
+        struct nfs3_write_gather        *gather = NULL;
+        nfs3_call_state_t               *cs = NULL;
+        nfs3_call_state_t               *tmp = NULL;
+        struct list_head                waiters;
+        int                             done = 0;
+
+        INIT_LIST_HEAD (&waiters);
+        batch = run->batch;
+        gather = batch->gather;
+
+        LOCK (&gather->lock);
+        {
+                if ((op_errno) && (!gather->op_errno))
+                        gather->op_errno = op_errno;
+
+                if (--batch->pending == 0) {
+                        done = 1;
+                        gather->sending = NULL;
+                        gather->sentseq = batch->endseq;
+                        list_for_each_entry_safe (cs, tmp, &gather->waiters,
+                                                  gatherwait_q) {
+                                if (cs->gatherseq <= gather->sentseq)
+                                        list_move_tail (&cs->gatherwait_q,
+                                                        &waiters);
+                        }
+                }
+        }
+        UNLOCK (&gather->lock);
+
+        __sync_fetch_and_sub (&gather->nfs3->gatheredbytes, run->size);
+        if (run->iobref)
+                iobref_unref (run->iobref);
+        GF_FREE (run);
+
+        if (!done)
+                return;
+
+        GF_FREE (batch);
+        list_for_each_entry_safe (cs, tmp, &waiters, gatherwait_q) {
+                list_del_init (&cs->gatherwait_q);
+                nfs3_call_resume (cs);
+        }
+
+        nfs3_write_gather_send (gather);
+}
+
+
+int32_t
+nfs3_write_gather_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                       int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
+                       struct iatt *postbuf)
+{
+        struct nfs3_write_run   *run = NULL;
+
+        run = frame->local;
+        if ((op_ret >= 0) && (op_ret < run->size)) {
+                op_ret = -1;
+                op_errno = EIO;
+        }
+
+        if (op_ret == -1)
+                gf_log (GF_NFS3, GF_LOG_ERROR, "Gathered write failed: offset "
+                        "%"PRId64", size %"GF_PRI_SIZET": %s",
+                        (int64_t)run->offset, run->size, strerror (op_errno));
+
+        nfs3_write_gather_run_done (run, (op_ret == -1) ? op_errno : 0);
+        return 0;
+}
+
+
+/* Turns the batch into runs of adjacent writes from the same user, freeing
+ * the gathered writes as it goes; their iobufs are now held by the runs.
+ */
+int
+__nfs3_write_batch_to_runs (struct nfs3_write_gather *gather,
+                            struct nfs3_write_batch *batch,
+                            struct list_head *runs)
+{
+        struct nfs3_gathered_write      *gw = NULL;
+        struct nfs3_gathered_write      *tmp = NULL;
+        struct nfs3_write_run           *run = NULL;
+        int                             count = 0;
+
+        list_for_each_entry_safe (gw, tmp, &batch->writes, list) {
+                if ((!run) || (run->count == GF_NFS3_WRITE_GATHER_MAX_IOV) ||
+                    (run->offset + run->size != gw->offset) ||
+                    (memcmp (&run->nfu, &gw->nfu, sizeof (gw->nfu)) != 0)) {
+                        run = GF_CALLOC (1, sizeof (*run),
+                                         gf_nfs_mt_nfs3_write_run);
+                        if (run)
+                                run->iobref = iobref_new ();
+                        if ((!run) || (!run->iobref)) {
+                                gf_log (GF_NFS3, GF_LOG_ERROR, "Memory "
+                                        "allocation failed, dropping gathered "
+                                        "write");
+                                if (run)
+                                        GF_FREE (run);
+                                run = NULL;
+                                if (!gather->op_errno)
+                                        gather->op_errno = ENOMEM;
+                                __sync_fetch_and_sub (&gather->nfs3->gatheredbytes,
+                                                      gw->vec.iov_len);
+                                goto free_write;
+                        }
+
+                        run->batch = batch;
+                        run->offset = gw->offset;
+                        run->nfu = gw->nfu;
+                        list_add_tail (&run->list, runs);
+                        ++count;
+                }
+
+                iobref_add (run->iobref, gw->iob);
+                run->vec[run->count++] = gw->vec;
+                run->size += gw->vec.iov_len;
+free_write:
+                list_del (&gw->list);
+                iobuf_unref (gw->iob);
+                GF_FREE (gw);
+        }
+
+        return count;
+}
+
+
+/* Sends the oldest batch if nothing is being sent and something in it is due.
+ * Once everything has been written, the waiters are resumed and the fd is let
+ * go of.
+ */
+void
+nfs3_write_gather_send (struct nfs3_write_gather *gather)
+{
+        struct nfs3_write_batch         *batch = NULL;
+        struct nfs3_write_run           *run = NULL;
+        struct nfs3_write_run           *rtmp = NULL;
+        nfs3_call_state_t               *cs = NULL;
+        nfs3_call_state_t               *cstmp = NULL;
+        struct list_head                runs;
+        struct list_head                waiters;
+        fd_t                            *fd = NULL;
+        xlator_t                        *nfsx = NULL;
+        int                             ret = 0;
+
+        INIT_LIST_HEAD (&runs);
+        INIT_LIST_HEAD (&waiters);
+        nfsx = gather->nfs3->nfsx;
+
+        LOCK (&gather->lock);
+        {
+                if (gather->sending)
+                        goto unlock;
+
+                while (!list_empty (&gather->batches)) {
+                        batch = list_entry (gather->batches.next,
+                                            struct nfs3_write_batch, list);
+                        if (batch->startseq >= gather->flushseq)
+                                goto unlock;
+
+                        list_del_init (&batch->list);
+                        gather->bytes -= batch->bytes;
+                        batch->pending = __nfs3_write_batch_to_runs (gather,
+                                                                     batch,
+                                                                     &runs);
+                        if (batch->pending) {
+                                gather->sending = batch;
+                                /* The writes may all unwind before we are
+                                 * done sending them.
+                                 */
+                                fd = fd_ref (gather->fd);
+                                goto unlock;
+                        }
+
+                        /* Came to nothing, on to the next one. */
+                        gather->sentseq = batch->endseq;
+                        GF_FREE (batch);
+                }
+
+                /* Everything has been written. */
+                list_splice_init (&gather->waiters, &waiters);
+                fd = gather->fd;
+                gather->fd = NULL;
+        }
+unlock:
+        UNLOCK (&gather->lock);
+
+        list_for_each_entry_safe (run, rtmp, &runs, list) {
+                list_del_init (&run->list);
+                gf_log (GF_NFS3, GF_LOG_TRACE, "Sending gathered writes: "
+                        "offset %"PRId64", size %"GF_PRI_SIZET", iovecs %d",
+                        (int64_t)run->offset, run->size, run->count);
+                ret = nfs_writev (nfsx, gather->vol, &run->nfu, fd,
+                                  run->iobref, run->vec, run->count,
+                                  run->offset, nfs3_write_gather_cbk, run);
+                if (ret < 0)
+                        nfs3_write_gather_run_done (run, -ret);
+        }
+
+        list_for_each_entry_safe (cs, cstmp, &waiters, gatherwait_q) {
+                list_del_init (&cs->gatherwait_q);
+                nfs3_call_resume (cs);
+        }
+
+        if (fd)
+                fd_unref (fd);
+}
+
+
+void
+nfs3_write_gather_timeout (void *data)
+{
+        struct nfs3_write_gather        *gather = NULL;
+        gf_timer_t                      *timer = NULL;
+
+        gather = data;
+        LOCK (&gather->lock);
+        {
+                timer = gather->timer;
+                gather->timer = NULL;
+                gather->flushseq = gather->seq;
+        }
+        UNLOCK (&gather->lock);
+
+        /* the fired event stays on the stale list until cancelled */
+        if (timer)
+                gf_timer_call_cancel (gather->nfs3->nfsx->ctx, timer);
+
+        nfs3_write_gather_send (gather);
+}
+
+
+/* Adds the write to the last batch, or to a new one if it overlaps a write
+ * already in there.
+ */
+void
+__nfs3_write_gather_add (struct nfs3_write_gather *gather,
+                         struct nfs3_gathered_write *gw,
+                         struct nfs3_write_batch **spare)
+{
+        struct nfs3_write_batch         *batch = NULL;
+        struct nfs3_gathered_write      *prev = NULL;
+        struct list_head                *pos = NULL;
+        off_t                           end = 0;
+
+        end = gw->offset + gw->vec.iov_len;
+        if (!list_empty (&gather->batches)) {
+                batch = list_entry (gather->batches.prev,
+                                    struct nfs3_write_batch, list);
+                /* Walk back from the highest offset, as writes mostly come
+                 * in ascending order.
+                 */
+                pos = &batch->writes;
+                while (pos->prev != &batch->writes) {
+                        prev = list_entry (pos->prev,
+                                           struct nfs3_gathered_write, list);
+                        if (prev->offset + prev->vec.iov_len <= gw->offset)
+                                break;
+                        if (prev->offset < end) {
+                                batch = NULL;
+                                break;
+                        }
+                        pos = &prev->list;
+                }
+        }
+
+        if (!batch) {
+                batch = *spare;
+                *spare = NULL;
+                INIT_LIST_HEAD (&batch->writes);
+                batch->gather = gather;
+                batch->startseq = gw->seq;
+                list_add_tail (&batch->list, &gather->batches);
+                pos = &batch->writes;
+        }
+
+        /* Goes right before pos. */
+        list_add_tail (&gw->list, pos);
+        batch->endseq = gw->seq + 1;
+        batch->bytes += gw->vec.iov_len;
+}
+
+
+/* Holds on to an UNSTABLE write to send it later along with its neighbours.
+ * Returns 0 if the write was gathered, in which case it can be replied to
+ * right away.
+ */
+int
+nfs3_write_gather (nfs3_call_state_t *cs)
+{
+        struct nfs3_state               *nfs3 = NULL;
+        struct inode_op_queue           *inode_q = NULL;
+        struct nfs3_write_gather        *gather = NULL;
+        struct nfs3_gathered_write      *gw = NULL;
+        struct nfs3_write_batch         *spare = NULL;
+        struct timeval                  delta = {0, };
+        uint64_t                        total = 0;
+        int                             ret = -ENOMEM;
+
+        if ((!cs) || (!cs->iob) || (!cs->fd))
+                return -EFAULT;
+
+        nfs3 = cs->nfs3state;
+        inode_q = nfs3_get_inode_queue (cs);
+        if (!inode_q)
+                goto err;
+
+        gather = &inode_q->gather;
+        gw = GF_CALLOC (1, sizeof (*gw), gf_nfs_mt_nfs3_gathered_write);
+        if (!gw)
+                goto err;
+
+        spare = GF_CALLOC (1, sizeof (*spare), gf_nfs_mt_nfs3_write_batch);
+        if (!spare)
+                goto err;
+
+        gw->offset = cs->dataoffset;
+        gw->vec = cs->datavec;
+        gw->vec.iov_len = cs->datacount;
+        gw->iob = iobuf_ref (cs->iob);
+        nfs_request_user_init (&gw->nfu, cs->req);
+
+        total = __sync_add_and_fetch (&nfs3->gatheredbytes, cs->datacount);
+        LOCK (&gather->lock);
+        {
+                if (!gather->fd) {
+                        gather->fd = fd_ref (cs->fd);
+                        gather->vol = cs->vol;
+                }
+
+                gw->seq = gather->seq++;
+                __nfs3_write_gather_add (gather, gw, &spare);
+                gather->bytes += cs->datacount;
+                if ((gather->bytes >= nfs3->writegathersize) ||
+                    (total > nfs3->writegathersize *
+                     GF_NFS3_WRITE_GATHER_TOTAL_MULT))
+                        gather->flushseq = gather->seq;
+
+                if ((!gather->timer) && (gather->flushseq < gather->seq)) {
+                        delta.tv_sec = GF_NFS3_WRITE_GATHER_TIMEOUT;
+                        gather->timer = gf_timer_call_after (nfs3->nfsx->ctx,
+                                                             delta,
+                                                  nfs3_write_gather_timeout,
+                                                             gather);
+                        /* Without a timer, do not wait for more. */
+                        if (!gather->timer)
+                                gather->flushseq = gather->seq;
+                }
+        }
+        UNLOCK (&gather->lock);
+
+        if (spare)
+                GF_FREE (spare);
+
+        nfs3_write_gather_send (gather);
+        return 0;
+
+err:
+        gf_log (GF_NFS3, GF_LOG_ERROR, "Failed to gather write");
+        if (gw)
+                GF_FREE (gw);
+        return ret;
+}
+
+
+/* Returns 1 after queueing the call state to be resumed with resume once all
+ * the writes gathered on its inode so far have been written, 0 if there is
+ * nothing to wait for. Waits once per call state.
+ */
+int
+nfs3_write_gather_wait (nfs3_call_state_t *cs, nfs3_resume_fn_t resume)
+{
+        struct nfs3_write_gather        *gather = NULL;
+        int                             wait = 0;
+
+        if ((!cs) || (cs->gatherseq))
+                return 0;
+
+        gather = nfs3_write_gather_get (cs);
+        if (!gather)
+                return 0;
+
+        LOCK (&gather->lock);
+        {
+                if (gather->sentseq < gather->seq) {
+                        wait = 1;
+                        cs->gatherseq = gather->seq;
+                        cs->resume_fn = resume;
+                        list_add_tail (&cs->gatherwait_q, &gather->waiters);
+                        if (gather->flushseq < gather->seq)
+                                gather->flushseq = gather->seq;
+                }
+        }
+        UNLOCK (&gather->lock);
+
+        if (wait) {
+                gf_log (GF_NFS3, GF_LOG_TRACE, "Waiting for gathered writes");
+                nfs3_write_gather_send (gather);
+        }
+
+        return wait;
+}
+
+
+/* Returns and clears the first error in writing gathered data. */
+int
+nfs3_write_gather_error (nfs3_call_state_t *cs)
+{
+        struct nfs3_write_gather        *gather = NULL;
+        int                             op_errno = 0;
+
+        if (!cs)
+                return 0;
+
+        gather = nfs3_write_gather_get (cs);
+        if (!gather)
+                return 0;
+
+        LOCK (&gather->lock);
+        {
+                op_errno = gather->op_errno;
+                gather->op_errno = 0;
+        }
+        UNLOCK (&gather->lock);
+
+        return op_errno;
+}
+
+
 void
 nfs3_stat_to_errstr (uint32_t xid, char *op, nfsstat3 stat, int pstat,
                      char *errstr)
@@ -2513,6 +2982,629 @@ nfs3_log_readdir_call (uint32_t xid, struct nfs3_fh *fh, count3 dircount,
 }
 
 
+static inline unsigned int
+nfs3_fhcache_hash (struct nfs3_state *nfs3, xlator_t *vol, uuid_t gfid)
+{
+        uint32_t        hash = 0;
+
+        /* gfids are random, so any four bytes of one make a good hash. */
+        memcpy (&hash, &gfid[12], sizeof (hash));
+        hash ^= (uint32_t)((unsigned long)vol >> 4);
+
+        return hash & (nfs3->fhbucketcount - 1);
+}
+
+
+struct nfs3_fhcache_entry *
+__nfs3_fhcache_find (struct nfs3_state *nfs3, xlator_t *vol, uuid_t gfid)
+{
+        struct nfs3_fhcache_entry       *fhe = NULL;
+        unsigned int                    bucket = 0;
+
+        bucket = nfs3_fhcache_hash (nfs3, vol, gfid);
+        list_for_each_entry (fhe, &nfs3->fhbuckets[bucket], hash) {
+                if ((fhe->vol == vol) && (uuid_compare (fhe->gfid, gfid) == 0))
+                        return fhe;
+        }
+
+        return NULL;
+}
+
+
+void
+__nfs3_fhcache_remove_entry (struct nfs3_state *nfs3,
+                             struct nfs3_fhcache_entry *fhe)
+{
+        list_del (&fhe->hash);
+        list_del (&fhe->lru);
+        nfs3->fhcacheused -= fhe->size;
+        --nfs3->fhcount;
+        GF_FREE (fhe);
+}
+
+
+/* One entry per line: volume name, gfid and the path, which runs to the end
+ * of the line. Paths containing a newline are simply not persisted.
+ */
+int
+nfs3_fhcache_record (struct nfs3_fhcache_records *records,
+                     struct nfs3_fhcache_entry *fhe)
+{
+        char            *buf = NULL;
+        size_t          size = 0;
+        int             len = 0;
+
+        if (strchr (fhe->path, '\n'))
+                return 0;
+
+        /* volume name, space, gfid, space, path, newline */
+        size = records->len + strlen (fhe->vol->name) + 38 +
+               (fhe->size - sizeof (*fhe)) + 2;
+        if (size > records->size) {
+                size = max (size, 2 * records->size);
+                if (!records->buf)
+                        buf = GF_CALLOC (1, size, gf_nfs_mt_char);
+                else
+                        buf = GF_REALLOC (records->buf, size);
+                if (!buf)
+                        return -1;
+                records->buf = buf;
+                records->size = size;
+        }
+
+        len = snprintf (records->buf + records->len,
+                        records->size - records->len, "%s %s %s\n",
+                        fhe->vol->name, uuid_utoa (fhe->gfid), fhe->path);
+        if ((len < 0) || ((size_t)len >= records->size - records->len))
+                return -1;
+
+        records->len += len;
+        return 0;
+}
+
+
+/* Rewrites the cache file with the given records and re-opens the journal
+ * on it. Called with fhjournallock held.
+ */
+int
+nfs3_fhcache_rewrite (struct nfs3_state *nfs3,
+                      struct nfs3_fhcache_records *records)
+{
+        char                            *tmppath = NULL;
+        FILE                            *fp = NULL;
+        int                             ret = -1;
+
+        if (gf_asprintf (&tmppath, "%s.tmp", nfs3->fhcachefile) < 0)
+                goto out;
+
+        fp = fopen (tmppath, "w");
+        if (!fp) {
+                gf_log (GF_NFS3, GF_LOG_ERROR, "Failed to open %s: %s",
+                        tmppath, strerror (errno));
+                goto out;
+        }
+
+        if (records->len)
+                fwrite (records->buf, 1, records->len, fp);
+
+        ret = fclose (fp);
+        fp = NULL;
+        if ((ret == 0) && (rename (tmppath, nfs3->fhcachefile) == -1))
+                ret = -1;
+        if (ret == -1) {
+                gf_log (GF_NFS3, GF_LOG_ERROR, "Failed to write %s: %s",
+                        nfs3->fhcachefile, strerror (errno));
+                unlink (tmppath);
+                goto out;
+        }
+
+        if (nfs3->fhjournal)
+                fclose (nfs3->fhjournal);
+
+        nfs3->fhjournal = fopen (nfs3->fhcachefile, "a");
+        if (!nfs3->fhjournal) {
+                gf_log (GF_NFS3, GF_LOG_ERROR, "Failed to open %s, handle "
+                        "paths will not be persisted: %s", nfs3->fhcachefile,
+                        strerror (errno));
+                ret = -1;
+                goto out;
+        }
+
+        ret = 0;
+out:
+        if (fp) {
+                fclose (fp);
+                unlink (tmppath);
+        }
+
+        if (tmppath)
+                GF_FREE (tmppath);
+
+        return ret;
+}
+
+
+/* Writes the queued records out, or with a compaction pending, rewrites the
+ * cache file with just the entries in the index, least recently used first
+ * so that loading it back restores the LRU order. The index is only locked
+ * to take the records out, the file is written without it. If somebody is
+ * already at it, the records are left for the next flush.
+ */
+int
+nfs3_fhcache_flush (struct nfs3_state *nfs3)
+{
+        struct nfs3_fhcache_records     records = {0, };
+        struct nfs3_fhcache_entry       *fhe = NULL;
+        int                             compact = 0;
+        int                             ret = 0;
+
+        if (pthread_mutex_trylock (&nfs3->fhjournallock) != 0)
+                return 0;
+
+        LOCK (&nfs3->fhlock);
+        {
+                compact = nfs3->fhcompact;
+                nfs3->fhcompact = 0;
+                nfs3->fhflushed = time (NULL);
+
+                if (!compact) {
+                        records = nfs3->fhpending;
+                        memset (&nfs3->fhpending, 0, sizeof (records));
+                        goto unlock;
+                }
+
+                /* The index has everything that was queued. Even if this
+                 * fails, do not retry on every insert.
+                 */
+                nfs3->fhpending.len = 0;
+                nfs3->fhjournaled = nfs3->fhcount;
+                list_for_each_entry (fhe, &nfs3->fhlru, lru) {
+                        ret = nfs3_fhcache_record (&records, fhe);
+                        if (ret == -1)
+                                break;
+                }
+        }
+unlock:
+        UNLOCK (&nfs3->fhlock);
+
+        if (compact) {
+                if (ret == 0)
+                        ret = nfs3_fhcache_rewrite (nfs3, &records);
+                else
+                        gf_log (GF_NFS3, GF_LOG_ERROR, "Memory allocation "
+                                "failed, not compacting %s",
+                                nfs3->fhcachefile);
+        } else if ((records.len) && (nfs3->fhjournal)) {
+                if ((fwrite (records.buf, 1, records.len, nfs3->fhjournal)
+                     != records.len) || (fflush (nfs3->fhjournal) != 0)) {
+                        gf_log (GF_NFS3, GF_LOG_ERROR, "Failed to write %s:"
+                                " %s", nfs3->fhcachefile, strerror (errno));
+                        ret = -1;
+                }
+        }
+
+        pthread_mutex_unlock (&nfs3->fhjournallock);
+
+        if (records.buf)
+                GF_FREE (records.buf);
+
+        return ret;
+}
+
+
+void
+nfs3_fhcache_flush_timeout (void *data);
+
+/* Called with fhlock held. */
+static void
+__nfs3_fhcache_arm_timer (struct nfs3_state *nfs3)
+{
+        struct timeval  delta = {0, };
+
+        delta.tv_sec = GF_NFS3_FHCACHE_JOURNAL_SECS;
+        nfs3->fhtimer = gf_timer_call_after (nfs3->nfsx->ctx, delta,
+                                             nfs3_fhcache_flush_timeout, nfs3);
+        if (!nfs3->fhtimer)
+                gf_log (GF_NFS3, GF_LOG_WARNING, "Failed to start the fh "
+                        "cache flush timer, records are only written out "
+                        "by later inserts");
+}
+
+
+/* Writes out the records an idle server would otherwise sit on. */
+void
+nfs3_fhcache_flush_timeout (void *data)
+{
+        struct nfs3_state       *nfs3 = NULL;
+        gf_timer_t              *timer = NULL;
+        int                     flush = 0;
+
+        nfs3 = data;
+        LOCK (&nfs3->fhlock);
+        {
+                /* stopped by nfs3_fhcache_fini */
+                timer = nfs3->fhtimer;
+                if (!timer)
+                        goto unlock;
+
+                __nfs3_fhcache_arm_timer (nfs3);
+                flush = (nfs3->fhpending.len != 0);
+        }
+unlock:
+        UNLOCK (&nfs3->fhlock);
+
+        if (!timer)
+                return;
+
+        gf_timer_call_cancel (nfs3->nfsx->ctx, timer);
+
+        if (flush)
+                nfs3_fhcache_flush (nfs3);
+}
+
+
+/* Returns 1 if a new entry was added, 0 if the gfid was already known at
+ * this path and -1 on failure. Adding an entry evicts the least recently
+ * used ones beyond the configured size.
+ */
+int
+__nfs3_fhcache_insert (struct nfs3_state *nfs3, xlator_t *vol, uuid_t gfid,
+                       const char *path, size_t len, int journal)
+{
+        struct nfs3_fhcache_entry       *fhe = NULL;
+        struct nfs3_fhcache_entry       *victim = NULL;
+        size_t                          size = 0;
+
+        size = sizeof (*fhe) + len + 1;
+        fhe = __nfs3_fhcache_find (nfs3, vol, gfid);
+        if (fhe) {
+                if ((fhe->size == size) &&
+                    (strncmp (fhe->path, path, len) == 0)) {
+                        list_move_tail (&fhe->lru, &nfs3->fhlru);
+                        return 0;
+                }
+
+                /* Renamed, the old path is of no use any more. */
+                __nfs3_fhcache_remove_entry (nfs3, fhe);
+        }
+
+        fhe = GF_CALLOC (1, size, gf_nfs_mt_nfs3_fhcache_entry);
+        if (!fhe) {
+                gf_log (GF_NFS3, GF_LOG_ERROR, "fh cache entry allocation "
+                        "failed");
+                return -1;
+        }
+
+        fhe->vol = vol;
+        uuid_copy (fhe->gfid, gfid);
+        fhe->size = size;
+        memcpy (fhe->path, path, len);
+        list_add (&fhe->hash,
+                  &nfs3->fhbuckets[nfs3_fhcache_hash (nfs3, vol, gfid)]);
+        list_add_tail (&fhe->lru, &nfs3->fhlru);
+        nfs3->fhcacheused += size;
+        ++nfs3->fhcount;
+
+        if ((journal) && (nfs3->fhcachefile) &&
+            (nfs3_fhcache_record (&nfs3->fhpending, fhe) == 0))
+                ++nfs3->fhjournaled;
+
+        while (nfs3->fhcacheused > nfs3->fhcachesize) {
+                victim = list_entry (nfs3->fhlru.next,
+                                     struct nfs3_fhcache_entry, lru);
+                if (victim == fhe)
+                        break;
+                __nfs3_fhcache_remove_entry (nfs3, victim);
+        }
+
+        return 1;
+}
+
+
+int
+nfs3_fhcache_add (struct nfs3_state *nfs3, xlator_t *vol, uuid_t gfid,
+                  const char *path, size_t len)
+{
+        int     ret = 0;
+        int     flush = 0;
+
+        if ((!nfs3) || (!vol) || (!path))
+                return -1;
+
+        if (!nfs3->fhbuckets)
+                return 0;
+
+        /* The root handle is always resolvable without help. */
+        if ((len == 0) || ((len == 1) && (path[0] == '/')))
+                return 0;
+
+        LOCK (&nfs3->fhlock);
+        {
+                ret = __nfs3_fhcache_insert (nfs3, vol, gfid, path, len, 1);
+                if ((ret != 1) || (!nfs3->fhcachefile))
+                        goto unlock;
+
+                /* Entries for evicted or renamed files accumulate in the
+                 * journal, drop them once they are the majority.
+                 */
+                if (nfs3->fhjournaled > 2 * nfs3->fhcount +
+                    GF_NFS3_FHCACHE_MIN_BUCKETS)
+                        nfs3->fhcompact = 1;
+
+                flush = ((nfs3->fhcompact) ||
+                         (nfs3->fhpending.len >=
+                          GF_NFS3_FHCACHE_JOURNAL_BATCH) ||
+                         (time (NULL) - nfs3->fhflushed >=
+                          GF_NFS3_FHCACHE_JOURNAL_SECS));
+        }
+unlock:
+        UNLOCK (&nfs3->fhlock);
+
+        if (flush)
+                nfs3_fhcache_flush (nfs3);
+
+        return ret;
+}
+
+
+/* Returns a copy of the path the gfid was last seen at, or NULL. */
+char *
+nfs3_fhcache_get_path (struct nfs3_state *nfs3, xlator_t *vol, uuid_t gfid)
+{
+        struct nfs3_fhcache_entry       *fhe = NULL;
+        char                            *path = NULL;
+
+        if ((!nfs3) || (!vol) || (!nfs3->fhbuckets))
+                return NULL;
+
+        LOCK (&nfs3->fhlock);
+        {
+                fhe = __nfs3_fhcache_find (nfs3, vol, gfid);
+                if (fhe) {
+                        list_move_tail (&fhe->lru, &nfs3->fhlru);
+                        path = gf_strdup (fhe->path);
+                } else
+                        ++nfs3->fhmisses;
+        }
+        UNLOCK (&nfs3->fhlock);
+
+        return path;
+}
+
+
+void
+nfs3_fhcache_resolved (struct nfs3_state *nfs3, xlator_t *vol, uuid_t gfid,
+                       int stale)
+{
+        struct nfs3_fhcache_entry       *fhe = NULL;
+
+        LOCK (&nfs3->fhlock);
+        {
+                if (!stale) {
+                        ++nfs3->fhhits;
+                        goto unlock;
+                }
+
+                ++nfs3->fhstale;
+                fhe = __nfs3_fhcache_find (nfs3, vol, gfid);
+                if (fhe)
+                        __nfs3_fhcache_remove_entry (nfs3, fhe);
+        }
+unlock:
+        UNLOCK (&nfs3->fhlock);
+}
+
+
+xlator_t *
+nfs3_fhcache_volume (struct nfs3_state *nfs3, const char *volname)
+{
+        struct nfs3_export      *exp = NULL;
+
+        list_for_each_entry (exp, &nfs3->exports, explist) {
+                if (strcmp (exp->subvol->name, volname) == 0)
+                        return exp->subvol;
+        }
+
+        return NULL;
+}
+
+
+int
+__nfs3_fhcache_load (struct nfs3_state *nfs3)
+{
+        FILE            *fp = NULL;
+        char            *line = NULL;
+        char            *gfidstr = NULL;
+        char            *path = NULL;
+        xlator_t        *vol = NULL;
+        uuid_t          gfid = {0, };
+        size_t          len = 0;
+        int             skipping = 0;
+        uint64_t        loaded = 0;
+        int             ret = -1;
+
+        fp = fopen (nfs3->fhcachefile, "r");
+        if (!fp) {
+                if (errno == ENOENT)
+                        return 0;
+                gf_log (GF_NFS3, GF_LOG_ERROR, "Failed to open %s: %s",
+                        nfs3->fhcachefile, strerror (errno));
+                return -1;
+        }
+
+        line = GF_CALLOC (1, GF_NFS3_FHCACHE_LINE_MAX, gf_nfs_mt_char);
+        if (!line) {
+                gf_log (GF_NFS3, GF_LOG_ERROR, "Memory allocation failed");
+                goto out;
+        }
+
+        while (fgets (line, GF_NFS3_FHCACHE_LINE_MAX, fp)) {
+                len = strlen (line);
+                /* Lines that do not fit are skipped to their end. */
+                if ((len == 0) || (line[len - 1] != '\n')) {
+                        skipping = 1;
+                        continue;
+                }
+
+                line[--len] = '\0';
+                if (skipping) {
+                        skipping = 0;
+                        continue;
+                }
+
+                gfidstr = strchr (line, ' ');
+                if (!gfidstr)
+                        continue;
+                *gfidstr++ = '\0';
+
+                path = strchr (gfidstr, ' ');
+                if (!path)
+                        continue;
+                *path++ = '\0';
+
+                if ((path[0] != '/') || (uuid_parse (gfidstr, gfid) != 0))
+                        continue;
+
+                /* Volumes that are no longer exported are dropped here and
+                 * by the compaction that follows.
+                 */
+                vol = nfs3_fhcache_volume (nfs3, line);
+                if (!vol)
+                        continue;
+
+                if (__nfs3_fhcache_insert (nfs3, vol, gfid, path,
+                                           strlen (path), 0) == 1)
+                        ++loaded;
+        }
+
+        gf_log (GF_NFS3, GF_LOG_INFO, "Loaded %"PRIu64" handle paths from %s",
+                loaded, nfs3->fhcachefile);
+        ret = 0;
+out:
+        if (line)
+                GF_FREE (line);
+
+        fclose (fp);
+        return ret;
+}
+
+
+int
+nfs3_fhcache_init (struct nfs3_state *nfs3)
+{
+        unsigned int    buckets = GF_NFS3_FHCACHE_MIN_BUCKETS;
+        unsigned int    i = 0;
+
+        if (!nfs3)
+                return -1;
+
+        INIT_LIST_HEAD (&nfs3->fhlru);
+        LOCK_INIT (&nfs3->fhlock);
+        pthread_mutex_init (&nfs3->fhjournallock, NULL);
+        if (nfs3->fhcachesize == 0) {
+                gf_log (GF_NFS3, GF_LOG_DEBUG, "fh cache disabled");
+                return 0;
+        }
+
+        while (buckets < nfs3->fhcachesize / GF_NFS3_FHCACHE_AVG_ENTRY)
+                buckets <<= 1;
+
+        nfs3->fhbuckets = GF_CALLOC (buckets, sizeof (struct list_head),
+                                     gf_nfs_mt_list_head);
+        if (!nfs3->fhbuckets) {
+                gf_log (GF_NFS3, GF_LOG_ERROR, "Memory allocation failed");
+                return -1;
+        }
+
+        for (i = 0; i < buckets; i++)
+                INIT_LIST_HEAD (&nfs3->fhbuckets[i]);
+        nfs3->fhbucketcount = buckets;
+
+        if (!nfs3->fhcachefile)
+                return 0;
+
+        /* A cache file that cannot be read or written only costs us the
+         * warm start, so none of this is fatal.
+         */
+        LOCK (&nfs3->fhlock);
+        {
+                __nfs3_fhcache_load (nfs3);
+                nfs3->fhcompact = 1;
+        }
+        UNLOCK (&nfs3->fhlock);
+
+        nfs3_fhcache_flush (nfs3);
+
+        LOCK (&nfs3->fhlock);
+        {
+                __nfs3_fhcache_arm_timer (nfs3);
+        }
+        UNLOCK (&nfs3->fhlock);
+
+        return 0;
+}
+
+
+/* Stops the flush timer and writes out whatever is still queued. */
+void
+nfs3_fhcache_fini (struct nfs3_state *nfs3)
+{
+        gf_timer_t      *timer = NULL;
+
+        if ((!nfs3) || (!nfs3->fhbuckets) || (!nfs3->fhcachefile))
+                return;
+
+        LOCK (&nfs3->fhlock);
+        {
+                timer = nfs3->fhtimer;
+                nfs3->fhtimer = NULL;
+        }
+        UNLOCK (&nfs3->fhlock);
+
+        if (timer)
+                gf_timer_call_cancel (nfs3->nfsx->ctx, timer);
+
+        nfs3_fhcache_flush (nfs3);
+}
+
+
+void
+nfs3_fhcache_dump (struct nfs3_state *nfs3)
+{
+        char    key[GF_DUMP_MAX_BUF_LEN];
+        char    key_prefix[GF_DUMP_MAX_BUF_LEN];
+
+        if (!nfs3)
+                return;
+
+        gf_proc_dump_build_key (key_prefix, "xlator.nfs", "nfs3.fhcache");
+        gf_proc_dump_add_section (key_prefix);
+
+        gf_proc_dump_build_key (key, key_prefix, "size");
+        gf_proc_dump_write (key, "%"GF_PRI_SIZET, nfs3->fhcachesize);
+
+        gf_proc_dump_build_key (key, key_prefix, "used");
+        gf_proc_dump_write (key, "%"GF_PRI_SIZET, nfs3->fhcacheused);
+
+        gf_proc_dump_build_key (key, key_prefix, "entries");
+        gf_proc_dump_write (key, "%"PRIu64, nfs3->fhcount);
+
+        gf_proc_dump_build_key (key, key_prefix, "hits");
+        gf_proc_dump_write (key, "%"PRIu64, nfs3->fhhits);
+
+        gf_proc_dump_build_key (key, key_prefix, "misses");
+        gf_proc_dump_write (key, "%"PRIu64, nfs3->fhmisses);
+
+        gf_proc_dump_build_key (key, key_prefix, "stale");
+        gf_proc_dump_write (key, "%"PRIu64, nfs3->fhstale);
+
+        if (nfs3->fhcachefile) {
+                gf_proc_dump_build_key (key, key_prefix, "file");
+                gf_proc_dump_write (key, "%s", nfs3->fhcachefile);
+        }
+}
+
+
 int
 nfs3_fh_resolve_inode_done (nfs3_call_state_t *cs, inode_t *inode)
 {
@@ -2610,6 +3702,12 @@ nfs3_fh_resolve_entry_lookup_cbk (call_frame_t *frame, void *cookie,
                 inode_lookup (linked_inode);
                 inode_unref (linked_inode);
         }
+
+        /* Found by the hard resolution, save the next one the walk. */
+        if (!cs->resolventry)
+                nfs3_fhcache_add (cs->nfs3state, cs->vol, buf->ia_gfid,
+                                  cs->resolvedloc.path,
+                                  strlen (cs->resolvedloc.path));
 err:
         nfs3_call_resume (cs);
         return 0;
@@ -2645,6 +3743,11 @@ nfs3_fh_resolve_found_entry (nfs3_call_state_t *cs, gf_dirent_t *candidate)
                                   cs);
         } else {
                 gf_log (GF_NFS3, GF_LOG_TRACE, "Entry got from itable");
+                if (ret == 0)
+                        nfs3_fhcache_add (cs->nfs3state, cs->vol,
+                                          cs->resolvedloc.inode->gfid,
+                                          cs->resolvedloc.path,
+                                          strlen (cs->resolvedloc.path));
                 nfs3_call_resume (cs);
         }
 
@@ -3039,6 +4142,181 @@ out:
 }
 
 
+/* The path in the fh cache did not lead to the handle's gfid, forget it and
+ * fall back to resolving with the hashes in the handle.
+ */
+int
+nfs3_fh_resolve_cached_fallback (nfs3_call_state_t *cs)
+{
+        gf_log (GF_NFS3, GF_LOG_TRACE, "Cached path is stale: %s, gfid: %s",
+                cs->resolvepath, uuid_utoa (cs->resolvefh.gfid));
+        nfs3_fhcache_resolved (cs->nfs3state, cs->vol, cs->resolvefh.gfid, 1);
+        return nfs3_fh_resolve_inode_hard (cs);
+}
+
+
+int32_t
+nfs3_fh_resolve_cached_lookup_cbk (call_frame_t *frame, void *cookie,
+                                   xlator_t *this, int32_t op_ret,
+                                   int32_t op_errno, inode_t *inode,
+                                   struct iatt *buf, dict_t *xattr,
+                                   struct iatt *postparent);
+
+/* Links the components of the cached path into the inode table, one lookup
+ * for each that is not already there, and checks that the path still leads
+ * to the gfid in the handle.
+ */
+int
+nfs3_fh_resolve_cached_walk (nfs3_call_state_t *cs)
+{
+        inode_table_t   *itable = NULL;
+        inode_t         *parent = NULL;
+        inode_t         *entry = NULL;
+        char            *pathcopy = NULL;
+        char            *component = NULL;
+        char            *saveptr = NULL;
+        nfs_user_t      nfu = {0, };
+        int             ret = -EFAULT;
+
+        itable = cs->vol->itable;
+        pathcopy = gf_strdup (cs->resolvepath);
+        if (!pathcopy)
+                return nfs3_fh_resolve_cached_fallback (cs);
+
+        parent = inode_ref (itable->root);
+        component = strtok_r (pathcopy, "/", &saveptr);
+        while (component) {
+                entry = inode_grep (itable, parent, component);
+                if (!entry)
+                        break;
+
+                inode_unref (parent);
+                parent = entry;
+                component = strtok_r (NULL, "/", &saveptr);
+        }
+
+        if (!component) {
+                if (uuid_compare (parent->gfid, cs->resolvefh.gfid) != 0) {
+                        ret = nfs3_fh_resolve_cached_fallback (cs);
+                        goto out;
+                }
+
+                gf_log (GF_NFS3, GF_LOG_TRACE, "FH resolved from cached path:"
+                        " %s", cs->resolvepath);
+                nfs3_fhcache_resolved (cs->nfs3state, cs->vol,
+                                       cs->resolvefh.gfid, 0);
+                if (cs->resolventry)
+                        ret = nfs3_fh_resolve_entry_hard (cs);
+                else
+                        ret = nfs3_fh_resolve_inode_done (cs, parent);
+                goto out;
+        }
+
+        nfs_loc_wipe (&cs->resolvedloc);
+        ret = nfs_entry_loc_fill (itable, parent->gfid, component,
+                                  &cs->resolvedloc, NFS_RESOLVE_CREATE);
+        if (ret == 0) {
+                /* Linked in by someone else meanwhile. */
+                ret = nfs3_fh_resolve_cached_walk (cs);
+                goto out;
+        } else if (ret != -2) {
+                ret = nfs3_fh_resolve_cached_fallback (cs);
+                goto out;
+        }
+
+        gf_log (GF_NFS3, GF_LOG_TRACE, "Cached path component needs lookup:"
+                " %s", cs->resolvedloc.path);
+        nfs_user_root_create (&nfu);
+        ret = nfs_lookup (cs->nfsx, cs->vol, &nfu, &cs->resolvedloc,
+                          nfs3_fh_resolve_cached_lookup_cbk, cs);
+        if (ret < 0)
+                ret = nfs3_fh_resolve_cached_fallback (cs);
+
+out:
+        inode_unref (parent);
+        GF_FREE (pathcopy);
+        return ret;
+}
+
+
+int32_t
+nfs3_fh_resolve_cached_lookup_cbk (call_frame_t *frame, void *cookie,
+                                   xlator_t *this, int32_t op_ret,
+                                   int32_t op_errno, inode_t *inode,
+                                   struct iatt *buf, dict_t *xattr,
+                                   struct iatt *postparent)
+{
+        nfs3_call_state_t       *cs = NULL;
+        inode_t                 *linked_inode = NULL;
+
+        cs = frame->local;
+        if (op_ret == -1) {
+                gf_log (GF_NFS3, GF_LOG_TRACE, "Lookup failed: %s: %s",
+                        cs->resolvedloc.path, strerror (op_errno));
+                nfs3_fh_resolve_cached_fallback (cs);
+                goto err;
+        }
+
+        linked_inode = inode_link (inode, cs->resolvedloc.parent,
+                                   cs->resolvedloc.name, buf);
+        if (!linked_inode) {
+                nfs3_fh_resolve_cached_fallback (cs);
+                goto err;
+        }
+
+        inode_lookup (linked_inode);
+        inode_unref (linked_inode);
+        nfs3_fh_resolve_cached_walk (cs);
+
+err:
+        return 0;
+}
+
+
+/* Tries the path the handle's gfid was last seen at before resorting to
+ * nfs3_fh_resolve_inode_hard. Only done once per call so that a path that
+ * keeps dropping out of the inode table cannot keep us going in circles.
+ */
+int
+nfs3_fh_resolve_cached (nfs3_call_state_t *cs)
+{
+        if (!cs)
+                return -EFAULT;
+
+        if (!cs->resolvepath)
+                cs->resolvepath = nfs3_fhcache_get_path (cs->nfs3state,
+                                                         cs->vol,
+                                                         cs->resolvefh.gfid);
+        else
+                return nfs3_fh_resolve_inode_hard (cs);
+
+        if (!cs->resolvepath)
+                return nfs3_fh_resolve_inode_hard (cs);
+
+        gf_log (GF_NFS3, GF_LOG_TRACE, "FH resolution from cached path: %s",
+                cs->resolvepath);
+        return nfs3_fh_resolve_cached_walk (cs);
+}
+
+
+/* Remembers the path of the directory an entry is being resolved in. */
+void
+nfs3_fh_resolve_cache_parent (nfs3_call_state_t *cs)
+{
+        char    *sep = NULL;
+
+        if (!cs->resolvedloc.path)
+                return;
+
+        sep = strrchr (cs->resolvedloc.path, '/');
+        if (!sep)
+                return;
+
+        nfs3_fhcache_add (cs->nfs3state, cs->vol, cs->resolvefh.gfid,
+                          cs->resolvedloc.path, sep - cs->resolvedloc.path);
+}
+
+
 int
 nfs3_fh_resolve_entry_hard (nfs3_call_state_t *cs)
 {
@@ -3058,6 +4336,13 @@ nfs3_fh_resolve_entry_hard (nfs3_call_state_t *cs)
                                   cs->resolventry, &cs->resolvedloc,
                                   NFS_RESOLVE_CREATE);
 
+        /* Only remember a parent the hash walk had to find, taking the
+         * index lock for every one found in the inode table would put it
+         * on the path of every call.
+         */
+        if (((ret == 0) || (ret == -2)) && (cs->hashidx))
+                nfs3_fh_resolve_cache_parent (cs);
+
         if (ret == -2) {
                 gf_log (GF_NFS3, GF_LOG_TRACE, "Entry needs lookup: %s",
                         cs->resolvedloc.path);
@@ -3072,7 +4357,7 @@ nfs3_fh_resolve_entry_hard (nfs3_call_state_t *cs)
         } else if (ret == -1) {
                 gf_log (GF_NFS3, GF_LOG_TRACE, "Entry needs parent lookup: %s",
                         cs->resolvedloc.path);
-                ret = nfs3_fh_resolve_inode_hard (cs);
+                ret = nfs3_fh_resolve_cached (cs);
         } else if (ret == 0) {
                 cs->resolve_ret = 0;
                 nfs3_call_resume (cs);
@@ -3093,7 +4378,7 @@ nfs3_fh_resolve_inode (nfs3_call_state_t *cs)
         gf_log (GF_NFS3, GF_LOG_TRACE, "FH needs inode resolution");
         inode = inode_find (cs->vol->itable, cs->resolvefh.gfid);
         if (!inode)
-                ret = nfs3_fh_resolve_inode_hard (cs);
+                ret = nfs3_fh_resolve_cached (cs);
         else
                 ret = nfs3_fh_resolve_inode_done (cs, inode);
 
@@ -346,4 +346,20 @@ nfs3_fdcache_remove (struct nfs3_state *nfs3, fd_t *fd);
 
 extern int
 nfs3_is_parentdir_entry (char *entry);
+
+extern int
+nfs3_fhcache_init (struct nfs3_state *nfs3);
+
+extern int
+nfs3_write_gather (nfs3_call_state_t *cs);
+
+extern int
+nfs3_write_gather_wait (nfs3_call_state_t *cs, nfs3_resume_fn_t resume);
+
+extern int
+nfs3_write_gather_error (nfs3_call_state_t *cs);
+
+extern int
+nfs3_fhcache_add (struct nfs3_state *nfs3, xlator_t *vol, uuid_t gfid,
+                  const char *path, size_t len);
 #endif
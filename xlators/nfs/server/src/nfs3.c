@@ -418,6 +418,9 @@ nfs3_call_state_wipe (nfs3_call_state_t *cs)
         if (cs->pathname)
                 GF_FREE (cs->pathname);
 
+        if (cs->resolvepath)
+                GF_FREE (cs->resolvepath);
+
         if (!list_empty (&cs->entries.list))
                 gf_dirent_free (&cs->entries);
 
@@ -935,6 +938,11 @@ nfs3_setattr_resume (void *carg)
 
         cs = (nfs3_call_state_t *)carg;
         nfs3_check_fh_resolve_status (cs, stat, nfs3err);
+        /* A truncate must not be overtaken by gathered writes. */
+        if ((gf_attr_size_set (cs->setattr_valid)) &&
+            (nfs3_write_gather_wait (cs, nfs3_setattr_resume)))
+                return 0;
+
         nfs_request_user_init (&nfu, cs->req);
         /* If no ctime check is required, head straight to setting the attrs. */
         if (cs->sattrguardcheck)
@@ -1725,6 +1733,9 @@ nfs3_read_fd_resume (void *carg)
 
         cs = (nfs3_call_state_t *)carg;
         nfs3_check_fh_resolve_status (cs, stat, nfs3err);
+        if (nfs3_write_gather_wait (cs, nfs3_read_fd_resume))
+                return 0;
+
         nfs_request_user_init (&nfu, cs->req);
         ret = nfs_read (cs->nfsx, cs->vol, &nfu, cs->fd, cs->datacount,
                         cs->dataoffset, nfs3svc_read_cbk, cs);
@@ -1948,7 +1959,8 @@ err:
  *| COMMIT      ||    fsync     | getattr      |
  *+============================================+
  *
- *
+ * Without either option, UNSTABLE writes are gathered, see nfs3_write_resume,
+ * and COMMIT waits for the gathered writes to be sent before the fsync.
  */
 int32_t
 nfs3svc_write_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
@@ -2036,6 +2048,31 @@ __nfs3_write_resume (nfs3_call_state_t *cs)
 }
 
 
+/* UNSTABLE writes are held back to be sent later coalesced with their
+ * neighbours, and replied to right away with the server start-up time as
+ * the verifier. A client that sees the verifier change on COMMIT knows to
+ * send its uncommitted writes again.
+ */
+int
+nfs3_write_gathered_reply (nfs3_call_state_t *cs)
+{
+        struct iatt             prestat = {0, };
+        struct iatt             poststat = {0, };
+        struct nfs3_state       *nfs3 = NULL;
+
+        nfs3 = cs->nfs3state;
+        /* We do not know the attributes without asking the volume, zero
+         * filled ones are not sent to the client.
+         */
+        nfs3_log_write_res (nfs_rpcsvc_request_xid (cs->req), NFS3_OK, 0,
+                            cs->datacount, UNSTABLE, nfs3->serverstart);
+        nfs3_write_reply (cs->req, NFS3_OK, cs->datacount, UNSTABLE,
+                          nfs3->serverstart, &prestat, &poststat);
+        nfs3_call_state_wipe (cs);
+        return 0;
+}
+
+
 int
 nfs3_write_resume (void *carg)
 {
@@ -2049,6 +2086,17 @@ nfs3_write_resume (void *carg)
         cs = (nfs3_call_state_t *)carg;
         nfs3_check_fh_resolve_status (cs, stat, nfs3err);
 
+        if ((cs->writetype == UNSTABLE) && (cs->nfs3state->writegathersize) &&
+            (!nfs3_export_write_trusted (cs->nfs3state,
+                                         cs->resolvefh.exportid))) {
+                if (nfs3_write_gather (cs) == 0)
+                        return nfs3_write_gathered_reply (cs);
+        }
+
+        /* Anything else must not overtake the writes gathered before it. */
+        if (nfs3_write_gather_wait (cs, nfs3_write_resume))
+                return 0;
+
         ret = __nfs3_write_resume (cs);
         if (ret < 0)
                 stat = nfs3_errno_to_nfsstat3 (-ret);
@@ -4785,6 +4833,7 @@ nfs3_commit_resume (void *carg)
 {
         nfsstat3                stat = NFS3ERR_SERVERFAULT;
         int                     ret = -EFAULT;
+        int                     op_errno = 0;
         nfs_user_t              nfu = {0, };
         nfs3_call_state_t       *cs = NULL;
 
@@ -4794,6 +4843,19 @@ nfs3_commit_resume (void *carg)
         cs = (nfs3_call_state_t *)carg;
         nfs3_check_fh_resolve_status (cs, stat, nfs3err);
 
+        if (nfs3_write_gather_wait (cs, nfs3_commit_resume))
+                return 0;
+
+        /* Gathered writes that failed were already replied to as UNSTABLE,
+         * this is where the client hears about it.
+         */
+        op_errno = nfs3_write_gather_error (cs);
+        if (op_errno) {
+                ret = -op_errno;
+                stat = nfs3_errno_to_nfsstat3 (op_errno);
+                goto nfs3err;
+        }
+
         if (nfs3_export_sync_trusted (cs->nfs3state, cs->resolvefh.exportid)) {
                 ret = -1;
                 stat = NFS3_OK;
@@ -5037,6 +5099,69 @@ nfs3_init_options (struct nfs3_state *nfs3, xlator_t *nfsx)
                 }
         }
 
+        /* nfs3.fh-cache-size */
+        nfs3->fhcachesize = GF_NFS3_FHCACHE_SIZE;
+        if (dict_get (nfsx->options, "nfs3.fh-cache-size")) {
+                ret = dict_get_str (nfsx->options, "nfs3.fh-cache-size",
+                                    &optstr);
+                if (ret < 0) {
+                        gf_log (GF_NFS3, GF_LOG_ERROR, "Failed to read"
+                                " option: nfs3.fh-cache-size");
+                        ret = -1;
+                        goto err;
+                }
+
+                ret = gf_string2bytesize (optstr, &size64);
+                nfs3->fhcachesize = size64;
+                if (ret == -1) {
+                        gf_log (GF_NFS3, GF_LOG_ERROR, "Failed to format"
+                                " option: nfs3.fh-cache-size");
+                        ret = -1;
+                        goto err;
+                }
+        }
+
+        /* nfs3.write-gather-size */
+        nfs3->writegathersize = GF_NFS3_WRITE_GATHER_SIZE;
+        if (dict_get (nfsx->options, "nfs3.write-gather-size")) {
+                ret = dict_get_str (nfsx->options, "nfs3.write-gather-size",
+                                    &optstr);
+                if (ret < 0) {
+                        gf_log (GF_NFS3, GF_LOG_ERROR, "Failed to read"
+                                " option: nfs3.write-gather-size");
+                        ret = -1;
+                        goto err;
+                }
+
+                ret = gf_string2bytesize (optstr, &size64);
+                nfs3->writegathersize = size64;
+                if (ret == -1) {
+                        gf_log (GF_NFS3, GF_LOG_ERROR, "Failed to format"
+                                " option: nfs3.write-gather-size");
+                        ret = -1;
+                        goto err;
+                }
+        }
+
+        /* nfs3.fh-cache-file */
+        if (dict_get (nfsx->options, "nfs3.fh-cache-file")) {
+                ret = dict_get_str (nfsx->options, "nfs3.fh-cache-file",
+                                    &optstr);
+                if (ret < 0) {
+                        gf_log (GF_NFS3, GF_LOG_ERROR, "Failed to read"
+                                " option: nfs3.fh-cache-file");
+                        ret = -1;
+                        goto err;
+                }
+
+                nfs3->fhcachefile = gf_strdup (optstr);
+                if (!nfs3->fhcachefile) {
+                        gf_log (GF_NFS3, GF_LOG_ERROR, "Memory allocation"
+                                " failed");
+                        ret = -1;
+                        goto err;
+                }
+        }
 
         /* We want to use the size of the biggest param for the io buffer size.
          */
@@ -5336,6 +5461,13 @@ nfs3_init_state (xlator_t *nfsx)
         LOCK_INIT (&nfs3->fdlrulock);
         nfs3->fdcount = 0;
 
+        /* Needs the exports to map volume names in the cache file. */
+        ret = nfs3_fhcache_init (nfs3);
+        if (ret == -1) {
+                gf_log (GF_NFS3, GF_LOG_ERROR, "Failed to init fh cache");
+                goto free_localpool;
+        }
+
         ret = 0;
 
 free_localpool:
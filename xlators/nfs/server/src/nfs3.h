@@ -34,6 +34,7 @@
 #include "nfs-common.h"
 #include "xdr-nfs3.h"
 #include "mem-pool.h"
+#include "timer.h"
 
 #include <sys/statvfs.h>
 
@@ -80,6 +81,62 @@ struct nfs3_fd_entry {
         struct list_head        list;
 };
 
+/* Default upper bound on the memory used by the gfid to path index. */
+#define GF_NFS3_FHCACHE_SIZE            (32 * GF_UNIT_MB)
+
+/* Expected average footprint of an index entry, used to size the hash
+ * table from the memory bound.
+ */
+#define GF_NFS3_FHCACHE_AVG_ENTRY       256
+#define GF_NFS3_FHCACHE_MIN_BUCKETS     1024
+#define GF_NFS3_FHCACHE_LINE_MAX        (NFS_PATH_MAX + 128)
+
+/* New entries are queued in memory and appended to the cache file once this
+ * many bytes are waiting or the last write is this many seconds old. A timer
+ * with the same period writes out what an idle server still has queued.
+ */
+#define GF_NFS3_FHCACHE_JOURNAL_BATCH   (64 * GF_UNIT_KB)
+#define GF_NFS3_FHCACHE_JOURNAL_SECS    5
+
+/* Index from a handle's gfid to the path it was last resolved at. Handles
+ * whose inodes have dropped out of the inode table, e.g. after a restart,
+ * are resolved by looking up this path instead of walking the directory
+ * tree with the hashes in the handle.
+ */
+struct nfs3_fhcache_entry {
+        struct list_head        hash;
+        struct list_head        lru;
+        xlator_t                *vol;
+        uuid_t                  gfid;
+        size_t                  size;
+        char                    path[0];
+};
+
+/* Cache file lines waiting to be written out. */
+struct nfs3_fhcache_records {
+        char                    *buf;
+        size_t                  len;
+        size_t                  size;
+};
+
+/* UNSTABLE writes are gathered per inode and sent to the volume once this
+ * many bytes have been gathered, on COMMIT or after the timeout, coalescing
+ * adjacent writes into one writev.
+ */
+#define GF_NFS3_WRITE_GATHER_SIZE       (1 * GF_UNIT_MB)
+#define GF_NFS3_WRITE_GATHER_TIMEOUT    1
+
+/* Bound on the writes gathered over all files, as a multiple of the per
+ * file size. Beyond it gathered writes are sent right away.
+ */
+#define GF_NFS3_WRITE_GATHER_TOTAL_MULT 64
+
+/* Most iovecs coalesced into one writev. The client transports copy a
+ * request into MAX_IOVEC (16) slots, of which the rpc and program headers
+ * take some, so stay at MAX_IOVEC - 3.
+ */
+#define GF_NFS3_WRITE_GATHER_MAX_IOV    13
+
 /* Per subvolume nfs3 specific state */
 struct nfs3_export {
         struct list_head        explist;
@@ -133,6 +190,37 @@ struct nfs3_state {
         struct list_head        fdlru;
         gf_lock_t               fdlrulock;
         int                     fdcount;
+
+        /* gfid to path index for handle resolution, see nfs3_fhcache_*.
+         * Disabled when fhcachesize is 0. When fhcachefile is set, new
+         * entries are appended to it and it is loaded back on start-up.
+         * fhlock guards the index and the queued records, the cache file
+         * itself is only written under fhjournallock.
+         */
+        struct list_head        *fhbuckets;
+        unsigned int            fhbucketcount;
+        struct list_head        fhlru;
+        gf_lock_t               fhlock;
+        size_t                  fhcachesize;
+        size_t                  fhcacheused;
+        uint64_t                fhcount;
+        char                    *fhcachefile;
+        FILE                    *fhjournal;
+        pthread_mutex_t         fhjournallock;
+        struct nfs3_fhcache_records fhpending;
+        time_t                  fhflushed;
+        gf_timer_t              *fhtimer;
+        int                     fhcompact;
+        uint64_t                fhjournaled;
+        uint64_t                fhhits;
+        uint64_t                fhmisses;
+        uint64_t                fhstale;
+
+        /* Write gathering, 0 disables it. gatheredbytes counts the bytes held
+         * over all files until they have been written.
+         */
+        size_t                  writegathersize;
+        uint64_t                gatheredbytes;
 };
 
 typedef enum nfs3_lookup_type {
@@ -202,17 +290,74 @@ struct nfs3_local {
         int                     hashidx;
         fd_t                    *resolve_dir_fd;
         char                    *resolventry;
+        char                    *resolvepath;
         nfs3_lookup_type_t      lookuptype;
+
+        /* Hook and sequence number used while waiting for gathered writes
+         * to be sent, see nfs3_write_gather_wait.
+         */
+        struct list_head        gatherwait_q;
+        uint64_t                gatherseq;
 };
 
 #define nfs3_is_revalidate_lookup(cst) ((cst)->lookuptype == GF_NFS3_REVALIDATE)
 #define nfs3_lookup_op(cst) (nfs_rpcsvc_request_procnum(cst->req) == NFS3_LOOKUP)
 typedef struct nfs3_local nfs3_call_state_t;
 
-/* Queue of ops waiting for open fop to return. */
+/* An UNSTABLE write waiting to be sent with its neighbours. */
+struct nfs3_gathered_write {
+        struct list_head        list;
+        uint64_t                seq;
+        off_t                   offset;
+        struct iovec            vec;
+        struct iobuf            *iob;
+        nfs_user_t              nfu;
+};
+
+/* A set of gathered writes that do not overlap, sorted by offset. A write
+ * that overlaps one in the last batch starts a new batch and batches are sent
+ * one after the other, so overlapping writes reach the volume in the order
+ * they were received.
+ */
+struct nfs3_write_batch {
+        struct list_head        list;
+        struct list_head        writes;
+        uint64_t                startseq;
+        uint64_t                endseq;
+        size_t                  bytes;
+        int                     pending;
+        struct nfs3_write_gather *gather;
+};
+
+struct nfs3_write_gather {
+        gf_lock_t               lock;
+        struct nfs3_state       *nfs3;
+        xlator_t                *vol;
+        fd_t                    *fd;
+        struct list_head        batches;
+        struct nfs3_write_batch *sending;
+        /* Bytes gathered and not yet being sent. */
+        size_t                  bytes;
+        /* Every gathered write gets the next sequence number. All writes
+         * before sentseq have been written, everything before flushseq must
+         * be sent without waiting for more to gather.
+         */
+        uint64_t                seq;
+        uint64_t                sentseq;
+        uint64_t                flushseq;
+        struct list_head        waiters;
+        gf_timer_t              *timer;
+        /* First error writing gathered data, reported by the next COMMIT. */
+        int                     op_errno;
+};
+
+/* Per inode nfs3 state: the queue of ops waiting for open fop to return and
+ * the gathered writes.
+ */
 struct inode_op_queue {
         struct list_head        opq;
         pthread_mutex_t         qlock;
+        struct nfs3_write_gather gather;
 };
 
 
@@ -220,4 +365,10 @@ struct inode_op_queue {
 
 extern rpcsvc_program_t *
 nfs3svc_init (xlator_t *nfsx);
+
+extern void
+nfs3_fhcache_dump (struct nfs3_state *nfs3);
+
+extern void
+nfs3_fhcache_fini (struct nfs3_state *nfs3);
 #endif
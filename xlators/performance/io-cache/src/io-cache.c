@@ -41,16 +41,6 @@ uint32_t
 ioc_get_priority (ioc_table_t *table, const char *path);
 
 
-inline uint32_t
-ioc_hashfn (void *data, int len)
-{
-        off_t offset;
-
-        offset = *(off_t *) data;
-
-        return (offset >> ioc_log2_page_size);
-}
-
 inline ioc_inode_t *
 ioc_inode_reupdate (ioc_inode_t *ioc_inode)
 {
@@ -114,8 +104,8 @@ __ioc_inode_flush (ioc_inode_t *ioc_inode)
 	int64_t    destroy_size = 0;
 	int64_t    ret = 0;
 
-	list_for_each_entry_safe (curr, next, &ioc_inode->cache.page_lru,
-                                  page_lru) {
+	list_for_each_entry_safe (curr, next, &ioc_inode->cache.page_list,
+                                  page_list) {
 		ret = ioc_page_destroy (curr);
     
 		if (ret != -1) 
@@ -137,11 +127,8 @@ ioc_inode_flush (ioc_inode_t *ioc_inode)
 	ioc_inode_unlock (ioc_inode);
   
 	if (destroy_size) {
-		ioc_table_lock (ioc_inode->table);
-		{
-			ioc_inode->table->cache_used -= destroy_size;
-		}
-		ioc_table_unlock (ioc_inode->table);
+                __sync_fetch_and_sub (&ioc_inode->table->cache_used,
+                                      destroy_size);
 	}
 
 	return;
@@ -365,11 +352,8 @@ ioc_cache_validate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 	}
 
 	if (destroy_size) {
-		ioc_table_lock (ioc_inode->table);
-		{
-			ioc_inode->table->cache_used -= destroy_size;
-		}
-		ioc_table_unlock (ioc_inode->table);
+                __sync_fetch_and_sub (&ioc_inode->table->cache_used,
+                                      destroy_size);
 	}
 
 	if (op_ret < 0)
@@ -886,12 +870,9 @@ int32_t
 ioc_need_prune (ioc_table_t *table)
 {
 	int64_t cache_difference = 0;
-  
-	ioc_table_lock (table);
-	{
-		cache_difference = table->cache_used - table->cache_size;
-	}
-	ioc_table_unlock (table);
+
+        /* cache_used is updated atomically, no table lock on this path */
+        cache_difference = table->cache_used - table->cache_size;
 
 	if (cache_difference > 0)
 		return 1;
@@ -1067,9 +1048,7 @@ ioc_readv (call_frame_t *frame, xlator_t *this, fd_t *fd,
 	uint64_t     tmp_ioc_inode = 0;
 	ioc_inode_t  *ioc_inode = NULL;
 	ioc_local_t  *local = NULL;
-	uint32_t     weight = 0;
         ioc_table_t  *table = NULL;
-        uint32_t     num_pages = 0;
         int32_t      op_errno = -1;
 
         if (!this) {
@@ -1097,46 +1076,6 @@ ioc_readv (call_frame_t *frame, xlator_t *this, fd_t *fd,
         }
 
 
-        ioc_table_lock (table);
-        {
-                if (!table->mem_pool) {
-
-                        num_pages = (table->cache_size / table->page_size)
-                                + ((table->cache_size % table->page_size) 
-                                ? 1 : 0);
-
-                        table->mem_pool
-                                =  mem_pool_new (rbthash_entry_t, num_pages);
-
-                        if (!table->mem_pool) {
-                                gf_log (this->name, GF_LOG_ERROR,
-                                        "Unable to allocate mem_pool");
-                                op_errno = ENOMEM;
-                                ioc_table_unlock (table);
-                                goto out;
-                        }
-                }
-        }
-        ioc_table_unlock (table);
-
-        ioc_inode_lock (ioc_inode);
-        {
-                if (!ioc_inode->cache.page_table) {
-                        ioc_inode->cache.page_table
-                                = rbthash_table_init 
-                                                (IOC_PAGE_TABLE_BUCKET_COUNT,
-                                                 ioc_hashfn, NULL, 0,
-                                                 table->mem_pool);
-
-                        if (ioc_inode->cache.page_table == NULL) {
-                                op_errno = ENOMEM;
-                                ioc_inode_unlock (ioc_inode);
-                                goto out;
-                        }
-                }
-        }
-        ioc_inode_unlock (ioc_inode);
-
 	if (!fd_ctx_get (fd, this, NULL)) {
 		/* disable caching for this fd, go ahead with normal readv */
 		STACK_WIND (frame, ioc_readv_disabled_cbk,
@@ -1167,15 +1106,6 @@ ioc_readv (call_frame_t *frame, xlator_t *this, fd_t *fd,
 		"NEW REQ (%p) offset = %"PRId64" && size = %"GF_PRI_SIZET"", 
 		frame, offset, size);
 
-	weight = ioc_inode->weight;
-
-	ioc_table_lock (ioc_inode->table);
-	{
-		list_move_tail (&ioc_inode->inode_lru, 
-				&ioc_inode->table->inode_lru[weight]);
-	}
-	ioc_table_unlock (ioc_inode->table);
-
 	ioc_dispatch_requests (frame, ioc_inode, fd, offset, size);
 	return 0;
 
@@ -1950,6 +1880,11 @@ init (xlator_t *this)
 		INIT_LIST_HEAD (&table->inode_lru[index]);
 
 	pthread_mutex_init (&table->table_lock, NULL);
+
+        INIT_LIST_HEAD (&table->clock_ring);
+        table->clock_hand = &table->clock_ring;
+        pthread_mutex_init (&table->clock_lock, NULL);
+
 	this->private = table;
         ret = 0;
 
@@ -1990,6 +1925,10 @@ ioc_priv_dump (xlator_t *this)
         gf_proc_dump_write (key, "%ld", priv->cache_used);
         gf_proc_dump_build_key (key, key_prefix, "inode_count");
         gf_proc_dump_write (key, "%u", priv->inode_count);
+        gf_proc_dump_build_key (key, key_prefix, "page_count");
+        gf_proc_dump_write (key, "%"PRIu64, priv->page_count);
+        gf_proc_dump_build_key (key, key_prefix, "clock_evictions");
+        gf_proc_dump_write (key, "%"PRIu64, priv->clock_evictions);
 
 out:
         return 0;
@@ -2011,11 +1950,7 @@ fini (xlator_t *this)
         if (table == NULL)
                 return;
 
-        if (table->mem_pool != NULL) {
-                mem_pool_destroy (table->mem_pool);
-                table->mem_pool = NULL;
-        }
-
+	pthread_mutex_destroy (&table->clock_lock);
 	pthread_mutex_destroy (&table->table_lock);
 	GF_FREE (table);
 
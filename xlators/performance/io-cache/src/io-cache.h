@@ -34,14 +34,20 @@
 #include "xlator.h"
 #include "common-utils.h"
 #include "call-stub.h"
-#include "rbthash.h"
-#include "hashfn.h"
 #include <sys/time.h>
 #include <fnmatch.h>
 
 #define IOC_PAGE_SIZE    (1024 * 128)   /* 128KB */
 #define IOC_CACHE_SIZE   (32 * 1024 * 1024)
-#define IOC_PAGE_TABLE_BUCKET_COUNT 1
+
+/* page index: radix tree over (offset / page_size), 64 slots per node */
+#define IOC_RADIX_SHIFT      6
+#define IOC_RADIX_SLOTS      (1 << IOC_RADIX_SHIFT)
+#define IOC_RADIX_MASK       (IOC_RADIX_SLOTS - 1)
+#define IOC_RADIX_MAX_HEIGHT ((64 + IOC_RADIX_SHIFT - 1) / IOC_RADIX_SHIFT)
+
+/* upper bound on the clock reference count a page can get from its weight */
+#define IOC_CLOCK_MAX_REF    4
 
 struct ioc_table;
 struct ioc_local;
@@ -109,12 +115,27 @@ struct ioc_local {
 	dict_t           *xattr_req;
 };
 
+/*
+ * ioc_radix_node - interior or leaf node of the per-inode page index.
+ *                  leaf slots point to ioc_page_t, interior slots to
+ *                  child nodes.
+ */
+struct ioc_radix_node {
+        void     *slots[IOC_RADIX_SLOTS];
+        uint32_t  count;              /* number of non-NULL slots */
+};
+
 /*
  * ioc_page - structure to store page of data from file 
  *
  */
 struct ioc_page {
-	struct list_head    page_lru;
+	struct list_head    page_list;  /* pages of the owning inode */
+        struct list_head    page_clock; /* global clock ring of the table */
+        uint32_t            clock_ref;  /*
+                                         * set on every hit, decremented
+                                         * by each pass of the clock hand
+                                         */
 	struct ioc_inode    *inode;   /* inode this page belongs to */
 	struct ioc_priority *priority;
 	char                dirty;
@@ -129,8 +150,10 @@ struct ioc_page {
 };
 
 struct ioc_cache {
-        rbthash_table_t  *page_table;
-        struct list_head  page_lru;
+        struct ioc_radix_node *page_root;   /* page index, keyed by
+                                             * offset / page_size */
+        uint32_t          page_height; /* levels in page_root, 0 if empty */
+        struct list_head  page_list;
 	time_t            mtime;       /*
                                         * seconds component of file mtime
                                         */
@@ -175,7 +198,15 @@ struct ioc_table {
 	uint32_t         inode_count;
 	int32_t          cache_timeout;
 	int32_t          max_pri;
-        struct mem_pool  *mem_pool;
+        pthread_mutex_t  clock_lock;  /*
+                                       * protects clock_ring, clock_hand
+                                       * and page_count. nests inside
+                                       * inode_lock.
+                                       */
+        struct list_head clock_ring;  /* all cached pages of all inodes */
+        struct list_head *clock_hand;
+        uint64_t         page_count;
+        uint64_t         clock_evictions;
 };
 
 typedef struct ioc_table ioc_table_t;
@@ -203,6 +234,9 @@ ioc_page_get (ioc_inode_t *ioc_inode, off_t offset);
 ioc_page_t *
 ioc_page_create (ioc_inode_t *ioc_inode, off_t offset);
 
+void
+ioc_page_index_destroy (struct ioc_cache *cache);
+
 void
 ioc_page_fault (ioc_inode_t *ioc_inode,	call_frame_t *frame, fd_t *fd,
 		off_t offset);
@@ -296,6 +330,11 @@ ioc_frame_fill (ioc_page_t *page, call_frame_t *frame, off_t offset,
 	} while (0)
 
 
+#define ioc_clock_ref(ioc_inode)					\
+	(((ioc_inode)->weight < IOC_CLOCK_MAX_REF) ?			\
+	 (ioc_inode)->weight : IOC_CLOCK_MAX_REF)
+
+
 static inline uint64_t
 time_elapsed (struct timeval *now,
 	      struct timeval *then)
@@ -338,7 +377,4 @@ ioc_prune (ioc_table_t *table);
 
 int32_t
 ioc_need_prune (ioc_table_t *table);
-
-inline uint32_t
-ioc_hashfn (void *data, int len);
 #endif /* __IO_CACHE_H */
@@ -164,7 +164,7 @@ ioc_inode_update (ioc_table_t *table, inode_t *inode, uint32_t weight)
         }
   
 	ioc_inode->table = table;
-	INIT_LIST_HEAD (&ioc_inode->cache.page_lru);
+	INIT_LIST_HEAD (&ioc_inode->cache.page_list);
 
 	ioc_table_lock (table);
 
@@ -207,7 +207,12 @@ ioc_inode_destroy (ioc_inode_t *ioc_inode)
 	ioc_table_unlock (table);
   
 	ioc_inode_flush (ioc_inode);
-        rbthash_table_destroy (ioc_inode->cache.page_table);
+
+        ioc_inode_lock (ioc_inode);
+        {
+                ioc_page_index_destroy (&ioc_inode->cache);
+        }
+        ioc_inode_unlock (ioc_inode);
 
 	pthread_mutex_destroy (&ioc_inode->inode_lock);
 	GF_FREE (ioc_inode);
@@ -34,7 +34,173 @@
 char
 ioc_empty (struct ioc_cache *cache)
 {
-        return list_empty (&cache->page_lru);
+        return list_empty (&cache->page_list);
+}
+
+/*
+ * page index - a radix tree per inode, keyed by the page number
+ * (offset / page_size). a tree of height h covers page numbers below
+ * 2^(h * IOC_RADIX_SHIFT), so sequential reads of a file touch only a
+ * handful of nodes and a lookup is a few array dereferences.
+ *
+ * all the __ioc_page_index_* functions assume ioc_inode->inode_lock is held.
+ */
+static inline uint64_t
+ioc_page_index_max (uint32_t height)
+{
+        if (height >= IOC_RADIX_MAX_HEIGHT)
+                return (uint64_t) -1;
+
+        return (1ULL << (height * IOC_RADIX_SHIFT)) - 1;
+}
+
+static ioc_page_t *
+__ioc_page_index_lookup (struct ioc_cache *cache, uint64_t index)
+{
+        struct ioc_radix_node *node  = NULL;
+        int32_t                shift = 0;
+
+        node = cache->page_root;
+        if ((node == NULL) || (index > ioc_page_index_max (cache->page_height)))
+                return NULL;
+
+        for (shift = (cache->page_height - 1) * IOC_RADIX_SHIFT; shift > 0;
+             shift -= IOC_RADIX_SHIFT) {
+                node = node->slots[(index >> shift) & IOC_RADIX_MASK];
+                if (node == NULL)
+                        return NULL;
+        }
+
+        return node->slots[index & IOC_RADIX_MASK];
+}
+
+static int
+__ioc_page_index_insert (struct ioc_cache *cache, uint64_t index,
+                         ioc_page_t *page)
+{
+        struct ioc_radix_node *node  = NULL;
+        struct ioc_radix_node *child = NULL;
+        int32_t                shift = 0;
+        int                    ret   = -1;
+
+        if (cache->page_root == NULL) {
+                cache->page_root = GF_CALLOC (1, sizeof (*node),
+                                              gf_ioc_mt_ioc_radix_node_t);
+                if (cache->page_root == NULL)
+                        goto out;
+
+                cache->page_height = 1;
+        }
+
+        /* grow the tree upwards until index fits */
+        while (index > ioc_page_index_max (cache->page_height)) {
+                node = GF_CALLOC (1, sizeof (*node),
+                                  gf_ioc_mt_ioc_radix_node_t);
+                if (node == NULL)
+                        goto out;
+
+                node->slots[0] = cache->page_root;
+                node->count = 1;
+                cache->page_root = node;
+                cache->page_height++;
+        }
+
+        node = cache->page_root;
+        for (shift = (cache->page_height - 1) * IOC_RADIX_SHIFT; shift > 0;
+             shift -= IOC_RADIX_SHIFT) {
+                child = node->slots[(index >> shift) & IOC_RADIX_MASK];
+                if (child == NULL) {
+                        child = GF_CALLOC (1, sizeof (*child),
+                                           gf_ioc_mt_ioc_radix_node_t);
+                        if (child == NULL)
+                                goto out;
+
+                        node->slots[(index >> shift) & IOC_RADIX_MASK] = child;
+                        node->count++;
+                }
+                node = child;
+        }
+
+        if (node->slots[index & IOC_RADIX_MASK] == NULL)
+                node->count++;
+        node->slots[index & IOC_RADIX_MASK] = page;
+
+        ret = 0;
+out:
+        return ret;
+}
+
+static void
+__ioc_page_index_delete (struct ioc_cache *cache, uint64_t index)
+{
+        struct ioc_radix_node *path[IOC_RADIX_MAX_HEIGHT];
+        struct ioc_radix_node *node  = NULL;
+        int32_t                shift = 0;
+        int32_t                level = 0;
+        uint32_t               slot  = 0;
+
+        node = cache->page_root;
+        if ((node == NULL) || (index > ioc_page_index_max (cache->page_height)))
+                return;
+
+        /* path[0] is the leaf, path[page_height - 1] the root */
+        shift = (cache->page_height - 1) * IOC_RADIX_SHIFT;
+        for (level = cache->page_height - 1; level > 0; level--) {
+                path[level] = node;
+                node = node->slots[(index >> shift) & IOC_RADIX_MASK];
+                if (node == NULL)
+                        return;
+                shift -= IOC_RADIX_SHIFT;
+        }
+        path[0] = node;
+
+        /* clear the slot and free the nodes which became empty */
+        for (level = 0; level < cache->page_height; level++) {
+                node = path[level];
+                slot = (index >> (level * IOC_RADIX_SHIFT)) & IOC_RADIX_MASK;
+                if (node->slots[slot] == NULL)
+                        break;
+
+                node->slots[slot] = NULL;
+                if (--node->count)
+                        break;
+
+                GF_FREE (node);
+                if (level == cache->page_height - 1) {
+                        cache->page_root = NULL;
+                        cache->page_height = 0;
+                }
+        }
+}
+
+static void
+ioc_page_index_free (struct ioc_radix_node *node, uint32_t height)
+{
+        int i = 0;
+
+        if (height > 1) {
+                for (i = 0; i < IOC_RADIX_SLOTS; i++) {
+                        if (node->slots[i] != NULL)
+                                ioc_page_index_free (node->slots[i],
+                                                     height - 1);
+                }
+        }
+
+        GF_FREE (node);
+}
+
+/*
+ * ioc_page_index_destroy - free the nodes of the page index. the pages
+ *                          themselves are destroyed by ioc_inode_flush.
+ */
+void
+ioc_page_index_destroy (struct ioc_cache *cache)
+{
+        if (cache->page_root != NULL)
+                ioc_page_index_free (cache->page_root, cache->page_height);
+
+        cache->page_root = NULL;
+        cache->page_height = 0;
 }
 
 ioc_page_t *
@@ -42,63 +208,103 @@ ioc_page_get (ioc_inode_t *ioc_inode, off_t offset)
 {
 	ioc_page_t   *page           = NULL;
 	ioc_table_t  *table          = NULL;
-	off_t         rounded_offset = 0;
 
         table = ioc_inode->table;
-        rounded_offset = floor (offset, table->page_size);
- 
-        page = rbthash_get (ioc_inode->cache.page_table, &rounded_offset,
-                            sizeof (rounded_offset));
+
+        page = __ioc_page_index_lookup (&ioc_inode->cache,
+                                        offset / table->page_size);
 
         if (page != NULL) {
-		/* push the page to the end of the lru list */
-		list_move_tail (&page->page_lru, &ioc_inode->cache.page_lru);
+                /* give the page another turn of the clock. no table lock
+                 * is taken on a hit, the hand reads clock_ref racily */
+                page->clock_ref = ioc_clock_ref (ioc_inode);
 	}
 
 	return page;
 }
 
 
+/*
+ * __ioc_page_clock_unlink - remove page from the clock ring
+ *
+ * assumes table->clock_lock is held
+ */
+static void
+__ioc_page_clock_unlink (ioc_table_t *table, ioc_page_t *page)
+{
+        if (table->clock_hand == &page->page_clock)
+                table->clock_hand = page->page_clock.next;
+
+        list_del_init (&page->page_clock);
+        table->page_count--;
+}
+
+/*
+ * __ioc_page_release - drop page from its inode and free it. page must
+ *                      already be out of the clock ring.
+ *
+ * assumes ioc_inode->inode_lock is held
+ */
+static int64_t
+__ioc_page_release (ioc_page_t *page)
+{
+	int64_t  page_size = 0;
+
+	page_size = iobref_size (page->iobref);
+
+        __ioc_page_index_delete (&page->inode->cache,
+                                 page->offset / page->inode->table->page_size);
+	list_del (&page->page_list);
+
+	gf_log (page->inode->table->xl->name, GF_LOG_TRACE,
+		"destroying page = %p, offset = %"PRId64" "
+		"&& inode = %p",
+		page, page->offset, page->inode);
+
+	if (page->vector){
+		iobref_unref (page->iobref);
+		GF_FREE (page->vector);
+		page->vector = NULL;
+	}
+
+	page->inode = NULL;
+
+	pthread_mutex_destroy (&page->page_lock);
+	GF_FREE (page);
+
+	return page_size;
+}
+
 /*
  * ioc_page_destroy -
  *
  * @page:
  *
+ * assumes ioc_inode->inode_lock is held
  */
 int64_t
 ioc_page_destroy (ioc_page_t *page)
 {
-	int64_t  page_size = 0;
-
-	page_size = iobref_size (page->iobref);
+	int64_t      page_size = 0;
+        ioc_table_t *table     = NULL;
 
 	if (page->waitq) {
 		/* frames waiting on this page, do not destroy this page */
 		page_size = -1;
-	} else {
-                rbthash_remove (page->inode->cache.page_table, &page->offset,
-                                sizeof (page->offset));
-		list_del (&page->page_lru);
-    
-		gf_log (page->inode->table->xl->name, GF_LOG_TRACE,
-			"destroying page = %p, offset = %"PRId64" "
-			"&& inode = %p",
-			page, page->offset, page->inode);
-    
-		if (page->vector){
-			iobref_unref (page->iobref);
-			GF_FREE (page->vector);
-			page->vector = NULL;
-		}
-    
-		page->inode = NULL;
+                goto out;
 	}
 
-	if (page_size != -1) {
-		pthread_mutex_destroy (&page->page_lock);
-		GF_FREE (page);
-	}
+        table = page->inode->table;
+
+        pthread_mutex_lock (&table->clock_lock);
+        {
+                __ioc_page_clock_unlink (table, page);
+        }
+        pthread_mutex_unlock (&table->clock_lock);
 
+        page_size = __ioc_page_release (page);
+
+out:
 	return page_size;
 }
 
@@ -108,72 +314,83 @@ ioc_page_destroy (ioc_page_t *page)
  *
  * @table: ioc_table_t of this translator
  *
+ * pages of all inodes sit on one clock ring. the hand decrements the
+ * clock_ref of every page it passes and evicts pages which reach zero,
+ * so pages of heavier inodes (higher priority) survive more sweeps.
+ * the clock lock nests inside inode locks, hence inodes are only
+ * trylock'ed here and busy ones are skipped.
  */
 int32_t
 ioc_prune (ioc_table_t *table)
 {
-	ioc_inode_t *curr = NULL, *next_ioc_inode = NULL;
-	ioc_page_t  *page = NULL, *next = NULL;
-	int32_t     ret = -1;
-	int32_t     index = 0;
-	uint64_t    size_to_prune = 0;
-	uint64_t    size_pruned = 0;
-
-	ioc_table_lock (table);
-	{
-		size_to_prune = table->cache_used - table->cache_size;
-		/* take out the least recently used inode */
-		for (index=0; index < table->max_pri; index++) {
-			list_for_each_entry_safe (curr, next_ioc_inode, 
-						  &table->inode_lru[index], 
-						  inode_lru) {
-				/* prune page-by-page for this inode, till 
-				 * we reach the equilibrium */
-				ioc_inode_lock (curr);
-				/* { */
-
-				list_for_each_entry_safe (page, next, 
-							  &curr->cache.page_lru,
-                                                          page_lru) {
-					/* done with all pages, and not 
-					 * reached equilibrium yet??
-					 * continue with next inode in 
-					 * lru_list */
-					size_pruned += page->size;
-					ret = ioc_page_destroy (page);
-
-					if (ret != -1)
-						table->cache_used -= ret;
-	    
-					gf_log (table->xl->name,
-						GF_LOG_TRACE,
-						"index = %d && table->cache_"
-						"used = %"PRIu64" && table->"
-						"cache_size = %"PRIu64, 
-						index, table->cache_used, 
-						table->cache_size);
-	    
-					if (size_pruned >= size_to_prune)
-						break;
-				} /* list_for_each_entry_safe(page...) */
-				if (ioc_empty (&curr->cache)) {
-					list_del_init (&curr->inode_lru);
-				}
+	ioc_inode_t      *ioc_inode     = NULL;
+	ioc_page_t       *page          = NULL;
+        struct list_head *next          = NULL;
+	int64_t           ret           = -1;
+        int64_t           size_to_prune = 0;
+	uint64_t          size_pruned   = 0;
+        uint64_t          budget        = 0;
+
+        size_to_prune = table->cache_used - table->cache_size;
+        if (size_to_prune <= 0)
+                goto out;
 
-				/* } */ 
-				ioc_inode_unlock (curr);
-	
-				if (size_pruned >= size_to_prune)
-					break;
-			} /* list_for_each_entry_safe (curr...) */
-      
-			if (size_pruned >= size_to_prune)
-				break;
-		} /* for(index=0;...) */
+        pthread_mutex_lock (&table->clock_lock);
+        {
+                /* every page can be passed IOC_CLOCK_MAX_REF times before
+                 * it becomes a victim, plus one more for the eviction */
+                budget = (IOC_CLOCK_MAX_REF + 1) * table->page_count;
+
+                while (budget-- > 0) {
+                        if (table->clock_hand == &table->clock_ring)
+                                table->clock_hand = table->clock_ring.next;
+                        if (table->clock_hand == &table->clock_ring)
+                                break;
+
+                        page = list_entry (table->clock_hand, ioc_page_t,
+                                           page_clock);
+                        next = table->clock_hand->next;
+
+                        if (page->clock_ref > 0) {
+                                page->clock_ref--;
+                                table->clock_hand = next;
+                                continue;
+                        }
+
+                        ioc_inode = page->inode;
+                        if (pthread_mutex_trylock (&ioc_inode->inode_lock)) {
+                                table->clock_hand = next;
+                                continue;
+                        }
+
+                        if (page->waitq) {
+                                /* page in transit */
+                                pthread_mutex_unlock (&ioc_inode->inode_lock);
+                                table->clock_hand = next;
+                                continue;
+                        }
+
+                        __ioc_page_clock_unlink (table, page);
+                        ret = __ioc_page_release (page);
+
+                        pthread_mutex_unlock (&ioc_inode->inode_lock);
+
+                        __sync_fetch_and_sub (&table->cache_used, ret);
+                        table->clock_evictions++;
+                        size_pruned += ret;
 
-	} /* ioc_inode_table locked region end */
-	ioc_table_unlock (table);
+                        gf_log (table->xl->name, GF_LOG_TRACE,
+                                "table->cache_used = %"PRIu64" && table->"
+                                "cache_size = %"PRIu64,
+                                table->cache_used, table->cache_size);
 
+                        if (size_pruned >= size_to_prune)
+                                break;
+                }
+        }
+        pthread_mutex_unlock (&table->clock_lock);
+
+out:
 	return 0;
 }
 
@@ -183,6 +400,7 @@ ioc_prune (ioc_table_t *table)
  * @ioc_inode:
  * @offset:
  *
+ * assumes ioc_inode->inode_lock is held
  */
 ioc_page_t *
 ioc_page_create (ioc_inode_t *ioc_inode, off_t offset)
@@ -191,6 +409,7 @@ ioc_page_create (ioc_inode_t *ioc_inode, off_t offset)
 	ioc_page_t  *page           = NULL;
 	off_t        rounded_offset = 0;
 	ioc_page_t  *newpage        = NULL;
+        int          ret            = -1;
 
         table = ioc_inode->table;
         rounded_offset = floor (offset, table->page_size);
@@ -209,12 +428,27 @@ ioc_page_create (ioc_inode_t *ioc_inode, off_t offset)
 
 	newpage->offset = rounded_offset;
 	newpage->inode = ioc_inode;
+        newpage->clock_ref = ioc_clock_ref (ioc_inode);
 	pthread_mutex_init (&newpage->page_lock, NULL);
 
-        rbthash_insert (ioc_inode->cache.page_table, newpage, &rounded_offset,
-                        sizeof (rounded_offset));
+        ret = __ioc_page_index_insert (&ioc_inode->cache,
+                                       rounded_offset / table->page_size,
+                                       newpage);
+        if (ret == -1) {
+                pthread_mutex_destroy (&newpage->page_lock);
+                GF_FREE (newpage);
+                goto out;
+        }
+
+	list_add_tail (&newpage->page_list, &ioc_inode->cache.page_list);
 
-	list_add_tail (&newpage->page_lru, &ioc_inode->cache.page_lru);
+        /* insert just behind the hand, the page is visited last */
+        pthread_mutex_lock (&table->clock_lock);
+        {
+                list_add_tail (&newpage->page_clock, table->clock_hand);
+                table->page_count++;
+        }
+        pthread_mutex_unlock (&table->clock_lock);
 
 	page = newpage;
 
@@ -441,19 +675,11 @@ unlock:
 	ioc_waitq_return (waitq);
 
 	if (iobref_page_size) {
-		ioc_table_lock (table);
-		{
-			table->cache_used += iobref_page_size;
-		}
-		ioc_table_unlock (table);
+                __sync_fetch_and_add (&table->cache_used, iobref_page_size);
 	}
 
 	if (destroy_size) {
-		ioc_table_lock (table);
-		{
-			table->cache_used -= destroy_size;
-		}
-		ioc_table_unlock (table);
+                __sync_fetch_and_sub (&table->cache_used, destroy_size);
 	}
 
 	if (ioc_need_prune (ioc_inode->table)) {
@@ -551,21 +777,17 @@ ioc_frame_fill (ioc_page_t *page, call_frame_t *frame, off_t offset,
 	off_t       src_offset = 0;
 	off_t       dst_offset = 0;
 	ssize_t     copy_size = 0;
-	ioc_inode_t *ioc_inode = NULL;
         ioc_fill_t  *new = NULL;
         int8_t      found = 0;
         int32_t     ret = 0;
 
         local = frame->local;
-        ioc_inode = page->inode;
 
 	gf_log (frame->this->name, GF_LOG_TRACE,
 		"frame (%p) offset = %"PRId64" && size = %"GF_PRI_SIZET" "
 		"&& page->size = %"GF_PRI_SIZET" && wait_count = %d",
 		frame, offset, size, page->size, local->wait_count);
 
-	/* immediately move this page to the end of the page_lru list */
-	list_move_tail (&page->page_lru, &ioc_inode->cache.page_lru);
 	/* fill local->pending_size bytes from local->pending_offset */
 	if (local->op_ret != -1 && page->size) {
 		if (offset > page->offset)
@@ -869,7 +1091,7 @@ ioc_page_error (ioc_page_t *page, int32_t op_ret, int32_t op_errno)
 	ret = ioc_page_destroy (page);
 
 	if (ret != -1) {
-		table->cache_used -= ret;
+                __sync_fetch_and_sub (&table->cache_used, ret);
 	}
 
 	return waitq;
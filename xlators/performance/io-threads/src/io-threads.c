@@ -39,50 +39,205 @@ int __iot_workers_scale (iot_conf_t *conf);
 
 
 call_stub_t *
-__iot_dequeue (iot_conf_t *conf)
+__iot_dequeue (iot_queue_t *queue, int pri)
 {
         call_stub_t  *stub = NULL;
+
+        if (list_empty (&queue->reqs[pri]))
+                return NULL;
+
+        stub = list_entry (queue->reqs[pri].next, call_stub_t, list);
+        list_del_init (&stub->list);
+        queue->count[pri]--;
+
+        return stub;
+}
+
+
+/* take the highest priority stub, looking at the worker's own queue
+   first and stealing from the other queues otherwise */
+call_stub_t *
+iot_dequeue (iot_conf_t *conf, int slot)
+{
+        call_stub_t  *stub = NULL;
+        iot_queue_t  *queue = NULL;
+        int           pri = 0;
         int           i = 0;
 
-        for (i = 0; i < IOT_PRI_MAX; i++) {
-                if (list_empty (&conf->reqs[i]))
-                        continue;
-                stub = list_entry (conf->reqs[i].next, call_stub_t, list);
-                break;
+        for (pri = 0; pri < IOT_PRI_MAX; pri++) {
+                for (i = 0; i < IOT_MAX_THREADS; i++) {
+                        queue = &conf->queues[(slot + i) % IOT_MAX_THREADS];
+
+                        /* unlocked peek, rechecked under the lock */
+                        if (!queue->count[pri])
+                                continue;
+
+                        LOCK (&queue->lock);
+                        {
+                                stub = __iot_dequeue (queue, pri);
+                        }
+                        UNLOCK (&queue->lock);
+
+                        if (stub)
+                                goto out;
+                }
         }
 
-        if (!stub)
-                return NULL;
+out:
+        if (stub)
+                __sync_fetch_and_sub (&conf->queue_size, 1);
 
-        conf->queue_size--;
-        list_del_init (&stub->list);
+        return stub;
+}
+
+
+/* take the head of a bucket no other worker is running, starting from
+   the buckets nearest to the worker's slot */
+call_stub_t *
+iot_bucket_dequeue (iot_conf_t *conf, int slot, iot_bucket_t **bucket_p)
+{
+        call_stub_t   *stub = NULL;
+        iot_bucket_t  *bucket = NULL;
+        int            start = 0;
+        int            i = 0;
+
+        start = slot * (IOT_ORDER_BUCKETS / IOT_MAX_THREADS);
+
+        for (i = 0; i < IOT_ORDER_BUCKETS; i++) {
+                bucket = &conf->buckets[(start + i) % IOT_ORDER_BUCKETS];
+
+                if (!bucket->count || bucket->busy)
+                        continue;
+
+                LOCK (&bucket->lock);
+                {
+                        if (!bucket->busy && !list_empty (&bucket->reqs)) {
+                                stub = list_entry (bucket->reqs.next,
+                                                   call_stub_t, list);
+                                list_del_init (&stub->list);
+                                bucket->count--;
+                                bucket->busy = 1;
+                        }
+                }
+                UNLOCK (&bucket->lock);
+
+                if (stub)
+                        break;
+        }
+
+        if (stub) {
+                __sync_fetch_and_sub (&conf->queue_size, 1);
+                *bucket_p = bucket;
+        }
 
         return stub;
 }
 
 
 void
-__iot_enqueue (iot_conf_t *conf, call_stub_t *stub, int pri)
+__iot_enqueue (iot_queue_t *queue, call_stub_t *stub, int pri)
 {
         if (pri < 0 || pri >= IOT_PRI_MAX)
                 pri = IOT_PRI_MAX-1;
 
-        list_add_tail (&stub->list, &conf->reqs[pri]);
+        list_add_tail (&stub->list, &queue->reqs[pri]);
 
-        conf->queue_size++;
+        queue->count[pri]++;
 
         return;
 }
 
 
+/* wake up one sleeping worker, unless a wakeup is already on its way.
+   The woken worker passes the wakeup on while the queues are non-empty,
+   so a burst of stubs does not cost a signal per stub */
+void
+iot_wakeup (iot_conf_t *conf)
+{
+        __sync_synchronize ();
+
+        if (!conf->sleep_count || conf->wakeup_pending)
+                return;
+
+        pthread_mutex_lock (&conf->mutex);
+        {
+                if (conf->sleep_count && !conf->wakeup_pending) {
+                        conf->wakeup_pending = 1;
+                        pthread_cond_signal (&conf->cond);
+                }
+        }
+        pthread_mutex_unlock (&conf->mutex);
+}
+
+
+/* account for a stub (or a bucket) that became runnable */
+int
+iot_runnable_add (iot_conf_t *conf)
+{
+        int  queue_size = 0;
+        int  ret = 0;
+
+        queue_size = __sync_add_and_fetch (&conf->queue_size, 1);
+
+        iot_wakeup (conf);
+
+        if (conf->curr_count < conf->max_count
+            && conf->curr_count < log_base2 (queue_size))
+                ret = iot_workers_scale (conf);
+
+        return ret;
+}
+
+
+void
+iot_bucket_release (iot_conf_t *conf, iot_bucket_t *bucket)
+{
+        int  runnable = 0;
+
+        LOCK (&bucket->lock);
+        {
+                bucket->busy = 0;
+                runnable = !list_empty (&bucket->reqs);
+        }
+        UNLOCK (&bucket->lock);
+
+        if (runnable)
+                iot_runnable_add (conf);
+}
+
+
+int
+iot_slot_get (iot_conf_t *conf)
+{
+        int  i = 0;
+        int  slot = 0;
+
+        pthread_mutex_lock (&conf->mutex);
+        {
+                for (i = 0; i < IOT_MAX_THREADS; i++) {
+                        if (!conf->slot_used[i]) {
+                                conf->slot_used[i] = 1;
+                                slot = i;
+                                break;
+                        }
+                }
+        }
+        pthread_mutex_unlock (&conf->mutex);
+
+        return slot;
+}
+
+
 void *
 iot_worker (void *data)
 {
         iot_conf_t       *conf = NULL;
         xlator_t         *this = NULL;
         call_stub_t      *stub = NULL;
+        iot_bucket_t     *bucket = NULL;
         struct timespec   sleep_till = {0, };
         int               ret = 0;
+        int               slot = 0;
         char              timeout = 0;
         char              bye = 0;
 
@@ -90,28 +245,56 @@ iot_worker (void *data)
         this = conf->this;
         THIS = this;
 
+        slot = iot_slot_get (conf);
+
         for (;;) {
+                stub = NULL;
+                bucket = NULL;
+
+                if (conf->order_by_inode)
+                        stub = iot_bucket_dequeue (conf, slot, &bucket);
+
+                if (!stub)
+                        stub = iot_dequeue (conf, slot);
+
+                if (stub) {
+                        if (conf->queue_size)
+                                iot_wakeup (conf);
+
+                        call_resume (stub);
+
+                        if (bucket)
+                                iot_bucket_release (conf, bucket);
+                        continue;
+                }
+
                 sleep_till.tv_sec = time (NULL) + conf->idle_time;
 
                 pthread_mutex_lock (&conf->mutex);
                 {
-                        while (conf->queue_size == 0) {
-                                conf->sleep_count++;
+                        conf->sleep_count++;
 
+                        /* pairs with the barrier in iot_wakeup () */
+                        __sync_synchronize ();
+
+                        while (conf->queue_size == 0) {
                                 ret = pthread_cond_timedwait (&conf->cond,
                                                               &conf->mutex,
                                                               &sleep_till);
-                                conf->sleep_count--;
-
                                 if (ret == ETIMEDOUT) {
                                         timeout = 1;
                                         break;
                                 }
                         }
 
+                        conf->sleep_count--;
+                        conf->wakeup_pending = 0;
+
                         if (timeout) {
-                                if (conf->curr_count > IOT_MIN_THREADS) {
+                                if (conf->curr_count > IOT_MIN_THREADS
+                                    && conf->queue_size == 0) {
                                         conf->curr_count--;
+                                        conf->slot_used[slot] = 0;
                                         bye = 1;
                                         gf_log (conf->this->name, GF_LOG_DEBUG,
                                                 "timeout, terminated. conf->curr_count=%d",
@@ -120,14 +303,9 @@ iot_worker (void *data)
                                         timeout = 0;
                                 }
                         }
-
-                        stub = __iot_dequeue (conf);
                 }
                 pthread_mutex_unlock (&conf->mutex);
 
-                if (stub) /* guard against spurious wakeups */
-                        call_resume (stub);
-
                 if (bye)
                         break;
         }
@@ -139,54 +317,90 @@ iot_worker (void *data)
 int
 do_iot_schedule (iot_conf_t *conf, call_stub_t *stub, int pri)
 {
-        int   ret = 0;
+        iot_queue_t  *queue = NULL;
+        int           count = 0;
 
-        pthread_mutex_lock (&conf->mutex);
-        {
-                __iot_enqueue (conf, stub, pri);
+        /* spread over the queues of the running workers, the unlocked
+           increment is only a hint */
+        count = conf->curr_count;
+        if (count < 1)
+                count = 1;
 
-                pthread_cond_signal (&conf->cond);
+        queue = &conf->queues[conf->next_queue++ % count];
 
-                ret = __iot_workers_scale (conf);
+        LOCK (&queue->lock);
+        {
+                __iot_enqueue (queue, stub, pri);
         }
-        pthread_mutex_unlock (&conf->mutex);
+        UNLOCK (&queue->lock);
 
-        return ret;
+        return iot_runnable_add (conf);
 }
 
 
 int
-iot_schedule_slow (iot_conf_t *conf, call_stub_t *stub)
+iot_schedule_unordered (iot_conf_t *conf, inode_t *inode, call_stub_t *stub,
+                        int pri)
 {
-        return do_iot_schedule (conf, stub, IOT_PRI_LO);
+        return do_iot_schedule (conf, stub, pri);
 }
 
 
+/* fops on one inode hash to the same bucket and are run one at a time,
+   in the order they arrived */
 int
-iot_schedule_fast (iot_conf_t *conf, call_stub_t *stub)
+iot_schedule_ordered (iot_conf_t *conf, inode_t *inode, call_stub_t *stub)
 {
-        return do_iot_schedule (conf, stub, IOT_PRI_HI);
+        iot_bucket_t  *bucket = NULL;
+        int            runnable = 0;
+        int            ret = 0;
+
+        bucket = &conf->buckets[((unsigned long) inode / sizeof (*inode))
+                                % IOT_ORDER_BUCKETS];
+
+        LOCK (&bucket->lock);
+        {
+                list_add_tail (&stub->list, &bucket->reqs);
+                bucket->count++;
+
+                runnable = (!bucket->busy && bucket->count == 1);
+        }
+        UNLOCK (&bucket->lock);
+
+        if (runnable)
+                ret = iot_runnable_add (conf);
+
+        return ret;
 }
 
+
 int
-iot_schedule (iot_conf_t *conf, call_stub_t *stub)
+iot_schedule_pri (iot_conf_t *conf, inode_t *inode, call_stub_t *stub, int pri)
 {
-        return do_iot_schedule (conf, stub, IOT_PRI_NORMAL);
+        if (conf->order_by_inode && inode)
+                return iot_schedule_ordered (conf, inode, stub);
+
+        return iot_schedule_unordered (conf, inode, stub, pri);
 }
 
 
 int
-iot_schedule_unordered (iot_conf_t *conf, inode_t *inode, call_stub_t *stub)
+iot_schedule_slow (iot_conf_t *conf, inode_t *inode, call_stub_t *stub)
 {
-        return do_iot_schedule (conf, stub, 0);
+        return iot_schedule_pri (conf, inode, stub, IOT_PRI_LO);
 }
 
 
 int
-iot_schedule_ordered (iot_conf_t *conf, inode_t *inode, call_stub_t *stub)
+iot_schedule_fast (iot_conf_t *conf, inode_t *inode, call_stub_t *stub)
 {
+        return iot_schedule_pri (conf, inode, stub, IOT_PRI_HI);
+}
 
-        return do_iot_schedule (conf, stub, 0);
+int
+iot_schedule (iot_conf_t *conf, inode_t *inode, call_stub_t *stub)
+{
+        return iot_schedule_pri (conf, inode, stub, IOT_PRI_NORMAL);
 }
 
 
@@ -228,7 +442,7 @@ iot_lookup (call_frame_t *frame, xlator_t *this, loc_t *loc, dict_t *xattr_req)
                 goto out;
         }
 
-        ret = iot_schedule_fast (this->private, stub);
+        ret = iot_schedule_fast (this->private, loc->inode, stub);
 
 out:
         if (ret < 0) {
@@ -280,7 +494,7 @@ iot_setattr (call_frame_t *frame, xlator_t *this, loc_t *loc,
                 goto out;
         }
 
-        ret = iot_schedule (this->private, stub);
+        ret = iot_schedule (this->private, loc->inode, stub);
 
 out:
         if (ret < 0) {
@@ -331,7 +545,7 @@ iot_fsetattr (call_frame_t *frame, xlator_t *this, fd_t *fd,
                 goto out;
         }
 
-        ret = iot_schedule (this->private, stub);
+        ret = iot_schedule (this->private, fd->inode, stub);
 
 out:
         if (ret < 0) {
@@ -377,7 +591,7 @@ iot_access (call_frame_t *frame, xlator_t *this, loc_t *loc, int32_t mask)
                 goto out;
         }
 
-        ret = iot_schedule_fast (this->private, stub);
+        ret = iot_schedule_fast (this->private, loc->inode, stub);
 out:
         if (ret < 0) {
                 STACK_UNWIND_STRICT (access, frame, -1, -ret);
@@ -426,7 +640,7 @@ iot_readlink (call_frame_t *frame, xlator_t *this, loc_t *loc, size_t size)
                 goto out;
         }
 
-        ret = iot_schedule_fast (this->private, stub);
+        ret = iot_schedule_fast (this->private, loc->inode, stub);
 
 out:
         if (ret < 0) {
@@ -479,7 +693,7 @@ iot_mknod (call_frame_t *frame, xlator_t *this, loc_t *loc, mode_t mode,
                 goto out;
         }
 
-        ret = iot_schedule (this->private, stub);
+        ret = iot_schedule (this->private, loc->inode, stub);
 
 out:
         if (ret < 0) {
@@ -531,7 +745,7 @@ iot_mkdir (call_frame_t *frame, xlator_t *this, loc_t *loc, mode_t mode,
                 goto out;
         }
 
-        ret = iot_schedule (this->private, stub);
+        ret = iot_schedule (this->private, loc->inode, stub);
 
 out:
         if (ret < 0) {
@@ -580,7 +794,7 @@ iot_rmdir (call_frame_t *frame, xlator_t *this, loc_t *loc, int flags)
                 goto out;
         }
 
-        ret = iot_schedule (this->private, stub);
+        ret = iot_schedule (this->private, loc->inode, stub);
 out:
         if (ret < 0) {
                 STACK_UNWIND_STRICT (rmdir, frame, -1, -ret, NULL, NULL);
@@ -631,7 +845,7 @@ iot_symlink (call_frame_t *frame, xlator_t *this, const char *linkname,
                 goto out;
         }
 
-        ret = iot_schedule (this->private, stub);
+        ret = iot_schedule (this->private, loc->inode, stub);
 
 out:
         if (ret < 0) {
@@ -682,7 +896,7 @@ iot_rename (call_frame_t *frame, xlator_t *this, loc_t *oldloc, loc_t *newloc)
                 goto out;
         }
 
-        ret = iot_schedule (this->private, stub);
+        ret = iot_schedule (this->private, oldloc->inode, stub);
 
 out:
         if (ret < 0) {
@@ -732,7 +946,7 @@ iot_open (call_frame_t *frame, xlator_t *this, loc_t *loc, int32_t flags,
                 goto out;
         }
 
-	ret = iot_schedule_fast (this->private, stub);
+	ret = iot_schedule_fast (this->private, fd->inode, stub);
 
 out:
         if (ret < 0) {
@@ -788,7 +1002,7 @@ iot_create (call_frame_t *frame, xlator_t *this, loc_t *loc, int32_t flags,
                 goto out;
         }
 
-        ret = iot_schedule (this->private, stub);
+        ret = iot_schedule (this->private, fd->inode, stub);
 
 out:
         if (ret < 0) {
@@ -844,7 +1058,7 @@ iot_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
                 goto out;
 	}
 
-        ret = iot_schedule_slow (this->private, stub);
+        ret = iot_schedule_slow (this->private, fd->inode, stub);
 
 out:
         if (ret < 0) {
@@ -893,7 +1107,7 @@ iot_flush (call_frame_t *frame, xlator_t *this, fd_t *fd)
                 goto out;
 	}
 
-        ret = iot_schedule (this->private, stub);
+        ret = iot_schedule (this->private, fd->inode, stub);
 out:
         if (ret < 0) {
 		STACK_UNWIND_STRICT (flush, frame, -1, -ret);
@@ -943,7 +1157,7 @@ iot_fsync (call_frame_t *frame, xlator_t *this, fd_t *fd, int32_t datasync)
                 goto out;
 	}
 
-        ret = iot_schedule_slow (this->private, stub);
+        ret = iot_schedule_slow (this->private, fd->inode, stub);
 
 out:
         if (ret < 0) {
@@ -999,7 +1213,7 @@ iot_writev (call_frame_t *frame, xlator_t *this, fd_t *fd,
                 goto out;
 	}
 
-        ret = iot_schedule_slow (this->private, stub);
+        ret = iot_schedule_slow (this->private, fd->inode, stub);
 out:
         if (ret < 0) {
 		STACK_UNWIND_STRICT (writev, frame, -1, -ret, NULL, NULL);
@@ -1051,7 +1265,7 @@ iot_lk (call_frame_t *frame, xlator_t *this, fd_t *fd, int32_t cmd,
                 goto out;
 	}
 
-        ret = iot_schedule (this->private, stub);
+        ret = iot_schedule (this->private, fd->inode, stub);
 out:
         if (ret < 0) {
 		STACK_UNWIND_STRICT (lk, frame, -1, -ret, NULL);
@@ -1099,7 +1313,7 @@ iot_stat (call_frame_t *frame, xlator_t *this, loc_t *loc)
                 goto out;
 	}
 
-        ret = iot_schedule_fast (this->private, stub);
+        ret = iot_schedule_fast (this->private, loc->inode, stub);
 
 out:
         if (ret < 0) {
@@ -1148,7 +1362,7 @@ iot_fstat (call_frame_t *frame, xlator_t *this, fd_t *fd)
                 goto out;
 	}
 
-        ret = iot_schedule_fast (this->private, stub);
+        ret = iot_schedule_fast (this->private, fd->inode, stub);
 out:
         if (ret < 0) {
 		STACK_UNWIND_STRICT (fstat, frame, -1, -ret, NULL);
@@ -1200,7 +1414,7 @@ iot_truncate (call_frame_t *frame, xlator_t *this, loc_t *loc, off_t offset)
                 goto out;
 	}
 
-        ret = iot_schedule_slow (this->private, stub);
+        ret = iot_schedule_slow (this->private, loc->inode, stub);
 
 out:
         if (ret < 0) {
@@ -1253,7 +1467,7 @@ iot_ftruncate (call_frame_t *frame, xlator_t *this, fd_t *fd, off_t offset)
                 goto out;
 	}
 
-        ret = iot_schedule_slow (this->private, stub);
+        ret = iot_schedule_slow (this->private, fd->inode, stub);
 out:
         if (ret < 0) {
 		STACK_UNWIND_STRICT (ftruncate, frame, -1, -ret, NULL, NULL);
@@ -1304,7 +1518,7 @@ iot_unlink (call_frame_t *frame, xlator_t *this, loc_t *loc)
                 goto out;
 	}
 
-        ret = iot_schedule (this->private, stub);
+        ret = iot_schedule (this->private, loc->inode, stub);
 
 out:
         if (ret < 0) {
@@ -1354,7 +1568,7 @@ iot_link (call_frame_t *frame, xlator_t *this, loc_t *oldloc, loc_t *newloc)
                 goto out;
         }
 
-        ret = iot_schedule (this->private, stub);
+        ret = iot_schedule (this->private, oldloc->inode, stub);
 out:
         if (ret < 0) {
                 STACK_UNWIND_STRICT (link, frame, -1, -ret, NULL, NULL, NULL,
@@ -1400,7 +1614,7 @@ iot_opendir (call_frame_t *frame, xlator_t *this, loc_t *loc, fd_t *fd)
                 goto out;
         }
 
-        ret = iot_schedule_fast (this->private, stub);
+        ret = iot_schedule_fast (this->private, fd->inode, stub);
 out:
         if (ret < 0) {
                 STACK_UNWIND_STRICT (opendir, frame, -1, -ret, NULL);
@@ -1446,7 +1660,7 @@ iot_fsyncdir (call_frame_t *frame, xlator_t *this, fd_t *fd, int datasync)
                 goto out;
         }
 
-        ret = iot_schedule_slow (this->private, stub);
+        ret = iot_schedule_slow (this->private, fd->inode, stub);
 out:
         if (ret < 0) {
                 STACK_UNWIND_STRICT (fsyncdir, frame, -1, -ret);
@@ -1491,7 +1705,7 @@ iot_statfs (call_frame_t *frame, xlator_t *this, loc_t *loc)
                 goto out;
         }
 
-        ret = iot_schedule_fast (this->private, stub);
+        ret = iot_schedule_fast (this->private, NULL, stub);
 out:
         if (ret < 0) {
                 STACK_UNWIND_STRICT (statfs, frame, -1, -ret, NULL);
@@ -1539,7 +1753,7 @@ iot_setxattr (call_frame_t *frame, xlator_t *this, loc_t *loc, dict_t *dict,
                 goto out;
         }
 
-        ret = iot_schedule (this->private, stub);
+        ret = iot_schedule (this->private, loc->inode, stub);
 
 out:
         if (ret < 0) {
@@ -1587,7 +1801,7 @@ iot_getxattr (call_frame_t *frame, xlator_t *this, loc_t *loc,
                 goto out;
         }
 
-        ret = iot_schedule (this->private, stub);
+        ret = iot_schedule (this->private, loc->inode, stub);
 
 out:
         if (ret < 0) {
@@ -1635,7 +1849,7 @@ iot_fgetxattr (call_frame_t *frame, xlator_t *this, fd_t *fd,
                 goto out;
         }
 
-        ret = iot_schedule (this->private, stub);
+        ret = iot_schedule (this->private, fd->inode, stub);
 out:
         if (ret < 0) {
                 STACK_UNWIND_STRICT (fgetxattr, frame, -1, -ret, NULL);
@@ -1683,7 +1897,7 @@ iot_fsetxattr (call_frame_t *frame, xlator_t *this, fd_t *fd, dict_t *dict,
                 goto out;
         }
 
-        ret = iot_schedule (this->private, stub);
+        ret = iot_schedule (this->private, fd->inode, stub);
 out:
         if (ret < 0) {
                 STACK_UNWIND_STRICT (fsetxattr, frame, -1, -ret);
@@ -1731,7 +1945,7 @@ iot_removexattr (call_frame_t *frame, xlator_t *this, loc_t *loc,
                 goto out;
         }
 
-        ret = iot_schedule (this->private, stub);
+        ret = iot_schedule (this->private, loc->inode, stub);
 out:
         if (ret < 0) {
                 STACK_UNWIND_STRICT (removexattr, frame, -1, -ret);
@@ -1779,7 +1993,7 @@ iot_readdirp (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
                 goto out;
         }
 
-        ret = iot_schedule_fast (this->private, stub);
+        ret = iot_schedule_fast (this->private, fd->inode, stub);
 out:
         if (ret < 0) {
                 STACK_UNWIND_STRICT (readdirp, frame, -1, -ret, NULL);
@@ -1826,7 +2040,7 @@ iot_readdir (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
                 goto out;
         }
 
-        ret = iot_schedule_fast (this->private, stub);
+        ret = iot_schedule_fast (this->private, fd->inode, stub);
 out:
         if (ret < 0) {
                 STACK_UNWIND_STRICT (readdir, frame, -1, -ret, NULL);
@@ -1874,7 +2088,7 @@ iot_xattrop (call_frame_t *frame, xlator_t *this, loc_t *loc,
                 goto out;
         }
 
-        ret = iot_schedule_slow (this->private, stub);
+        ret = iot_schedule_slow (this->private, loc->inode, stub);
 out:
         if (ret < 0) {
                 STACK_UNWIND_STRICT (xattrop, frame, -1, -ret, NULL);
@@ -1921,7 +2135,7 @@ iot_fxattrop (call_frame_t *frame, xlator_t *this, fd_t *fd,
                 goto out;
         }
 
-        ret = iot_schedule_slow (this->private, stub);
+        ret = iot_schedule_slow (this->private, fd->inode, stub);
 out:
         if (ret < 0) {
                 STACK_UNWIND_STRICT (fxattrop, frame, -1, -ret, NULL);
@@ -1970,7 +2184,7 @@ iot_rchecksum (call_frame_t *frame, xlator_t *this, fd_t *fd, off_t offset,
                 goto out;
         }
 
-        ret = iot_schedule_slow (this->private, stub);
+        ret = iot_schedule_slow (this->private, fd->inode, stub);
 out:
         if (ret < 0) {
                 STACK_UNWIND_STRICT (rchecksum, frame, -1, -ret, -1, NULL);
@@ -2168,6 +2382,7 @@ init (xlator_t *this)
         int              idle_time = IOT_DEFAULT_IDLE;
         int              ret = -1;
         int              i = 0;
+        int              j = 0;
 
 	if (!this->children || this->children->next) {
 		gf_log ("io-threads", GF_LOG_ERROR,
@@ -2220,8 +2435,30 @@ init (xlator_t *this)
 
         conf->this = this;
 
-        for (i = 0; i < IOT_PRI_MAX; i++) {
-                INIT_LIST_HEAD (&conf->reqs[i]);
+        if (dict_get (options, "order-by-inode")) {
+                if (gf_string2boolean (data_to_str (dict_get (options,
+                                                        "order-by-inode")),
+                                       &conf->order_by_inode) == -1) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "'order-by-inode' takes only boolean "
+                                "options");
+                        GF_FREE (conf);
+                        goto out;
+                }
+        }
+
+        pthread_mutex_init (&conf->mutex, NULL);
+        pthread_cond_init (&conf->cond, NULL);
+
+        for (i = 0; i < IOT_ORDER_BUCKETS; i++) {
+                LOCK_INIT (&conf->buckets[i].lock);
+                INIT_LIST_HEAD (&conf->buckets[i].reqs);
+        }
+
+        for (i = 0; i < IOT_MAX_THREADS; i++) {
+                LOCK_INIT (&conf->queues[i].lock);
+                for (j = 0; j < IOT_PRI_MAX; j++)
+                        INIT_LIST_HEAD (&conf->queues[i].reqs[j]);
         }
 
 	ret = iot_workers_scale (conf);
@@ -2305,6 +2542,9 @@ struct volume_options options[] = {
          .min   = 1,
          .max   = 0x7fffffff,
         },
+        {.key   = {"order-by-inode"},
+         .type  = GF_OPTION_TYPE_BOOL,
+        },
 	{ .key  = {NULL},
         },
 };
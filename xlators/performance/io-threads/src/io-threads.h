@@ -52,6 +52,8 @@ struct iot_conf;
 
 #define IOT_THREAD_STACK_SIZE   ((size_t)(1024*1024))
 
+#define IOT_ORDER_BUCKETS       256
+
 
 typedef enum {
         IOT_PRI_HI = 0, /* low latency */
@@ -61,19 +63,47 @@ typedef enum {
 } iot_pri_t;
 
 
+/* per-worker request queue, other workers steal from it when idle */
+struct iot_queue {
+        gf_lock_t            lock;
+        struct list_head     reqs[IOT_PRI_MAX];
+        int                  count[IOT_PRI_MAX];
+};
+
+typedef struct iot_queue iot_queue_t;
+
+
+/* stubs of the inodes hashing to a bucket, run one at a time in arrival
+   order when ordering by inode */
+struct iot_bucket {
+        gf_lock_t            lock;
+        struct list_head     reqs;
+        int                  count;
+        int                  busy;        /* a worker is running the head */
+};
+
+typedef struct iot_bucket iot_bucket_t;
+
+
 struct iot_conf {
-        pthread_mutex_t      mutex;
+        pthread_mutex_t      mutex;       /* thread scaling and sleeping */
         pthread_cond_t       cond;
 
         int32_t              max_count;   /* configured maximum */
         int32_t              curr_count;  /* actual number of threads running */
         int32_t              sleep_count;
+        int32_t              wakeup_pending;
 
         int32_t              idle_time;   /* in seconds */
 
-        struct list_head     reqs[IOT_PRI_MAX];
+        iot_queue_t          queues[IOT_MAX_THREADS];
+        char                 slot_used[IOT_MAX_THREADS];
+        unsigned int         next_queue;  /* round-robin enqueue hint */
+
+        gf_boolean_t         order_by_inode;
+        iot_bucket_t         buckets[IOT_ORDER_BUCKETS];
 
-        int                  queue_size;
+        int                  queue_size;  /* runnable stubs, atomic */
         pthread_attr_t       w_attr;
 
         xlator_t            *this;
@@ -142,6 +142,8 @@ ra_fault_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 	ra_waitq_t   *waitq = NULL;
 	fd_t         *fd = NULL;
 	uint64_t     tmp_file = 0;
+        struct timeval tv = {0, };
+        int64_t      rtt = 0;
 
 	local = frame->local;
 	fd  = local->fd;
@@ -151,11 +153,20 @@ ra_fault_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 	file = (ra_file_t *)(long)tmp_file;
 	pending_offset = local->pending_offset;
 
+        gettimeofday (&tv, NULL);
+        rtt = (tv.tv_sec - local->tv.tv_sec) * 1000000
+                + (tv.tv_usec - local->tv.tv_usec);
+
 	ra_file_lock (file);
 	{
 		if (op_ret >= 0)
 			file->stbuf = *stbuf;
 
+                /* smoothed fault latency, sizes the read-ahead window */
+                if (rtt > 0)
+                        file->rtt = file->rtt ? (7 * file->rtt + rtt) / 8
+                                : (uint64_t) rtt;
+
 		if (op_ret < 0) {
 			page = ra_page_get (file, pending_offset);
 			if (page)
@@ -235,6 +246,7 @@ ra_page_fault (ra_file_t *file, call_frame_t *frame, off_t offset)
 	fault_local->pending_size = file->page_size;
 
 	fault_local->fd = fd_ref (file->fd);
+        gettimeofday (&fault_local->tv, NULL);
 
 	STACK_WIND (fault_frame, ra_fault_cbk,
 		    FIRST_CHILD (fault_frame->this),
@@ -467,6 +479,9 @@ ra_page_wakeup (ra_page_t *page)
 void
 ra_page_purge (ra_page_t *page)
 {
+        if (page->dirty && page->ready)
+                __sync_fetch_and_add (&page->file->conf->wasted, 1);
+
 	page->prev->next = page->next;
 	page->next->prev = page->prev;
 
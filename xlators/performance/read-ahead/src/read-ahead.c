@@ -39,7 +39,8 @@
 #include <sys/time.h>
 
 static void
-read_ahead (call_frame_t *frame, ra_file_t *file);
+read_ahead (call_frame_t *frame, ra_file_t *file, struct ra_stream *stream,
+            uint64_t tick, char stalled);
 
 
 int
@@ -77,7 +78,6 @@ ra_open_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                 file->disabled = 1;
         }
 
-	file->offset = (unsigned long long) 0;
 	file->conf = conf;
 	file->pages.next = &file->pages;
 	file->pages.prev = &file->pages;
@@ -98,10 +98,6 @@ ra_open_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 	file->page_size = conf->page_size;
 	pthread_mutex_init (&file->file_lock, NULL);
 
-	if (!file->disabled) {
-		file->page_count = 1;
-	}
-
 	ret = fd_ctx_set (fd, this, (uint64_t)(long)file);
         if (ret == -1) {
                 ra_file_destroy (file);
@@ -148,7 +144,6 @@ ra_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 	if ((fd->flags & O_DIRECT) || ((fd->flags & O_ACCMODE) == O_WRONLY))
 			file->disabled = 1;
 
-	file->offset = (unsigned long long) 0;
 	//file->size = fd->inode->buf.ia_size;
 	file->conf = conf;
 	file->pages.next = &file->pages;
@@ -216,28 +211,147 @@ ra_create (call_frame_t *frame, xlator_t *this, loc_t *loc, int32_t flags,
 */
 
 static void
-flush_region (call_frame_t *frame, ra_file_t *file, off_t offset, off_t size)
+__flush_region (ra_file_t *file, off_t offset, off_t size)
 {
 	ra_page_t *trav = NULL;
 	ra_page_t *next = NULL;
 
+        trav = file->pages.next;
+        while (trav != &file->pages
+               && trav->offset < (offset + size)) {
+
+                next = trav->next;
+                if (trav->offset >= offset && !trav->waitq) {
+                        ra_page_purge (trav);
+                }
+                trav = next;
+        }
+}
+
+
+static void
+flush_region (call_frame_t *frame, ra_file_t *file, off_t offset, off_t size)
+{
 	ra_file_lock (file);
 	{
-		trav = file->pages.next;
-		while (trav != &file->pages
-		       && trav->offset < (offset + size)) {
-
-			next = trav->next;
-			if (trav->offset >= offset && !trav->waitq) {
-				ra_page_purge (trav);
-			}
-			trav = next;
-		}
+                __flush_region (file, offset, size);
 	}
 	ra_file_unlock (file);
 }
 
 
+/* end of the region a stream is expected to read within its window */
+static off_t
+ra_stream_end (ra_file_t *file, struct ra_stream *stream)
+{
+        return stream->next + stream->size
+                + (stream->window * max (file->page_size,
+                                         stream->size + stream->stride));
+}
+
+
+/*
+ * __ra_stream_get - find the stream a read at offset belongs to, or start
+ *                   a new one in place of the least recently used stream.
+ *
+ * a read continues a stream if it starts where the stream expects it to.
+ * the second read of a fresh stream may also fix its stride, when it
+ * skips no more than a full window ahead of the first read.
+ *
+ * assumes file->file_lock is held
+ */
+static struct ra_stream *
+__ra_stream_get (ra_file_t *file, off_t offset, size_t size)
+{
+        struct ra_stream *stream   = NULL;
+        struct ra_stream *victim   = NULL;
+        struct timeval    tv       = {0, };
+        int64_t           elapsed  = 0;
+        off_t             consumed = 0;
+        int               i        = 0;
+
+        gettimeofday (&tv, NULL);
+
+        for (i = 0; i < RA_MAX_STREAMS; i++) {
+                if (file->streams[i].tick
+                    && (file->streams[i].next == offset)) {
+                        stream = &file->streams[i];
+                        break;
+                }
+        }
+
+        for (i = 0; (stream == NULL) && (i < RA_MAX_STREAMS); i++) {
+                if (file->streams[i].tick
+                    && (file->streams[i].hits == 0)
+                    && (offset > file->streams[i].next)
+                    && ((offset - file->streams[i].next)
+                        <= (file->page_size * file->page_count))) {
+                        stream = &file->streams[i];
+                        stream->stride = offset - stream->next;
+                }
+        }
+
+        if (stream == NULL) {
+                for (i = 0; i < RA_MAX_STREAMS; i++) {
+                        if ((victim == NULL)
+                            || (file->streams[i].tick < victim->tick))
+                                victim = &file->streams[i];
+                }
+
+                if (victim->tick) {
+                        /* drop what was read ahead for the old stream */
+                        consumed = floor (victim->offset, file->page_size);
+                        __flush_region (file, consumed,
+                                        ra_stream_end (file, victim)
+                                        - consumed);
+                }
+
+                memset (victim, 0, sizeof (*victim));
+                __sync_fetch_and_add (&file->conf->streams, 1);
+
+                stream = victim;
+                goto update;
+        }
+
+        stream->hits++;
+
+        elapsed = (tv.tv_sec - stream->tv.tv_sec) * 1000000
+                + (tv.tv_usec - stream->tv.tv_usec);
+        if (elapsed > 0) {
+                if (stream->rate)
+                        stream->rate = (3 * stream->rate
+                                        + (size * 1000000 / elapsed)) / 4;
+                else
+                        stream->rate = size * 1000000 / elapsed;
+        }
+
+        /* pages this stream has moved past */
+        consumed = floor (stream->offset, file->page_size);
+        __flush_region (file, consumed,
+                        floor (offset, file->page_size) - consumed);
+
+update:
+        stream->offset = offset;
+        stream->size   = size;
+        stream->next   = offset + size + stream->stride;
+        stream->tv     = tv;
+        stream->tick   = ++file->stream_tick;
+
+        return stream;
+}
+
+
+static void
+ra_stream_reset (ra_file_t *file)
+{
+        ra_file_lock (file);
+        {
+                memset (file->streams, 0, sizeof (file->streams));
+        }
+        ra_file_unlock (file);
+}
+
+
 int
 ra_release (xlator_t *this, fd_t *fd)
 {
@@ -254,71 +368,87 @@ ra_release (xlator_t *this, fd_t *fd)
 }
 
 
-void
-read_ahead (call_frame_t *frame, ra_file_t *file)
+/*
+ * read_ahead - fault in the pages stream is going to read next.
+ *
+ * the window starts at one page once a stream is confirmed, doubles
+ * every time the reader had to wait for a page, and is kept at least as
+ * large as what the reader consumes during one page fault round trip.
+ * it is bounded by the page-count option.
+ */
+static void
+read_ahead (call_frame_t *frame, ra_file_t *file, struct ra_stream *stream,
+            uint64_t tick, char stalled)
 {
-	off_t      ra_offset = 0;
-	size_t     ra_size = 0;
-	off_t      trav_offset = 0;
+	off_t       faults[RA_MAX_PAGE_COUNT];
+	int         fault_count = 0;
+	off_t       trav_offset = 0;
+	off_t       req_offset = 0;
 	ra_page_t  *trav = NULL;
-	off_t      cap = 0;
-	char       fault = 0;
+        uint32_t    max_window = 0;
+        uint64_t    bdp = 0;
+        int         pages = 0;
+        int         i = 0;
 
 	if (!file->page_count)
 		return;
 
-	ra_size   = file->page_size * file->page_count;
-	ra_offset = floor (file->offset, file->page_size);
-	cap       = file->size ? file->size : file->offset + ra_size;
-
-	while (ra_offset < min (file->offset + ra_size, cap)) {
-
-		ra_file_lock (file);
-		{
-			trav = ra_page_get (file, ra_offset);
-		}
-		ra_file_unlock (file);
+        max_window = min (file->page_count, RA_MAX_PAGE_COUNT);
 
-		if (!trav)
-			break;
-
-		ra_offset += file->page_size;
+	ra_file_lock (file);
+	{
+                /* the slot was taken over by another stream meanwhile */
+                if ((stream->tick != tick) || (stream->hits == 0))
+                        goto unlock;
+
+                if (stream->window == 0)
+                        stream->window = 1;
+                else if (stalled)
+                        stream->window = min (stream->window * 2, max_window);
+
+                bdp = (stream->rate * file->rtt / 1000000) / file->page_size
+                        + 1;
+                if (bdp > stream->window)
+                        stream->window = min (bdp, max_window);
+
+                /* one request per step for strided streams, consecutive
+                   pages for sequential ones */
+                req_offset = stream->next;
+                while (pages < stream->window) {
+                        trav_offset = floor (req_offset, file->page_size);
+                        do {
+                                trav = ra_page_get (file, trav_offset);
+                                if (!trav) {
+                                        trav = ra_page_create (file,
+                                                               trav_offset);
+                                        if (!trav)
+                                                /* OUT OF MEMORY */
+                                                goto unlock;
+
+                                        trav->dirty = 1;
+                                        faults[fault_count++] = trav_offset;
+                                }
+                                trav_offset += file->page_size;
+                                pages++;
+                        } while ((pages < stream->window)
+                                 && (stream->stride != 0)
+                                 && (trav_offset < req_offset + stream->size));
+
+                        if (stream->stride == 0)
+                                req_offset = trav_offset;
+                        else
+                                req_offset += stream->size + stream->stride;
+                }
 	}
+unlock:
+	ra_file_unlock (file);
 
-	if (trav)
-		/* comfortable enough */
-		return;
-
-	trav_offset = ra_offset;
-
-	cap  = file->size ? file->size : ra_offset + ra_size;
-
-	while (trav_offset < min(ra_offset + ra_size, cap)) {
-		fault = 0;
-		ra_file_lock (file);
-		{
-			trav = ra_page_get (file, trav_offset);
-			if (!trav) {
-				fault = 1;
-				trav = ra_page_create (file, trav_offset);
-				if (trav) 
-					trav->dirty = 1;
-			}
-		}
-		ra_file_unlock (file);
-
-		if (!trav) {
-			/* OUT OF MEMORY */
-			break;
-		}
-
-		if (fault) {
-			gf_log (frame->this->name, GF_LOG_TRACE,
-				"RA at offset=%"PRId64, trav_offset);
-			ra_page_fault (file, frame, trav_offset);
-		}
-		trav_offset += file->page_size;
-	}
+        for (i = 0; i < fault_count; i++) {
+                gf_log (frame->this->name, GF_LOG_TRACE,
+                        "RA at offset=%"PRId64, faults[i]);
+                __sync_fetch_and_add (&file->conf->prefetched, 1);
+                ra_page_fault (file, frame, faults[i]);
+        }
 
 	return;
 }
@@ -334,7 +464,12 @@ ra_need_atime_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 }
 
 
-static void
+/*
+ * dispatch_requests - serve the read from cached pages, fault in the
+ *                     missing ones. returns 1 if the reader had to wait
+ *                     for any page.
+ */
+static char
 dispatch_requests (call_frame_t *frame, ra_file_t *file)
 {
 	ra_local_t    *local = NULL;
@@ -346,6 +481,7 @@ dispatch_requests (call_frame_t *frame, ra_file_t *file)
 	call_frame_t  *ra_frame = NULL;
 	char          need_atime_update = 1;
 	char          fault = 0;
+        char          stalled = 0;
 
 	local = frame->local;
 	conf  = file->conf;
@@ -377,14 +513,20 @@ dispatch_requests (call_frame_t *frame, ra_file_t *file)
 				gf_log (frame->this->name, GF_LOG_TRACE,
 					"HIT at offset=%"PRId64".",
 					trav_offset);
+                                __sync_fetch_and_add (&conf->hits, 1);
 				ra_frame_fill (trav, frame);
 			} else {
 				gf_log (frame->this->name, GF_LOG_TRACE,
 					"IN-TRANSIT at offset=%"PRId64".",
 					trav_offset);
+                                if (!fault)
+                                        __sync_fetch_and_add (&conf->in_transit,
+                                                              1);
 				ra_wait_on_page (trav, frame);
 				need_atime_update = 0;
+                                stalled = 1;
 			}
+                        trav->dirty = 0;
 		}
 	unlock:
 		ra_file_unlock (file);
@@ -393,6 +535,7 @@ dispatch_requests (call_frame_t *frame, ra_file_t *file)
 			gf_log (frame->this->name, GF_LOG_TRACE,
 				"MISS at offset=%"PRId64".",
 				trav_offset);
+                        __sync_fetch_and_add (&conf->misses, 1);
 			ra_page_fault (file, frame, trav_offset);
 		}
 
@@ -414,7 +557,7 @@ dispatch_requests (call_frame_t *frame, ra_file_t *file)
 	}
 
 out:
-	return ;
+	return stalled;
 }
 
 
@@ -436,12 +579,11 @@ ra_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
 {
 	ra_file_t    *file = NULL;
 	ra_local_t   *local = NULL;
-	ra_conf_t    *conf = NULL;
 	int          op_errno = 0;
-	char         expected_offset = 1;
 	uint64_t     tmp_file = 0;
-
-	conf = this->private;
+        struct ra_stream *stream = NULL;
+        uint64_t     tick = 0;
+        char         stalled = 0;
 
 	gf_log (this->name, GF_LOG_TRACE,
 		"NEW REQ at offset=%"PRId64" for size=%"GF_PRI_SIZET"",
@@ -457,28 +599,6 @@ ra_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
                 goto unwind;
         }
 
-	if (file->offset != offset) {
-		gf_log (this->name, GF_LOG_DEBUG,
-			"unexpected offset (%"PRId64" != %"PRId64") resetting",
-			file->offset, offset);
-
-		expected_offset = file->expected = file->page_count = 0;
-	} else {
-		gf_log (this->name, GF_LOG_TRACE,
-			"expected offset (%"PRId64") when page_count=%d",
-			offset, file->page_count);
-
-		if (file->expected < (conf->page_size * conf->page_count)) {
-			file->expected += size;
-			file->page_count = min ((file->expected / file->page_size),
-						conf->page_count);
-		}
-	}
-
-	if (!expected_offset) {
-		flush_region (frame, file, 0, file->pages.prev->offset + 1);
-	}
-
 	if (file->disabled) {
 		STACK_WIND (frame, ra_readv_disabled_cbk,
 			    FIRST_CHILD (frame->this), 
@@ -496,6 +616,18 @@ ra_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
 		goto unwind;
 	}
 
+        ra_file_lock (file);
+        {
+                stream = __ra_stream_get (file, offset, size);
+                tick = stream->tick;
+
+                gf_log (this->name, GF_LOG_TRACE,
+                        "stream %p hits=%u window=%u stride=%"PRId64,
+                        stream, stream->hits, stream->window,
+                        stream->stride);
+        }
+        ra_file_unlock (file);
+
 	local->fd         = fd;
 	local->offset     = offset;
 	local->size       = size;
@@ -508,16 +640,12 @@ ra_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
 
 	frame->local = local;
 
-	dispatch_requests (frame, file);
-
-	flush_region (frame, file, 0, floor (offset, file->page_size));
+	stalled = dispatch_requests (frame, file);
 
-        read_ahead (frame, file);
+        read_ahead (frame, file, stream, tick, stalled);
 
 	ra_frame_return (frame);
 
-	file->offset = offset + size;
-
 	return 0;
 
 unwind:
@@ -649,8 +777,8 @@ ra_writev (call_frame_t *frame, xlator_t *this, fd_t *fd, struct iovec *vector,
 
         flush_region (frame, file, 0, file->pages.prev->offset+1);
 
-        /* reset the read-ahead counters too */
-        file->expected = file->page_count = 0;
+        /* reset the read-ahead streams too */
+        ra_stream_reset (file);
 
 	frame->local = fd;
 
@@ -818,6 +946,18 @@ ra_priv_dump (xlator_t *this)
         gf_proc_dump_write (key, "%d", conf->page_count);
         gf_proc_dump_build_key (key, key_prefix, "force_atime_update");
         gf_proc_dump_write (key, "%d", conf->force_atime_update);
+        gf_proc_dump_build_key (key, key_prefix, "hits");
+        gf_proc_dump_write (key, "%"PRIu64, conf->hits);
+        gf_proc_dump_build_key (key, key_prefix, "in_transit");
+        gf_proc_dump_write (key, "%"PRIu64, conf->in_transit);
+        gf_proc_dump_build_key (key, key_prefix, "misses");
+        gf_proc_dump_write (key, "%"PRIu64, conf->misses);
+        gf_proc_dump_build_key (key, key_prefix, "prefetched");
+        gf_proc_dump_write (key, "%"PRIu64, conf->prefetched);
+        gf_proc_dump_build_key (key, key_prefix, "wasted");
+        gf_proc_dump_write (key, "%"PRIu64, conf->wasted);
+        gf_proc_dump_build_key (key, key_prefix, "streams");
+        gf_proc_dump_write (key, "%"PRIu64, conf->streams);
 
         pthread_mutex_unlock (&conf->conf_lock);
 
@@ -967,7 +1107,7 @@ struct volume_options options[] = {
 	{ .key  = {"page-count"}, 
 	  .type = GF_OPTION_TYPE_INT, 
 	  .min  = 1, 
-	  .max  = 16 
+	  .max  = RA_MAX_PAGE_COUNT
 	},
 	{ .key = {NULL} },
 };
@@ -32,6 +32,10 @@
 #include "xlator.h"
 #include "common-utils.h"
 #include "read-ahead-mem-types.h"
+#include <sys/time.h>
+
+#define RA_MAX_STREAMS     8   /* independent readers tracked per fd */
+#define RA_MAX_PAGE_COUNT  16  /* upper limit of option page-count */
 
 struct ra_conf;
 struct ra_local;
@@ -69,6 +73,7 @@ struct ra_local {
 	fd_t             *fd;
 	int32_t           wait_count;
 	pthread_mutex_t   local_lock;
+        struct timeval    tv;       /* when the page fault was sent */
 };
 
 
@@ -76,7 +81,7 @@ struct ra_page {
 	struct ra_page   *next;
 	struct ra_page   *prev;
 	struct ra_file   *file;
-	char              dirty;
+	char              dirty;    /* read ahead, not consumed yet */
 	char              ready;
 	struct iovec     *vector;
 	int32_t           count;
@@ -87,16 +92,35 @@ struct ra_page {
 };
 
 
+/*
+ * ra_stream - one sequential or constant-stride reader of an fd. several
+ *             threads reading the same fd each get their own stream.
+ */
+struct ra_stream {
+        off_t             offset;   /* offset of the last read */
+        size_t            size;     /* size of the last read */
+        off_t             stride;   /* gap between two reads, 0 if
+                                     * sequential */
+        off_t             next;     /* where the next read is expected */
+        uint32_t          hits;     /* reads which matched this stream */
+        uint32_t          window;   /* read-ahead window, in pages */
+        uint64_t          rate;     /* consumption rate, bytes/sec */
+        struct timeval    tv;       /* time of the last read */
+        uint64_t          tick;     /* last use, 0 if the slot is free */
+};
+
+
 struct ra_file {
 	struct ra_file    *next;
 	struct ra_file    *prev;
 	struct ra_conf    *conf;
 	fd_t              *fd;
 	int                disabled;
-	size_t             expected;
 	struct ra_page     pages;
-	off_t              offset;
 	size_t             size;
+        struct ra_stream   streams[RA_MAX_STREAMS];
+        uint64_t           stream_tick;
+        uint64_t           rtt;      /* page fault latency in usec */
 	int32_t            refcount;
 	pthread_mutex_t    file_lock;
 	struct iatt        stbuf;
@@ -112,6 +136,14 @@ struct ra_conf {
 	struct ra_file    files;
 	gf_boolean_t      force_atime_update;
 	pthread_mutex_t   conf_lock;
+
+        /* updated atomically, reported in the statedump */
+        uint64_t          hits;        /* pages found ready */
+        uint64_t          in_transit;  /* pages found with a fault pending */
+        uint64_t          misses;      /* pages faulted in by the reader */
+        uint64_t          prefetched;  /* pages faulted in by read-ahead */
+        uint64_t          wasted;      /* prefetched, purged unconsumed */
+        uint64_t          streams;     /* streams started */
 };
 
 
@@ -36,7 +36,10 @@
 #include "call-stub.h"
 #include "statedump.h"
 #include "write-behind-mem-types.h"
+#include "rb.h"
 
+/* the transports take a bounded number of payload vectors per message,
+   longer runs of writes are packed into one iobuf before winding */
 #define MAX_VECTOR_COUNT 8
 #define WB_AGGREGATE_SIZE 131072 /* 128 KB */
 #define WB_WINDOW_SIZE 1048576 /* 1MB */
@@ -58,10 +61,27 @@ typedef struct wb_file {
         int32_t      op_ret;
         int32_t      op_errno;
         list_head_t  request;
-        list_head_t  passive_requests;
         fd_t        *fd;
         gf_lock_t    lock;
         xlator_t    *this;
+
+        /* 
+         * writes not yet wound are grouped in generations, a fop other
+         * than write closes the current one. the unwound writes of the
+         * current generation are indexed by offset in @extents and never
+         * overlap: a newer write cuts its range out of older ones, see
+         * __wb_extent_insert.
+         */
+        struct rb_table *extents;
+        uint64_t     generation;
+
+        struct iatt  stbuf;             /* from the last write reply, for
+                                           reads served from @extents */
+        char         stbuf_valid;
+        uint64_t     stbuf_generation;
+
+        uint64_t     collapsed_bytes;
+        uint64_t     local_reads;
 }wb_file_t;
 
 
@@ -75,12 +95,17 @@ typedef struct wb_request {
         int32_t         refcount;
         wb_file_t      *file;
         glusterfs_fop_t fop;
+        uint64_t        generation;
+        off_t           wind_off;       /* what is left to send of the */
+        size_t          wind_size;      /* write after overlaps are cut */
         union {
                 struct  {
                         char write_behind;
                         char stack_wound;
                         char got_reply;
-                        char virgin;
+                        char collapsed;     /* completely overwritten by
+                                             * a later write, never wound
+                                             */
                         char flush_all;     /* while trying to sync to back-end,
                                              * don't wait till a data of size
                                              * equal to configured aggregate-size
@@ -118,6 +143,7 @@ typedef struct wb_local {
         int             op_errno;
         call_frame_t   *frame;
         int32_t         reply_count;
+        uint64_t        generation;
 } wb_local_t;
 
 
@@ -221,6 +247,295 @@ wb_request_ref (wb_request_t *this)
 }
 
 
+static int
+wb_extent_cmp (const void *a, const void *b, void *param)
+{
+        const wb_request_t *r1 = a;
+        const wb_request_t *r2 = b;
+
+        /* overlapping extents compare equal */
+        if ((off_t)(r1->wind_off + r1->wind_size) <= r2->wind_off)
+                return -1;
+
+        if (r1->wind_off >= (off_t)(r2->wind_off + r2->wind_size))
+                return 1;
+
+        return 0;
+}
+
+
+/* close the current generation, see wb_file_t */
+static void
+__wb_extents_seal (wb_file_t *file)
+{
+        if (file->extents != NULL) {
+                rb_destroy (file->extents, NULL);
+                file->extents = NULL;
+        }
+
+        file->generation++;
+}
+
+
+/* cut @head bytes off the start and @tail bytes off the end of what is
+   still to be sent for @request */
+static void
+__wb_request_trim (wb_request_t *request, size_t head, size_t tail)
+{
+        struct iovec *vector = NULL;
+        int           count  = 0;
+        int           i      = 0;
+        int           j      = 0;
+        size_t        skip   = 0;
+        size_t        len    = 0;
+
+        vector = request->stub->args.writev.vector;
+        count  = request->stub->args.writev.count;
+
+        request->wind_off += head;
+        request->wind_size -= (head + tail);
+        request->stub->args.writev.off = request->wind_off;
+        request->file->collapsed_bytes += (head + tail);
+
+        skip = head;
+        for (i = 0; i < count; i++) {
+                if (skip >= vector[i].iov_len) {
+                        skip -= vector[i].iov_len;
+                        continue;
+                }
+
+                vector[j].iov_base = vector[i].iov_base + skip;
+                vector[j].iov_len  = vector[i].iov_len - skip;
+                skip = 0;
+                j++;
+        }
+        count = j;
+
+        for (i = 0; (i < count) && (len < request->wind_size); i++) {
+                if ((len + vector[i].iov_len) > request->wind_size) {
+                        vector[i].iov_len = request->wind_size - len;
+                }
+                len += vector[i].iov_len;
+        }
+
+        request->stub->args.writev.count = i;
+}
+
+
+/* 
+ * @request was overwritten completely by a later write of the same
+ * generation. it is never wound, the data goes out with the write which
+ * replaced it, so it is accounted for as if it was wound and replied.
+ */
+static void
+__wb_request_collapse (wb_request_t *request)
+{
+        wb_file_t *file = NULL;
+
+        file = request->file;
+
+        file->collapsed_bytes += request->wind_size;
+        request->wind_size = 0;
+
+        request->flags.write_request.collapsed = 1;
+        request->flags.write_request.stack_wound = 1;
+        request->flags.write_request.got_reply = 1;
+
+        file->aggregate_current -= request->write_size;
+        if (request->flags.write_request.write_behind) {
+                file->window_current -= request->write_size;
+        }
+
+        /* reference for stack winding */
+        __wb_request_unref (request);
+}
+
+
+static void
+__wb_extent_insert (wb_file_t *file, wb_request_t *request)
+{
+        wb_request_t  *extent     = NULL;
+        off_t          start      = 0;
+        off_t          end        = 0;
+        off_t          extent_end = 0;
+        void         **slot       = NULL;
+
+        /* offsets of appending writes mean nothing, nor is there anything
+           to cut out of an empty write */
+        if ((file->flags & O_APPEND) || (request->wind_size == 0)) {
+                return;
+        }
+
+        if (file->extents == NULL) {
+                file->extents = rb_create (wb_extent_cmp, NULL, NULL);
+                if (file->extents == NULL) {
+                        goto alone;
+                }
+        }
+
+        start = request->wind_off;
+        end = start + request->wind_size;
+
+        while ((extent = rb_find (file->extents, request)) != NULL) {
+                extent_end = extent->wind_off + extent->wind_size;
+
+                if ((extent->wind_off < start) && (extent_end > end)) {
+                        /* 
+                         * lands in the middle of a pending write. instead
+                         * of splitting that one, let this write start a
+                         * new generation, it will be wound after the
+                         * current one is done.
+                         */
+                        __wb_extents_seal (file);
+                        request->generation = file->generation;
+
+                        file->extents = rb_create (wb_extent_cmp, NULL, NULL);
+                        if (file->extents == NULL) {
+                                goto alone;
+                        }
+                        break;
+                }
+
+                if ((extent->wind_off >= start) && (extent_end <= end)) {
+                        rb_delete (file->extents, extent);
+                        __wb_request_collapse (extent);
+                } else if (extent->wind_off < start) {
+                        __wb_request_trim (extent, 0, extent_end - start);
+                } else {
+                        __wb_request_trim (extent, end - extent->wind_off, 0);
+                }
+        }
+
+        slot = rb_probe (file->extents, request);
+        if (slot != NULL) {
+                return;
+        }
+
+alone:
+        /* without the index overlaps can not be told, so nothing may be
+           wound together with this write */
+        __wb_extents_seal (file);
+        request->generation = file->generation;
+        __wb_extents_seal (file);
+
+        return;
+}
+
+
+/* 
+ * serve a read from unwound writes of the current generation, if they
+ * cover all of it. any older data under the range is overwritten by them
+ * anyway.
+ */
+static int
+__wb_read_pending (wb_file_t *file, size_t size, off_t offset,
+                   struct iovec **vector_p, int32_t *count_p,
+                   struct iobref **iobref_p, struct iatt *stbuf)
+{
+        struct rb_traverser  trav;
+        wb_request_t         probe;
+        wb_request_t        *extent = NULL;
+        wb_request_t        *first  = NULL;
+        struct iovec        *vector = NULL;
+        struct iobref       *iobref = NULL;
+        off_t                covered = 0;
+        off_t                end     = 0;
+        off_t                from    = 0;
+        off_t                to      = 0;
+        int32_t              count   = 0;
+        int                  ret     = -1;
+
+        if ((file->extents == NULL) || !file->stbuf_valid || (size == 0)) {
+                goto out;
+        }
+
+        memset (&probe, 0, sizeof (probe));
+        probe.wind_off = offset;
+        probe.wind_size = 1;
+
+        end = offset + size;
+
+        first = rb_t_find (&trav, file->extents, &probe);
+        covered = offset;
+        for (extent = first; extent != NULL; extent = rb_t_next (&trav)) {
+                if (extent->wind_off > covered) {
+                        break;
+                }
+
+                from = covered - extent->wind_off;
+                to = min (end, (off_t)(extent->wind_off + extent->wind_size))
+                        - extent->wind_off;
+                count += iov_subset (extent->stub->args.writev.vector,
+                                     extent->stub->args.writev.count,
+                                     from, to, NULL);
+
+                covered = extent->wind_off + to;
+                if (covered >= end) {
+                        break;
+                }
+        }
+
+        if (covered < end) {
+                goto out;
+        }
+
+        vector = GF_CALLOC (count, sizeof (*vector), gf_wb_mt_iovec);
+        if (vector == NULL) {
+                goto out;
+        }
+
+        iobref = iobref_new ();
+        if (iobref == NULL) {
+                GF_FREE (vector);
+                goto out;
+        }
+
+        rb_t_find (&trav, file->extents, &probe);
+        covered = offset;
+        count = 0;
+        for (extent = first; covered < end; extent = rb_t_next (&trav)) {
+                from = covered - extent->wind_off;
+                to = min (end, (off_t)(extent->wind_off + extent->wind_size))
+                        - extent->wind_off;
+                count += iov_subset (extent->stub->args.writev.vector,
+                                     extent->stub->args.writev.count,
+                                     from, to, vector + count);
+
+                if (extent->stub->args.writev.iobref) {
+                        iobref_merge (iobref,
+                                      extent->stub->args.writev.iobref);
+                }
+
+                covered = extent->wind_off + to;
+        }
+
+        /* writes of older generations still queued may extend the file
+           beyond what the last reply said */
+        *stbuf = file->stbuf;
+        list_for_each_entry (extent, &file->request, list) {
+                if ((extent->stub == NULL)
+                    || (extent->stub->fop != GF_FOP_WRITE)
+                    || (extent->generation < file->stbuf_generation)
+                    || extent->flags.write_request.collapsed) {
+                        continue;
+                }
+
+                if (stbuf->ia_size < (extent->wind_off + extent->wind_size)) {
+                        stbuf->ia_size = extent->wind_off + extent->wind_size;
+                }
+        }
+
+        file->local_reads++;
+
+        *vector_p = vector;
+        *count_p = count;
+        *iobref_p = iobref;
+        ret = 0;
+out:
+        return ret;
+}
+
+
 wb_request_t *
 wb_enqueue (wb_file_t *file, call_stub_t *stub)
 {
@@ -260,7 +575,8 @@ wb_enqueue (wb_file_t *file, call_stub_t *stub)
                         local->op_errno = 0;
                 }
 
-                request->flags.write_request.virgin = 1;
+                request->wind_off = stub->args.writev.off;
+                request->wind_size = request->write_size;
         }
 
         LOCK (&file->lock);
@@ -274,6 +590,9 @@ wb_enqueue (wb_file_t *file, call_stub_t *stub)
                         __wb_request_ref (request);
 
                         file->aggregate_current += request->write_size;
+
+                        request->generation = file->generation;
+                        __wb_extent_insert (file, request);
                 } else {
                         list_for_each_entry (tmp, &file->request, list) {
                                 if (tmp->stub && tmp->stub->fop
@@ -282,6 +601,12 @@ wb_enqueue (wb_file_t *file, call_stub_t *stub)
                                 }
                         }
 
+                        /* writes queued after this fop must neither be
+                           merged with nor overwrite those before it */
+                        __wb_extents_seal (file);
+                        file->stbuf_valid = 0;
+                        file->stbuf_generation = file->generation;
+
                         /*reference for resuming */
                         __wb_request_ref (request);
                 }
@@ -305,7 +630,6 @@ wb_file_create (xlator_t *this, fd_t *fd, int32_t flags)
         }
 
         INIT_LIST_HEAD (&file->request);
-        INIT_LIST_HEAD (&file->passive_requests);
 
         /* 
            fd_ref() not required, file should never decide the existance of
@@ -336,6 +660,10 @@ wb_file_destroy (wb_file_t *file)
         UNLOCK (&file->lock);
 
         if (!refcount){
+                if (file->extents != NULL) {
+                        rb_destroy (file->extents, NULL);
+                }
+
                 LOCK_DESTROY (&file->lock);
                 GF_FREE (file);
         }
@@ -344,46 +672,69 @@ wb_file_destroy (wb_file_t *file)
 }
 
 
+/* the writes in @winds are done, with @op_ret */
+static void
+__wb_sync_done (wb_file_t *file, list_head_t *winds, int32_t op_ret,
+                int32_t op_errno)
+{
+        wb_request_t *request = NULL, *dummy = NULL;
+        wb_local_t   *per_request_local = NULL;
+
+        list_for_each_entry_safe (request, dummy, winds, winds) {
+                request->flags.write_request.got_reply = 1;
+
+                if (!request->flags.write_request.write_behind
+                    && (op_ret == -1)) {
+                        per_request_local = request->stub->frame->local;
+                        per_request_local->op_ret = op_ret;
+                        per_request_local->op_errno = op_errno;
+                }
+
+                if (request->flags.write_request.write_behind) {
+                        file->window_current -= request->write_size;
+                }
+
+                list_del_init (&request->winds);
+                __wb_request_unref (request);
+        }
+
+        if (op_ret == -1) {
+                file->op_ret = op_ret;
+                file->op_errno = op_errno;
+        }
+}
+
+
 int32_t
 wb_sync_cbk (call_frame_t *frame, void *cookie, xlator_t *this, int32_t op_ret,
              int32_t op_errno, struct iatt *prebuf, struct iatt *postbuf)
 {
         wb_local_t   *local = NULL;
-        list_head_t  *winds = NULL;
         wb_file_t    *file = NULL;
-        wb_request_t *request = NULL, *dummy = NULL;
-        wb_local_t   *per_request_local = NULL;
         int32_t       ret = -1;
         fd_t         *fd  = NULL;
+        uint64_t      size = 0;
 
 
         local = frame->local;
-        winds = &local->winds;
         file = local->file;
 
         LOCK (&file->lock);
         {
-                list_for_each_entry_safe (request, dummy, winds, winds) {
-                        request->flags.write_request.got_reply = 1;
-
-                        if (!request->flags.write_request.write_behind
-                            && (op_ret == -1)) {
-                                per_request_local = request->stub->frame->local;
-                                per_request_local->op_ret = op_ret;
-                                per_request_local->op_errno = op_errno;
+                __wb_sync_done (file, &local->winds, op_ret, op_errno);
+
+                /* replies of writes wound before a truncate or the like
+                   tell nothing about the file any more */
+                if ((op_ret != -1) && (postbuf != NULL)
+                    && (local->generation >= file->stbuf_generation)) {
+                        size = file->stbuf_valid ? file->stbuf.ia_size : 0;
+                        file->stbuf = *postbuf;
+                        if (file->stbuf.ia_size < size) {
+                                file->stbuf.ia_size = size;
                         }
-
-                        if (request->flags.write_request.write_behind) {
-                                file->window_current -= request->write_size;
-                        }
-
-                        __wb_request_unref (request);
-                }
-                
-                if (op_ret == -1) {
-                        file->op_ret = op_ret;
-                        file->op_errno = op_errno;
+                        file->stbuf_valid = 1;
                 }
+
                 fd = file->fd;
         }
         UNLOCK (&file->lock);
@@ -407,196 +758,270 @@ wb_sync_cbk (call_frame_t *frame, void *cookie, xlator_t *this, int32_t op_ret,
 }
 
 
-ssize_t
-wb_sync (call_frame_t *frame, wb_file_t *file, list_head_t *winds)
+static int
+wb_request_offset_cmp (const void *a, const void *b)
+{
+        const wb_request_t *r1 = *(wb_request_t * const *)a;
+        const wb_request_t *r2 = *(wb_request_t * const *)b;
+
+        if (r1->wind_off < r2->wind_off)
+                return -1;
+
+        if (r1->wind_off > r2->wind_off)
+                return 1;
+
+        return 0;
+}
+
+
+/* copy the payload into a single iobuf, so that a run of many small writes
+   goes out as one vector */
+static int
+wb_pack_vector (xlator_t *this, struct iovec *vector, int32_t *count,
+                struct iobref *iobref)
+{
+        struct iobuf *iobuf = NULL;
+        size_t        size  = 0;
+        int           ret   = -1;
+
+        size = iov_length (vector, *count);
+
+        iobuf = iobuf_get2 (this->ctx->iobuf_pool, size);
+        if (iobuf == NULL) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "out of memory");
+                goto out;
+        }
+
+        ret = iobref_add (iobref, iobuf);
+        if (ret != 0) {
+                gf_log (this->name, GF_LOG_DEBUG,
+                        "cannot add iobuf (%p) into iobref (%p)",
+                        iobuf, iobref);
+                iobuf_unref (iobuf);
+                goto out;
+        }
+
+        iov_unload (iobuf->ptr, vector, *count);
+
+        vector[0].iov_base = iobuf->ptr;
+        vector[0].iov_len = size;
+        *count = 1;
+
+        /* iobref holds it from now on */
+        iobuf_unref (iobuf);
+out:
+        return ret;
+}
+
+
+/* wind one write for @nr requests, which are contiguous and sorted by
+   offset */
+static ssize_t
+wb_sync_run (call_frame_t *frame, wb_file_t *file, wb_request_t **requests,
+             int nr)
 {
-        wb_request_t   *dummy = NULL, *request = NULL;
-        wb_request_t   *first_request = NULL, *next = NULL;
-        size_t          total_count = 0, count = 0;
-        size_t          copied = 0;
         call_frame_t   *sync_frame = NULL;
-        struct iobref  *iobref = NULL;
         wb_local_t     *local = NULL;
         struct iovec   *vector = NULL;
-        ssize_t         current_size = 0, bytes = 0;
-        size_t          bytecount = 0;
-        wb_conf_t      *conf = NULL;
-        fd_t           *fd   = NULL;
-        int32_t         op_errno = -1;
+        struct iobref  *iobref = NULL;
+        list_head_t     failed;
+        int32_t         count = 0;
+        size_t          size = 0;
+        fd_t           *fd = NULL;
+        int             i = 0;
+        ssize_t         bytes = -1;
 
-        if (frame == NULL) {
-                op_errno = EINVAL;
+        for (i = 0; i < nr; i++) {
+                count += requests[i]->stub->args.writev.count;
+        }
+
+        local = GF_CALLOC (1, sizeof (*local), gf_wb_mt_wb_local_t);
+        if (local == NULL) {
+                gf_log (file->this->name, GF_LOG_ERROR, "out of memory");
                 goto out;
         }
 
-        conf = file->this->private;
-        list_for_each_entry (request, winds, winds) {
-                total_count += request->stub->args.writev.count;
-                if (total_count > 0) {
-                        break;
-                }
+        INIT_LIST_HEAD (&local->winds);
+
+        vector = GF_CALLOC (count, sizeof (*vector), gf_wb_mt_iovec);
+        if (vector == NULL) {
+                gf_log (file->this->name, GF_LOG_ERROR, "out of memory");
+                goto out;
         }
 
-        if (total_count == 0) {
-                gf_log (file->this->name, GF_LOG_TRACE, "no vectors are to be"
-                        "synced");
+        iobref = iobref_new ();
+        if (iobref == NULL) {
+                gf_log (file->this->name, GF_LOG_ERROR, "out of memory");
                 goto out;
         }
-  
-        list_for_each_entry_safe (request, dummy, winds, winds) {
-                if (!vector) {
-                        vector = GF_MALLOC (VECTORSIZE (MAX_VECTOR_COUNT),
-                                            gf_wb_mt_iovec);
-                        if (vector == NULL) {
-                                bytes = -1;
-                                op_errno = ENOMEM;
-                                gf_log (file->this->name, GF_LOG_ERROR,
-                                        "out of memory");
-                                goto out;
-                        }
 
-                        iobref = iobref_new ();
-                        if (iobref == NULL) {
-                                bytes = -1;
-                                op_errno = ENOMEM;
-                                gf_log (file->this->name, GF_LOG_ERROR,
-                                        "out of memory");
-                                goto out;
-                        }
+        count = 0;
+        for (i = 0; i < nr; i++) {
+                memcpy (vector + count, requests[i]->stub->args.writev.vector,
+                        VECTORSIZE (requests[i]->stub->args.writev.count));
+                count += requests[i]->stub->args.writev.count;
+                size += requests[i]->wind_size;
 
-                        local = GF_CALLOC (1, sizeof (*local),
-                                           gf_wb_mt_wb_local_t);
-                        if (local == NULL) {
-                                bytes = -1;
-                                op_errno = ENOMEM;
-                                gf_log (file->this->name, GF_LOG_ERROR,
-                                        "out of memory");
-                                goto out;
-                        }
+                if (requests[i]->stub->args.writev.iobref) {
+                        iobref_merge (iobref,
+                                      requests[i]->stub->args.writev.iobref);
+                }
+        }
 
-                        INIT_LIST_HEAD (&local->winds);
-            
-                        first_request = request;
-                        current_size = 0;
+        if (count > MAX_VECTOR_COUNT) {
+                if (wb_pack_vector (file->this, vector, &count, iobref) != 0) {
+                        goto out;
                 }
+        }
 
-                count += request->stub->args.writev.count;
-                bytecount = VECTORSIZE (request->stub->args.writev.count);
-                memcpy (((char *)vector)+copied,
-                        request->stub->args.writev.vector,
-                        bytecount);
-                copied += bytecount;
-      
-                current_size += request->write_size;
+        sync_frame = copy_frame (frame);
+        if (sync_frame == NULL) {
+                gf_log (file->this->name, GF_LOG_ERROR, "out of memory");
+                goto out;
+        }
 
-                if (request->stub->args.writev.iobref) {
-                        iobref_merge (iobref,
-                                      request->stub->args.writev.iobref);
-                }
+        for (i = 0; i < nr; i++) {
+                list_add_tail (&requests[i]->winds, &local->winds);
+        }
+
+        sync_frame->local = local;
+        local->file = file;
+        local->generation = requests[0]->generation;
+
+        LOCK (&file->lock);
+        {
+                fd = file->fd;
+        }
+        UNLOCK (&file->lock);
+
+        fd_ref (fd);
+
+        bytes = size;
+        STACK_WIND (sync_frame, wb_sync_cbk,
+                    FIRST_CHILD(sync_frame->this),
+                    FIRST_CHILD(sync_frame->this)->fops->writev,
+                    fd, vector, count, requests[0]->wind_off, iobref);
+
+        local = NULL;
+out:
+        if (iobref != NULL) {
+                iobref_unref (iobref);
+        }
+
+        if (vector != NULL) {
+                GF_FREE (vector);
+        }
 
-                next = NULL;
-                if (request->winds.next != winds) {    
-                        next = list_entry (request->winds.next,
-                                           wb_request_t, winds);
+        if (bytes == -1) {
+                if (local != NULL) {
+                        GF_FREE (local);
                 }
 
-                list_del_init (&request->winds);
-                list_add_tail (&request->winds, &local->winds);
+                INIT_LIST_HEAD (&failed);
+                for (i = 0; i < nr; i++) {
+                        list_add_tail (&requests[i]->winds, &failed);
+                }
 
-                if ((!next)
-                    || ((count + next->stub->args.writev.count)
-                        > MAX_VECTOR_COUNT)
-                    || ((current_size + next->write_size)
-                        > conf->aggregate_size))
+                LOCK (&file->lock);
                 {
-                        sync_frame = copy_frame (frame);  
-                        if (sync_frame == NULL) {
-                                bytes = -1;
-                                op_errno = ENOMEM;
-                                gf_log (file->this->name, GF_LOG_ERROR,
-                                        "out of memory");
-                                goto out;
-                        }
+                        __wb_sync_done (file, &failed, -1, ENOMEM);
+                }
+                UNLOCK (&file->lock);
+        }
 
-                        sync_frame->local = local;
-                        local->file = file;
+        return bytes;
+}
 
-                        LOCK (&file->lock);
-                        {
-                                fd = file->fd;
-                        }
-                        UNLOCK (&file->lock);
 
-                        fd_ref (fd);
-
-                        bytes += current_size;
-                        STACK_WIND (sync_frame,
-                                    wb_sync_cbk,
-                                    FIRST_CHILD(sync_frame->this),
-                                    FIRST_CHILD(sync_frame->this)->fops->writev,
-                                    fd, vector,
-                                    count,
-                                    first_request->stub->args.writev.off,
-                                    iobref);
-        
-                        iobref_unref (iobref);
-                        GF_FREE (vector);
-                        first_request = NULL;
-                        iobref = NULL;
-                        vector = NULL;
-                        sync_frame = NULL;
-                        local = NULL;
-                        copied = count = 0;
-                }
+/* 
+ * the requests in @winds are one generation, so (appending writes aside)
+ * they do not overlap and may be sent in any order. they go out sorted by
+ * offset, adjacent ones merged into a write of up to aggregate-size.
+ */
+ssize_t
+wb_sync (call_frame_t *frame, wb_file_t *file, list_head_t *winds)
+{
+        wb_request_t   *request = NULL, *dummy = NULL, *prev = NULL;
+        wb_request_t  **requests = NULL;
+        wb_conf_t      *conf = NULL;
+        size_t          size = 0;
+        ssize_t         bytes = 0, ret = 0;
+        int             nr = 0, first = 0, i = 0;
+
+        if (frame == NULL) {
+                goto out;
         }
 
-out:
-        if (sync_frame != NULL) {
-                sync_frame->local = NULL;
-                STACK_DESTROY (sync_frame->root);
+        conf = file->this->private;
+
+        list_for_each_entry (request, winds, winds) {
+                nr++;
         }
 
-        if (local != NULL) {
-                /* had we winded these requests, we would have unrefed
-                 * in wb_sync_cbk.
-                 */
-                list_for_each_entry_safe (request, dummy, &local->winds,
-                                          winds) {
-                        wb_request_unref (request);
+        if (nr == 0) {
+                gf_log (file->this->name, GF_LOG_TRACE, "no vectors are to be"
+                        "synced");
+                goto out;
+        }
+
+        requests = GF_CALLOC (nr, sizeof (*requests),
+                              gf_wb_mt_wb_request_ptr_t);
+        if (requests == NULL) {
+                gf_log (file->this->name, GF_LOG_ERROR, "out of memory");
+
+                LOCK (&file->lock);
+                {
+                        __wb_sync_done (file, winds, -1, ENOMEM);
                 }
+                UNLOCK (&file->lock);
 
-                GF_FREE (local);
-                local = NULL;
+                bytes = -1;
+                goto out;
         }
 
-        if (iobref != NULL) {
-                iobref_unref (iobref);
+        nr = 0;
+        list_for_each_entry_safe (request, dummy, winds, winds) {
+                list_del_init (&request->winds);
+                requests[nr++] = request;
         }
 
-        if (vector != NULL) {
-                GF_FREE (vector);
+        if (!(file->flags & O_APPEND)) {
+                qsort (requests, nr, sizeof (*requests),
+                       wb_request_offset_cmp);
         }
 
-        if (bytes == -1) {
-                /*
-                 * had we winded these requests, we would have unrefed
-                 * in wb_sync_cbk.
-                 */
-                if (local) {
-                        list_for_each_entry_safe (request, dummy, &local->winds,
-                                                  winds) {
-                                wb_request_unref (request);
+        for (i = 0; i <= nr; i++) {
+                if (i < nr) {
+                        request = requests[i];
+                        if ((i == first)
+                            || (((prev->wind_off + prev->wind_size)
+                                 == request->wind_off)
+                                && ((size + request->wind_size)
+                                    <= conf->aggregate_size))) {
+                                size += request->wind_size;
+                                prev = request;
+                                continue;
                         }
                 }
 
-                if (file != NULL) {
-                        LOCK (&file->lock);
-                        {
-                                file->op_ret = -1;
-                                file->op_errno = op_errno;
-                        }
-                        UNLOCK (&file->lock);
+                ret = wb_sync_run (frame, file, requests + first, i - first);
+                if (ret == -1) {
+                        bytes = -1;
+                } else if (bytes != -1) {
+                        bytes += ret;
                 }
+
+                first = i;
+                if (i < nr) {
+                        size = request->wind_size;
+                        prev = request;
+                }
+        }
+
+out:
+        if (requests != NULL) {
+                GF_FREE (requests);
         }
 
         return bytes;
@@ -1435,10 +1860,10 @@ wb_create (call_frame_t *frame, xlator_t *this, loc_t *loc, int32_t flags,
         return 0;
 }
 
-/* Mark all the contiguous write requests for winding starting from head of
- * request list. Stops marking at the first non-write request found. If
- * file is opened with O_APPEND, make sure all the writes marked for winding
- * will fit into a single write call to server.
+/* Mark the write requests of the oldest generation for winding starting
+ * from head of request list. Stops marking at the first non-write request
+ * found. If file is opened with O_APPEND, only contiguous writes are marked,
+ * and make sure all of them will fit into a single write call to server.
  */
 size_t
 __wb_mark_wind_all (wb_file_t *file, list_head_t *list, list_head_t *winds)
@@ -1447,6 +1872,7 @@ __wb_mark_wind_all (wb_file_t *file, list_head_t *list, list_head_t *winds)
         size_t        size            = 0;
         char          first_request   = 1;
         off_t         offset_expected = 0;
+        uint64_t      generation      = 0;
         wb_conf_t    *conf            = NULL;
         int           count           = 0;
 
@@ -1462,16 +1888,19 @@ __wb_mark_wind_all (wb_file_t *file, list_head_t *list, list_head_t *winds)
                 if (!request->flags.write_request.stack_wound) {
                         if (first_request) {
                                 first_request = 0;
-                                offset_expected = request->stub->args.writev.off;
+                                offset_expected = request->wind_off;
+                                generation = request->generation;
                         }
-                        
-                        if (request->stub->args.writev.off != offset_expected) {
+
+                        /* may overlap what is marked so far */
+                        if (request->generation != generation) {
                                 break;
                         }
 
                         if ((file->flags & O_APPEND)
-                            && (((size + request->write_size)
-                                 > conf->aggregate_size)
+                            && ((request->wind_off != offset_expected)
+                                || ((size + request->write_size)
+                                    > conf->aggregate_size)
                                 || ((count + request->stub->args.writev.count)
                                     > MAX_VECTOR_COUNT))) {
                                 break;
@@ -1486,6 +1915,11 @@ __wb_mark_wind_all (wb_file_t *file, list_head_t *list, list_head_t *winds)
                         list_add_tail (&request->winds, winds);
                 } 
         }
+
+        /* new writes must not be merged into the ones going out now */
+        if (!first_request && (generation == file->generation)) {
+                __wb_extents_seal (file);
+        }
   
         return size;
 }
@@ -1520,17 +1954,15 @@ __wb_can_wind (list_head_t *list, char *other_fop_in_queue,
                 if (!request->flags.write_request.stack_wound) {
                         if (first_request) {
                                 first_request = 0;
-                                offset_expected
-                                        = request->stub->args.writev.off;
+                                offset_expected = request->wind_off;
                                 if (wind_all != NULL) {
                                         *wind_all = request->flags.write_request.flush_all;
                                 }
                         } 
 
-                        if (offset_expected != request->stub->args.writev.off) {
-                                if (non_contiguous_writes) {
-                                        *non_contiguous_writes = 1;
-                                }
+                        if ((offset_expected != request->wind_off)
+                            && (non_contiguous_writes != NULL)) {
+                                *non_contiguous_writes = 1;
                                 break;
                         }
 
@@ -1561,8 +1993,11 @@ __wb_mark_winds (list_head_t *list, list_head_t *winds, size_t aggregate_conf,
         request = list_entry (list->next, typeof (*request), list);
         file = request->file;
 
+        /* the extent index takes care of writes scattered over the file,
+           only appending writes need to go out in order */
         __wb_can_wind (list, &other_fop_in_queue,
-                       &non_contiguous_writes, &incomplete_writes, &wind_all);
+                       (file->flags & O_APPEND) ? &non_contiguous_writes
+                       : NULL, &incomplete_writes, &wind_all);
 
         if (!incomplete_writes && ((enable_trickling_writes)
                                    || (wind_all) || (non_contiguous_writes)
@@ -1764,122 +2199,6 @@ out:
 }
 
 
-inline int
-__wb_copy_into_holder (wb_request_t *holder, wb_request_t *request)
-{
-        char          *ptr    = NULL;
-        struct iobuf  *iobuf  = NULL;
-        struct iobref *iobref = NULL;
-        int            ret    = -1;
-
-        if (holder->flags.write_request.virgin) {
-                iobuf = iobuf_get (request->file->this->ctx->iobuf_pool);
-                if (iobuf == NULL) {
-                        gf_log (request->file->this->name, GF_LOG_ERROR,
-                                "out of memory");
-                        goto out;
-                }
-
-                iobref = iobref_new ();
-                if (iobref == NULL) {
-                        iobuf_unref (iobuf);
-                        gf_log (request->file->this->name, GF_LOG_ERROR,
-                                "out of memory");
-                        goto out;
-                }
-                                                                          
-                ret = iobref_add (iobref, iobuf);
-                if (ret != 0) {
-                        iobuf_unref (iobuf);
-                        iobref_unref (iobref);
-                        gf_log (request->file->this->name, GF_LOG_DEBUG,
-                                "cannot add iobuf (%p) into iobref (%p)",
-                                iobuf, iobref);
-                        goto out;
-                }
-                                                                          
-                iov_unload (iobuf->ptr, holder->stub->args.writev.vector,
-                            holder->stub->args.writev.count);
-                holder->stub->args.writev.vector[0].iov_base = iobuf->ptr;
-                                                                          
-                iobref_unref (holder->stub->args.writev.iobref);
-                holder->stub->args.writev.iobref = iobref;
-                                                                          
-                iobuf_unref (iobuf);
-
-                holder->flags.write_request.virgin = 0;
-        }
-
-        ptr = holder->stub->args.writev.vector[0].iov_base + holder->write_size;
-
-        iov_unload (ptr,
-                    request->stub->args.writev.vector,
-                    request->stub->args.writev.count);
-
-        holder->stub->args.writev.vector[0].iov_len += request->write_size;
-        holder->write_size += request->write_size;
-
-        request->flags.write_request.stack_wound = 1;
-        list_move_tail (&request->list, &request->file->passive_requests);
-
-        ret = 0;
-out:
-        return ret;
-}
-
-
-/* this procedure assumes that write requests have only one vector to write */
-void
-__wb_collapse_write_bufs (list_head_t *requests, size_t page_size)
-{
-        off_t         offset_expected = 0;
-        size_t        space_left      = 0;
-        wb_request_t *request         = NULL, *tmp = NULL, *holder = NULL;
-        int           ret             = 0;
-
-        list_for_each_entry_safe (request, tmp, requests, list) {
-                if ((request->stub == NULL)
-                    || (request->stub->fop != GF_FOP_WRITE)
-                    || (request->flags.write_request.stack_wound)) {
-                        holder = NULL;
-                        continue;
-                }
-
-                if (request->flags.write_request.write_behind) {
-                        if (holder == NULL) {
-                                holder = request;
-                                continue;
-                        }
-
-                        offset_expected = holder->stub->args.writev.off
-                                + holder->write_size;
-
-                        if (request->stub->args.writev.off != offset_expected) {
-                                holder = request;
-                                continue;
-                        }
-
-                        space_left = page_size - holder->write_size;
-
-                        if (space_left >= request->write_size) {
-                                ret = __wb_copy_into_holder (holder, request);
-                                if (ret != 0) {
-                                        break;
-                                }
-                                
-                                __wb_request_unref (request);
-                        } else {
-                                holder = request;
-                        }
-                } else { 
-                        break;
-                }
-        }
-
-        return;
-}
-
-
 int32_t 
 wb_process_queue (call_frame_t *frame, wb_file_t *file)
 {
@@ -1902,17 +2221,8 @@ wb_process_queue (call_frame_t *frame, wb_file_t *file)
         size = conf->aggregate_size;
         LOCK (&file->lock);
         {
-                /* 
-                 * make sure requests are marked for unwinding and adjacent
-                 * continguous write buffers (each of size less than that of
-                 * an iobuf) are packed properly so that iobufs are filled to
-                 * their maximum capacity, before calling __wb_mark_winds.
-                 */
                 __wb_mark_unwinds (&file->request, &unwinds);
 
-                __wb_collapse_write_bufs (&file->request,
-                                          file->this->ctx->page_size);
-
                 count = __wb_get_other_requests (&file->request,
                                                  &other_requests);
 
@@ -2123,6 +2433,10 @@ wb_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
         call_stub_t  *stub = NULL;
         int32_t       ret = -1;
         wb_request_t *request = NULL;
+        struct iovec *vector = NULL;
+        int32_t       count = 0;
+        struct iobref *iobref = NULL;
+        struct iatt   stbuf = {0, };
 
         if ((!IA_ISDIR (fd->inode->ia_type))
             && fd_ctx_get (fd, this, &tmp_file)) {
@@ -2137,6 +2451,24 @@ wb_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
 
 	file = (wb_file_t *)(long)tmp_file;
 
+        if (file) {
+                LOCK (&file->lock);
+                {
+                        ret = __wb_read_pending (file, size, offset, &vector,
+                                                 &count, &iobref, &stbuf);
+                }
+                UNLOCK (&file->lock);
+
+                if (ret == 0) {
+                        STACK_UNWIND_STRICT (readv, frame, iov_length (vector,
+                                                                       count),
+                                             0, vector, count, &stbuf, iobref);
+                        GF_FREE (vector);
+                        iobref_unref (iobref);
+                        return 0;
+                }
+        }
+
         local = GF_CALLOC (1, sizeof (*local),
                            gf_wb_mt_wb_local_t);
         if (local == NULL) {
@@ -2567,16 +2899,14 @@ wb_priv_dump (xlator_t *this)
 
 
 void
-__wb_dump_requests (struct list_head *head, char *prefix, char passive)
+__wb_dump_requests (struct list_head *head, char *prefix)
 {
         char          key[GF_DUMP_MAX_BUF_LEN];
         char          key_prefix[GF_DUMP_MAX_BUF_LEN];
         wb_request_t *request = NULL;
 
         list_for_each_entry (request, head, list) {
-                gf_proc_dump_build_key (key, prefix,
-                                        passive ? "passive-request"
-                                        : "active-request");
+                gf_proc_dump_build_key (key, prefix, "request");
                 gf_proc_dump_build_key (key_prefix, key,
                                         gf_fop_list[request->fop]);
 
@@ -2599,7 +2929,11 @@ __wb_dump_requests (struct list_head *head, char *prefix, char passive)
 
                         gf_proc_dump_build_key (key, key_prefix, "offset");
                         gf_proc_dump_write (key, "%"PRId64,
-                                            request->stub->args.writev.off);
+                                            request->wind_off);
+
+                        gf_proc_dump_build_key (key, key_prefix, "generation");
+                        gf_proc_dump_write (key, "%"PRIu64,
+                                            request->generation);
 
                         gf_proc_dump_build_key (key, key_prefix,
                                                 "write_behind");
@@ -2610,9 +2944,9 @@ __wb_dump_requests (struct list_head *head, char *prefix, char passive)
                         gf_proc_dump_write (key, "%d",
                                             request->flags.write_request.got_reply);
 
-                        gf_proc_dump_build_key (key, key_prefix, "virgin");
+                        gf_proc_dump_build_key (key, key_prefix, "collapsed");
                         gf_proc_dump_write (key, "%d",
-                                            request->flags.write_request.virgin);
+                                            request->flags.write_request.collapsed);
 
                         gf_proc_dump_build_key (key, key_prefix, "flush_all");
                         gf_proc_dump_write (key, "%d",
@@ -2692,13 +3026,22 @@ wb_file_dump (xlator_t *this, fd_t *fd)
 
         LOCK (&file->lock);
         {
-                if (!list_empty (&file->request)) {
-                        __wb_dump_requests (&file->request, key_prefix, 0);
-                }
+                gf_proc_dump_build_key (key, key_prefix, "generation");
+                gf_proc_dump_write (key, "%"PRIu64, file->generation);
+
+                gf_proc_dump_build_key (key, key_prefix, "extents");
+                gf_proc_dump_write (key, "%"GF_PRI_SIZET,
+                                    (file->extents != NULL)
+                                    ? rb_count (file->extents) : 0);
+
+                gf_proc_dump_build_key (key, key_prefix, "collapsed_bytes");
+                gf_proc_dump_write (key, "%"PRIu64, file->collapsed_bytes);
 
-                if (!list_empty (&file->passive_requests)) {
-                        __wb_dump_requests (&file->passive_requests, key_prefix,
-                                            1);
+                gf_proc_dump_build_key (key, key_prefix, "local_reads");
+                gf_proc_dump_write (key, "%"PRIu64, file->local_reads);
+
+                if (!list_empty (&file->request)) {
+                        __wb_dump_requests (&file->request, key_prefix);
                 }
         }
         UNLOCK (&file->lock);
@@ -40,6 +40,8 @@ int client_ping_cbk (struct rpc_req *req, struct iovec *iov, int count,
 
 /* Handshake */
 
+/* The ping timer of an rpc, the main one or an extra channel, is armed
+   with that rpc as its data; its xlator is the rpc's notify data. */
 void
 rpc_client_ping_timer_expired (void *data)
 {
@@ -53,18 +55,17 @@ rpc_client_ping_timer_expired (void *data)
         xlator_t                *this               = NULL;
         clnt_conf_t             *conf               = NULL;
 
-        this = data;
+        clnt = data;
+        if (!clnt)
+                goto out;
 
+        this = clnt->mydata;
         if (!this || !this->private) {
                 goto out;
         }
 
         conf = this->private;
 
-        clnt = conf->rpc;
-        if (!clnt)
-                goto out;
-
         conn = &clnt->conn;
         trans = conn->trans;
 
@@ -95,7 +96,7 @@ rpc_client_ping_timer_expired (void *data)
                         conn->ping_timer =
                                 gf_timer_call_after (this->ctx, timeout,
                                                      rpc_client_ping_timer_expired,
-                                                     (void *) this);
+                                                     (void *) clnt);
                         if (conn->ping_timer == NULL)
                                 gf_log (trans->name, GF_LOG_DEBUG,
                                         "unable to setup timer");
@@ -127,21 +128,24 @@ client_start_ping (void *data)
 {
         xlator_t                *this        = NULL;
         clnt_conf_t             *conf        = NULL;
+        struct rpc_clnt         *rpc         = NULL;
         rpc_clnt_connection_t   *conn        = NULL;
         int32_t                  ret         = -1;
         struct timeval           timeout     = {0, };
         call_frame_t            *frame       = NULL;
         int                      frame_count = 0;
 
-        this = data;
+        rpc = data;
+        if (!rpc)
+                goto fail;
+
+        this = rpc->mydata;
         if (!this || !this->private)
                 goto fail;
 
         conf  = this->private;
-        if (!conf->rpc)
-                goto fail;
 
-        conn = &conf->rpc->conn;
+        conn = &rpc->conn;
 
         if (conf->opt.ping_timeout == 0)
                 return;
@@ -180,7 +184,7 @@ client_start_ping (void *data)
                 conn->ping_timer =
                         gf_timer_call_after (this->ctx, timeout,
                                              rpc_client_ping_timer_expired,
-                                             (void *) this);
+                                             (void *) rpc);
 
                 if (conn->ping_timer == NULL) {
                         gf_log (this->name, GF_LOG_DEBUG,
@@ -195,8 +199,9 @@ client_start_ping (void *data)
         if (!frame)
                 goto fail;
 
-        ret = client_submit_request (this, NULL, frame, conf->handshake,
-                                     GF_HNDSK_PING, client_ping_cbk, NULL, NULL,
+        ret = client_submit_request (this, rpc, NULL, frame,
+                                     conf->handshake, GF_HNDSK_PING,
+                                     client_ping_cbk, NULL, NULL,
                                      NULL, 0, NULL, 0, NULL);
         if (ret)
                 goto fail;
@@ -221,6 +226,7 @@ client_ping_cbk (struct rpc_req *req, struct iovec *iov, int count,
         struct timeval         timeout = {0, };
         call_frame_t          *frame   = NULL;
         clnt_conf_t           *conf    = NULL;
+        struct rpc_clnt       *rpc     = NULL;
 
         if (!myframe)
                 goto out;
@@ -231,7 +237,8 @@ client_ping_cbk (struct rpc_req *req, struct iovec *iov, int count,
                 goto out;
 
         conf = this->private;
-        conn = &conf->rpc->conn;
+        rpc  = req->conn->rpc_clnt;
+        conn = &rpc->conn;
 
         if (req->rpc_status == -1) {
 		 if (conn->ping_timer != NULL) {
@@ -257,7 +264,7 @@ client_ping_cbk (struct rpc_req *req, struct iovec *iov, int count,
 
                 conn->ping_timer =
                         gf_timer_call_after (this->ctx, timeout,
-                                             client_start_ping, (void *)this);
+                                             client_start_ping, (void *)rpc);
 
                 if (conn->ping_timer == NULL)
                         gf_log (this->name, GF_LOG_DEBUG,
@@ -271,6 +278,29 @@ out:
 }
 
 
+/* before the rpc goes away, so that its ping timer does not fire on it */
+void
+client_ping_cancel (struct rpc_clnt *rpc)
+{
+        rpc_clnt_connection_t *conn = NULL;
+
+        if (!rpc)
+                return;
+
+        conn = &rpc->conn;
+
+        pthread_mutex_lock (&conn->lock);
+        {
+                if (conn->ping_timer)
+                        gf_timer_call_cancel (rpc->ctx, conn->ping_timer);
+
+                conn->ping_timer   = NULL;
+                conn->ping_started = 0;
+        }
+        pthread_mutex_unlock (&conn->lock);
+}
+
+
 int
 client3_getspec_cbk (struct rpc_req *req, struct iovec *iov, int count,
                      void *myframe)
@@ -327,8 +357,9 @@ int32_t client3_getspec (call_frame_t *frame, xlator_t *this, void *data)
         req.flags = args->flags;
         req.key   = (char *)args->name;
 
-        ret = client_submit_request (this, &req, frame, conf->handshake,
-                                     GF_HNDSK_GETSPEC, client3_getspec_cbk,
+        ret = client_submit_request (this, conf->rpc, &req, frame,
+                                     conf->handshake, GF_HNDSK_GETSPEC,
+                                     client3_getspec_cbk,
                                      NULL, xdr_from_getspec_req, NULL, 0,
                                      NULL, 0, NULL);
 
@@ -588,7 +619,7 @@ protocol_client_reopendir (xlator_t *this, clnt_fd_ctx_t *fdctx)
 
         frame->local = local; local = NULL;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        ret = client_submit_request (this, conf->rpc, &req, frame, conf->fops,
                                      GFS3_OP_OPENDIR,
                                      client3_1_reopendir_cbk, NULL,
                                      xdr_from_opendir_req, NULL, 0, NULL, 0,
@@ -665,7 +696,7 @@ protocol_client_reopen (xlator_t *this, clnt_fd_ctx_t *fdctx)
                 "attempting reopen on %s", local->loc.path);
 
         local = NULL;
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        ret = client_submit_request (this, conf->rpc, &req, frame, conf->fops,
                                      GFS3_OP_OPEN, client3_1_reopen_cbk, NULL,
                                      xdr_from_open_req, NULL, 0, NULL, 0, NULL);
         if (ret)
@@ -868,6 +899,8 @@ client_setvolume_cbk (struct rpc_req *req, struct iovec *iov, int count, void *m
         conf->connecting = 0;
         conf->connected = 1;
 
+        client_channels_start (this);
+
         /* TODO: more to test */
         client_post_handshake (frame, frame->this);
 
@@ -899,6 +932,75 @@ out:
         return 0;
 }
 
+/* SETVOLUME reply on one of the extra channels. Fd reopening, lock
+   recovery and CHILD_UP are all driven by the main rpc, a channel only
+   starts taking fops once the server has attached it to our connection.
+*/
+int
+client_channel_setvolume_cbk (struct rpc_req *req, struct iovec *iov,
+                              int count, void *myframe)
+{
+        call_frame_t     *frame   = NULL;
+        clnt_conf_t      *conf    = NULL;
+        clnt_channel_t   *channel = NULL;
+        xlator_t         *this    = NULL;
+        gf_setvolume_rsp  rsp     = {0,};
+        int               ret     = 0;
+        int32_t           op_ret  = -1;
+
+        frame = myframe;
+        this  = frame->this;
+        conf  = this->private;
+
+        channel = client_channel_of (conf, req->conn->rpc_clnt);
+        if (!channel)
+                goto out;
+
+        /* the channel went down, it will go through this again */
+        if (-1 == req->rpc_status)
+                goto out;
+
+        ret = xdr_to_setvolume_rsp (*iov, &rsp);
+        if (ret < 0) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "failed to decode SETVOLUME reply on channel %d",
+                        (int)(channel - conf->channels) + 1);
+                rpc_transport_disconnect (req->conn->trans);
+                goto out;
+        }
+
+        op_ret = rsp.op_ret;
+        if (-1 == op_ret) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "SETVOLUME on channel %d failed: %s",
+                        (int)(channel - conf->channels) + 1,
+                        strerror (gf_error_to_errno (rsp.op_errno)));
+                rpc_transport_disconnect (req->conn->trans);
+                goto out;
+        }
+
+        rpc_clnt_set_connected (req->conn);
+
+        pthread_mutex_lock (&conf->lock);
+        {
+                /* unless the main rpc went down meanwhile */
+                if (channel->connected && conf->handshaked)
+                        channel->ready = 1;
+        }
+        pthread_mutex_unlock (&conf->lock);
+
+        gf_log (this->name, GF_LOG_DEBUG, "channel %d attached",
+                (int)(channel - conf->channels) + 1);
+
+out:
+        if (rsp.dict.dict_val)
+                free (rsp.dict.dict_val);
+
+        STACK_DESTROY (frame->root);
+
+        return 0;
+}
+
 int
 client_setvolume (xlator_t *this, struct rpc_clnt *rpc)
 {
@@ -908,6 +1010,7 @@ client_setvolume (xlator_t *this, struct rpc_clnt *rpc)
         char             *process_uuid_xl = NULL;
         clnt_conf_t      *conf            = NULL;
         dict_t           *options         = NULL;
+        fop_cbk_fn_t      cbk             = NULL;
 
         struct rpc_clnt_config config = {0, };
 
@@ -915,6 +1018,13 @@ client_setvolume (xlator_t *this, struct rpc_clnt *rpc)
         options = this->options;
         conf    = this->private;
 
+        /* the channels present the same process-uuid, that is what
+           makes the server share one connection between them */
+        if (rpc == conf->rpc)
+                cbk = client_setvolume_cbk;
+        else
+                cbk = client_channel_setvolume_cbk;
+
         if (conf->fops) {
                 ret = dict_set_int32 (options, "fops-version",
                                       conf->fops->prognum);
@@ -986,15 +1096,18 @@ client_setvolume (xlator_t *this, struct rpc_clnt *rpc)
         if (!fr)
                 goto fail;
 
-        ret = client_submit_request (this, &req, fr, conf->handshake,
-                                     GF_HNDSK_SETVOLUME, client_setvolume_cbk,
+        ret = client_submit_request (this, rpc, &req, fr, conf->handshake,
+                                     GF_HNDSK_SETVOLUME, cbk,
                                      NULL, xdr_from_setvolume_req, NULL, 0,
                                      NULL, 0, NULL);
 
 fail:
-        if (ret) {
+        if (ret && (rpc == conf->rpc)) {
                 config.remote_port = -1;
                 rpc_clnt_reconfig (conf->rpc, &config);
+        } else if (ret) {
+                /* retried when the channel reconnects */
+                rpc_transport_disconnect (rpc->conn.trans);
         }
 
         if (req.dict.dict_val)
@@ -1149,7 +1262,7 @@ client_query_portmap (xlator_t *this, struct rpc_clnt *rpc)
                 goto fail;
         }
 
-        ret = client_submit_request (this, &req, fr, &clnt_pmap_prog,
+        ret = client_submit_request (this, rpc, &req, fr, &clnt_pmap_prog,
                                      GF_PMAP_PORTBYBRICK,
                                      client_query_portmap_cbk,
                                      NULL, xdr_from_pmap_port_by_brick_req,
@@ -1244,7 +1357,7 @@ client_handshake (xlator_t *this, struct rpc_clnt *rpc)
                 goto out;
 
         req.gfs_id = 0xbabe;
-        ret = client_submit_request (this, &req, frame, conf->dump,
+        ret = client_submit_request (this, rpc, &req, frame, conf->dump,
                                      GF_DUMP_DUMP, client_dump_version_cbk,
                                      NULL, xdr_from_dump_req, NULL, 0, NULL, 0,
                                      NULL);
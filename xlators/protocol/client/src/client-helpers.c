@@ -227,3 +227,54 @@ clnt_readdir_rsp_cleanup (gfs3_readdir_rsp *rsp)
 
         return 0;
 }
+
+
+/* Pick the connection a fop goes out on. Everything on one inode stays
+   on the same connection so that requests the server has to see in
+   order do not overtake each other; without an inode the fop is free
+   to go anywhere and the connections are used in turn. Channels which
+   are not attached to the server yet fall back to the main rpc.
+*/
+struct rpc_clnt *
+client_channel_get (xlator_t *this, inode_t *inode)
+{
+        clnt_conf_t    *conf    = NULL;
+        clnt_channel_t *channel = NULL;
+        uint32_t        slot    = 0;
+
+        conf = this->private;
+
+        if (!conf->channel_count)
+                return conf->rpc;
+
+        /* slot 0 is the main rpc */
+        if (inode)
+                slot = ((unsigned long) inode / sizeof (*inode))
+                        % (conf->channel_count + 1);
+        else
+                slot = __sync_fetch_and_add (&conf->channel_next, 1)
+                        % (conf->channel_count + 1);
+
+        if (!slot)
+                return conf->rpc;
+
+        channel = &conf->channels[slot - 1];
+        if (!channel->ready)
+                return conf->rpc;
+
+        return channel->rpc;
+}
+
+
+clnt_channel_t *
+client_channel_of (clnt_conf_t *conf, struct rpc_clnt *rpc)
+{
+        int i = 0;
+
+        for (i = 0; i < conf->channel_count; i++) {
+                if (conf->channels[i].rpc == rpc)
+                        return &conf->channels[i];
+        }
+
+        return NULL;
+}
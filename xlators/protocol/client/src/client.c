@@ -42,12 +42,32 @@ int client_init_rpc (xlator_t *this);
 int client_destroy_rpc (xlator_t *this);
 
 int
-client_submit_request (xlator_t *this, void *req, call_frame_t *frame,
-                       rpc_clnt_prog_t *prog, int procnum, fop_cbk_fn_t cbk,
+client_submit_request (xlator_t *this, struct rpc_clnt *rpc, void *req,
+                       call_frame_t *frame, rpc_clnt_prog_t *prog,
+                       int procnum, fop_cbk_fn_t cbk,
                        struct iobref *iobref, gfs_serialize_t sfunc,
                        struct iovec *rsphdr, int rsphdr_count,
                        struct iovec *rsp_payload, int rsp_payload_count,
                        struct iobref *rsp_iobref)
+{
+        return client_submit_dict_request (this, rpc, req, frame, prog,
+                                           procnum, cbk, iobref, sfunc, NULL,
+                                           rsphdr, rsphdr_count, rsp_payload,
+                                           rsp_payload_count, rsp_iobref);
+}
+
+
+/* Same as client_submit_request, for requests whose encoding ends with
+   an opaque dict: @req goes with that left empty, and @dict is serialized
+   into the message buffer right behind it (see xdr_append_dict). */
+int
+client_submit_dict_request (xlator_t *this, struct rpc_clnt *rpc, void *req,
+                            call_frame_t *frame, rpc_clnt_prog_t *prog,
+                            int procnum, fop_cbk_fn_t cbk,
+                            struct iobref *iobref, gfs_serialize_t sfunc,
+                            dict_t *dict, struct iovec *rsphdr,
+                            int rsphdr_count, struct iovec *rsp_payload,
+                            int rsp_payload_count, struct iobref *rsp_iobref)
 {
         int            ret         = -1;
         clnt_conf_t   *conf        = NULL;
@@ -57,7 +77,7 @@ client_submit_request (xlator_t *this, void *req, call_frame_t *frame,
         char           start_ping  = 0;
         struct iobref *new_iobref  = NULL;
 
-        if (!this || !prog || !frame)
+        if (!this || !rpc || !prog || !frame)
                 goto out;
 
         conf = this->private;
@@ -98,7 +118,7 @@ client_submit_request (xlator_t *this, void *req, call_frame_t *frame,
         }
 
         iov.iov_base = iobuf->ptr;
-        iov.iov_len  = 128 * GF_UNIT_KB;
+        iov.iov_len  = iobuf_pagesize (iobuf);
 
         /* Create the xdr payload */
         if (req && sfunc) {
@@ -106,26 +126,37 @@ client_submit_request (xlator_t *this, void *req, call_frame_t *frame,
                 if (ret == -1) {
                         goto out;
                 }
+                if (dict) {
+                        ret = xdr_append_dict (iov, ret, dict);
+                        if (ret == -1) {
+                                gf_log (this->name, GF_LOG_WARNING,
+                                        "failed to serialize dict into "
+                                        "the request");
+                                goto out;
+                        }
+                }
                 iov.iov_len = ret;
                 count = 1;
         }
         /* Send the msg */
-        ret = rpc_clnt_submit (conf->rpc, prog, procnum, cbk, &iov, count, NULL,
+        ret = rpc_clnt_submit (rpc, prog, procnum, cbk, &iov, count, NULL,
                                0, new_iobref, frame, rsphdr, rsphdr_count,
                                rsp_payload, rsp_payload_count, rsp_iobref);
 
+        /* every channel is pinged on its own, a hung one is only
+           noticed that way */
         if (ret == 0) {
-                pthread_mutex_lock (&conf->rpc->conn.lock);
+                pthread_mutex_lock (&rpc->conn.lock);
                 {
-                        if (!conf->rpc->conn.ping_started) {
+                        if (!rpc->conn.ping_started) {
                                 start_ping = 1;
                         }
                 }
-                pthread_mutex_unlock (&conf->rpc->conn.lock);
+                pthread_mutex_unlock (&rpc->conn.lock);
         }
 
         if (start_ping)
-                client_start_ping ((void *) this);
+                client_start_ping ((void *) rpc);
 
         ret = 0;
 out:
@@ -1548,6 +1579,150 @@ client_mark_fd_bad (xlator_t *this)
 }
 
 
+/* Called once the main rpc is through SETVOLUME: channels that were
+   never started are pointed at the port it found and connected, those
+   that came up meanwhile are attached now. */
+void
+client_channels_start (xlator_t *this)
+{
+        clnt_conf_t            *conf      = NULL;
+        clnt_channel_t         *channel   = NULL;
+        struct rpc_clnt_config  config    = {0, };
+        int                     i         = 0;
+        int                     start     = 0;
+        int                     handshake = 0;
+
+        conf = this->private;
+        if (!conf->channel_count)
+                return;
+
+        config.remote_port = conf->rpc->conn.config.remote_port;
+
+        pthread_mutex_lock (&conf->lock);
+        {
+                conf->handshaked = 1;
+        }
+        pthread_mutex_unlock (&conf->lock);
+
+        for (i = 0; i < conf->channel_count; i++) {
+                channel = &conf->channels[i];
+
+                rpc_clnt_reconfig (channel->rpc, &config);
+
+                start = handshake = 0;
+                pthread_mutex_lock (&conf->lock);
+                {
+                        if (!channel->started) {
+                                channel->started = 1;
+                                start = 1;
+                        } else if (channel->connected &&
+                                   !channel->handshaking) {
+                                channel->handshaking = 1;
+                                handshake = 1;
+                        }
+                }
+                pthread_mutex_unlock (&conf->lock);
+
+                if (start)
+                        rpc_clnt_start (channel->rpc);
+                else if (handshake)
+                        client_setvolume (this, channel->rpc);
+        }
+}
+
+
+/* The main rpc went down. The channels are dropped along with it, so
+   that the server lets go of the fds and locks of this client, which
+   are reopened and recovered over the main rpc once it is back. */
+static void
+client_channels_stop (xlator_t *this)
+{
+        clnt_conf_t    *conf    = NULL;
+        clnt_channel_t *channel = NULL;
+        int             i       = 0;
+
+        conf = this->private;
+        if (!conf->channel_count)
+                return;
+
+        pthread_mutex_lock (&conf->lock);
+        {
+                conf->handshaked = 0;
+        }
+        pthread_mutex_unlock (&conf->lock);
+
+        for (i = 0; i < conf->channel_count; i++) {
+                channel = &conf->channels[i];
+                if (channel->started)
+                        rpc_transport_disconnect (channel->rpc->conn.trans);
+        }
+}
+
+
+int
+client_channel_notify (struct rpc_clnt *rpc, void *mydata,
+                       rpc_clnt_event_t event, void *data)
+{
+        xlator_t       *this      = NULL;
+        clnt_conf_t    *conf      = NULL;
+        clnt_channel_t *channel   = NULL;
+        int             handshake = 0;
+
+        this = mydata;
+        if (!this || !this->private)
+                goto out;
+
+        conf = this->private;
+
+        channel = client_channel_of (conf, rpc);
+        if (!channel)
+                goto out;
+
+        switch (event) {
+        case RPC_CLNT_CONNECT:
+                pthread_mutex_lock (&conf->lock);
+                {
+                        channel->connected = 1;
+
+                        /* if the main rpc is not there yet, this is left
+                           to client_channels_start () */
+                        if (conf->handshaked && !channel->handshaking) {
+                                channel->handshaking = 1;
+                                handshake = 1;
+                        }
+                }
+                pthread_mutex_unlock (&conf->lock);
+
+                if (handshake)
+                        client_setvolume (this, rpc);
+                break;
+
+        case RPC_CLNT_DISCONNECT:
+                pthread_mutex_lock (&conf->lock);
+                {
+                        if (channel->ready)
+                                gf_log (this->name, GF_LOG_DEBUG,
+                                        "channel %d disconnected",
+                                        (int)(channel - conf->channels) + 1);
+
+                        channel->connected   = 0;
+                        channel->handshaking = 0;
+                        channel->ready       = 0;
+                }
+                pthread_mutex_unlock (&conf->lock);
+                break;
+
+        default:
+                gf_log (this->name, GF_LOG_TRACE,
+                        "got some other RPC event %d on a channel", event);
+                break;
+        }
+
+out:
+        return 0;
+}
+
+
 int
 client_rpc_notify (struct rpc_clnt *rpc, void *mydata, rpc_clnt_event_t event,
                    void *data)
@@ -1595,6 +1770,8 @@ client_rpc_notify (struct rpc_clnt *rpc, void *mydata, rpc_clnt_event_t event,
 
                 client_mark_fd_bad (this);
 
+                client_channels_stop (this);
+
                 if (!conf->skip_notify) {
                         if (conf->connected)
                                 gf_log (this->name, GF_LOG_NORMAL,
@@ -1657,7 +1834,8 @@ notify (xlator_t *this, int32_t event, void *data, ...)
 int
 build_client_config (xlator_t *this, clnt_conf_t *conf)
 {
-        int ret = 0;
+        int ret             = 0;
+        int transport_count = 0;
 
         if (!conf)
                 return -1;
@@ -1695,6 +1873,14 @@ build_client_config (xlator_t *this, clnt_conf_t *conf)
                 conf->opt.ping_timeout = GF_UNIVERSAL_ANSWER;
         }
 
+        ret = dict_get_int32 (this->options, "transport-count",
+                              &transport_count);
+        if ((ret >= 0) && (transport_count > 1)) {
+                gf_log (this->name, GF_LOG_DEBUG,
+                        "using %d connections to the brick", transport_count);
+                conf->channel_count = transport_count - 1;
+        }
+
         ret = dict_get_str (this->options, "remote-subvolume",
                             &conf->opt.remote_subvolume);
         if (ret) {
@@ -1730,6 +1916,26 @@ mem_acct_init (xlator_t *this)
         return ret;
 }
 
+static void
+client_destroy_channels (clnt_conf_t *conf)
+{
+        int i = 0;
+
+        if (!conf->channels)
+                return;
+
+        for (i = 0; i < conf->channel_count; i++) {
+                if (conf->channels[i].rpc) {
+                        client_ping_cancel (conf->channels[i].rpc);
+                        rpc_clnt_unref (conf->channels[i].rpc);
+                }
+        }
+
+        GF_FREE (conf->channels);
+        conf->channels   = NULL;
+        conf->handshaked = 0;
+}
+
 int
 client_destroy_rpc (xlator_t *this)
 {
@@ -1741,6 +1947,8 @@ client_destroy_rpc (xlator_t *this)
                 goto out;
 
         if (conf->rpc) {
+                client_destroy_channels (conf);
+                client_ping_cancel (conf->rpc);
                 conf->rpc = rpc_clnt_unref (conf->rpc);
                 ret = 0;
                 gf_log (this->name, GF_LOG_DEBUG,
@@ -1759,8 +1967,10 @@ out:
 int
 client_init_rpc (xlator_t *this)
 {
-        int          ret  = -1;
-        clnt_conf_t *conf = NULL;
+        int             ret     = -1;
+        int             i       = 0;
+        clnt_conf_t    *conf    = NULL;
+        clnt_channel_t *channel = NULL;
 
         conf = this->private;
 
@@ -1787,6 +1997,33 @@ client_init_rpc (xlator_t *this)
         if (ret)
                 goto out;
 
+        if (conf->channel_count) {
+                conf->channels = GF_CALLOC (conf->channel_count,
+                                            sizeof (*conf->channels),
+                                            gf_client_mt_clnt_channel_t);
+                if (!conf->channels) {
+                        ret = -1;
+                        goto out;
+                }
+        }
+
+        /* not started here, see client_channels_start () */
+        for (i = 0; i < conf->channel_count; i++) {
+                channel = &conf->channels[i];
+
+                channel->rpc = rpc_clnt_new (&conf->rpc_conf, this->options,
+                                             this->ctx, this->name);
+                if (!channel->rpc) {
+                        ret = -1;
+                        goto out;
+                }
+
+                ret = rpc_clnt_register_notify (channel->rpc,
+                                                client_channel_notify, this);
+                if (ret)
+                        goto out;
+        }
+
         ret = 0;
 
         gf_log (this->name, GF_LOG_DEBUG, "client init successful");
@@ -2042,8 +2279,12 @@ fini (xlator_t *this)
         this->private = NULL;
 
         if (conf) {
-                if (conf->rpc)
-                       rpc_clnt_unref (conf->rpc);
+                client_destroy_channels (conf);
+
+                if (conf->rpc) {
+                        client_ping_cancel (conf->rpc);
+                        rpc_clnt_unref (conf->rpc);
+                }
 
                 /* Saved Fds */
                 /* TODO: */
@@ -2055,6 +2296,37 @@ fini (xlator_t *this)
         return;
 }
 
+static void
+client_saved_frames_dump (struct rpc_clnt *rpc, char *key_prefix)
+{
+        rpc_clnt_connection_t *conn = NULL;
+        char                   key[GF_DUMP_MAX_BUF_LEN];
+        int                    ret = -1;
+
+        conn = &rpc->conn;
+
+        ret = pthread_mutex_trylock (&conn->lock);
+        if (ret) {
+                gf_log ("", GF_LOG_WARNING, "Unable to lock connection"
+                        " errno: %d", errno);
+                return;
+        }
+
+        if (conn->saved_frames) {
+                gf_proc_dump_build_key(key, key_prefix, "outstanding_frames");
+                gf_proc_dump_write(key, "%"PRId64, conn->saved_frames->count);
+                gf_proc_dump_build_key(key, key_prefix,
+                                       "outstanding_frames_peak");
+                gf_proc_dump_write(key, "%"PRId64, conn->saved_frames->peak);
+                gf_proc_dump_build_key(key, key_prefix, "bailed_frames");
+                gf_proc_dump_write(key, "%"PRIu64,
+                                   conn->saved_frames->bailed);
+        }
+
+        pthread_mutex_unlock (&conn->lock);
+}
+
+
 int
 client_priv_dump (xlator_t *this)
 {
@@ -2108,6 +2380,14 @@ client_priv_dump (xlator_t *this)
                 gf_proc_dump_build_key(key, key_prefix, "total_bytes_written");
                 gf_proc_dump_write(key, "%"PRIu64,
                                    conf->rpc->conn.trans->total_bytes_write);
+
+                client_saved_frames_dump (conf->rpc, key_prefix);
+        }
+
+        for (i = 0; i < conf->channel_count; i++) {
+                gf_proc_dump_build_key(key, key_prefix, "channel.%d.ready",
+                                       i + 1);
+                gf_proc_dump_write(key, "%d", conf->channels[i].ready);
         }
         pthread_mutex_unlock(&conf->lock);
 
@@ -2231,5 +2511,14 @@ struct volume_options options[] = {
           .min   = 1,
           .max   = 1013,
         },
+        { .key   = {"transport-count"},
+          .type  = GF_OPTION_TYPE_INT,
+          .min   = 1,
+          .max   = 16,
+          .description = "Number of connections opened to the brick. "
+          "Fops on an fd are spread over them by inode, reads go "
+          "round robin. Each connection is pinged on its own and "
+          "dropped after ping-timeout without a reply."
+        },
         { .key   = {NULL} },
 };
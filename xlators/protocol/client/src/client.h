@@ -39,8 +39,27 @@ struct clnt_options {
         int   ping_timeout;
 };
 
+/* An additional connection to the same brick. It does its own
+   SETVOLUME with the process-uuid of the main one, so the server puts
+   it into the same connection and fds and locks are valid on all of
+   them. Channels are only brought up once the main rpc has completed
+   its handshake, and are torn down whenever it disconnects.
+*/
+typedef struct clnt_channel {
+        struct rpc_clnt       *rpc;
+        int                    started;
+        int                    connected;   /* transport is up */
+        int                    handshaking; /* SETVOLUME sent */
+        int                    ready;       /* SETVOLUME succeeded */
+} clnt_channel_t;
+
 typedef struct clnt_conf {
         struct rpc_clnt       *rpc;
+        clnt_channel_t        *channels;      /* transport-count - 1 of them */
+        int                    channel_count;
+        uint32_t               channel_next;  /* round robin cursor */
+        int                    handshaked;    /* main rpc passed SETVOLUME,
+                                                 channels may follow */
         struct clnt_options    opt;
         struct rpc_clnt_config rpc_conf;
 	struct list_head       saved_fds;
@@ -148,13 +167,21 @@ void this_fd_set_ctx (fd_t *file, xlator_t *this, loc_t *loc,
                       clnt_fd_ctx_t *ctx);
 
 int client_local_wipe (clnt_local_t *local);
-int client_submit_request (xlator_t *this, void *req,
+int client_submit_request (xlator_t *this, struct rpc_clnt *rpc, void *req,
                            call_frame_t *frame, rpc_clnt_prog_t *prog,
                            int procnum, fop_cbk_fn_t cbk,
                            struct iobref *iobref, gfs_serialize_t sfunc,
                            struct iovec *rsphdr, int rsphdr_count,
                            struct iovec *rsp_payload, int rsp_count,
                            struct iobref *rsp_iobref);
+int client_submit_dict_request (xlator_t *this, struct rpc_clnt *rpc,
+                                void *req, call_frame_t *frame,
+                                rpc_clnt_prog_t *prog, int procnum,
+                                fop_cbk_fn_t cbk, struct iobref *iobref,
+                                gfs_serialize_t sfunc, dict_t *dict,
+                                struct iovec *rsphdr, int rsphdr_count,
+                                struct iovec *rsp_payload, int rsp_count,
+                                struct iobref *rsp_iobref);
 
 int protocol_client_reopendir (xlator_t *this, clnt_fd_ctx_t *fdctx);
 int protocol_client_reopen (xlator_t *this, clnt_fd_ctx_t *fdctx);
@@ -178,5 +205,10 @@ int32_t is_client_dump_locks_cmd (char *name);
 int32_t client_dump_locks (char *name, inode_t *inode,
                            dict_t *dict);
 int client_fdctx_destroy (xlator_t *this, clnt_fd_ctx_t *fdctx);
+struct rpc_clnt *client_channel_get (xlator_t *this, inode_t *inode);
+clnt_channel_t *client_channel_of (clnt_conf_t *conf, struct rpc_clnt *rpc);
+void client_channels_start (xlator_t *this);
+void client_ping_cancel (struct rpc_clnt *rpc);
+int client_setvolume (xlator_t *this, struct rpc_clnt *rpc);
 
 #endif /* !_CLIENT_H */
@@ -32,13 +32,13 @@ void client_start_ping (void *data);
 rpc_clnt_prog_t clnt3_1_fop_prog;
 
 int
-client_submit_vec_request (xlator_t  *this, void *req, call_frame_t  *frame,
-                           rpc_clnt_prog_t *prog, int procnum, fop_cbk_fn_t cbk,
+client_submit_vec_request (xlator_t  *this, struct rpc_clnt *rpc, void *req,
+                           call_frame_t  *frame, rpc_clnt_prog_t *prog,
+                           int procnum, fop_cbk_fn_t cbk,
                            struct iovec  *payload, int payloadcnt,
                            struct iobref *iobref, gfs_serialize_t sfunc)
 {
         int            ret        = 0;
-        clnt_conf_t   *conf       = NULL;
         struct iovec   iov        = {0, };
         struct iobuf  *iobuf      = NULL;
         int            count      = 0;
@@ -47,8 +47,6 @@ client_submit_vec_request (xlator_t  *this, void *req, call_frame_t  *frame,
 
         start_ping = 0;
 
-        conf = this->private;
-
         iobuf = iobuf_get (this->ctx->iobuf_pool);
         if (!iobuf) {
                 goto out;
@@ -77,7 +75,7 @@ client_submit_vec_request (xlator_t  *this, void *req, call_frame_t  *frame,
         }
 
         iov.iov_base = iobuf->ptr;
-        iov.iov_len  = 128 * GF_UNIT_KB;
+        iov.iov_len  = iobuf_pagesize (iobuf);
 
         /* Create the xdr payload */
         if (req && sfunc) {
@@ -90,22 +88,24 @@ client_submit_vec_request (xlator_t  *this, void *req, call_frame_t  *frame,
                 count = 1;
         }
         /* Send the msg */
-        ret = rpc_clnt_submit (conf->rpc, prog, procnum, cbk, &iov, count,
+        ret = rpc_clnt_submit (rpc, prog, procnum, cbk, &iov, count,
                                payload, payloadcnt, new_iobref, frame, NULL, 0,
                                NULL, 0, NULL);
 
+        /* every channel is pinged on its own, a hung one is only
+           noticed that way */
         if (ret == 0) {
-                pthread_mutex_lock (&conf->rpc->conn.lock);
+                pthread_mutex_lock (&rpc->conn.lock);
                 {
-                        if (!conf->rpc->conn.ping_started) {
+                        if (!rpc->conn.ping_started) {
                                 start_ping = 1;
                         }
                 }
-                pthread_mutex_unlock (&conf->rpc->conn.lock);
+                pthread_mutex_unlock (&rpc->conn.lock);
         }
 
         if (start_ping)
-                client_start_ping ((void *) this);
+                client_start_ping ((void *) rpc);
 
 out:
         if (new_iobref != NULL) {
@@ -729,7 +729,6 @@ client3_1_getxattr_cbk (struct rpc_req *req, struct iovec *iov, int count,
 {
         call_frame_t      *frame    = NULL;
         dict_t            *dict     = NULL;
-        char              *buf      = NULL;
         int                dict_len = 0;
         int                op_ret   = 0;
         int                op_errno = EINVAL;
@@ -763,20 +762,17 @@ client3_1_getxattr_cbk (struct rpc_req *req, struct iovec *iov, int count,
 
                 if (dict_len > 0) {
                         dict = dict_new();
-                        buf = memdup (rsp.dict.dict_val, rsp.dict.dict_len);
-
                         GF_VALIDATE_OR_GOTO (frame->this->name, dict, out);
-                        GF_VALIDATE_OR_GOTO (frame->this->name, buf, out);
 
-                        ret = dict_unserialize (buf, dict_len, &dict);
+                        ret = dict_unserialize_nocopy (rsp.dict.dict_val,
+                                                       dict_len, &dict);
+                        rsp.dict.dict_val = NULL;
                         if (ret < 0) {
                                 gf_log (frame->this->name, GF_LOG_DEBUG,
                                         "failed to unserialize xattr dict");
                                 op_errno = EINVAL;
                                 goto out;
                         }
-                        dict->extra_free = buf;
-                        buf = NULL;
                 }
                 op_ret = 0;
         }
@@ -791,9 +787,6 @@ out:
                 rsp.dict.dict_val = NULL;
         }
 
-        if (buf)
-                GF_FREE (buf);
-
         if (dict)
                 dict_unref (dict);
 
@@ -807,7 +800,6 @@ client3_1_fgetxattr_cbk (struct rpc_req *req, struct iovec *iov, int count,
                          void *myframe)
 {
         call_frame_t       *frame    = NULL;
-        char               *buf      = NULL;
         dict_t             *dict     = NULL;
         gfs3_fgetxattr_rsp  rsp      = {0,};
         int                 ret      = 0;
@@ -842,18 +834,16 @@ client3_1_fgetxattr_cbk (struct rpc_req *req, struct iovec *iov, int count,
                 if (dict_len > 0) {
                         dict = dict_new();
                         GF_VALIDATE_OR_GOTO (frame->this->name, dict, out);
-                        buf = memdup (rsp.dict.dict_val, rsp.dict.dict_len);
-                        GF_VALIDATE_OR_GOTO (frame->this->name, buf, out);
 
-                        ret = dict_unserialize (buf, dict_len, &dict);
+                        ret = dict_unserialize_nocopy (rsp.dict.dict_val,
+                                                       dict_len, &dict);
+                        rsp.dict.dict_val = NULL;
                         if (ret < 0) {
                                 gf_log (frame->this->name, GF_LOG_DEBUG,
                                         "failed to unserialize xattr dict");
                                 op_errno = EINVAL;
                                 goto out;
                         }
-                        dict->extra_free = buf;
-                        buf = NULL;
                 }
                 op_ret = 0;
         }
@@ -866,9 +856,6 @@ out:
                 rsp.dict.dict_val = NULL;
         }
 
-        if (buf)
-                GF_FREE (buf);
-
         if (dict)
                 dict_unref (dict);
 
@@ -1171,7 +1158,6 @@ client3_1_xattrop_cbk (struct rpc_req *req, struct iovec *iov, int count,
 {
         call_frame_t     *frame    = NULL;
         dict_t           *dict     = NULL;
-        char             *buf      = NULL;
         gfs3_xattrop_rsp  rsp      = {0,};
         int               ret      = 0;
         int               op_ret   = 0;
@@ -1206,17 +1192,15 @@ client3_1_xattrop_cbk (struct rpc_req *req, struct iovec *iov, int count,
                         dict = dict_new();
                         GF_VALIDATE_OR_GOTO (frame->this->name, dict, out);
 
-                        buf = memdup (rsp.dict.dict_val, rsp.dict.dict_len);
-                        GF_VALIDATE_OR_GOTO (frame->this->name, buf, out);
-                        op_ret = dict_unserialize (buf, dict_len, &dict);
+                        op_ret = dict_unserialize_nocopy (rsp.dict.dict_val,
+                                                          dict_len, &dict);
+                        rsp.dict.dict_val = NULL;
                         if (op_ret < 0) {
                                 gf_log (frame->this->name, GF_LOG_DEBUG,
                                         "failed to unserialize xattr dict");
                                 op_errno = EINVAL;
                                 goto out;
                         }
-                        dict->extra_free = buf;
-                        buf = NULL;
                 }
                 op_ret = 0;
         }
@@ -1233,9 +1217,6 @@ out:
                 rsp.dict.dict_val = NULL;
         }
 
-        if (buf)
-                GF_FREE (buf);
-
         if (dict)
                 dict_unref (dict);
 
@@ -1250,7 +1231,6 @@ client3_1_fxattrop_cbk (struct rpc_req *req, struct iovec *iov, int count,
 {
         call_frame_t      *frame    = NULL;
         dict_t            *dict     = NULL;
-        char              *buf      = NULL;
         gfs3_fxattrop_rsp  rsp      = {0,};
         int                ret      = 0;
         int                op_ret   = 0;
@@ -1285,17 +1265,15 @@ client3_1_fxattrop_cbk (struct rpc_req *req, struct iovec *iov, int count,
                         dict = dict_new();
                         GF_VALIDATE_OR_GOTO (frame->this->name, dict, out);
 
-                        buf = memdup (rsp.dict.dict_val, rsp.dict.dict_len);
-                        GF_VALIDATE_OR_GOTO (frame->this->name, buf, out);
-                        op_ret = dict_unserialize (buf, dict_len, &dict);
+                        op_ret = dict_unserialize_nocopy (rsp.dict.dict_val,
+                                                          dict_len, &dict);
+                        rsp.dict.dict_val = NULL;
                         if (op_ret < 0) {
                                 gf_log (frame->this->name, GF_LOG_DEBUG,
                                         "failed to unserialize xattr dict");
                                 op_errno = EINVAL;
                                 goto out;
                         }
-                        dict->extra_free = buf;
-                        buf = NULL;
                 }
                 op_ret = 0;
         }
@@ -1312,9 +1290,6 @@ out:
                 rsp.dict.dict_val = NULL;
         }
 
-        if (buf)
-                GF_FREE (buf);
-
         if (dict)
                 dict_unref (dict);
 
@@ -1880,7 +1855,6 @@ client3_1_lookup_cbk (struct rpc_req *req, struct iovec *iov, int count,
         int              op_errno   = EINVAL;
         dict_t          *xattr      = NULL;
         inode_t         *inode      = NULL;
-        char            *buf        = NULL;
 
         frame = myframe;
         local = frame->local;
@@ -1914,10 +1888,9 @@ client3_1_lookup_cbk (struct rpc_req *req, struct iovec *iov, int count,
                 xattr = dict_new();
                 GF_VALIDATE_OR_GOTO (frame->this->name, xattr, out);
 
-                buf = memdup (rsp.dict.dict_val, rsp.dict.dict_len);
-                GF_VALIDATE_OR_GOTO (frame->this->name, buf, out);
-
-                ret = dict_unserialize (buf, rsp.dict.dict_len, &xattr);
+                ret = dict_unserialize_nocopy (rsp.dict.dict_val,
+                                               rsp.dict.dict_len, &xattr);
+                rsp.dict.dict_val = NULL;
                 if (ret < 0) {
                         gf_log (frame->this->name, GF_LOG_DEBUG,
                                 "%s (%"PRId64"): failed to "
@@ -1926,9 +1899,6 @@ client3_1_lookup_cbk (struct rpc_req *req, struct iovec *iov, int count,
                         op_errno = EINVAL;
                         goto out;
                 }
-
-                xattr->extra_free = buf;
-                buf = NULL;
         }
 
         if ((!uuid_is_null (inode->gfid))
@@ -1960,10 +1930,6 @@ out:
                 rsp.dict.dict_val = NULL;
         }
 
-        if (buf) {
-                GF_FREE (buf);
-        }
-
         return 0;
 }
 
@@ -2058,7 +2024,10 @@ client_fdctx_destroy (xlator_t *this, clnt_fd_ctx_t *fdctx)
         if (fdctx->is_dir) {
                 gfs3_releasedir_req  req = {{0,},};
                 req.fd = fdctx->remote_fd;
-                ret = client_submit_request (this, &req, fr, &clnt3_1_fop_prog,
+                ret = client_submit_request (this,
+                                             client_channel_get (this,
+                                                                 fdctx->inode),
+                                             &req, fr, &clnt3_1_fop_prog,
                                              GFS3_OP_RELEASEDIR,
                                              client3_1_releasedir_cbk,
                                              NULL, xdr_from_releasedir_req,
@@ -2066,7 +2035,10 @@ client_fdctx_destroy (xlator_t *this, clnt_fd_ctx_t *fdctx)
         } else {
                 gfs3_release_req  req = {{0,},};
                 req.fd = fdctx->remote_fd;
-                ret = client_submit_request (this, &req, fr, &clnt3_1_fop_prog,
+                ret = client_submit_request (this,
+                                             client_channel_get (this,
+                                                                 fdctx->inode),
+                                             &req, fr, &clnt3_1_fop_prog,
                                              GFS3_OP_RELEASE,
                                              client3_1_release_cbk, NULL,
                                              xdr_from_release_req, NULL, 0,
@@ -2124,7 +2096,10 @@ client3_1_releasedir (call_frame_t *frame, xlator_t *this,
 
         if (remote_fd != -1) {
                 req.fd = remote_fd;
-                ret = client_submit_request (this, &req, frame, conf->fops,
+                ret = client_submit_request (this,
+                                             client_channel_get (this,
+                                                                 fdctx->inode),
+                                             &req, frame, conf->fops,
                                              GFS3_OP_RELEASEDIR,
                                              client3_1_releasedir_cbk,
                                              NULL, xdr_from_releasedir_req,
@@ -2181,7 +2156,10 @@ client3_1_release (call_frame_t *frame, xlator_t *this,
 
                 delete_granted_locks_fd (fdctx);
 
-                ret = client_submit_request (this, &req, frame, conf->fops,
+                ret = client_submit_request (this,
+                                             client_channel_get (this,
+                                                                 fdctx->inode),
+                                             &req, frame, conf->fops,
                                              GFS3_OP_RELEASE,
                                              client3_1_release_cbk, NULL,
                                              xdr_from_release_req, NULL, 0,
@@ -2206,7 +2184,6 @@ client3_1_lookup (call_frame_t *frame, xlator_t *this,
         clnt_args_t     *args              = NULL;
         gfs3_lookup_req  req               = {{0,},};
         int              ret               = 0;
-        size_t           dict_len          = 0;
         int              op_errno          = ESTALE;
         data_t          *content           = NULL;
         struct iovec     vector[MAX_IOVEC] = {{0}, };
@@ -2261,42 +2238,30 @@ client3_1_lookup (call_frame_t *frame, xlator_t *this,
                         rsphdr = &vector[0];
                         rsphdr->iov_base = iobuf_ptr (rsp_iobuf);
                         rsphdr->iov_len
-                                = rsp_iobuf->iobuf_arena->iobuf_pool->page_size;
+                                = iobuf_pagesize (rsp_iobuf);
                         count = 1;
                         rsp_iobuf = NULL;
                         local->iobref = rsp_iobref;
                         rsp_iobref = NULL;
                 }
-
-                ret = dict_allocate_and_serialize (args->dict,
-                                                   &req.dict.dict_val,
-                                                   &dict_len);
-                if (ret < 0) {
-                        gf_log (this->name, GF_LOG_DEBUG,
-                                "failed to get serialized length of dict");
-                        op_errno = EINVAL;
-                        goto unwind;
-                }
         }
 
         req.path          = (char *)args->loc->path;
         req.bname         = (char *)args->loc->name;
-        req.dict.dict_len = dict_len;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
-                                     GFS3_OP_LOOKUP, client3_1_lookup_cbk,
-                                     NULL, xdr_from_lookup_req, rsphdr, count,
-                                     NULL, 0, local->iobref);
+        /* the dict is serialized straight into the request */
+        ret = client_submit_dict_request (this, conf->rpc, &req, frame,
+                                          conf->fops, GFS3_OP_LOOKUP,
+                                          client3_1_lookup_cbk, NULL,
+                                          xdr_from_lookup_req, args->dict,
+                                          rsphdr, count, NULL, 0,
+                                          local->iobref);
 
         if (ret) {
                 op_errno = ENOTCONN;
                 goto unwind;
         }
 
-        if (req.dict.dict_val) {
-                GF_FREE (req.dict.dict_val);
-        }
-
         if (rsp_iobref != NULL) {
                 iobref_unref (rsp_iobref);
         }
@@ -2313,9 +2278,6 @@ unwind:
         if (local)
                 client_local_wipe (local);
 
-        if (req.dict.dict_val)
-                GF_FREE (req.dict.dict_val);
-
         if (rsp_iobref != NULL) {
                 iobref_unref (rsp_iobref);
         }
@@ -2350,7 +2312,7 @@ client3_1_stat (call_frame_t *frame, xlator_t *this,
         req.path = (char *)args->loc->path;
         conf = this->private;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        ret = client_submit_request (this, conf->rpc, &req, frame, conf->fops,
                                      GFS3_OP_STAT, client3_1_stat_cbk, NULL,
                                      xdr_from_stat_req, NULL, 0, NULL, 0, NULL);
         if (ret) {
@@ -2389,7 +2351,7 @@ client3_1_truncate (call_frame_t *frame, xlator_t *this,
 
         conf = this->private;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        ret = client_submit_request (this, conf->rpc, &req, frame, conf->fops,
                                      GFS3_OP_TRUNCATE,
                                      client3_1_truncate_cbk, NULL,
                                      xdr_from_truncate_req, NULL, 0, NULL, 0,
@@ -2415,6 +2377,7 @@ client3_1_ftruncate (call_frame_t *frame, xlator_t *this,
         gfs3_ftruncate_req  req      = {{0,},};
         int                 op_errno = EINVAL;
         int                 ret      = 0;
+        struct rpc_clnt    *rpc      = NULL;
 
         if (!frame || !this || !data)
                 goto unwind;
@@ -2447,7 +2410,8 @@ client3_1_ftruncate (call_frame_t *frame, xlator_t *this,
         req.offset = args->offset;
         req.fd     = fdctx->remote_fd;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        rpc = client_channel_get (this, args->fd->inode);
+        ret = client_submit_request (this, rpc, &req, frame, conf->fops,
                                      GFS3_OP_FTRUNCATE,
                                      client3_1_ftruncate_cbk, NULL,
                                      xdr_from_ftruncate_req, NULL, 0, NULL, 0,
@@ -2488,7 +2452,7 @@ client3_1_access (call_frame_t *frame, xlator_t *this,
 
         conf = this->private;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        ret = client_submit_request (this, conf->rpc, &req, frame, conf->fops,
                                      GFS3_OP_ACCESS,
                                      client3_1_access_cbk, NULL,
                                      xdr_from_access_req, NULL, 0, NULL, 0,
@@ -2527,7 +2491,7 @@ client3_1_readlink (call_frame_t *frame, xlator_t *this,
         req.size = args->size;
         conf = this->private;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        ret = client_submit_request (this, conf->rpc, &req, frame, conf->fops,
                                      GFS3_OP_READLINK,
                                      client3_1_readlink_cbk, NULL,
                                      xdr_from_readlink_req, NULL, 0, NULL, 0,
@@ -2569,7 +2533,7 @@ client3_1_unlink (call_frame_t *frame, xlator_t *this,
         req.bname = (char *)args->loc->name;
         conf = this->private;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        ret = client_submit_request (this, conf->rpc, &req, frame, conf->fops,
                                      GFS3_OP_UNLINK,
                                      client3_1_unlink_cbk, NULL,
                                      xdr_from_unlink_req, NULL, 0, NULL, 0,
@@ -2610,7 +2574,7 @@ client3_1_rmdir (call_frame_t *frame, xlator_t *this,
         req.flags = args->flags;
         conf = this->private;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        ret = client_submit_request (this, conf->rpc, &req, frame, conf->fops,
                                      GFS3_OP_RMDIR, client3_1_rmdir_cbk, NULL,
                                      xdr_from_rmdir_req, NULL, 0, NULL, 0,
                                      NULL);
@@ -2673,7 +2637,7 @@ client3_1_symlink (call_frame_t *frame, xlator_t *this,
 
         conf = this->private;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        ret = client_submit_request (this, conf->rpc, &req, frame, conf->fops,
                                      GFS3_OP_SYMLINK, client3_1_symlink_cbk,
                                      NULL, xdr_from_symlink_req, NULL, 0, NULL,
                                      0, NULL);
@@ -2729,7 +2693,7 @@ client3_1_rename (call_frame_t *frame, xlator_t *this,
         req.newbname = (char *)args->newloc->name;
         conf = this->private;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        ret = client_submit_request (this, conf->rpc, &req, frame, conf->fops,
                                      GFS3_OP_RENAME, client3_1_rename_cbk, NULL,
                                      xdr_from_rename_req, NULL, 0, NULL, 0,
                                      NULL);
@@ -2782,7 +2746,7 @@ client3_1_link (call_frame_t *frame, xlator_t *this,
         req.newbname = (char *)args->newloc->name;
         conf = this->private;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        ret = client_submit_request (this, conf->rpc, &req, frame, conf->fops,
                                      GFS3_OP_LINK, client3_1_link_cbk, NULL,
                                      xdr_from_link_req, NULL, 0, NULL, 0, NULL);
         if (ret) {
@@ -2846,7 +2810,7 @@ client3_1_mknod (call_frame_t *frame, xlator_t *this,
 
         conf = this->private;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        ret = client_submit_request (this, conf->rpc, &req, frame, conf->fops,
                                      GFS3_OP_MKNOD, client3_1_mknod_cbk, NULL,
                                      xdr_from_mknod_req, NULL, 0, NULL, 0,
                                      NULL);
@@ -2922,7 +2886,7 @@ client3_1_mkdir (call_frame_t *frame, xlator_t *this,
 
         conf = this->private;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        ret = client_submit_request (this, conf->rpc, &req, frame, conf->fops,
                                      GFS3_OP_MKDIR, client3_1_mkdir_cbk, NULL,
                                      xdr_from_mkdir_req, NULL, 0, NULL, 0,
                                      NULL);
@@ -3000,7 +2964,7 @@ client3_1_create (call_frame_t *frame, xlator_t *this,
 
         conf = this->private;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        ret = client_submit_request (this, conf->rpc, &req, frame, conf->fops,
                                      GFS3_OP_CREATE, client3_1_create_cbk, NULL,
                                      xdr_from_create_req, NULL, 0, NULL, 0,
                                      NULL);
@@ -3065,7 +3029,7 @@ client3_1_open (call_frame_t *frame, xlator_t *this,
 
         conf = this->private;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        ret = client_submit_request (this, conf->rpc, &req, frame, conf->fops,
                                      GFS3_OP_OPEN, client3_1_open_cbk, NULL,
                                      xdr_from_open_req, NULL, 0, NULL, 0, NULL);
         if (ret) {
@@ -3100,6 +3064,7 @@ client3_1_readv (call_frame_t *frame, xlator_t *this,
         struct iobuf   *rsp_iobuf  = NULL;
         struct iobref  *rsp_iobref = NULL;
         clnt_local_t   *local      = NULL;
+        struct rpc_clnt *rpc       = NULL;
 
         if (!frame || !this || !data)
                 goto unwind;
@@ -3149,7 +3114,7 @@ client3_1_readv (call_frame_t *frame, xlator_t *this,
         iobref_add (rsp_iobref, rsp_iobuf);
         iobuf_unref (rsp_iobuf);
         rsp_vec.iov_base = iobuf_ptr (rsp_iobuf);
-        rsp_vec.iov_len = rsp_iobuf->iobuf_arena->iobuf_pool->page_size;
+        rsp_vec.iov_len = iobuf_pagesize (rsp_iobuf);
 
         rsp_iobuf = NULL;
 
@@ -3174,7 +3139,8 @@ client3_1_readv (call_frame_t *frame, xlator_t *this,
         rsp_iobref = NULL;
         frame->local = local;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        rpc = client_channel_get (this, NULL);
+        ret = client_submit_request (this, rpc, &req, frame, conf->fops,
                                      GFS3_OP_READ, client3_1_readv_cbk, NULL,
                                      xdr_from_readv_req, NULL, 0, &rsp_vec, 1,
                                      local->iobref);
@@ -3207,6 +3173,7 @@ client3_1_writev (call_frame_t *frame, xlator_t *this, void *data)
         gfs3_write_req  req      = {{0,},};
         int             op_errno = ESTALE;
         int             ret        = 0;
+        struct rpc_clnt *rpc     = NULL;
 
         if (!frame || !this || !data)
                 goto unwind;
@@ -3239,7 +3206,9 @@ client3_1_writev (call_frame_t *frame, xlator_t *this, void *data)
         req.offset = args->offset;
         req.fd     = fdctx->remote_fd;
 
-        ret = client_submit_vec_request (this, &req, frame, conf->fops, GFS3_OP_WRITE,
+        rpc = client_channel_get (this, args->fd->inode);
+        ret = client_submit_vec_request (this, rpc, &req, frame, conf->fops,
+                                         GFS3_OP_WRITE,
                                          client3_1_writev_cbk,
                                          args->vector, args->count,
                                          args->iobref, xdr_from_writev_req);
@@ -3264,6 +3233,7 @@ client3_1_flush (call_frame_t *frame, xlator_t *this,
         clnt_local_t *local    = NULL;
         int             op_errno = ESTALE;
         int             ret      = 0;
+        struct rpc_clnt *rpc     = NULL;
 
         if (!frame || !this || !data)
                 goto unwind;
@@ -3309,7 +3279,8 @@ client3_1_flush (call_frame_t *frame, xlator_t *this,
 
         req.fd = fdctx->remote_fd;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        rpc = client_channel_get (this, args->fd->inode);
+        ret = client_submit_request (this, rpc, &req, frame, conf->fops,
                                      GFS3_OP_FLUSH, client3_1_flush_cbk, NULL,
                                      xdr_from_flush_req, NULL, 0, NULL, 0,
                                      NULL);
@@ -3335,6 +3306,7 @@ client3_1_fsync (call_frame_t *frame, xlator_t *this,
         clnt_conf_t    *conf     = NULL;
         int             op_errno = 0;
         int           ret        = 0;
+        struct rpc_clnt *rpc     = NULL;
 
         if (!frame || !this || !data)
                 goto unwind;
@@ -3366,7 +3338,8 @@ client3_1_fsync (call_frame_t *frame, xlator_t *this,
         req.fd   = fdctx->remote_fd;
         req.data = args->flags;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        rpc = client_channel_get (this, args->fd->inode);
+        ret = client_submit_request (this, rpc, &req, frame, conf->fops,
                                      GFS3_OP_FSYNC, client3_1_fsync_cbk, NULL,
                                      xdr_from_fsync_req, NULL, 0, NULL, 0,
                                      NULL);
@@ -3392,6 +3365,7 @@ client3_1_fstat (call_frame_t *frame, xlator_t *this,
         clnt_conf_t    *conf     = NULL;
         int             op_errno = ESTALE;
         int           ret        = 0;
+        struct rpc_clnt *rpc     = NULL;
 
         if (!frame || !this || !data)
                 goto unwind;
@@ -3422,7 +3396,8 @@ client3_1_fstat (call_frame_t *frame, xlator_t *this,
 
         req.fd = fdctx->remote_fd;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        rpc = client_channel_get (this, args->fd->inode);
+        ret = client_submit_request (this, rpc, &req, frame, conf->fops,
                                      GFS3_OP_FSTAT, client3_1_fstat_cbk, NULL,
                                      xdr_from_fstat_req, NULL, 0, NULL, 0,
                                      NULL);
@@ -3471,7 +3446,7 @@ client3_1_opendir (call_frame_t *frame, xlator_t *this,
 
         conf = this->private;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        ret = client_submit_request (this, conf->rpc, &req, frame, conf->fops,
                                      GFS3_OP_OPENDIR, client3_1_opendir_cbk,
                                      NULL, xdr_from_opendir_req,
                                      NULL, 0, NULL, 0, NULL);
@@ -3500,6 +3475,7 @@ client3_1_fsyncdir (call_frame_t *frame, xlator_t *this, void *data)
         int                op_errno = ESTALE;
         gfs3_fsyncdir_req  req      = {{0,},};
         int                ret        = 0;
+        struct rpc_clnt   *rpc      = NULL;
 
         if (!frame || !this || !data)
                 goto unwind;
@@ -3533,7 +3509,8 @@ client3_1_fsyncdir (call_frame_t *frame, xlator_t *this, void *data)
 
         conf = this->private;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        rpc = client_channel_get (this, args->fd->inode);
+        ret = client_submit_request (this, rpc, &req, frame, conf->fops,
                                      GFS3_OP_FSYNCDIR, client3_1_fsyncdir_cbk,
                                      NULL, xdr_from_fsyncdir_req, NULL, 0,
                                      NULL, 0, NULL);
@@ -3576,7 +3553,7 @@ client3_1_statfs (call_frame_t *frame, xlator_t *this,
 
         conf = this->private;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        ret = client_submit_request (this, conf->rpc, &req, frame, conf->fops,
                                      GFS3_OP_STATFS, client3_1_statfs_cbk, NULL,
                                      xdr_from_statfs_req, NULL, 0, NULL, 0,
                                      NULL);
@@ -3629,7 +3606,7 @@ client3_1_setxattr (call_frame_t *frame, xlator_t *this,
 
         conf = this->private;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        ret = client_submit_request (this, conf->rpc, &req, frame, conf->fops,
                                      GFS3_OP_SETXATTR, client3_1_setxattr_cbk,
                                      NULL, xdr_from_setxattr_req, NULL, 0,
                                      NULL, 0, NULL);
@@ -3663,6 +3640,7 @@ client3_1_fsetxattr (call_frame_t *frame, xlator_t *this,
         int                 op_errno = ESTALE;
         int                 ret      = 0;
         size_t              dict_len = 0;
+        struct rpc_clnt    *rpc      = NULL;
 
         if (!frame || !this || !data)
                 goto unwind;
@@ -3707,7 +3685,8 @@ client3_1_fsetxattr (call_frame_t *frame, xlator_t *this,
                 req.dict.dict_len = dict_len;
         }
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        rpc = client_channel_get (this, args->fd->inode);
+        ret = client_submit_request (this, rpc, &req, frame, conf->fops,
                                      GFS3_OP_FSETXATTR, client3_1_fsetxattr_cbk,
                                      NULL, xdr_from_fsetxattr_req, NULL, 0,
                                      NULL, 0, NULL);
@@ -3748,6 +3727,7 @@ client3_1_fgetxattr (call_frame_t *frame, xlator_t *this,
         struct iobuf       *rsp_iobuf  = NULL;
         struct iovec       *rsphdr     = NULL;
         struct iovec        vector[MAX_IOVEC] = {{0}, };
+        struct rpc_clnt    *rpc        = NULL;
 
         if (!frame || !this || !data)
                 goto unwind;
@@ -3806,7 +3786,7 @@ client3_1_fgetxattr (call_frame_t *frame, xlator_t *this,
         iobuf_unref (rsp_iobuf);
         rsphdr = &vector[0];
         rsphdr->iov_base = iobuf_ptr (rsp_iobuf);
-        rsphdr->iov_len = rsp_iobuf->iobuf_arena->iobuf_pool->page_size;
+        rsphdr->iov_len = iobuf_pagesize (rsp_iobuf);
         count = 1;
         rsp_iobuf = NULL;
         local->iobref = rsp_iobref;
@@ -3820,7 +3800,8 @@ client3_1_fgetxattr (call_frame_t *frame, xlator_t *this,
                 req.namelen = 0;
         }
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        rpc = client_channel_get (this, args->fd->inode);
+        ret = client_submit_request (this, rpc, &req, frame, conf->fops,
                                      GFS3_OP_FGETXATTR,
                                      client3_1_fgetxattr_cbk, NULL,
                                      xdr_from_fgetxattr_req, rsphdr, count,
@@ -3916,7 +3897,7 @@ client3_1_getxattr (call_frame_t *frame, xlator_t *this,
         iobuf_unref (rsp_iobuf);
         rsphdr = &vector[0];
         rsphdr->iov_base = iobuf_ptr (rsp_iobuf);
-        rsphdr->iov_len = rsp_iobuf->iobuf_arena->iobuf_pool->page_size;
+        rsphdr->iov_len = iobuf_pagesize (rsp_iobuf);
         count = 1;
         rsp_iobuf = NULL;
         local->iobref = rsp_iobref;
@@ -3953,7 +3934,7 @@ client3_1_getxattr (call_frame_t *frame, xlator_t *this,
                 }
         }
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        ret = client_submit_request (this, conf->rpc, &req, frame, conf->fops,
                                      GFS3_OP_GETXATTR,
                                      client3_1_getxattr_cbk, NULL,
                                      xdr_from_getxattr_req, rsphdr, count,
@@ -4040,7 +4021,7 @@ client3_1_xattrop (call_frame_t *frame, xlator_t *this,
         iobuf_unref (rsp_iobuf);
         rsphdr = &vector[0];
         rsphdr->iov_base = iobuf_ptr (rsp_iobuf);
-        rsphdr->iov_len = rsp_iobuf->iobuf_arena->iobuf_pool->page_size;
+        rsphdr->iov_len = iobuf_pagesize (rsp_iobuf);
         count = 1;
         rsp_iobuf = NULL;
         local->iobref = rsp_iobref;
@@ -4064,7 +4045,7 @@ client3_1_xattrop (call_frame_t *frame, xlator_t *this,
 
         conf = this->private;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        ret = client_submit_request (this, conf->rpc, &req, frame, conf->fops,
                                      GFS3_OP_XATTROP,
                                      client3_1_xattrop_cbk, NULL,
                                      xdr_from_xattrop_req, rsphdr, count,
@@ -4113,13 +4094,13 @@ client3_1_fxattrop (call_frame_t *frame, xlator_t *this,
         gfs3_fxattrop_req  req        = {{0,},};
         int                op_errno   = ESTALE;
         int                ret        = 0;
-        size_t             dict_len   = 0;
         int                count      = 0;
         clnt_local_t    *local      = NULL;
         struct iobref     *rsp_iobref = NULL;
         struct iobuf      *rsp_iobuf  = NULL;
         struct iovec      *rsphdr     = NULL;
         struct iovec       vector[MAX_IOVEC] = {{0}, };
+        struct rpc_clnt   *rpc        = NULL;
 
         if (!frame || !this || !data)
                 goto unwind;
@@ -4182,38 +4163,25 @@ client3_1_fxattrop (call_frame_t *frame, xlator_t *this,
         iobuf_unref (rsp_iobuf);
         rsphdr = &vector[0];
         rsphdr->iov_base = iobuf_ptr (rsp_iobuf);
-        rsphdr->iov_len = rsp_iobuf->iobuf_arena->iobuf_pool->page_size;
+        rsphdr->iov_len = iobuf_pagesize (rsp_iobuf);
         count = 1;
         rsp_iobuf = NULL;
         local->iobref = rsp_iobref;
         rsp_iobref = NULL;
 
-        if (args->dict) {
-                ret = dict_allocate_and_serialize (args->dict,
-                                                   &req.dict.dict_val,
-                                                   &dict_len);
-                if (ret < 0) {
-                        gf_log (this->name, GF_LOG_DEBUG,
-                                "failed to get serialized dict");
-                        goto unwind;
-                }
-                req.dict.dict_len = dict_len;
-        }
-
-        ret = client_submit_request (this, &req, frame, conf->fops,
-                                     GFS3_OP_FXATTROP,
-                                     client3_1_fxattrop_cbk, NULL,
-                                     xdr_from_fxattrop_req, rsphdr, count,
-                                     NULL, 0, local->iobref);
+        /* the dict is serialized straight into the request */
+        rpc = client_channel_get (this, args->fd->inode);
+        ret = client_submit_dict_request (this, rpc, &req, frame, conf->fops,
+                                          GFS3_OP_FXATTROP,
+                                          client3_1_fxattrop_cbk, NULL,
+                                          xdr_from_fxattrop_req, args->dict,
+                                          rsphdr, count, NULL, 0,
+                                          local->iobref);
         if (ret) {
                 op_errno = ENOTCONN;
                 goto unwind;
         }
 
-        if (req.dict.dict_val) {
-                GF_FREE (req.dict.dict_val);
-        }
-
         return 0;
 unwind:
         local = frame->local;
@@ -4221,10 +4189,6 @@ unwind:
 
         STACK_UNWIND_STRICT (fxattrop, frame, -1, op_errno, NULL);
 
-        if (req.dict.dict_val) {
-                GF_FREE (req.dict.dict_val);
-        }
-
         client_local_wipe (local);
 
         if (rsp_iobref) {
@@ -4264,7 +4228,7 @@ client3_1_removexattr (call_frame_t *frame, xlator_t *this,
 
         conf = this->private;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        ret = client_submit_request (this, conf->rpc, &req, frame, conf->fops,
                                      GFS3_OP_REMOVEXATTR,
                                      client3_1_removexattr_cbk, NULL,
                                      xdr_from_removexattr_req, NULL, 0, NULL,
@@ -4294,6 +4258,7 @@ client3_1_lk (call_frame_t *frame, xlator_t *this,
         clnt_conf_t     *conf       = NULL;
         int              op_errno   = ESTALE;
         int              ret        = 0;
+        struct rpc_clnt *rpc        = NULL;
 
         if (!frame || !this || !data)
                 goto unwind;
@@ -4358,9 +4323,10 @@ client3_1_lk (call_frame_t *frame, xlator_t *this,
         req.type  = gf_type;
         gf_proto_flock_from_flock (&req.flock, args->flock);
 
-        ret = client_submit_request (this, &req, frame, conf->fops, GFS3_OP_LK,
-                                     client3_1_lk_cbk, NULL, xdr_from_lk_req,
-                                     NULL, 0, NULL, 0, NULL);
+        rpc = client_channel_get (this, args->fd->inode);
+        ret = client_submit_request (this, rpc, &req, frame, conf->fops,
+                                     GFS3_OP_LK, client3_1_lk_cbk, NULL,
+                                     xdr_from_lk_req, NULL, 0, NULL, 0, NULL);
         if (ret) {
                 op_errno = ENOTCONN;
                 goto unwind;
@@ -4426,7 +4392,7 @@ client3_1_inodelk (call_frame_t *frame, xlator_t *this,
 
         conf = this->private;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        ret = client_submit_request (this, conf->rpc, &req, frame, conf->fops,
                                      GFS3_OP_INODELK,
                                      client3_1_inodelk_cbk, NULL,
                                      xdr_from_inodelk_req, NULL, 0, NULL, 0,
@@ -4456,6 +4422,7 @@ client3_1_finodelk (call_frame_t *frame, xlator_t *this,
         clnt_conf_t       *conf     = NULL;
         int                op_errno = ESTALE;
         int           ret        = 0;
+        struct rpc_clnt   *rpc      = NULL;
 
         if (!frame || !this || !data)
                 goto unwind;
@@ -4514,7 +4481,8 @@ client3_1_finodelk (call_frame_t *frame, xlator_t *this,
         req.type  = gf_type;
         gf_proto_flock_from_flock (&req.flock, args->flock);
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        rpc = client_channel_get (this, args->fd->inode);
+        ret = client_submit_request (this, rpc, &req, frame, conf->fops,
                                      GFS3_OP_FINODELK,
                                      client3_1_finodelk_cbk, NULL,
                                      xdr_from_finodelk_req, NULL, 0, NULL, 0,
@@ -4562,7 +4530,7 @@ client3_1_entrylk (call_frame_t *frame, xlator_t *this,
 
         conf = this->private;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        ret = client_submit_request (this, conf->rpc, &req, frame, conf->fops,
                                      GFS3_OP_ENTRYLK,
                                      client3_1_entrylk_cbk, NULL,
                                      xdr_from_entrylk_req, NULL, 0, NULL, 0,
@@ -4590,6 +4558,7 @@ client3_1_fentrylk (call_frame_t *frame, xlator_t *this,
         clnt_conf_t       *conf     = NULL;
         int                op_errno = ESTALE;
         int           ret        = 0;
+        struct rpc_clnt   *rpc      = NULL;
 
         if (!frame || !this || !data)
                 goto unwind;
@@ -4628,7 +4597,8 @@ client3_1_fentrylk (call_frame_t *frame, xlator_t *this,
                 req.namelen = 1;
         }
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        rpc = client_channel_get (this, args->fd->inode);
+        ret = client_submit_request (this, rpc, &req, frame, conf->fops,
                                      GFS3_OP_FENTRYLK,
                                      client3_1_fentrylk_cbk, NULL,
                                      xdr_from_fentrylk_req, NULL, 0, NULL, 0,
@@ -4655,6 +4625,7 @@ client3_1_rchecksum (call_frame_t *frame, xlator_t *this,
         gfs3_rchecksum_req  req      = {0,};
         int                 op_errno = ESTALE;
         int                 ret        = 0;
+        struct rpc_clnt    *rpc      = NULL;
 
         if (!frame || !this || !data)
                 goto unwind;
@@ -4687,7 +4658,8 @@ client3_1_rchecksum (call_frame_t *frame, xlator_t *this,
         req.offset = args->offset;
         req.fd     = fdctx->remote_fd;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        rpc = client_channel_get (this, args->fd->inode);
+        ret = client_submit_request (this, rpc, &req, frame, conf->fops,
                                      GFS3_OP_RCHECKSUM,
                                      client3_1_rchecksum_cbk, NULL,
                                      xdr_from_rchecksum_req, NULL, 0, NULL,
@@ -4723,6 +4695,7 @@ client3_1_readdir (call_frame_t *frame, xlator_t *this,
         struct iovec     *rsphdr     = NULL;
         struct iovec      vector[MAX_IOVEC] = {{0}, };
         int               readdir_rsp_size  = 0; 
+        struct rpc_clnt  *rpc        = NULL;
 
         if (!frame || !this || !data)
                 goto unwind;
@@ -4785,7 +4758,7 @@ client3_1_readdir (call_frame_t *frame, xlator_t *this,
                 rsphdr = &vector[0];
                 rsphdr->iov_base = iobuf_ptr (rsp_iobuf);
                 rsphdr->iov_len
-                        = rsp_iobuf->iobuf_arena->iobuf_pool->page_size;
+                        = iobuf_pagesize (rsp_iobuf);
                 count = 1;
                 rsp_iobuf = NULL;
                 local->iobref = rsp_iobref;
@@ -4795,7 +4768,8 @@ client3_1_readdir (call_frame_t *frame, xlator_t *this,
         req.offset = args->offset;
         req.fd = fdctx->remote_fd;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        rpc = client_channel_get (this, args->fd->inode);
+        ret = client_submit_request (this, rpc, &req, frame, conf->fops,
                                      GFS3_OP_READDIR,
                                      client3_1_readdir_cbk, NULL,
                                      xdr_from_readdir_req, rsphdr, count,
@@ -4845,6 +4819,7 @@ client3_1_readdirp (call_frame_t *frame, xlator_t *this,
         struct iovec     *rsphdr            = NULL;
         struct iovec      vector[MAX_IOVEC] = {{0}, };
         clnt_local_t     *local             = NULL;
+        struct rpc_clnt  *rpc               = NULL;
 
         if (!frame || !this || !data)
                 goto unwind;
@@ -4908,7 +4883,7 @@ client3_1_readdirp (call_frame_t *frame, xlator_t *this,
                 rsphdr = &vector[0];
                 rsphdr->iov_base = iobuf_ptr (rsp_iobuf);
                 rsphdr->iov_len
-                        = rsp_iobuf->iobuf_arena->iobuf_pool->page_size;
+                        = iobuf_pagesize (rsp_iobuf);
                 count = 1;
                 rsp_iobuf = NULL;
                 local->iobref = rsp_iobref;
@@ -4919,7 +4894,8 @@ client3_1_readdirp (call_frame_t *frame, xlator_t *this,
         req.offset = args->offset;
         req.fd = fdctx->remote_fd;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        rpc = client_channel_get (this, args->fd->inode);
+        ret = client_submit_request (this, rpc, &req, frame, conf->fops,
                                      GFS3_OP_READDIRP,
                                      client3_1_readdirp_cbk, NULL,
                                      xdr_from_readdirp_req, rsphdr, count, NULL,
@@ -4973,7 +4949,7 @@ client3_1_setattr (call_frame_t *frame, xlator_t *this,
 
         conf = this->private;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        ret = client_submit_request (this, conf->rpc, &req, frame, conf->fops,
                                      GFS3_OP_SETATTR,
                                      client3_1_setattr_cbk, NULL,
                                      xdr_from_setattr_req, NULL, 0, NULL, 0,
@@ -4998,6 +4974,7 @@ client3_1_fsetattr (call_frame_t *frame, xlator_t *this, void *data)
         gfs3_fsetattr_req  req      = {0,};
         int                op_errno = ESTALE;
         int                ret        = 0;
+        struct rpc_clnt   *rpc      = NULL;
 
         if (!frame || !this || !data)
                 goto unwind;
@@ -5030,7 +5007,8 @@ client3_1_fsetattr (call_frame_t *frame, xlator_t *this, void *data)
         req.valid = args->valid;
         gf_stat_from_iatt (&req.stbuf, args->stbuf);
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
+        rpc = client_channel_get (this, args->fd->inode);
+        ret = client_submit_request (this, rpc, &req, frame, conf->fops,
                                      GFS3_OP_FSETATTR,
                                      client3_1_fsetattr_cbk, NULL,
                                      xdr_from_fsetattr_req, NULL, 0, NULL, 0,
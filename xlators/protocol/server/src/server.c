@@ -38,7 +38,7 @@
 
 struct iobuf *
 gfs_serialize_reply (rpcsvc_request_t *req, void *arg, gfs_serialize_t sfunc,
-                     struct iovec *outmsg)
+                     dict_t *dict, struct iovec *outmsg)
 {
         struct iobuf            *iob = NULL;
         ssize_t                  retlen = -1;
@@ -60,6 +60,8 @@ gfs_serialize_reply (rpcsvc_request_t *req, void *arg, gfs_serialize_t sfunc,
          * need -1 for error notification during encoding.
          */
         retlen = sfunc (*outmsg, arg);
+        if ((retlen != -1) && dict)
+                retlen = xdr_append_dict (*outmsg, retlen, dict);
         if (retlen == -1) {
                 /* Failed to Encode 'GlusterFS' msg in RPC is not exactly
                    failure of RPC return values.. client should get
@@ -86,6 +88,20 @@ int
 server_submit_reply (call_frame_t *frame, rpcsvc_request_t *req, void *arg,
                      struct iovec *payload, int payloadcount,
                      struct iobref *iobref, gfs_serialize_t sfunc)
+{
+        return server_submit_dict_reply (frame, req, arg, payload,
+                                         payloadcount, iobref, sfunc, NULL);
+}
+
+
+/* For replies whose encoding ends with an opaque dict: @arg goes with
+   that left empty, and @dict is serialized straight into the reply
+   buffer behind it. */
+int
+server_submit_dict_reply (call_frame_t *frame, rpcsvc_request_t *req,
+                          void *arg, struct iovec *payload, int payloadcount,
+                          struct iobref *iobref, gfs_serialize_t sfunc,
+                          dict_t *dict)
 {
         struct iobuf           *iob        = NULL;
         int                     ret        = -1;
@@ -112,7 +128,7 @@ server_submit_reply (call_frame_t *frame, rpcsvc_request_t *req, void *arg,
                 new_iobref = 1;
         }
 
-        iob = gfs_serialize_reply (req, arg, sfunc, &rsp);
+        iob = gfs_serialize_reply (req, arg, sfunc, dict, &rsp);
         if (!iob) {
                 gf_log ("", GF_LOG_ERROR, "Failed to serialize reply");
                 goto ret;
@@ -200,6 +200,12 @@ server_submit_reply (call_frame_t *frame, rpcsvc_request_t *req, void *arg,
                      struct iovec *payload, int payloadcount,
                      struct iobref *iobref, gfs_serialize_t sfunc);
 
+int
+server_submit_dict_reply (call_frame_t *frame, rpcsvc_request_t *req,
+                          void *arg, struct iovec *payload, int payloadcount,
+                          struct iobref *iobref, gfs_serialize_t sfunc,
+                          dict_t *dict);
+
 int xdr_to_glusterfs_req (rpcsvc_request_t *req, void *arg,
                           gfs_serialize_t sfunc);
 
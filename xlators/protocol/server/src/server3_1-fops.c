@@ -67,7 +67,6 @@ server_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         inode_t          *link_inode = NULL;
         loc_t             fresh_loc  = {0,};
         gfs3_lookup_rsp   rsp        = {0, };
-        int32_t           ret        = -1;
         uuid_t            rootgfid   = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1};
 
         state = CALL_STATE(frame);
@@ -88,39 +87,6 @@ server_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                 return 0;
         }
 
-        if ((op_ret >= 0) && dict) {
-                rsp.dict.dict_len = dict_serialized_length (dict);
-                if (rsp.dict.dict_len < 0) {
-                        gf_log (this->name, GF_LOG_ERROR,
-                                "%s (%"PRId64"): failed to get serialized "
-                                "length of reply dict",
-                                state->loc.path, state->loc.inode->ino);
-                        op_ret   = -1;
-                        op_errno = EINVAL;
-                        rsp.dict.dict_len = 0;
-                        goto out;
-                }
-
-                rsp.dict.dict_val = GF_CALLOC (1, rsp.dict.dict_len,
-                                               gf_server_mt_rsp_buf_t);
-                if (!rsp.dict.dict_val) {
-                        op_ret = -1;
-                        op_errno = ENOMEM;
-                        rsp.dict.dict_len = 0;
-                        goto out;
-                }
-                ret = dict_serialize (dict, rsp.dict.dict_val);
-                if (ret < 0) {
-                        gf_log (this->name, GF_LOG_ERROR,
-                                "%s (%"PRId64"): failed to serialize reply dict",
-                                state->loc.path, state->loc.inode->ino);
-                        op_ret = -1;
-                        op_errno = -ret;
-                        rsp.dict.dict_len = 0;
-                        goto out;
-                }
-        }
-
         gf_stat_from_iatt (&rsp.postparent, postparent);
 
         if (op_ret == 0) {
@@ -157,15 +123,13 @@ server_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                         state->loc.inode ? state->loc.inode->ino : 0,
                         op_ret, strerror (op_errno));
         }
-out:
+
         rsp.op_ret   = op_ret;
         rsp.op_errno = gf_errno_to_error (op_errno);
 
-        server_submit_reply (frame, req, &rsp, NULL, 0, NULL,
-                             (gfs_serialize_t)xdr_serialize_lookup_rsp);
-
-        if (rsp.dict.dict_val)
-                GF_FREE (rsp.dict.dict_val);
+        server_submit_dict_reply (frame, req, &rsp, NULL, 0, NULL,
+                                  (gfs_serialize_t)xdr_serialize_lookup_rsp,
+                                  (op_ret >= 0) ? dict : NULL);
 
         return 0;
 }
@@ -1515,8 +1479,6 @@ server_xattrop_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                     int32_t op_ret, int32_t op_errno, dict_t *dict)
 {
         gfs3_xattrop_rsp  rsp   = {0,};
-        int32_t           len   = 0;
-        int32_t           ret   = -1;
         server_state_t   *state = NULL;
         rpcsvc_request_t *req   = NULL;
 
@@ -1531,47 +1493,15 @@ server_xattrop_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                 goto out;
         }
 
-        if ((op_ret >= 0) && dict) {
-                len = dict_serialized_length (dict);
-                if (len < 0) {
-                        gf_log (this->name, GF_LOG_ERROR,
-                                "%s (%"PRId64"): failed to get serialized length"
-                                " for reply dict",
-                                state->loc.path, state->loc.inode->ino);
-                        op_ret = -1;
-                        op_errno = EINVAL;
-                        len = 0;
-                        goto out;
-                }
-                rsp.dict.dict_val = GF_CALLOC (1, len, gf_server_mt_rsp_buf_t);
-                if (!rsp.dict.dict_val) {
-                        op_ret = -1;
-                        op_errno = ENOMEM;
-                        len = 0;
-                        goto out;
-                }
-                ret = dict_serialize (dict, rsp.dict.dict_val);
-                if (ret < 0) {
-                        gf_log (this->name, GF_LOG_ERROR,
-                                "%s (%"PRId64"): failed to serialize reply dict",
-                                state->loc.path, state->loc.inode->ino);
-                        op_ret = -1;
-                        op_errno = -ret;
-                        len = 0;
-                }
-        }
 out:
         req               = frame->local;
 
         rsp.op_ret        = op_ret;
         rsp.op_errno      = gf_errno_to_error (op_errno);
-        rsp.dict.dict_len = len;
-
-        server_submit_reply (frame, req, &rsp, NULL, 0, NULL,
-                             xdr_serialize_xattrop_rsp);
 
-        if (rsp.dict.dict_val)
-                GF_FREE (rsp.dict.dict_val);
+        server_submit_dict_reply (frame, req, &rsp, NULL, 0, NULL,
+                                  xdr_serialize_xattrop_rsp,
+                                  (op_ret >= 0) ? dict : NULL);
 
         return 0;
 }
@@ -1582,8 +1512,6 @@ server_fxattrop_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                      int32_t op_ret, int32_t op_errno, dict_t *dict)
 {
         gfs3_xattrop_rsp  rsp   = {0,};
-        int32_t           len   = 0;
-        int32_t           ret   = -1;
         server_state_t   *state = NULL;
         rpcsvc_request_t *req   = NULL;
 
@@ -1598,48 +1526,15 @@ server_fxattrop_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                 goto out;
         }
 
-        if ((op_ret >= 0) && dict) {
-                len = dict_serialized_length (dict);
-                if (len < 0) {
-                        gf_log (this->name, GF_LOG_ERROR,
-                                "fd - %"PRId64" (%"PRId64"): failed to get "
-                                "serialized length for reply dict",
-                                state->resolve.fd_no, state->fd->inode->ino);
-                        op_ret = -1;
-                        op_errno = EINVAL;
-                        len = 0;
-                        goto out;
-                }
-                rsp.dict.dict_val = GF_CALLOC (1, len, gf_server_mt_rsp_buf_t);
-                if (!rsp.dict.dict_val) {
-                        op_ret = -1;
-                        op_errno = ENOMEM;
-                        len = 0;
-                        goto out;
-                }
-                ret = dict_serialize (dict, rsp.dict.dict_val);
-                if (ret < 0) {
-                        gf_log (this->name, GF_LOG_ERROR,
-                                "fd - %"PRId64" (%"PRId64"): failed to "
-                                "serialize reply dict",
-                                state->resolve.fd_no, state->fd->inode->ino);
-                        op_ret = -1;
-                        op_errno = -ret;
-                        len = 0;
-                }
-        }
 out:
         req               = frame->local;
 
         rsp.op_ret        = op_ret;
         rsp.op_errno      = gf_errno_to_error (op_errno);
-        rsp.dict.dict_len = len;
-
-        server_submit_reply (frame, req, &rsp, NULL, 0, NULL,
-                             xdr_serialize_fxattrop_rsp);
 
-        if (rsp.dict.dict_val)
-                GF_FREE (rsp.dict.dict_val);
+        server_submit_dict_reply (frame, req, &rsp, NULL, 0, NULL,
+                                  xdr_serialize_fxattrop_rsp,
+                                  (op_ret >= 0) ? dict : NULL);
 
         return 0;
 }
@@ -2792,7 +2687,6 @@ server_create (rpcsvc_request_t *req)
         server_state_t      *state                  = NULL;
         call_frame_t        *frame                  = NULL;
         dict_t              *params                 = NULL;
-        char                *buf                    = NULL;
         gfs3_create_req      args                   = {{0,},};
         int                  ret                    = -1;
 
@@ -2826,15 +2720,9 @@ server_create (rpcsvc_request_t *req)
                 /* Unserialize the dictionary */
                 params = dict_new ();
 
-                buf = memdup (args.dict.dict_val, args.dict.dict_len);
-                if (buf == NULL) {
-                        gf_log (state->conn->bound_xl->name, GF_LOG_ERROR,
-                                "out of memory");
-                        goto out;
-                }
-
-                ret = dict_unserialize (buf, args.dict.dict_len,
-                                        &params);
+                ret = dict_unserialize_nocopy (args.dict.dict_val,
+                                               args.dict.dict_len, &params);
+                args.dict.dict_val = NULL;
                 if (ret < 0) {
                         gf_log (state->conn->bound_xl->name, GF_LOG_ERROR,
                                 "%"PRId64": %s (%"PRId64"): failed to "
@@ -2845,10 +2733,6 @@ server_create (rpcsvc_request_t *req)
                 }
 
                 state->params = params;
-
-                params->extra_free = buf;
-
-                buf = NULL;
         }
 
         state->resolve.type   = RESOLVE_NOT;
@@ -2871,10 +2755,6 @@ out:
         if (params)
                 dict_unref (params);
 
-        if (buf) {
-                GF_FREE (buf);
-        }
-
         /* memory allocated by libc, don't use GF_FREE */
         if (args.dict.dict_val != NULL) {
                 free (args.dict.dict_val);
@@ -3368,7 +3248,6 @@ server_setxattr (rpcsvc_request_t *req)
         dict_t              *dict                  = NULL;
         call_frame_t        *frame                 = NULL;
         server_connection_t *conn                  = NULL;
-        char                *buf                   = NULL;
         gfs3_setxattr_req    args                  = {{0,},};
         int32_t              ret                   = -1;
 
@@ -3378,7 +3257,6 @@ server_setxattr (rpcsvc_request_t *req)
         conn = req->trans->xl_private;
 
         args.path          = alloca (req->msg[0].iov_len);
-        args.dict.dict_val = alloca (req->msg[0].iov_len);
 
         if (!xdr_to_setxattr_req (req->msg[0], &args)) {
                 //failed to decode msg;
@@ -3408,10 +3286,9 @@ server_setxattr (rpcsvc_request_t *req)
 
         if (args.dict.dict_len) {
                 dict = dict_new ();
-                buf = memdup (args.dict.dict_val, args.dict.dict_len);
-                GF_VALIDATE_OR_GOTO (conn->bound_xl->name, buf, out);
-
-                ret = dict_unserialize (buf, args.dict.dict_len, &dict);
+                ret = dict_unserialize_nocopy (args.dict.dict_val,
+                                               args.dict.dict_len, &dict);
+                args.dict.dict_val = NULL;
                 if (ret < 0) {
                         gf_log (conn->bound_xl->name, GF_LOG_ERROR,
                                 "%"PRId64": %s (%"PRId64"): failed to "
@@ -3421,9 +3298,6 @@ server_setxattr (rpcsvc_request_t *req)
                         goto err;
                 }
 
-                dict->extra_free = buf;
-                buf = NULL;
-
                 state->dict = dict;
         }
 
@@ -3441,8 +3315,10 @@ err:
         server_setxattr_cbk (frame, NULL, frame->this, -1, EINVAL);
         ret = 0;
 out:
-        if (buf)
-                GF_FREE (buf);
+        /* memory allocated by libc, don't use GF_FREE */
+        if (args.dict.dict_val != NULL) {
+                free (args.dict.dict_val);
+        }
         return ret;
 
 }
@@ -3456,7 +3332,6 @@ server_fsetxattr (rpcsvc_request_t *req)
         dict_t              *dict                 = NULL;
         server_connection_t *conn                 = NULL;
         call_frame_t        *frame                = NULL;
-        char                *buf                  = NULL;
         gfs3_fsetxattr_req   args                 = {{0,},};
         int32_t              ret                  = -1;
 
@@ -3465,7 +3340,6 @@ server_fsetxattr (rpcsvc_request_t *req)
 
         conn = req->trans->xl_private;
 
-        args.dict.dict_val = alloca (req->msg[0].iov_len);
         if (!xdr_to_fsetxattr_req (req->msg[0], &args)) {
                 //failed to decode msg;
                 req->rpc_err = GARBAGE_ARGS;
@@ -3493,10 +3367,9 @@ server_fsetxattr (rpcsvc_request_t *req)
 
         if (args.dict.dict_len) {
                 dict = dict_new ();
-                buf = memdup (args.dict.dict_val, args.dict.dict_len);
-                GF_VALIDATE_OR_GOTO (conn->bound_xl->name, buf, out);
-
-                ret = dict_unserialize (buf, args.dict.dict_len, &dict);
+                ret = dict_unserialize_nocopy (args.dict.dict_val,
+                                               args.dict.dict_len, &dict);
+                args.dict.dict_val = NULL;
                 if (ret < 0) {
                         gf_log (conn->bound_xl->name, GF_LOG_ERROR,
                                 "%"PRId64": %s (%"PRId64"): failed to "
@@ -3505,8 +3378,6 @@ server_fsetxattr (rpcsvc_request_t *req)
                                 state->resolve.ino);
                         goto err;
                 }
-                dict->extra_free = buf;
-                buf = NULL;
                 state->dict = dict;
         }
 
@@ -3521,8 +3392,10 @@ err:
         server_setxattr_cbk (frame, NULL, frame->this, -1, EINVAL);
         ret = 0;
 out:
-        if (buf)
-                GF_FREE (buf);
+        /* memory allocated by libc, don't use GF_FREE */
+        if (args.dict.dict_val != NULL) {
+                free (args.dict.dict_val);
+        }
         return ret;
 }
 
@@ -3535,7 +3408,6 @@ server_fxattrop (rpcsvc_request_t *req)
         server_state_t      *state                = NULL;
         server_connection_t *conn                 = NULL;
         call_frame_t        *frame                = NULL;
-        char                *buf                   = NULL;
         gfs3_fxattrop_req    args                 = {{0,},};
         int32_t              ret                  = -1;
 
@@ -3544,7 +3416,6 @@ server_fxattrop (rpcsvc_request_t *req)
 
         conn = req->trans->xl_private;
 
-        args.dict.dict_val = alloca (req->msg[0].iov_len);
         if (!xdr_to_fxattrop_req (req->msg[0], &args)) {
                 //failed to decode msg;
                 req->rpc_err = GARBAGE_ARGS;
@@ -3575,10 +3446,9 @@ server_fxattrop (rpcsvc_request_t *req)
                 /* Unserialize the dictionary */
                 dict = dict_new ();
 
-                buf = memdup (args.dict.dict_val, args.dict.dict_len);
-                GF_VALIDATE_OR_GOTO (conn->bound_xl->name, buf, out);
-
-                ret = dict_unserialize (buf, args.dict.dict_len, &dict);
+                ret = dict_unserialize_nocopy (args.dict.dict_val,
+                                               args.dict.dict_len, &dict);
+                args.dict.dict_val = NULL;
                 if (ret < 0) {
                         gf_log (conn->bound_xl->name, GF_LOG_ERROR,
                                 "fd - %"PRId64" (%"PRId64"): failed to unserialize "
@@ -3586,8 +3456,6 @@ server_fxattrop (rpcsvc_request_t *req)
                                 state->resolve.fd_no, state->fd->inode->ino);
                         goto fail;
                 }
-                dict->extra_free = buf;
-                buf = NULL;
 
                 state->dict = dict;
         }
@@ -3604,6 +3472,10 @@ fail:
         server_fxattrop_cbk (frame, NULL, frame->this, -1, EINVAL, NULL);
         ret = 0;
 out:
+        /* memory allocated by libc, don't use GF_FREE */
+        if (args.dict.dict_val != NULL) {
+                free (args.dict.dict_val);
+        }
         return ret;
 }
 
@@ -3616,7 +3488,6 @@ server_xattrop (rpcsvc_request_t *req)
         server_state_t      *state                 = NULL;
         server_connection_t *conn                  = NULL;
         call_frame_t        *frame                 = NULL;
-        char                *buf                   = NULL;
         gfs3_xattrop_req     args                  = {{0,},};
         int32_t              ret                   = -1;
 
@@ -3625,7 +3496,6 @@ server_xattrop (rpcsvc_request_t *req)
 
         conn = req->trans->xl_private;
 
-        args.dict.dict_val = alloca (req->msg[0].iov_len);
         args.path          = alloca (req->msg[0].iov_len);
 
         if (!xdr_to_xattrop_req (req->msg[0], &args)) {
@@ -3658,10 +3528,9 @@ server_xattrop (rpcsvc_request_t *req)
                 /* Unserialize the dictionary */
                 dict = dict_new ();
 
-                buf = memdup (args.dict.dict_val, args.dict.dict_len);
-                GF_VALIDATE_OR_GOTO (conn->bound_xl->name, buf, out);
-
-                ret = dict_unserialize (buf, args.dict.dict_len, &dict);
+                ret = dict_unserialize_nocopy (args.dict.dict_val,
+                                               args.dict.dict_len, &dict);
+                args.dict.dict_val = NULL;
                 if (ret < 0) {
                         gf_log (conn->bound_xl->name, GF_LOG_ERROR,
                                 "fd - %"PRId64" (%"PRId64"): failed to unserialize "
@@ -3669,8 +3538,6 @@ server_xattrop (rpcsvc_request_t *req)
                                 state->resolve.fd_no, state->fd->inode->ino);
                         goto fail;
                 }
-                dict->extra_free = buf;
-                buf = NULL;
 
                 state->dict = dict;
         }
@@ -3686,6 +3553,10 @@ fail:
         server_xattrop_cbk (frame, NULL, frame->this, -1, EINVAL, NULL);
         ret = 0;
 out:
+        /* memory allocated by libc, don't use GF_FREE */
+        if (args.dict.dict_val != NULL) {
+                free (args.dict.dict_val);
+        }
         return ret;
 }
 
@@ -4041,7 +3912,6 @@ server_mknod (rpcsvc_request_t *req)
         server_state_t      *state                  = NULL;
         call_frame_t        *frame                  = NULL;
         dict_t              *params                 = NULL;
-        char                *buf                    = NULL;
         gfs3_mknod_req       args                   = {{0,},};
         int                  ret                    = -1;
 
@@ -4076,15 +3946,9 @@ server_mknod (rpcsvc_request_t *req)
                 /* Unserialize the dictionary */
                 params = dict_new ();
 
-                buf = memdup (args.dict.dict_val, args.dict.dict_len);
-                if (buf == NULL) {
-                        gf_log (state->conn->bound_xl->name, GF_LOG_ERROR,
-                                "out of memory");
-                        goto out;
-                }
-
-                ret = dict_unserialize (buf, args.dict.dict_len,
-                                        &params);
+                ret = dict_unserialize_nocopy (args.dict.dict_val,
+                                               args.dict.dict_len, &params);
+                args.dict.dict_val = NULL;
                 if (ret < 0) {
                         gf_log (state->conn->bound_xl->name, GF_LOG_ERROR,
                                 "%"PRId64": %s (%"PRId64"): failed to "
@@ -4095,10 +3959,6 @@ server_mknod (rpcsvc_request_t *req)
                 }
 
                 state->params = params;
-
-                params->extra_free = buf;
-
-                buf = NULL;
         }
 
         state->resolve.type    = RESOLVE_NOT;
@@ -4122,10 +3982,6 @@ out:
         if (params)
                 dict_unref (params);
 
-        if (buf) {
-                GF_FREE (buf);
-        }
-
         /* memory allocated by libc, don't use GF_FREE */
         if (args.dict.dict_val != NULL) {
                 free (args.dict.dict_val);
@@ -4142,7 +3998,6 @@ server_mkdir (rpcsvc_request_t *req)
         server_state_t      *state                  = NULL;
         call_frame_t        *frame                  = NULL;
         dict_t              *params                 = NULL;
-        char                *buf                    = NULL;
         gfs3_mkdir_req       args                   = {{0,},};
         int                  ret                    = -1;
 
@@ -4176,15 +4031,9 @@ server_mkdir (rpcsvc_request_t *req)
                 /* Unserialize the dictionary */
                 params = dict_new ();
 
-                buf = memdup (args.dict.dict_val, args.dict.dict_len);
-                if (buf == NULL) {
-                        gf_log (state->conn->bound_xl->name, GF_LOG_ERROR,
-                                "out of memory");
-                        goto out;
-                }
-
-                ret = dict_unserialize (buf, args.dict.dict_len,
-                                        &params);
+                ret = dict_unserialize_nocopy (args.dict.dict_val,
+                                               args.dict.dict_len, &params);
+                args.dict.dict_val = NULL;
                 if (ret < 0) {
                         gf_log (state->conn->bound_xl->name, GF_LOG_ERROR,
                                 "%"PRId64": %s (%"PRId64"): failed to "
@@ -4195,10 +4044,6 @@ server_mkdir (rpcsvc_request_t *req)
                 }
 
                 state->params = params;
-
-                params->extra_free = buf;
-
-                buf = NULL;
         }
 
         state->resolve.type    = RESOLVE_NOT;
@@ -4221,10 +4066,6 @@ out:
         if (params)
                 dict_unref (params);
 
-        if (buf) {
-                GF_FREE (buf);
-        }
-
         if (args.dict.dict_val != NULL) {
                 /* memory allocated by libc, don't use GF_FREE */
                 free (args.dict.dict_val);
@@ -4588,7 +4429,6 @@ server_symlink (rpcsvc_request_t *req)
         server_state_t      *state                 = NULL;
         call_frame_t        *frame                 = NULL;
         dict_t              *params                = NULL;
-        char                *buf                   = NULL;
         gfs3_symlink_req     args                  = {{0,},};
         int                  ret                   = -1;
 
@@ -4624,15 +4464,9 @@ server_symlink (rpcsvc_request_t *req)
                 /* Unserialize the dictionary */
                 params = dict_new ();
 
-                buf = memdup (args.dict.dict_val, args.dict.dict_len);
-                if (buf == NULL) {
-                        gf_log (state->conn->bound_xl->name, GF_LOG_ERROR,
-                                "out of memory");
-                        goto out;
-                }
-
-                ret = dict_unserialize (buf, args.dict.dict_len,
-                                        &params);
+                ret = dict_unserialize_nocopy (args.dict.dict_val,
+                                               args.dict.dict_len, &params);
+                args.dict.dict_val = NULL;
                 if (ret < 0) {
                         gf_log (state->conn->bound_xl->name, GF_LOG_ERROR,
                                 "%"PRId64": %s (%"PRId64"): failed to "
@@ -4643,10 +4477,6 @@ server_symlink (rpcsvc_request_t *req)
                 }
 
                 state->params = params;
-
-                params->extra_free = buf;
-
-                buf = NULL;
         }
 
         state->resolve.type   = RESOLVE_NOT;
@@ -4667,10 +4497,6 @@ out:
         if (params)
                 dict_unref (params);
 
-        if (buf) {
-                GF_FREE (buf);
-        }
-
         /* memory allocated by libc, don't use GF_FREE */
         if (args.dict.dict_val != NULL) {
                 free (args.dict.dict_val);
@@ -4942,7 +4768,6 @@ server_lookup (rpcsvc_request_t *req)
         server_connection_t *conn                   = NULL;
         server_state_t      *state                  = NULL;
         dict_t              *xattr_req              = NULL;
-        char                *buf                    = NULL;
         gfs3_lookup_req      args                   = {{0,},};
         int                  ret                    = -1;
 
@@ -4953,7 +4778,6 @@ server_lookup (rpcsvc_request_t *req)
 
         args.path          = alloca (req->msg[0].iov_len);
         args.bname         = alloca (req->msg[0].iov_len);
-        args.dict.dict_val = alloca (req->msg[0].iov_len);
 
         if (!xdr_to_lookup_req (req->msg[0], &args)) {
                 //failed to decode msg;
@@ -4993,15 +4817,9 @@ server_lookup (rpcsvc_request_t *req)
                 /* Unserialize the dictionary */
                 xattr_req = dict_new ();
 
-                buf = memdup (args.dict.dict_val, args.dict.dict_len);
-                if (buf == NULL) {
-                        gf_log (conn->bound_xl->name, GF_LOG_ERROR,
-                                "out of memory");
-                        goto out;
-                }
-
-                ret = dict_unserialize (buf, args.dict.dict_len,
-                                        &xattr_req);
+                ret = dict_unserialize_nocopy (args.dict.dict_val,
+                                               args.dict.dict_len, &xattr_req);
+                args.dict.dict_val = NULL;
                 if (ret < 0) {
                         gf_log (conn->bound_xl->name, GF_LOG_ERROR,
                                 "%"PRId64": %s (%"PRId64"): failed to "
@@ -5012,10 +4830,6 @@ server_lookup (rpcsvc_request_t *req)
                 }
 
                 state->dict = xattr_req;
-
-                xattr_req->extra_free = buf;
-
-                buf = NULL;
         }
 
         ret = 0;
@@ -5026,14 +4840,14 @@ out:
         if (xattr_req)
                 dict_unref (xattr_req);
 
-        if (buf) {
-                GF_FREE (buf);
-        }
-
         server_lookup_cbk (frame, NULL, frame->this, -1, EINVAL, NULL, NULL,
                            NULL, NULL);
         ret = 0;
 err:
+        /* memory allocated by libc, don't use GF_FREE */
+        if (args.dict.dict_val != NULL) {
+                free (args.dict.dict_val);
+        }
         return ret;
 }
 
@@ -4171,6 +4171,7 @@ posix_rchecksum (call_frame_t *frame, xlator_t *this,
         uint64_t  tmp_pfd  =  0;
 
         struct posix_fd *pfd  = NULL;
+        struct posix_private *priv = NULL;
 
         int op_ret   = -1;
         int op_errno = 0;
@@ -4215,8 +4216,11 @@ posix_rchecksum (call_frame_t *frame, xlator_t *this,
                 goto out;
         }
 
+        priv = this->private;
+
         weak_checksum = gf_rsync_weak_checksum (buf, len);
-        gf_rsync_strong_checksum (buf, len, strong_checksum);
+        gf_rsync_strong_checksum_type (priv->rchecksum_type, buf, len,
+                                       strong_checksum);
 
         GF_FREE (buf);
 
@@ -4286,6 +4290,7 @@ init (xlator_t *this)
         int                    ret           = 0;
         int                    op_ret        = -1;
         int32_t                janitor_sleep = 0;
+        int                    rchecksum_type = 0;
 
         dir_data = dict_get (this->options, "directory");
 
@@ -4460,6 +4465,27 @@ init (xlator_t *this)
 		_private->janitor_sleep_duration = janitor_sleep;
 	}
 
+        _private->rchecksum_type = GF_RSYNC_STRONG_MD5;
+
+        tmp_data = dict_get (this->options, "rchecksum-strong-hash");
+        if (tmp_data) {
+                rchecksum_type = gf_rsync_strong_type_get (tmp_data->data);
+                if (rchecksum_type < 0) {
+                        ret = -1;
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "wrong value '%s' for 'rchecksum-strong-hash'",
+                                tmp_data->data);
+                        goto out;
+                }
+
+                _private->rchecksum_type = rchecksum_type;
+        }
+
+        gf_log (this->name, GF_LOG_DEBUG,
+                "rchecksum uses %s weak and %s strong checksums",
+                gf_rsync_weak_checksum_impl (),
+                gf_rsync_strong_type_name (_private->rchecksum_type));
+
 #ifndef GF_DARWIN_HOST_OS
         {
                 struct rlimit lim;
@@ -4579,5 +4605,12 @@ struct volume_options options[] = {
           .type = GF_OPTION_TYPE_BOOL },
         { .key  = {"janitor-sleep-duration"},
           .type = GF_OPTION_TYPE_INT },
+        { .key  = {"rchecksum-strong-hash"},
+          .type = GF_OPTION_TYPE_STR,
+          .value = {"md5", "murmur3"},
+          .description = "Strong checksum returned by rchecksum for the "
+                         "diff self-heal of replicate. All the bricks of a "
+                         "replica set must use the same one."
+        },
 	{ .key  = {NULL} }
 };
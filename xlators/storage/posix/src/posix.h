@@ -81,6 +81,8 @@ struct posix_private {
 
         time_t last_landfill_check;
         int32_t janitor_sleep_duration;
+
+        int     rchecksum_type;  /* gf_rsync_strong_type_t of rchecksum */
         struct list_head janitor_fds;
         pthread_cond_t janitor_cond;
         pthread_mutex_t janitor_lock;